@@ -119,6 +119,7 @@ testScripts = [
     'mempool_spendcoinbase.py',
     'mempool_reorg.py',
     'mempool_limit.py',
+    'mempool_persist.py',
     'httpbasics.py',
     'multi_rpc.py',
     'zapwallettxes.py',
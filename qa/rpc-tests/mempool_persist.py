@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# Copyright (c) 2014-2016 The Bitcoin Core developers
+# Copyright (c) 2018-2020 The SmartCash developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test that the mempool, with the entry times and fee deltas of its
+# transactions, is written to mempool.dat on shutdown and loaded again
+# on restart, unless -persistmempool=0 is given.
+#
+
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+class MempoolPersistTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 2
+        self.setup_clean_chain = False
+
+    def setup_network(self):
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, [[], ["-persistmempool=0"]])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.is_network_split = False
+
+    def wait_for_mempool_size(self, node, size, timeout=60):
+        # The mempool is loaded in the background after startup
+        while timeout > 0 and len(node.getrawmempool()) != size:
+            time.sleep(0.25)
+            timeout -= 0.25
+        assert_equal(len(node.getrawmempool()), size)
+
+    def restart_nodes(self, extra_args):
+        stop_nodes(self.nodes)
+        self.nodes = start_nodes(len(extra_args), self.options.tmpdir, extra_args)
+
+    def run_test(self):
+        txids = []
+        for i in range(5):
+            txids.append(self.nodes[0].sendtoaddress(self.nodes[0].getnewaddress(), Decimal("0.01")))
+        self.nodes[0].prioritisetransaction(txids[0], 0, 10000)
+        sync_mempools(self.nodes)
+        assert_equal(len(self.nodes[0].getrawmempool()), 5)
+        assert_equal(len(self.nodes[1].getrawmempool()), 5)
+        entries = self.nodes[0].getrawmempool(True)
+
+        # The wallet would add its transactions back to the mempool by itself
+        print("Restart, node0 loads its mempool and node1 doesn't")
+        self.restart_nodes([["-walletbroadcast=0"], ["-persistmempool=0"]])
+        self.wait_for_mempool_size(self.nodes[0], 5)
+        time.sleep(1)
+        assert_equal(len(self.nodes[1].getrawmempool()), 0)
+
+        # Entry times and fee deltas survive the restart
+        loaded = self.nodes[0].getrawmempool(True)
+        for txid in txids:
+            assert_equal(loaded[txid]["time"], entries[txid]["time"])
+            assert_equal(loaded[txid]["modifiedfee"], entries[txid]["modifiedfee"])
+        assert_equal(loaded[txids[0]]["modifiedfee"], loaded[txids[0]]["fee"] + Decimal("0.0001"))
+
+        print("Restart node0 with -persistmempool=0, it doesn't load mempool.dat")
+        self.restart_nodes([["-walletbroadcast=0", "-persistmempool=0"]])
+        time.sleep(1)
+        assert_equal(len(self.nodes[0].getrawmempool()), 0)
+
+        print("Restart node0 again, mempool.dat wasn't overwritten in the meantime")
+        self.restart_nodes([["-walletbroadcast=0"]])
+        self.wait_for_mempool_size(self.nodes[0], 5)
+
+        # A reorg adds the parent back after its child is in the mempool
+        print("Reorg a parent back into the mempool, it is still written before its child")
+        self.restart_nodes([[]])
+        self.wait_for_mempool_size(self.nodes[0], 5)
+        address = self.nodes[0].getnewaddress()
+        parent = self.nodes[0].sendtoaddress(address, Decimal("0.01"))
+        blockhash = self.nodes[0].generate(1)[0]
+        assert_equal(len(self.nodes[0].getrawmempool()), 0)
+        vout = [out["n"] for out in self.nodes[0].getrawtransaction(parent, 1)["vout"]
+                 if out["scriptPubKey"].get("addresses") == [address]][0]
+        rawtx = self.nodes[0].createrawtransaction([{"txid": parent, "vout": vout}],
+                                                  {self.nodes[0].getnewaddress(): Decimal("0.009")})
+        child = self.nodes[0].sendrawtransaction(self.nodes[0].signrawtransaction(rawtx)["hex"])
+        self.nodes[0].invalidateblock(blockhash)
+        assert(parent in self.nodes[0].getrawmempool())
+        assert(child in self.nodes[0].getrawmempool())
+        size = len(self.nodes[0].getrawmempool())
+
+        self.restart_nodes([["-walletbroadcast=0"]])
+        self.wait_for_mempool_size(self.nodes[0], size)
+        assert(child in self.nodes[0].getrawmempool())
+
+if __name__ == '__main__':
+    MempoolPersistTest().main()
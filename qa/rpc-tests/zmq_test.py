@@ -11,10 +11,55 @@ from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import *
 import zmq
 import struct
+from io import BytesIO
 
 import http.client
 import urllib.parse
 
+def read_compact_size(f):
+    n = struct.unpack("<B", f.read(1))[0]
+    if n == 253:
+        n = struct.unpack("<H", f.read(2))[0]
+    elif n == 254:
+        n = struct.unpack("<I", f.read(4))[0]
+    elif n == 255:
+        n = struct.unpack("<Q", f.read(8))[0]
+    return n
+
+def parse_address_delta(body):
+    # block hash, height, connected flag, then type, hash160, balance and received change per address
+    f = BytesIO(body)
+    blockhash = bytes_to_hex_str(f.read(32)[::-1])
+    height, connected = struct.unpack("<iB", f.read(5))
+    deltas = []
+    for i in range(read_compact_size(f)):
+        addrtype = struct.unpack("<B", f.read(1))[0]
+        hash160 = bytes_to_hex_str(f.read(20))
+        balance, received = struct.unpack("<qq", f.read(16))
+        deltas.append((addrtype, hash160, balance, received))
+    assert_equal(f.read(), b"")
+    return blockhash, height, connected, deltas
+
+def parse_rewards_round(body):
+    # event, round number, start/end heights and times, eligible/disqualified entries and amounts, rewards, payees, paid
+    assert_equal(len(body), struct.calcsize("<BH11q"))
+    fields = struct.unpack("<BH11q", body)
+    assert(fields[0] in (0, 1, 2))
+    return fields
+
+def parse_smartnode_list(body):
+    f = BytesIO(body)
+    added = []
+    for i in range(read_compact_size(f)):
+        outpoint = f.read(36)
+        addr = f.read(18)
+        pubkeys = [f.read(read_compact_size(f)) for j in range(2)]
+        protocol, sigtime = struct.unpack("<iq", f.read(12))
+        added.append((outpoint, addr, pubkeys, protocol, sigtime))
+    removed = [f.read(36) for i in range(read_compact_size(f))]
+    assert_equal(f.read(), b"")
+    return added, removed
+
 class ZMQTest (BitcoinTestFramework):
 
     def __init__(self):
@@ -29,13 +74,48 @@ class ZMQTest (BitcoinTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % self.port)
+
+        # The other topics on a socket of their own, so the ones above arrive like before
+        self.zmqSubSocketNew = self.zmqContext.socket(zmq.SUB)
+        self.zmqSubSocketNew.setsockopt(zmq.RCVTIMEO, 60000)
+        for topic in [b"rawtx", b"addressdelta", b"rewardsround", b"smartnodelist"]:
+            self.zmqSubSocketNew.setsockopt(zmq.SUBSCRIBE, topic)
+        self.zmqSubSocketNew.connect("tcp://127.0.0.1:%i" % self.port)
+        self.newSequence = {}
+
+        address = "tcp://127.0.0.1:%i" % self.port
         return start_nodes(self.num_nodes, self.options.tmpdir, extra_args=[
-            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)],
+            ['-addressindex'] + ['-zmqpub%s=%s' % (topic, address) for topic in
+                                 ["hashtx", "hashblock", "rawtx", "addressdelta", "rewardsround", "smartnodelist"]],
             [],
             [],
             []
             ])
 
+    def recv_new(self, topic, match):
+        # Skip to the next message of topic that matches, every message on the way has to be well formed
+        while True:
+            msg = self.zmqSubSocketNew.recv_multipart()
+            assert_equal(len(msg), 3)
+            msgSequence = struct.unpack('<I', msg[-1])[-1]
+            if msg[0] in self.newSequence:
+                assert_equal(msgSequence, self.newSequence[msg[0]] + 1)
+            self.newSequence[msg[0]] = msgSequence
+
+            if msg[0] == b"rawtx":
+                self.nodes[0].decoderawtransaction(bytes_to_hex_str(msg[1]))
+            elif msg[0] == b"addressdelta":
+                parse_address_delta(msg[1])
+            elif msg[0] == b"rewardsround":
+                parse_rewards_round(msg[1])
+            elif msg[0] == b"smartnodelist":
+                parse_smartnode_list(msg[1])
+            else:
+                raise AssertionError("unexpected topic %s" % msg[0])
+
+            if msg[0] == topic and match(msg[1]):
+                return msg[1]
+
     def run_test(self):
         self.sync_all()
 
@@ -60,6 +140,24 @@ class ZMQTest (BitcoinTestFramework):
 
         assert_equal(genhashes[0], blkhash) #blockhash from generate must be equal to the hash received over zmq
 
+        # rawtx of the coinbase, unchanged by the new topics
+        coinbase = self.nodes[0].getblock(genhashes[0])["tx"][0]
+        body = self.recv_new(b"rawtx", lambda body: self.nodes[0].decoderawtransaction(bytes_to_hex_str(body))["txid"] == coinbase)
+        rawcoinbase = self.nodes[0].decoderawtransaction(bytes_to_hex_str(body))
+
+        # addressdelta of the block, only the coinbase outputs were added
+        body = self.recv_new(b"addressdelta", lambda body: parse_address_delta(body)[0] == genhashes[0])
+        blockhash, height, connected, deltas = parse_address_delta(body)
+        assert_equal(height, self.nodes[0].getblockcount())
+        assert_equal(connected, 1)
+        assert(len(deltas) > 0)
+        for addrtype, hash160, balance, received in deltas:
+            assert(addrtype in (1, 2))
+            assert(balance > 0)
+            assert_equal(balance, received)
+        paid = sum(out["value"] for out in rawcoinbase["vout"] if out["scriptPubKey"]["type"] in ("pubkeyhash", "scripthash"))
+        assert_equal(sum(delta[2] for delta in deltas), int(paid * 100000000))
+
         n = 10
         genhashes = self.nodes[1].generate(n)
         self.sync_all()
@@ -79,6 +177,11 @@ class ZMQTest (BitcoinTestFramework):
         for x in range(0,n):
             assert_equal(genhashes[x], zmqHashes[x]) #blockhash from generate must be equal to the hash received over zmq
 
+        # node0 indexes the blocks of node1 in chain order
+        for x in range(0,n):
+            body = self.recv_new(b"addressdelta", lambda body: parse_address_delta(body)[0] == genhashes[x])
+        tipdeltas = parse_address_delta(body)[3]
+
         #test tx from a second node
         hashRPC = self.nodes[1].sendtoaddress(self.nodes[0].getnewaddress(), 1.0)
         self.sync_all()
@@ -95,6 +198,21 @@ class ZMQTest (BitcoinTestFramework):
 
         assert_equal(hashRPC, hashZMQ) #blockhash from generate must be equal to the hash received over zmq
 
+        # rawtx of the relayed transaction
+        body = self.recv_new(b"rawtx", lambda body: self.nodes[0].decoderawtransaction(bytes_to_hex_str(body))["txid"] == hashRPC)
+        assert_equal(bytes_to_hex_str(body), self.nodes[0].getrawtransaction(hashRPC))
+
+        # Disconnecting a block reverts its address deltas
+        tip = self.nodes[0].getbestblockhash()
+        assert_equal(tip, genhashes[-1])
+        self.nodes[0].invalidateblock(tip)
+        body = self.recv_new(b"addressdelta", lambda body: parse_address_delta(body)[0] == tip)
+        blockhash, height, connected, deltas = parse_address_delta(body)
+        assert_equal(connected, 0)
+        assert_equal(sorted(deltas), sorted((t, h, -b, -r) for t, h, b, r in tipdeltas))
+        self.nodes[0].reconsiderblock(tip)
+        assert_equal(self.nodes[0].getbestblockhash(), tip)
+
 
 if __name__ == '__main__':
     ZMQTest ().main ()
@@ -0,0 +1,242 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "asynclog.h"
+
+#include "tinyformat.h"
+#include "utiltime.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+
+//! Messages written between two flushes while the queue doesn't run dry
+static const size_t LOGWRITER_BATCH = 1024;
+
+CAsyncLogWriter::CAsyncLogWriter(const WriteFunction& write, const FlushFunction& flush, bool fDropOverflow,
+                                 size_t nMaxMessages, size_t nMaxBytes) :
+    write(write), flush(flush), fDropOverflow(fDropOverflow), nMaxBytes(nMaxBytes),
+    cells(new Cell[nMaxMessages]), nMask(nMaxMessages - 1),
+    nEnqueuePos(0), nDequeuePos(0), nQueuedBytes(0), nDropped(0), nDroppedTotal(0),
+    fWriterWaiting(false), nPushWaiting(0), fStop(false)
+{
+    assert(nMaxMessages >= 2 && (nMaxMessages & nMask) == 0);
+
+    for (size_t i = 0; i < nMaxMessages; i++)
+        cells[i].nSequence.store(i, std::memory_order_relaxed);
+}
+
+CAsyncLogWriter::~CAsyncLogWriter()
+{
+    Stop();
+}
+
+void CAsyncLogWriter::Start()
+{
+    assert(!thread.joinable());
+    fStop = false;
+    thread = boost::thread(&CAsyncLogWriter::ThreadWriter, this);
+}
+
+void CAsyncLogWriter::Stop()
+{
+    if (!thread.joinable())
+        return;
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+        condWork.notify_one();
+    }
+    thread.join();
+}
+
+bool CAsyncLogWriter::TryPush(int64_t nTimeMicros, std::string& str)
+{
+    // Bounds the memory of large messages, the ring bounds the number of messages.
+    // A message larger than the limit still goes into an empty queue, otherwise
+    // it could never be written and a blocking Push would wait forever.
+    size_t nQueued = nQueuedBytes.load(std::memory_order_relaxed);
+    if (nQueued != 0 && nQueued + str.size() > nMaxBytes)
+        return false;
+
+    Cell* cell;
+    size_t nPos = nEnqueuePos.load(std::memory_order_relaxed);
+
+    while (true) {
+        cell = &cells[nPos & nMask];
+        size_t nSequence = cell->nSequence.load(std::memory_order_acquire);
+        intptr_t nDiff = (intptr_t)nSequence - (intptr_t)nPos;
+
+        if (nDiff == 0) {
+            // The cell is free, claim it
+            if (nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                break;
+        } else if (nDiff < 0) {
+            // The writer didn't take the message of the previous round yet
+            return false;
+        } else {
+            nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    nQueuedBytes.fetch_add(str.size(), std::memory_order_relaxed);
+    cell->nTimeMicros = nTimeMicros;
+    cell->str.swap(str);
+    cell->nSequence.store(nPos + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool CAsyncLogWriter::TryPop(int64_t& nTimeMicros, std::string& str)
+{
+    Cell* cell;
+    size_t nPos = nDequeuePos.load(std::memory_order_relaxed);
+
+    while (true) {
+        cell = &cells[nPos & nMask];
+        size_t nSequence = cell->nSequence.load(std::memory_order_acquire);
+        intptr_t nDiff = (intptr_t)nSequence - (intptr_t)(nPos + 1);
+
+        if (nDiff == 0) {
+            if (nDequeuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                break;
+        } else if (nDiff < 0) {
+            return false;
+        } else {
+            nPos = nDequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    nTimeMicros = cell->nTimeMicros;
+    str.swap(cell->str);
+    cell->str.clear();
+    cell->nSequence.store(nPos + nMask + 1, std::memory_order_release);
+    nQueuedBytes.fetch_sub(str.size(), std::memory_order_relaxed);
+
+    return true;
+}
+
+bool CAsyncLogWriter::Push(int64_t nTimeMicros, std::string&& str)
+{
+    while (!TryPush(nTimeMicros, str)) {
+
+        if (fDropOverflow || !thread.joinable()) {
+            nDropped++;
+            nDroppedTotal++;
+            return false;
+        }
+
+        // Wait for the writer to make room
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nPushWaiting++;
+        condWork.notify_one();
+        condSpace.wait_for(lock, boost::chrono::milliseconds(10));
+        nPushWaiting--;
+    }
+
+    // Pairs with the fence in ThreadWriter: either the writer sees the message
+    // before it goes to sleep or we see that it is waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (fWriterWaiting.load(std::memory_order_relaxed)) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        condWork.notify_one();
+    }
+
+    return true;
+}
+
+size_t CAsyncLogWriter::WriteQueued(size_t nMax)
+{
+    size_t nWritten = 0;
+    int64_t nTimeMicros;
+    std::string str;
+
+    uint64_t nDroppedNow = nDropped.exchange(0);
+    if (nDroppedNow)
+        write(GetTimeMicros(), strprintf("Log queue full, dropped %u messages\n", nDroppedNow));
+
+    while (nWritten < nMax && TryPop(nTimeMicros, str)) {
+        write(nTimeMicros, str);
+        nWritten++;
+    }
+
+    return nWritten;
+}
+
+void CAsyncLogWriter::Drain()
+{
+    WriteQueued(SIZE_MAX);
+    flush();
+}
+
+void CAsyncLogWriter::DrainOnCrash(int fd)
+{
+    // Same as TryPop, but the message is written straight from the cell and the
+    // cell is never handed back, so nothing is allocated or freed.
+    size_t nPos = nDequeuePos.load(std::memory_order_relaxed);
+
+    while (true) {
+        Cell* cell = &cells[nPos & nMask];
+        size_t nSequence = cell->nSequence.load(std::memory_order_acquire);
+        intptr_t nDiff = (intptr_t)nSequence - (intptr_t)(nPos + 1);
+
+        if (nDiff == 0) {
+            if (!nDequeuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                continue;
+            const char* pch = cell->str.data();
+            size_t nLeft = cell->str.size();
+            while (nLeft > 0) {
+                ssize_t nWritten = ::write(fd, pch, nLeft);
+                if (nWritten < 0 && errno == EINTR)
+                    continue;
+                if (nWritten <= 0)
+                    return;
+                pch += nWritten;
+                nLeft -= nWritten;
+            }
+            nPos++;
+        } else if (nDiff < 0) {
+            return;
+        } else {
+            nPos = nDequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void CAsyncLogWriter::ThreadWriter()
+{
+    while (true) {
+
+        size_t nWritten = WriteQueued(LOGWRITER_BATCH);
+
+        if (nPushWaiting.load()) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condSpace.notify_all();
+        }
+
+        if (nWritten == LOGWRITER_BATCH)
+            continue;
+
+        // The queue ran dry, get the messages to the file before waiting for more
+        flush();
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+
+        if (fStop)
+            break;
+
+        fWriterWaiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (nDequeuePos.load() == nEnqueuePos.load() && !nDropped.load())
+            condWork.wait_for(lock, boost::chrono::milliseconds(500));
+
+        fWriterWaiting = false;
+    }
+
+    // Pushes that raced with the shutdown
+    Drain();
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_ASYNCLOG_H
+#define SMARTCASH_ASYNCLOG_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+//! -asynclog default
+static const bool DEFAULT_ASYNCLOG = true;
+//! -logdropoverflow default, block the logging thread while the queue is full
+static const bool DEFAULT_LOGDROPOVERFLOW = false;
+//! Messages waiting for the writer thread, a power of two
+static const size_t LOGQUEUE_MESSAGES = 8192;
+//! Bytes waiting for the writer thread
+static const size_t LOGQUEUE_BYTES = 16 * 1024 * 1024;
+
+/**
+ * Hands log messages from any thread over to a writer thread.
+ *
+ * Messages are kept in a bounded lock-free ring (Vyukov's MPMC queue), so logging
+ * threads never wait for each other or for the disk. If the ring is full, Push
+ * either waits for the writer or drops the message and counts it, depending on
+ * the overflow policy. The writer reports dropped messages in the log.
+ *
+ * The timestamp is taken by the caller but formatted by the writer.
+ */
+class CAsyncLogWriter
+{
+public:
+    //! Write one message, nTimeMicros is -1 for messages without timestamp
+    typedef boost::function<void(int64_t nTimeMicros, const std::string& str)> WriteFunction;
+    typedef boost::function<void()> FlushFunction;
+
+    CAsyncLogWriter(const WriteFunction& write, const FlushFunction& flush, bool fDropOverflow = DEFAULT_LOGDROPOVERFLOW,
+                    size_t nMaxMessages = LOGQUEUE_MESSAGES, size_t nMaxBytes = LOGQUEUE_BYTES);
+    ~CAsyncLogWriter();
+
+    void Start();
+    //! Write everything queued and stop the writer thread
+    void Stop();
+
+    //! Returns false if the message was dropped
+    bool Push(int64_t nTimeMicros, std::string&& str);
+
+    /** Write the queued messages on the calling thread. Used when the process
+     *  is about to die, so it doesn't wait for anything. */
+    void Drain();
+
+    /** Write the queued messages to fd from a signal handler. Only calls write(2):
+     *  no locks, no allocation and no timestamps, the writer formats those. */
+    void DrainOnCrash(int fd);
+
+    uint64_t GetDropped() const { return nDroppedTotal; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> nSequence;
+        int64_t nTimeMicros;
+        std::string str;
+    };
+
+    WriteFunction write;
+    FlushFunction flush;
+    bool fDropOverflow;
+    size_t nMaxBytes;
+
+    std::unique_ptr<Cell[]> cells;
+    size_t nMask;
+    std::atomic<size_t> nEnqueuePos;
+    std::atomic<size_t> nDequeuePos;
+    std::atomic<size_t> nQueuedBytes;
+
+    std::atomic<uint64_t> nDropped;
+    std::atomic<uint64_t> nDroppedTotal;
+
+    boost::mutex mutex;
+    boost::condition_variable condWork;
+    boost::condition_variable condSpace;
+    std::atomic<bool> fWriterWaiting;
+    std::atomic<int> nPushWaiting;
+    std::atomic<bool> fStop;
+    boost::thread thread;
+
+    bool TryPush(int64_t nTimeMicros, std::string& str);
+    bool TryPop(int64_t& nTimeMicros, std::string& str);
+    //! Write up to nMax messages, returns the number written
+    size_t WriteQueued(size_t nMax);
+    void ThreadWriter();
+};
+
+#endif // SMARTCASH_ASYNCLOG_H
@@ -0,0 +1,99 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "coins.h"
+#include "crypto/common.h"
+#include "random.h"
+#include "script/script.h"
+
+#include <vector>
+
+/* Number of outputs touched per run, about the inputs and outputs of a few full blocks */
+static const int COINS_COUNT = 20000;
+
+static std::vector<COutPoint> RandomOutPoints(FastRandomContext& rand, int nCount)
+{
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(nCount);
+    for (int i = 0; i < nCount; i++) {
+        uint256 hash;
+        for (unsigned char* p = hash.begin(); p != hash.end(); p += 4)
+            WriteLE32(p, rand.rand32());
+        outpoints.push_back(COutPoint(hash, rand.rand32() % 4));
+    }
+    return outpoints;
+}
+
+static Coin MakeCoin(int nHeight)
+{
+    // Pay to pubkey hash scripts fit into the prevector without an allocation
+    static const CScript script = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return Coin(CTxOut(nHeight * COIN, script), nHeight, false);
+}
+
+/** Create, look up and spend coins the way ConnectBlock does on top of the tip cache */
+static void CoinsCacheAddAccessSpend(benchmark::State& state)
+{
+    FastRandomContext rand(true);
+    std::vector<COutPoint> outpoints = RandomOutPoints(rand, COINS_COUNT);
+    CCoinsView viewDummy;
+    CCoinsViewCache viewTip(&viewDummy);
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(&viewTip);
+        for (size_t i = 0; i < outpoints.size(); i++)
+            view.AddCoin(outpoints[i], MakeCoin(i + 1), false);
+        CAmount nValue = 0;
+        for (size_t i = 0; i < outpoints.size(); i++)
+            nValue += view.AccessCoin(outpoints[i]).out.nValue;
+        for (size_t i = 0; i < outpoints.size(); i++)
+            view.SpendCoin(outpoints[i]);
+        if (nValue == 0 || view.DynamicMemoryUsage() == 0)
+            throw std::runtime_error("unexpected coins cache state");
+    }
+}
+
+/** Short lived caches with a few coins, like the ones used for every transaction */
+static void CoinsCacheSmallViews(benchmark::State& state)
+{
+    FastRandomContext rand(true);
+    std::vector<COutPoint> outpoints = RandomOutPoints(rand, COINS_COUNT);
+    CCoinsView viewDummy;
+    CCoinsViewCache viewTip(&viewDummy);
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i + 4 <= outpoints.size(); i += 4) {
+            CCoinsViewCache view(&viewTip);
+            for (size_t j = i; j < i + 4; j++)
+                view.AddCoin(outpoints[j], MakeCoin(j + 1), false);
+            if (!view.HaveCoin(outpoints[i]) || view.HaveCoin(outpoints[(i + 4) % outpoints.size()]))
+                throw std::runtime_error("unexpected coins cache state");
+        }
+    }
+}
+
+/** Write a block worth of changes into a large cache and flush that one to its base */
+static void CoinsCacheFlush(benchmark::State& state)
+{
+    FastRandomContext rand(true);
+    std::vector<COutPoint> outpoints = RandomOutPoints(rand, COINS_COUNT);
+    CCoinsView viewDummy;
+    CCoinsViewCache viewBase(&viewDummy);
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache viewTip(&viewBase);
+        for (int nBlock = 0; nBlock < 10; nBlock++) {
+            CCoinsViewCache view(&viewTip);
+            for (size_t i = nBlock; i < outpoints.size(); i += 10)
+                view.AddCoin(outpoints[i], MakeCoin(i + 1), true);
+            view.Flush();
+        }
+        viewTip.Flush();
+    }
+}
+
+BENCHMARK(CoinsCacheAddAccessSpend);
+BENCHMARK(CoinsCacheSmallViews);
+BENCHMARK(CoinsCacheFlush);
@@ -0,0 +1,110 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "asynclog.h"
+#include "hash.h"
+#include "tinyformat.h"
+#include "utiltime.h"
+
+#include <stdio.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+/* Threads logging at the same time, like validation, message handling and the SAPI workers */
+static const int LOG_THREADS = 4;
+/* Messages per thread and run */
+static const int LOG_MESSAGES = 2000;
+
+static void WriteTimestamped(FILE* file, int64_t nTimeMicros, const std::string& str)
+{
+    if (nTimeMicros >= 0) {
+        std::string strStamp = DateTimeStrFormat("%Y-%m-%d %H:%M:%S ", nTimeMicros / 1000000);
+        fwrite(strStamp.data(), 1, strStamp.size(), file);
+    }
+    fwrite(str.data(), 1, str.size(), file);
+}
+
+static void FlushFile(FILE* file)
+{
+    fflush(file);
+}
+
+/** A bit of hashing per message, roughly what is done between two -debug log lines during validation */
+static uint256 ValidateAndLog(int nThread, const boost::function<void(const std::string&)>& log)
+{
+    uint256 hash;
+    for (int i = 0; i < LOG_MESSAGES; i++) {
+        hash = Hash(hash.begin(), hash.end());
+        log(strprintf("ConnectBlock: thread %d checked input %d of tx %s\n", nThread, i, hash.ToString()));
+    }
+    return hash;
+}
+
+static void RunThreads(const boost::function<void(const std::string&)>& log)
+{
+    boost::thread_group threads;
+    for (int i = 0; i < LOG_THREADS; i++)
+        threads.create_thread(boost::bind(ValidateAndLog, i, log));
+    threads.join_all();
+}
+
+static boost::mutex mutexSyncLog;
+
+/** How LogPrintStr wrote debug.log before: format and write unbuffered under a global lock */
+static void SyncLog(FILE* file, const std::string& str)
+{
+    int64_t nTimeMicros = GetTimeMicros();
+    boost::mutex::scoped_lock lock(mutexSyncLog);
+    WriteTimestamped(file, nTimeMicros, str);
+}
+
+static void AsyncLog(CAsyncLogWriter* pwriter, const std::string& str)
+{
+    pwriter->Push(GetTimeMicros(), std::string(str));
+}
+
+static void LogSynchronous(benchmark::State& state)
+{
+    FILE* file = tmpfile();
+    setbuf(file, NULL);
+
+    while (state.KeepRunning())
+        RunThreads(boost::bind(SyncLog, file, _1));
+
+    fclose(file);
+}
+
+static void LogAsynchronous(benchmark::State& state)
+{
+    FILE* file = tmpfile();
+    setvbuf(file, NULL, _IOFBF, 1 << 16);
+    CAsyncLogWriter writer(boost::bind(WriteTimestamped, file, _1, _2), boost::bind(FlushFile, file));
+    writer.Start();
+
+    while (state.KeepRunning())
+        RunThreads(boost::bind(AsyncLog, &writer, _1));
+
+    writer.Stop();
+    fclose(file);
+}
+
+static void LogAsynchronousDrop(benchmark::State& state)
+{
+    FILE* file = tmpfile();
+    setvbuf(file, NULL, _IOFBF, 1 << 16);
+    CAsyncLogWriter writer(boost::bind(WriteTimestamped, file, _1, _2), boost::bind(FlushFile, file), true, 1024);
+    writer.Start();
+
+    while (state.KeepRunning())
+        RunThreads(boost::bind(AsyncLog, &writer, _1));
+
+    writer.Stop();
+    fclose(file);
+}
+
+BENCHMARK(LogSynchronous);
+BENCHMARK(LogAsynchronous);
+BENCHMARK(LogAsynchronousDrop);
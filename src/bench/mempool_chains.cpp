@@ -0,0 +1,156 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "txmempool.h"
+
+#include <list>
+
+/* Unconfirmed chains as long as the ancestor limit lets through with -limitancestorcount raised */
+static const int CHAIN_LENGTH = 500;
+/* Payout fan-out: outputs of the root and the length of the chain spending each of them */
+static const int FANOUT_OUTPUTS = 50;
+static const int FANOUT_DEPTH = 10;
+
+static CMutableTransaction SpendTx(const COutPoint& prevout, int nOutputs, int nTag)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vin[0].scriptSig = CScript() << nTag;
+    tx.vout.resize(nOutputs);
+    for (int i = 0; i < nOutputs; i++) {
+        tx.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[i].nValue = COIN;
+    }
+    return tx;
+}
+
+static void AddTx(CTxMemPool& pool, const CTransaction& tx, CAmount nFee)
+{
+    pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, nFee, 0, 0.0, 1, false, 0, false, 1, LockPoints()));
+}
+
+static std::vector<CTransaction> MakeChain(int nTag)
+{
+    std::vector<CTransaction> vChain;
+    vChain.push_back(SpendTx(COutPoint(), 1, nTag));
+    for (int i = 1; i < CHAIN_LENGTH; i++)
+        vChain.push_back(SpendTx(COutPoint(vChain.back().GetHash(), 0), 1, nTag));
+    return vChain;
+}
+
+static void AddChain(CTxMemPool& pool, const std::vector<CTransaction>& vChain)
+{
+    for (size_t i = 0; i < vChain.size(); i++)
+        AddTx(pool, vChain[i], 1000 + i);
+}
+
+/** A deep chain dropped at once, like when its root conflicts with a block */
+static void MempoolChainRemoveRoot(benchmark::State& state)
+{
+    std::vector<CTransaction> vChain = MakeChain(1);
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    while (state.KeepRunning()) {
+        AddChain(pool, vChain);
+        pool.remove(vChain[0], removed, true);
+        removed.clear();
+    }
+}
+
+/** A deep chain cut in the middle, the ancestors above the cut have to be updated */
+static void MempoolChainRemoveMiddle(benchmark::State& state)
+{
+    std::vector<CTransaction> vChain = MakeChain(2);
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    while (state.KeepRunning()) {
+        AddChain(pool, vChain);
+        pool.remove(vChain[CHAIN_LENGTH / 2], removed, true);
+        pool.remove(vChain[0], removed, true);
+        removed.clear();
+    }
+}
+
+/** Blocks mining a deep chain bit by bit */
+static void MempoolChainRemoveForBlock(benchmark::State& state)
+{
+    std::vector<CTransaction> vChain = MakeChain(3);
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> conflicts;
+
+    while (state.KeepRunning()) {
+        AddChain(pool, vChain);
+        for (int i = 0; i < CHAIN_LENGTH; i += CHAIN_LENGTH / 10) {
+            std::vector<CTransaction> vtx(vChain.begin() + i, vChain.begin() + i + CHAIN_LENGTH / 10);
+            pool.removeForBlock(vtx, 2, conflicts, false);
+        }
+    }
+}
+
+/** A payout whose outputs are spent by chains, evicted by -maxmempool */
+static void MempoolFanoutTrim(benchmark::State& state)
+{
+    std::vector<CTransaction> vTxs;
+    vTxs.push_back(SpendTx(COutPoint(), FANOUT_OUTPUTS, 4));
+    for (int i = 0; i < FANOUT_OUTPUTS; i++) {
+        vTxs.push_back(SpendTx(COutPoint(vTxs[0].GetHash(), i), 1, 4));
+        for (int j = 1; j < FANOUT_DEPTH; j++)
+            vTxs.push_back(SpendTx(COutPoint(vTxs.back().GetHash(), 0), 1, 4));
+    }
+    CTxMemPool pool(CFeeRate(0));
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vTxs.size(); i++)
+            AddTx(pool, vTxs[i], 1000 + i % FANOUT_DEPTH * 100);
+        while (pool.size() > 0)
+            pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4);
+    }
+}
+
+/** Deep chains paying the same feerate throughout, evicted by -maxmempool */
+static void MempoolChainTrim(benchmark::State& state)
+{
+    std::vector<std::vector<CTransaction> > vChains;
+    for (int i = 0; i < 4; i++)
+        vChains.push_back(MakeChain(5 + i));
+    CTxMemPool pool(CFeeRate(0));
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vChains.size(); i++) {
+            for (size_t j = 0; j < vChains[i].size(); j++)
+                AddTx(pool, vChains[i][j], 1000);
+        }
+        while (pool.size() > 0)
+            pool.TrimToSize(pool.DynamicMemoryUsage() / 2);
+    }
+}
+
+/** A disconnected block whose transaction is the root of a deep chain left in the mempool */
+static void MempoolChainReorg(benchmark::State& state)
+{
+    std::vector<CTransaction> vChain = MakeChain(9);
+    std::vector<uint256> vHashUpdate(1, vChain[0].GetHash());
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    while (state.KeepRunning()) {
+        for (size_t i = 1; i < vChain.size(); i++)
+            AddTx(pool, vChain[i], 1000 + i);
+        AddTx(pool, vChain[0], 1000);
+        pool.UpdateTransactionsFromBlock(vHashUpdate);
+        pool.remove(vChain[0], removed, true);
+        removed.clear();
+    }
+}
+
+BENCHMARK(MempoolChainRemoveRoot);
+BENCHMARK(MempoolChainRemoveMiddle);
+BENCHMARK(MempoolChainRemoveForBlock);
+BENCHMARK(MempoolFanoutTrim);
+BENCHMARK(MempoolChainTrim);
+BENCHMARK(MempoolChainReorg);
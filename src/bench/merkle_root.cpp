@@ -0,0 +1,42 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "consensus/merkle.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <vector>
+
+static void MerkleRoot(benchmark::State& state, size_t nLeaves)
+{
+    FastRandomContext rand(true);
+    std::vector<uint256> leaves(nLeaves);
+    for (size_t i = 0; i < nLeaves; i++) {
+        for (unsigned char* p = leaves[i].begin(); p != leaves[i].end(); p += 4)
+            WriteLE32(p, rand.rand32());
+    }
+
+    SHA256AutoDetect();
+    while (state.KeepRunning()) {
+        bool mutated;
+        uint256 root = ComputeMerkleRoot(leaves, &mutated);
+        leaves[0] = root;
+    }
+}
+
+static void MerkleRoot1000(benchmark::State& state)
+{
+    MerkleRoot(state, 1000);
+}
+
+static void MerkleRoot10000(benchmark::State& state)
+{
+    MerkleRoot(state, 10000);
+}
+
+BENCHMARK(MerkleRoot1000);
+BENCHMARK(MerkleRoot10000);
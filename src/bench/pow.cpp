@@ -0,0 +1,43 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "pow.h"
+#include "random.h"
+
+#include <vector>
+
+/* Number of headers in the simulated chain, more than fit into the retarget cache */
+static const int HEADERS_COUNT = 20000;
+
+/** Accept headers the way header sync does: each one is checked against the retarget of its parent */
+static void HeaderSyncRetarget(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+    FastRandomContext rand(true);
+
+    std::vector<CBlockIndex> blocks(HEADERS_COUNT);
+    std::vector<uint256> hashes(HEADERS_COUNT);
+    for (int i = 0; i < HEADERS_COUNT; i++) {
+        hashes[i] = ArithToUint256(arith_uint256(i + 1));
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+        blocks[i].nHeight = 1000000 + i;
+        blocks[i].nTime = i ? blocks[i - 1].nTime + 1 + rand.rand32(110) : 1499000000;
+        blocks[i].nBits = i ? GetNextWorkRequired(blocks[i].pprev, NULL, params) : 0x1b0404cb;
+    }
+
+    int i = 1;
+    while (state.KeepRunning()) {
+        if (GetNextWorkRequired(blocks[i].pprev, NULL, params) != blocks[i].nBits)
+            throw std::runtime_error("retarget mismatch");
+        if (++i == HEADERS_COUNT)
+            i = 1;
+    }
+}
+
+BENCHMARK(HeaderSyncRetarget);
@@ -0,0 +1,125 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "bench.h"
+#include "net.h"
+#include "netbase.h"
+
+#ifndef WIN32
+
+#include <cstring>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/* Connected peers without traffic */
+static const int IDLE_PEERS = 400;
+/* Connected peers sending a message in every iteration */
+static const int BUSY_PEERS = 16;
+static const size_t MESSAGE_SIZE = 256;
+
+/** Loopback TCP connections, the server side sockets are watched by the benchmark */
+struct LoopbackPeers
+{
+    std::vector<SOCKET> vServer;
+    std::vector<SOCKET> vClient;
+
+    explicit LoopbackPeers(int nPeers)
+    {
+        SOCKET hListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (bind(hListen, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(hListen, SOMAXCONN) != 0 ||
+            getsockname(hListen, (struct sockaddr*)&addr, &len) != 0)
+            throw std::runtime_error("cannot listen on loopback");
+
+        for (int i = 0; i < nPeers; i++) {
+            SOCKET hClient = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (connect(hClient, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+                throw std::runtime_error("cannot connect to loopback");
+            SOCKET hServer = accept(hListen, NULL, NULL);
+            if (hServer == INVALID_SOCKET)
+                throw std::runtime_error("cannot accept loopback connection");
+            SetSocketNonBlocking(hServer, true);
+            vClient.push_back(hClient);
+            vServer.push_back(hServer);
+        }
+        CloseSocket(hListen);
+    }
+
+    ~LoopbackPeers()
+    {
+        for (size_t i = 0; i < vServer.size(); i++) {
+            CloseSocket(vServer[i]);
+            CloseSocket(vClient[i]);
+        }
+    }
+
+    //! Busy peers are the last ones, so they have the highest descriptors
+    void SendBusy(const std::vector<char>& msg)
+    {
+        for (size_t i = vClient.size() - BUSY_PEERS; i < vClient.size(); i++)
+            send(vClient[i], &msg[0], msg.size(), MSG_NOSIGNAL);
+    }
+};
+
+static void SocketEvents(benchmark::State& state, SocketEventsMode mode)
+{
+    LoopbackPeers peers(IDLE_PEERS + BUSY_PEERS);
+    CSocketEvents events(mode);
+    std::vector<char> msg(MESSAGE_SIZE, 'x');
+    char pchBuf[0x10000];
+
+    if (events.GetMode() != mode)
+        throw std::runtime_error("socket events mode not available");
+
+    for (size_t i = 0; i < peers.vServer.size(); i++)
+        events.Add(peers.vServer[i]);
+
+    while (state.KeepRunning()) {
+        peers.SendBusy(msg);
+
+        // Wait until all busy peers have been served, like the socket handler does
+        int nReceived = 0;
+        while (nReceived < BUSY_PEERS * (int)MESSAGE_SIZE) {
+            std::set<SOCKET> recv_set, send_set, error_set;
+            if (mode == SOCKETEVENTS_SELECT)
+                recv_set.insert(peers.vServer.begin(), peers.vServer.end());
+            events.Wait(recv_set, send_set, error_set, 50);
+            for (std::set<SOCKET>::iterator it = recv_set.begin(); it != recv_set.end(); ++it) {
+                ssize_t nBytes;
+                // Edge-triggered sockets have to be drained
+                while ((nBytes = recv(*it, pchBuf, sizeof(pchBuf), MSG_DONTWAIT)) > 0)
+                    nReceived += nBytes;
+            }
+        }
+    }
+}
+
+static void SocketEventsSelect(benchmark::State& state)
+{
+    SocketEvents(state, SOCKETEVENTS_SELECT);
+}
+
+BENCHMARK(SocketEventsSelect);
+
+#ifdef HAVE_EPOLL
+static void SocketEventsEpoll(benchmark::State& state)
+{
+    SocketEvents(state, SOCKETEVENTS_EPOLL);
+}
+
+BENCHMARK(SocketEventsEpoll);
+#endif
+
+#endif // WIN32
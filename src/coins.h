@@ -11,6 +11,7 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -119,7 +120,23 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * PoolAllocator's MAX_BLOCK_SIZE_BYTES parameter here uses sizeof the data, and adds the size
+ * of 4 pointers. We do not know the exact node size used in the std::unordered_node implementation
+ * because it is implementation defined. Most implementations have an overhead of 1 or 2 pointers,
+ * so nodes can be connected in a linked list, and in some cases the hash value is stored as well.
+ * Using an additional sizeof(void*)*4 for MAX_BLOCK_SIZE_BYTES should thus be sufficient so that
+ * all implementations can allocate the nodes from the PoolAllocator.
+ */
+typedef std::unordered_map<COutPoint,
+                           CCoinsCacheEntry,
+                           SaltedOutpointHasher,
+                           std::equal_to<COutPoint>,
+                           PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                         sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4> >
+    CCoinsMap;
+
+typedef CCoinsMap::allocator_type::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -200,6 +217,8 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    /* The nodes of cacheCoins are carved from large chunks, it has to outlive cacheCoins. */
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -292,6 +311,9 @@ public:
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
 
+    //! Give the memory of the empty cache back to the system, clearing only returns it to the pool
+    void ReallocateCache();
+
     /**
      * By making the copy constructor private, we prevent accidentally using it when one intends to create a cache on top of a base cache.
      */
@@ -12,7 +12,11 @@
 #include "primitives/block.h"
 #include "uint256.h"
 
-uint256 ComputeMerkleRoot(const std::vector<uint256>& leaves, bool* mutated = NULL);
+/*
+ * Compute the Merkle root of a list of hashes, using the batched SHA256D64 kernels.
+ * *mutated is set to true if a duplicated subtree was found.
+ */
+uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated = NULL);
 std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position);
 uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint256>& branch, uint32_t position);
 
@@ -0,0 +1,248 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/chacha20.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <assert.h>
+#include <limits>
+#include <string.h>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+const int LIMBS = Num3072::LIMBS;
+const int LIMB_SIZE = Num3072::LIMB_SIZE;
+/** 2^3072 - 1103717 is the largest 3072-bit safe prime number, so the multiplicative group has no small subgroups */
+const limb_t MAX_PRIME_DIFF = 1103717;
+
+/** Full product of two 3072-bit numbers */
+void MulFull(limb_t (&r)[2 * LIMBS], const limb_t* a, const limb_t* b)
+{
+    memset(r, 0, sizeof(r));
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (limb_t)t;
+            carry = t >> LIMB_SIZE;
+        }
+        r[i + LIMBS] = carry;
+    }
+}
+
+/** Full square of a 3072-bit number, the products of different limbs are computed once and doubled */
+void SquareFull(limb_t (&r)[2 * LIMBS], const limb_t* a)
+{
+    memset(r, 0, sizeof(r));
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = i + 1; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)a[i] * a[j] + r[i + j] + carry;
+            r[i + j] = (limb_t)t;
+            carry = t >> LIMB_SIZE;
+        }
+        r[i + LIMBS] = carry;
+    }
+
+    limb_t top = 0;
+    for (int i = 0; i < 2 * LIMBS; ++i) {
+        limb_t v = r[i];
+        r[i] = (v << 1) | top;
+        top = v >> (LIMB_SIZE - 1);
+    }
+
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t t = (double_limb_t)a[i] * a[i] + r[2 * i] + carry;
+        r[2 * i] = (limb_t)t;
+        t = (double_limb_t)r[2 * i + 1] + (t >> LIMB_SIZE);
+        r[2 * i + 1] = (limb_t)t;
+        carry = t >> LIMB_SIZE;
+    }
+}
+
+/** Reduce a full product to 3072 bits, using 2^3072 = MAX_PRIME_DIFF (mod p) */
+void Reduce(limb_t (&out)[LIMBS], const limb_t (&t)[2 * LIMBS])
+{
+    double_limb_t acc = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        acc += (double_limb_t)t[LIMBS + i] * MAX_PRIME_DIFF + t[i];
+        out[i] = (limb_t)acc;
+        acc >>= LIMB_SIZE;
+    }
+
+    // Fold what overflowed 3072 bits back in, at most twice
+    while (acc) {
+        acc *= MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS; ++i) {
+            acc += out[i];
+            out[i] = (limb_t)acc;
+            acc >>= LIMB_SIZE;
+        }
+    }
+}
+
+} // namespace
+
+/** Indicates whether d is larger than the modulus. */
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != std::numeric_limits<limb_t>::max()) return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // this - p is this + MAX_PRIME_DIFF without the 2^3072 bit, all upper limbs wrap to zero
+    limbs[0] += MAX_PRIME_DIFF;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t t[2 * LIMBS];
+    MulFull(t, limbs, a.limbs);
+    Reduce(limbs, t);
+    if (IsOverflow()) FullReduce();
+}
+
+void Num3072::Square()
+{
+    limb_t t[2 * LIMBS];
+    SquareFull(t, limbs);
+    Reduce(limbs, t);
+    if (IsOverflow()) FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat's little theorem, this^(p-2) with p-2 = (2^3051 - 1) * 2^21 + 993433.
+    // x^(2^k - 1) is built up bit by bit of k, from x^(2^(k+l) - 1) = x^(2^k - 1)^(2^l) * x^(2^l - 1).
+    static const int ONES = 3051;
+    static const limb_t LOW = 993433;
+    static const int LOW_BITS = 21;
+
+    Num3072 x = *this;
+    if (x.IsOverflow()) x.FullReduce();
+
+    Num3072 out = x;
+    int k = 1;
+    for (int bit = 10; bit >= 0; --bit) {
+        // k -> 2k
+        Num3072 tmp = out;
+        for (int i = 0; i < k; ++i) out.Square();
+        out.Multiply(tmp);
+        k *= 2;
+        // k -> k + 1
+        if ((ONES >> bit) & 1) {
+            out.Square();
+            out.Multiply(x);
+            k += 1;
+        }
+    }
+    assert(k == ONES);
+
+    for (int bit = LOW_BITS - 1; bit >= 0; --bit) {
+        out.Square();
+        if ((LOW >> bit) & 1) out.Multiply(x);
+    }
+    return out;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            limbs[i] = ReadLE32(data + 4 * i);
+        } else {
+            limbs[i] = ReadLE64(data + 8 * i);
+        }
+    }
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE])
+{
+    if (IsOverflow()) FullReduce();
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + i * 4, limbs[i]);
+        } else {
+            WriteLE64(out + i * 8, limbs[i]);
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hashed[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hashed);
+    unsigned char tmp[Num3072::BYTE_SIZE];
+    ChaCha20(hashed, sizeof(hashed)).Output(tmp, sizeof(tmp));
+    return Num3072(tmp);
+}
+
+MuHash3072::MuHash3072(const unsigned char* data, size_t len)
+{
+    numerator = ToNum3072(data, len);
+}
+
+void MuHash3072::Finalize(uint256& out) const
+{
+    Num3072 result = numerator;
+    result.Divide(denominator);
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    result.ToBytes(data);
+
+    CSHA256().Write(data, sizeof(data)).Finalize(out.begin());
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
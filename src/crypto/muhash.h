@@ -0,0 +1,135 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+/** A 3072-bit number modulo the prime 2^3072 - 1103717 */
+class Num3072
+{
+private:
+    void FullReduce();
+    bool IsOverflow() const;
+    Num3072 GetInverse() const;
+
+public:
+    static const size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static const int LIMBS = 48;
+    static const int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static const int LIMBS = 96;
+    static const int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    void Multiply(const Num3072& a);
+    void Square();
+    void Divide(const Num3072& a);
+    void SetToOne();
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]);
+
+    Num3072() { SetToOne(); }
+    Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        unsigned char data[BYTE_SIZE];
+        Num3072(*this).ToBytes(data);
+        s.write((char*)data, sizeof(data));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned char data[BYTE_SIZE];
+        s.read((char*)data, sizeof(data));
+        *this = Num3072(data);
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return BYTE_SIZE;
+    }
+};
+
+/** A class representing MuHash sets
+ *
+ * MuHash is a hashing algorithm that supports adding set elements in any
+ * order but also deleting in any order. As a result, it can maintain a
+ * running sum for a set of data as a whole, and add/remove when data
+ * is added to or removed from it. A downside of MuHash is that computing
+ * an inverse is relatively expensive. This is solved by representing
+ * the running value as a fraction, and multiplying added elements into
+ * the numerator and removed elements into the denominator. Only when the
+ * final hash is desired, a single modular inverse and multiplication is
+ * needed to combine the two.
+ *
+ * As the update operations are also associative, H(a)+H(b)+H(c)+H(d) can
+ * in fact be computed as (H(a)+H(b)) + (H(c)+H(d)). This implies that
+ * all of this is perfectly parallellizable: each thread can process an
+ * arbitrary subset of the update operations, allowing them to be
+ * efficiently combined later.
+ *
+ * MuHash does not support checking if an element is already part of the
+ * set. That is why this class does not enforce the use of a set as the
+ * data it represents because there is no efficient way to do so.
+ * It is possible to add elements more than once and also to remove
+ * elements that have not been added before. However, this implementation
+ * is intended to represent a set of elements.
+ *
+ * See also https://cseweb.ucsd.edu/~mihir/papers/inchash.pdf and
+ * https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2017-May/014337.html.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    /* The empty set. */
+    MuHash3072() {}
+
+    /* A singleton with variable sized data in it. */
+    MuHash3072(const unsigned char* data, size_t len);
+
+    /* Insert a single piece of data into the set. */
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+
+    /* Remove a single piece of data from the set. */
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /* Multiply (resulting in a hash for the union of the sets) */
+    MuHash3072& operator*=(const MuHash3072& mul);
+
+    /* Divide (resulting in a hash for the difference of the sets) */
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    /* Finalize into a 32-byte hash. Does not change this object's value. */
+    void Finalize(uint256& out) const;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(numerator);
+        READWRITE(denominator);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
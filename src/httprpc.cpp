@@ -83,6 +83,36 @@ static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const Uni
     req->WriteReply(nStatus, strReply);
 }
 
+/**
+ * Execute a single request and send the reply like JSONRPCReply. Methods with a
+ * streamActor write their result straight into the reply.
+ */
+static void JSONRPCExecOne(HTTPRequest* req, const JSONRequest& jreq)
+{
+    req->WriteHeader("Content-Type", "application/json");
+    HTTPJSONReply reply(req, HTTPStatus::OK);
+
+    try {
+        reply.BeginObject();
+        reply.Key("result");
+        if (!tableRPC.executeStreamed(jreq.strMethod, jreq.params, reply))
+            reply.Value(tableRPC.execute(jreq.strMethod, jreq.params));
+    } catch (...) {
+        // The caller sends the error, unless the reply is on its way already
+        if (reply.Abort())
+            throw;
+        return;
+    }
+
+    reply.Key("error");
+    reply.Value(NullUniValue);
+    reply.Key("id");
+    reply.Value(jreq.id);
+    reply.End();
+    reply.Raw("\n");
+    reply.Finish();
+}
+
 //This function checks username and password against -rpcauth
 //entries from config file.
 static bool multiUserAuthorized(std::string strUserPass)
@@ -184,10 +214,8 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            JSONRPCExecOne(req, jreq);
+            return true;
 
         // array of requests
         } else if (valRequest.isArray())
@@ -34,6 +34,7 @@
 #endif
 
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 /** Maximum size of http request (request line + headers) */
@@ -420,12 +421,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyStarted) {
+        // The status was sent already, all we can do is to end the reply
+        LogPrintf("%s: Unfinished reply\n", __func__);
+        EndReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTPStatus::INTERNAL_SERVER_ERROR, "Unhandled request");
@@ -471,6 +477,13 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+void HTTPRequest::ClearHeaders()
+{
+    struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
+    assert(headers);
+    evhttp_clear_headers(headers);
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -478,7 +491,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !replyStarted && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -490,6 +503,189 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/**
+ * Bytes of a chunked reply the client didn't take yet. Shared between the
+ * worker writing the reply and the event thread sending it.
+ */
+struct HTTPReplyBuffer
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //! Chunks not passed to evhttp yet
+    size_t nQueued;
+    //! Passed to evhttp since the connection's output buffer last ran empty
+    size_t nSending;
+    //! The client disconnected
+    bool fClosed;
+    //! Keeps this alive while evhttp holds it as callback argument
+    std::shared_ptr<HTTPReplyBuffer> self;
+
+    HTTPReplyBuffer() : nQueued(0), nSending(0), fClosed(false) {}
+};
+
+static void http_reply_closed(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyBuffer* buffer = (HTTPReplyBuffer*)arg;
+    std::shared_ptr<HTTPReplyBuffer> keep;
+    {
+        boost::unique_lock<boost::mutex> lock(buffer->mutex);
+        buffer->fClosed = true;
+        keep.swap(buffer->self);
+    }
+    buffer->cond.notify_all();
+}
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+static void http_reply_sent(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyBuffer* buffer = (HTTPReplyBuffer*)arg;
+    {
+        boost::unique_lock<boost::mutex> lock(buffer->mutex);
+        buffer->nSending = 0;
+    }
+    buffer->cond.notify_all();
+}
+#endif
+
+static void http_reply_start(struct evhttp_request* req, int nStatus, std::shared_ptr<HTTPReplyBuffer> buffer)
+{
+    evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (!evcon) {
+        http_reply_closed(NULL, buffer.get());
+        return;
+    }
+
+    buffer->self = buffer;
+    evhttp_connection_set_closecb(evcon, http_reply_closed, buffer.get());
+    evhttp_send_reply_start(req, nStatus, NULL);
+}
+
+static void http_reply_chunk(struct evhttp_request* req, struct evbuffer* evb, std::shared_ptr<HTTPReplyBuffer> buffer)
+{
+    size_t nSize = evbuffer_get_length(evb);
+    // A no-op if the client disconnected, evhttp keeps req until the reply is ended
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+    evhttp_send_reply_chunk_with_cb(req, evb, http_reply_sent, buffer.get());
+#else
+    // No way to learn when the connection's output was written, only the
+    // chunks waiting for the event thread are bounded
+    evhttp_send_reply_chunk(req, evb);
+#endif
+    evbuffer_free(evb);
+
+    {
+        boost::unique_lock<boost::mutex> lock(buffer->mutex);
+        buffer->nQueued -= nSize;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        buffer->nSending += nSize;
+#endif
+    }
+    buffer->cond.notify_all();
+}
+
+static void http_reply_end(struct evhttp_request* req, std::shared_ptr<HTTPReplyBuffer> buffer)
+{
+    evhttp_connection* evcon = evhttp_request_get_connection(req);
+    // Frees req if the client disconnected
+    evhttp_send_reply_end(req);
+
+    if (evcon) {
+        evhttp_connection_set_closecb(evcon, NULL, NULL);
+        std::shared_ptr<HTTPReplyBuffer> keep;
+        boost::unique_lock<boost::mutex> lock(buffer->mutex);
+        keep.swap(buffer->self);
+    }
+}
+
+void HTTPRequest::StartReply(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    replyBuffer = std::make_shared<HTTPReplyBuffer>();
+    // Events are handled in the order they were triggered, so the chunks follow the headers
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_start, req, nStatus, replyBuffer));
+    ev->trigger(0);
+    replyStarted = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyStarted && req);
+    {
+        // Don't buffer the whole reply for a slow client
+        boost::unique_lock<boost::mutex> lock(replyBuffer->mutex);
+        while (!replyBuffer->fClosed && replyBuffer->nQueued + replyBuffer->nSending > MAX_HTTP_REPLY_PENDING)
+            replyBuffer->cond.wait(lock);
+        if (replyBuffer->fClosed)
+            return;
+        replyBuffer->nQueued += strChunk.size();
+    }
+
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_chunk, req, evb, replyBuffer));
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndReply()
+{
+    assert(replyStarted && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_end, req, replyBuffer));
+    ev->trigger(0);
+    replyStarted = false;
+    replySent = true;
+    replyBuffer.reset();
+    req = 0; // transferred back to main thread
+}
+
+bool HTTPRequest::ReplyClosed()
+{
+    if (!replyBuffer)
+        return false;
+    boost::unique_lock<boost::mutex> lock(replyBuffer->mutex);
+    return replyBuffer->fClosed;
+}
+
+HTTPJSONReply::HTTPJSONReply(HTTPRequest* req, int nStatus, unsigned int nPrettyIndent, size_t nChunkSize) :
+    CJSONStreamWriter(boost::bind(&HTTPJSONReply::WriteChunk, this, _1), nPrettyIndent, nChunkSize),
+    req(req), nStatus(nStatus)
+{
+}
+
+void HTTPJSONReply::WriteChunk(const std::string& strChunk)
+{
+    if (!Flushed())
+        req->StartReply(nStatus);
+    req->WriteReplyChunk(strChunk);
+}
+
+bool HTTPJSONReply::Abort()
+{
+    if (!Flushed()) {
+        Release();
+        req->ClearHeaders();
+        return true;
+    }
+
+    LogPrint("http", "%s: Reply cut short after it was started\n", __func__);
+    req->EndReply();
+    return false;
+}
+
+void HTTPJSONReply::Finish()
+{
+    if (!Flushed()) {
+        req->WriteReply(nStatus, Release());
+        return;
+    }
+
+    Flush();
+    req->EndReply();
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
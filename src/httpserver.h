@@ -5,7 +5,9 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include "jsonwriter.h"
 #include "sync.h"
+#include <memory>
 #include <string>
 #include <stdint.h>
 #include <boost/thread.hpp>
@@ -15,8 +17,11 @@
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+//! Chunked replies wait for the client while this much of the reply wasn't sent yet
+static const size_t MAX_HTTP_REPLY_PENDING = 4 * DEFAULT_JSON_CHUNK_SIZE;
 
 struct evhttp_request;
+struct HTTPReplyBuffer;
 struct event_base;
 class CService;
 class HTTPRequest;
@@ -58,6 +63,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
+    //! Flow control of a chunked reply
+    std::shared_ptr<HTTPReplyBuffer> replyBuffer;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -105,6 +113,11 @@ public:
      */
     void WriteHeader(const std::string& hdr, const std::string& value);
 
+    /**
+     * Drop the output headers written so far, to send a different reply.
+     */
+    void ClearHeaders();
+
     /**
      * Write HTTP reply.
      * nStatus is the HTTP status code to send.
@@ -114,6 +127,49 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply with chunked transfer encoding, send the headers and nStatus.
+     * The body follows with WriteReplyChunk, EndReply completes the reply.
+     *
+     * @note Call EndReply before calling any other HTTPRequest methods.
+     */
+    void StartReply(int nStatus);
+    /**
+     * Send the next part of the body. Waits while more than MAX_HTTP_REPLY_PENDING
+     * bytes were not taken by the client yet. Chunks are dropped once the client
+     * disconnected, see ReplyClosed.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+    void EndReply();
+    //! True if the client disconnected during a chunked reply
+    bool ReplyClosed();
+};
+
+/**
+ * JSON reply written with CJSONStreamWriter. Replies that fit into a single chunk
+ * are sent with WriteReply as before, larger ones are sent chunk by chunk while
+ * the rest is still being written.
+ */
+class HTTPJSONReply : public CJSONStreamWriter
+{
+private:
+    HTTPRequest* req;
+    int nStatus;
+
+    void WriteChunk(const std::string& strChunk);
+
+public:
+    HTTPJSONReply(HTTPRequest* req, int nStatus, unsigned int nPrettyIndent = 0, size_t nChunkSize = DEFAULT_JSON_CHUNK_SIZE);
+
+    //! Send what is left. Don't use req or this object afterwards.
+    void Finish();
+    /**
+     * Give up on the reply. If nothing was sent yet the headers are dropped and
+     * req can send another reply, e.g. an error. Otherwise the reply is cut short
+     * and false is returned.
+     */
+    bool Abort();
 };
 
 /** Event handler closure.
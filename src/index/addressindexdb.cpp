@@ -0,0 +1,564 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/addressindexdb.h"
+
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+using namespace std;
+
+static const char DB_ADDRESSINDEX = 'a';
+static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_SPENTINDEX = 'p';
+static const char DB_DEPOSITINDEX = 'd';
+static const char DB_ADDRESSBALANCE = 'b';
+static const char DB_BALANCERANK = 'r';
+static const char DB_HOLDERCOUNT = 'h';
+
+static const char DB_BEST_BLOCK = 'B';
+static const char DB_FLAG = 'F';
+
+void GetAddressBalanceDeltas(const CAddressIndexBlockData &data, bool fConnect, CAddressBalanceDeltaMap &mapDeltas) {
+    // The index entries of a block are undone with the opposite sign
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=data.addressIndex.begin(); it!=data.addressIndex.end(); it++) {
+        CAddressBalanceValue &delta = mapDeltas[std::make_pair(it->first.type, it->first.hashBytes)];
+        CAmount nValue = fConnect ? it->second : -it->second;
+        delta.balance += nValue;
+        if (it->second > 0)
+            delta.received += nValue;
+    }
+}
+
+CAddressIndexDB::CAddressIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "indexes" / "address", nCacheSize, fMemory, fWipe) {
+}
+
+bool CAddressIndexDB::ReadBestBlock(uint256 &hashBlock) {
+    if (!Read(DB_BEST_BLOCK, hashBlock)) {
+        hashBlock.SetNull();
+        return false;
+    }
+    return true;
+}
+
+bool CAddressIndexDB::WriteBlock(const CAddressIndexBlockData &data, bool fConnect, const uint256 &hashBestBlock) {
+    CDBBatch batch(*this);
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=data.addressIndex.begin(); it!=data.addressIndex.end(); it++) {
+        if (fConnect) {
+            batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+        } else {
+            batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+        }
+    }
+
+    // Null values mark entries to remove, in both directions
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=data.addressUnspentIndex.begin(); it!=data.addressUnspentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+
+    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=data.spentIndex.begin(); it!=data.spentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+
+    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=data.depositIndex.begin(); it!=data.depositIndex.end(); it++) {
+        if (fConnect) {
+            batch.Write(make_pair(DB_DEPOSITINDEX, it->first), it->second);
+        } else {
+            batch.Erase(make_pair(DB_DEPOSITINDEX, it->first));
+        }
+    }
+
+    CAddressBalanceDeltaMap mapDeltas;
+    GetAddressBalanceDeltas(data, fConnect, mapDeltas);
+
+    if (!mapDeltas.empty() && !UpdateBalances(batch, mapDeltas))
+        return false;
+
+    batch.Write(DB_BEST_BLOCK, hashBestBlock);
+
+    return WriteBatch(batch);
+}
+
+bool CAddressIndexDB::UpdateBalances(CDBBatch &batch, const CAddressBalanceDeltaMap &mapDeltas) {
+
+    int64_t nHolders = 0;
+    Read(DB_HOLDERCOUNT, nHolders);
+
+    for (CAddressBalanceDeltaMap::const_iterator it=mapDeltas.begin(); it!=mapDeltas.end(); it++) {
+
+        unsigned int type = it->first.first;
+        const uint160 &hashBytes = it->first.second;
+        CAddressBalanceValue value;
+
+        if (!Read(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, hashBytes)), value))
+            value.SetNull();
+
+        // The rank key contains the balance, move it
+        if (value.balance > 0) {
+            batch.Erase(make_pair(DB_BALANCERANK, CAddressBalanceRankKey(value.balance, type, hashBytes)));
+            nHolders--;
+        }
+
+        value.received += it->second.received;
+        value.balance += it->second.balance;
+
+        if (value.balance < 0)
+            return error("%s: negative balance of address %s", __func__, hashBytes.GetHex());
+
+        if (value.balance > 0) {
+            batch.Write(make_pair(DB_BALANCERANK, CAddressBalanceRankKey(value.balance, type, hashBytes)), value.received);
+            nHolders++;
+        }
+
+        if (value.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, hashBytes)));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, hashBytes)), value);
+        }
+    }
+
+    batch.Write(DB_HOLDERCOUNT, nHolders);
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
+    return Read(make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool CAddressIndexDB::ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+
+    lastIndex.SetNull();
+    nCount = 0;
+
+    std::pair<char,CAddressUnspentKey> key;
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            ++nCount;
+            pcursor->Next();
+        } else if( nCount ) {
+
+            pcursor->Prev();
+
+            if(pcursor->Valid() && pcursor->GetKey(key))
+                lastIndex = key.second;
+
+            break;
+        }else{
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CAddressUnspentKey &start, int offset, int limit, bool reverse) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    int nOffsetCount = 0, nFound = 0;
+
+    if( start.IsNull() )
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    else
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, start));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            if (limit > 0 && nFound == limit) {
+                break;
+            }
+            CAddressUnspentValue nValue;
+            if (pcursor->GetValue(nValue)) {
+
+                if( offset < 0 || ++nOffsetCount > offset ){
+                    unspentOutputs.push_back(make_pair(key.second, nValue));
+                    ++nFound;
+                }
+
+                if( reverse ) pcursor->Prev();
+                else          pcursor->Next();
+
+            } else {
+                return error("failed to get address unspent value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddressIndex(uint160 addressHash, int type,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int start, int end) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    if (start > 0 && end > 0) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
+            if (end > 0 && key.second.blockHeight > end) {
+                break;
+            }
+            CAmount nValue;
+            if (pcursor->GetValue(nValue)) {
+                addressIndex.push_back(make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances) {
+
+    bool fBalances;
+    if (nEndHeight == -1 && excludeZeroBalances && ReadFlag("addressbalances", fBalances) && fBalances)
+        return ReadRichList(addressList, 1);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(DB_ADDRESSINDEX);
+
+    CAddressIndexKey currentKey = CAddressIndexKey();
+    CAmount currentReceived = 0, currentBalance = 0;
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (pcursor->GetKey(key)){
+
+            if( currentKey.IsNull() ){
+                currentKey = key.second;
+            }
+
+            if( key.first != DB_ADDRESSINDEX)
+                break;
+
+            if( key.second.hashBytes != currentKey.hashBytes ) {
+
+                if( currentBalance > 0 && (!excludeZeroBalances || (excludeZeroBalances && currentBalance )))
+                    // Save the address info
+                    addressList.push_back(CAddressListEntry(currentKey.type,
+                                                            currentKey.hashBytes,
+                                                            currentReceived,
+                                                            currentBalance));
+
+                // And move on with the next one
+                currentReceived = 0;
+                currentBalance = 0;
+                currentKey = key.second;
+            }
+
+            CAmount nValue;
+            if (pcursor->GetValue(nValue)) {
+
+                if( nEndHeight == -1 || key.second.blockHeight < nEndHeight ){
+                    currentBalance += nValue;
+                    if( nValue > 0)
+                        currentReceived += nValue;
+                }
+
+                pcursor->Next();
+            } else {
+                return error("failed to get address index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    if( !excludeZeroBalances || (excludeZeroBalances && currentBalance ))
+        // Store the last one..
+        addressList.push_back(CAddressListEntry(currentKey.type,
+                                                currentKey.hashBytes,
+                                                currentReceived,
+                                                currentBalance));
+
+    return true;
+}
+
+bool CAddressIndexDB::UpgradeAddressBalances() {
+
+    bool fUpgraded;
+    if (ReadFlag("addressbalances", fUpgraded) && fUpgraded)
+        return true;
+
+    LogPrintf("%s: Summing up address balances...\n", __func__);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+
+    // Drop what an interrupted run left behind
+    pcursor->Seek(DB_ADDRESSBALANCE);
+    while (pcursor->Valid()) {
+        std::pair<char,CAddressIndexIteratorKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSBALANCE)
+            break;
+        batch.Erase(key);
+        pcursor->Next();
+    }
+
+    pcursor->Seek(DB_BALANCERANK);
+    while (pcursor->Valid()) {
+        std::pair<char,CAddressBalanceRankKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BALANCERANK)
+            break;
+        batch.Erase(key);
+        pcursor->Next();
+    }
+
+    if (!WriteBatch(batch))
+        return error("%s: failed to erase address balances", __func__);
+    batch.Clear();
+
+    CAddressIndexIteratorKey currentKey;
+    CAddressBalanceValue currentValue;
+    int64_t nHolders = 0;
+
+    // Also used to write the last address
+    auto writeBalance = [&]() {
+        if (currentValue.balance > 0) {
+            batch.Write(make_pair(DB_BALANCERANK, CAddressBalanceRankKey(currentValue.balance, currentKey.type, currentKey.hashBytes)), currentValue.received);
+            nHolders++;
+        }
+        if (!currentValue.IsNull())
+            batch.Write(make_pair(DB_ADDRESSBALANCE, currentKey), currentValue);
+    };
+
+    // Entries of an address are next to each other
+    pcursor->Seek(DB_ADDRESSINDEX);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX)
+            break;
+
+        if (key.second.type != currentKey.type || key.second.hashBytes != currentKey.hashBytes) {
+            writeBalance();
+            currentKey = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+            currentValue.SetNull();
+
+            if (batch.SizeEstimate() > (1 << 24)) {
+                if (!WriteBatch(batch))
+                    return error("%s: failed to write address balances", __func__);
+                batch.Clear();
+            }
+        }
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+
+        currentValue.balance += nValue;
+        if (nValue > 0)
+            currentValue.received += nValue;
+
+        pcursor->Next();
+    }
+
+    writeBalance();
+
+    batch.Write(DB_HOLDERCOUNT, nHolders);
+    batch.Write(std::make_pair(DB_FLAG, std::string("addressbalances")), '1');
+
+    if (!WriteBatch(batch, true))
+        return error("%s: failed to write address balances", __func__);
+
+    LogPrintf("%s: %d addresses with a balance\n", __func__, nHolders);
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    if (!Read(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), value))
+        value.SetNull();
+    return true;
+}
+
+bool CAddressIndexDB::ReadRichListCount(int &nCount, CAmount nMinBalance) {
+
+    nCount = 0;
+
+    if (nMinBalance <= 1) {
+        int64_t nHolders = 0;
+        Read(DB_HOLDERCOUNT, nHolders);
+        nCount = nHolders;
+        return true;
+    }
+
+    // Only visits the addresses above the threshold
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(DB_BALANCERANK);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressBalanceRankKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BALANCERANK || key.second.balance < nMinBalance)
+            break;
+        nCount++;
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadRichList(std::vector<CAddressListEntry> &vecEntries, CAmount nMinBalance, int offset, int limit) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    int nSkipped = 0;
+
+    pcursor->Seek(DB_BALANCERANK);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressBalanceRankKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BALANCERANK || key.second.balance < nMinBalance)
+            break;
+
+        if (limit >= 0 && vecEntries.size() == (size_t)limit)
+            break;
+
+        if (nSkipped < offset) {
+            nSkipped++;
+        } else {
+            CAmount nReceived;
+            if (!pcursor->GetValue(nReceived))
+                return error("failed to get balance rank value");
+            vecEntries.push_back(CAddressListEntry(key.second.type, key.second.hashBytes, nReceived, key.second.balance));
+        }
+
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadDepositIndex(uint160 addressHash, int type,
+                                    std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex,
+                                    int start, int offset, int limit, bool reverse) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    int nCount = 0;
+
+    if (start > 0) {
+        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CDepositIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_DEPOSITINDEX && key.second.hashBytes == addressHash) {
+            if (limit > 0 && depositIndex.size() == (size_t)limit) {
+                break;
+            }
+            CDepositValue nValue;
+            if (pcursor->GetValue(nValue)) {
+                if( ++nCount > offset )
+                    depositIndex.push_back(make_pair(key.second, nValue));
+
+                if( reverse ) pcursor->Prev();
+                else          pcursor->Next();
+
+            } else {
+                return error("failed to get deposit index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::ReadDepositIndexCount(uint160 addressHash, int type,
+                                    int &count,
+                                    int &firstTime, int &lastTime,
+                                    int start, int end) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    count = 0;
+    firstTime = 0;
+    lastTime = 0;
+
+    if (start > 0) {
+        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CDepositIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_DEPOSITINDEX && key.second.hashBytes == addressHash) {
+
+            if( !firstTime ) firstTime = key.second.timestamp;
+
+            if (end > 0 && key.second.timestamp > (unsigned int)end) {
+                if( !lastTime ) lastTime = firstTime;
+                break;
+            }
+
+            lastTime = key.second.timestamp;
+            count++;
+            pcursor->Next();
+
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::WriteFlag(const std::string &name, bool fValue) {
+    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
+}
+
+bool CAddressIndexDB::ReadFlag(const std::string &name, bool &fValue) {
+    char ch;
+    if (!Read(std::make_pair(DB_FLAG, name), ch))
+        return false;
+    fValue = ch == '1';
+    return true;
+}
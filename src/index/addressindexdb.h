@@ -0,0 +1,94 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_INDEX_ADDRESSINDEXDB_H
+#define SMARTCASH_INDEX_ADDRESSINDEXDB_H
+
+#include "dbwrapper.h"
+#include "spentindex.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! -addressindexdbcache default (MiB)
+static const int64_t nAddressIndexDefaultDbCache = 64;
+//! max. -addressindexdbcache (MiB)
+static const int64_t nAddressIndexMaxDbCache = 1024;
+
+/** All address/spent/deposit index entries produced by one block. */
+struct CAddressIndexBlockData
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
+
+    size_t size() const {
+        return addressIndex.size() + addressUnspentIndex.size() + spentIndex.size() + depositIndex.size();
+    }
+
+    void Clear() {
+        addressIndex.clear();
+        addressUnspentIndex.clear();
+        spentIndex.clear();
+        depositIndex.clear();
+    }
+};
+
+typedef std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue> CAddressBalanceDeltaMap;
+
+/** Sum up the balance changes per address of a block, a disconnected block changes them with the opposite sign */
+void GetAddressBalanceDeltas(const CAddressIndexBlockData &data, bool fConnect, CAddressBalanceDeltaMap &mapDeltas);
+
+/** Access to the optional address, spent and deposit indexes (indexes/address/) */
+class CAddressIndexDB : public CDBWrapper
+{
+public:
+    CAddressIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CAddressIndexDB(const CAddressIndexDB&);
+    void operator=(const CAddressIndexDB&);
+
+    bool UpdateBalances(CDBBatch &batch, const CAddressBalanceDeltaMap &mapDeltas);
+public:
+    //! Best block this index has been built up to
+    bool ReadBestBlock(uint256 &hashBlock);
+
+    /** Apply the entries of a connected (fConnect=true) or disconnected block and move
+     *  the best block marker to hashBestBlock in the same atomic batch. */
+    bool WriteBlock(const CAddressIndexBlockData &data, bool fConnect, const uint256 &hashBestBlock);
+
+    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    bool ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex);
+    bool ReadAddressUnspentIndex(uint160 addressHash, int type,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CAddressUnspentKey &start = CAddressUnspentKey(),
+                                 int offset = -1, int limit = -1, bool reverse = false);
+    bool ReadAddressIndex(uint160 addressHash, int type,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          int start = 0, int end = 0);
+    bool ReadAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances);
+
+    //! Sum up the balances of an index written without them
+    bool UpgradeAddressBalances();
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+    //! Number of addresses with a balance of at least nMinBalance
+    bool ReadRichListCount(int &nCount, CAmount nMinBalance);
+    //! Addresses with a balance of at least nMinBalance, the largest balance first
+    bool ReadRichList(std::vector<CAddressListEntry> &vecEntries, CAmount nMinBalance, int offset = 0, int limit = -1);
+    bool ReadDepositIndex(uint160 addressHash, int type,
+                          std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex,
+                          int start = 0, int offset = 0, int limit = 0, bool reverse = false);
+    bool ReadDepositIndexCount(uint160 addressHash, int type,
+                               int &count,
+                               int &firstTime, int &lastTime,
+                               int start, int end);
+
+    bool WriteFlag(const std::string &name, bool fValue);
+    bool ReadFlag(const std::string &name, bool &fValue);
+};
+
+#endif // SMARTCASH_INDEX_ADDRESSINDEXDB_H
@@ -0,0 +1,359 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/addressindexer.h"
+
+#include "chainparams.h"
+#include "pubkey.h"
+#include "txdb.h"
+#include "undo.h"
+#include "univalue.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/thread.hpp>
+
+CAddressIndexer *paddressindexer = NULL;
+
+bool GetAddressHashAndType(const CScript &script, uint160 &hashBytes, int &addressType)
+{
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        addressType = 2;
+    } else if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        addressType = 1;
+    } else if (script.IsPayToPublicKey()) {
+        std::vector<unsigned char> pubKeyBytes(script.begin()+1, script.begin()+34);
+        CPubKey pubKey(pubKeyBytes);
+        hashBytes = pubKey.GetID();
+        addressType = 1;
+    } else if (script.IsPayToScriptHashLocked()) {
+        int nOffset = script[0] + 5;
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + nOffset, script.begin() + nOffset + 20));
+        addressType = 2;
+    } else if (script.IsPayToPublicKeyHashLocked()) {
+        int nOffset = script[0] + 6;
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + nOffset, script.begin() + nOffset + 20));
+        addressType = 1;
+    } else {
+        hashBytes.SetNull();
+        addressType = 0;
+        return false;
+    }
+
+    return true;
+}
+
+bool BuildAddressIndexBlockData(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, bool fConnect, CAddressIndexBlockData &data)
+{
+    data.Clear();
+
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    // Undo in reverse order so that outputs created and spent within the block end up removed
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        int i = fConnect ? n : block.vtx.size() - 1 - n;
+        const CTransaction &tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+        std::map<std::pair<uint160, int>, CAmount> mapInputs;
+        std::map<std::pair<uint160, int>, CAmount> mapOutputs;
+        uint160 hashBytes;
+        int addressType;
+
+        if (!tx.IsCoinBase() && !tx.IsZerocoinSpend()) {
+
+            const CTxUndo &txundo = blockundo.vtxundo[i-1];
+
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+
+                const CTxIn &input = tx.vin[j];
+                const Coin &coin = txundo.vprevout[j];
+                const CTxOut &prevout = coin.out;
+
+                GetAddressHashAndType(prevout.scriptPubKey, hashBytes, addressType);
+
+                if (fDepositIndex && addressType) {
+                    mapInputs[std::make_pair(hashBytes, addressType)] += prevout.nValue;
+                }
+
+                if (fAddressIndex && addressType > 0) {
+                    // spending activity
+                    data.addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
+
+                    // remove/restore the spent output in the unspent index
+                    data.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, coin.nHeight),
+                                                                      fConnect ? CAddressUnspentValue() : CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, coin.nHeight)));
+                }
+
+                if (fSpentIndex) {
+                    // the txid and input that spent an output and the amount and address of the input
+                    data.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n),
+                                                             fConnect ? CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes) : CSpentIndexValue()));
+                }
+            }
+        }
+
+        if (!fAddressIndex && !fDepositIndex)
+            continue;
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++) {
+
+            const CTxOut &out = tx.vout[k];
+
+            if (!GetAddressHashAndType(out.scriptPubKey, hashBytes, addressType))
+                continue;
+
+            if (fDepositIndex) {
+                mapOutputs[std::make_pair(hashBytes, addressType)] += out.nValue;
+            }
+
+            if (fAddressIndex) {
+                // receiving activity
+                data.addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+
+                // add/remove the unspent output
+                data.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k, pindex->nHeight),
+                                                                  fConnect ? CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight) : CAddressUnspentValue()));
+            }
+        }
+
+        if (fDepositIndex) {
+
+            for (auto const &output : mapOutputs) {
+
+                auto input = mapInputs.find(output.first);
+
+                // A deposit is what an address received in excess of what it spent in the same transaction
+                CAmount nDeposit = input == mapInputs.end() ? output.second : output.second - input->second;
+
+                if (nDeposit > 0) {
+                    data.depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, txhash), CDepositValue(nDeposit, pindex->nHeight)));
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+CAddressIndexer::CAddressIndexer(CAddressIndexDB *pdbIn) : pdb(pdbIn), pindexBest(NULL), fNotified(false)
+{
+}
+
+bool CAddressIndexer::Init()
+{
+    uint256 hashBest;
+
+    if (!pdb->ReadBestBlock(hashBest))
+        return true;
+
+    LOCK2(cs_main, cs);
+
+    BlockMap::iterator it = mapBlockIndex.find(hashBest);
+
+    if (it == mapBlockIndex.end())
+        return error("%s: best block %s of the address index is unknown", __func__, hashBest.ToString());
+
+    pindexBest = it->second;
+
+    LogPrintf("%s: address index at height %d, chain at height %d\n", __func__, pindexBest->nHeight, chainActive.Height());
+
+    return true;
+}
+
+void CAddressIndexer::Notify()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csNotify);
+        fNotified = true;
+    }
+    condNotify.notify_one();
+}
+
+void CAddressIndexer::AddPendingBlock(const CBlock &block)
+{
+    LOCK(cs);
+
+    // Blocks too far ahead of the indexer are read back from disk when it gets there
+    if (mapPendingBlocks.size() >= MAX_ADDRESSINDEX_PENDING_BLOCKS)
+        return;
+
+    mapPendingBlocks.emplace(block.GetHash(), std::make_shared<const CBlock>(block));
+}
+
+void CAddressIndexer::BlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    AddPendingBlock(block);
+    Notify();
+}
+
+void CAddressIndexer::BlockDisconnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    AddPendingBlock(block);
+    Notify();
+}
+
+bool CAddressIndexer::ProcessBlock(const CBlockIndex *pindex, bool fConnect)
+{
+    const Consensus::Params &consensusParams = Params().GetConsensus();
+    std::shared_ptr<const CBlock> pblock;
+    CDiskBlockPos undoPos;
+    CAddressIndexBlockData data;
+    int64_t nStart = GetTimeMicros();
+
+    {
+        LOCK(cs);
+        auto it = mapPendingBlocks.find(pindex->GetBlockHash());
+        if (it != mapPendingBlocks.end()) {
+            pblock = it->second;
+            mapPendingBlocks.erase(it);
+        }
+    }
+
+    if (!pblock) {
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
+            return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+        pblock = pblockRead;
+    }
+
+    {
+        LOCK(cs_main);
+        undoPos = pindex->GetUndoPos();
+    }
+
+    // The genesis block has no undo data and its outputs are unspendable
+    if (pindex->pprev) {
+
+        CBlockUndo blockundo;
+
+        if (undoPos.IsNull())
+            return error("%s: no undo data available for block %s", __func__, pindex->GetBlockHash().ToString());
+
+        if (!UndoReadFromDisk(blockundo, undoPos, pindex->pprev->GetBlockHash()))
+            return error("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+
+        if (!BuildAddressIndexBlockData(*pblock, blockundo, pindex, fConnect, data))
+            return error("%s: failed to build index data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    const CBlockIndex *pindexNewBest = fConnect ? pindex : pindex->pprev;
+
+    if (!pdb->WriteBlock(data, fConnect, pindexNewBest ? pindexNewBest->GetBlockHash() : uint256()))
+        return error("%s: failed to write address index", __func__);
+
+    {
+        LOCK(cs);
+        pindexBest = pindexNewBest;
+    }
+
+    GetMainSignals().AddressIndexUpdated(pindex, fConnect, data);
+
+    LogPrint("addressindex", "%s: %s block %s (height %d), %u entries in %.2fms\n", __func__, fConnect ? "connected" : "disconnected",
+             pindex->GetBlockHash().ToString(), pindex->nHeight, data.size(), (GetTimeMicros() - nStart) * 0.001);
+
+    return true;
+}
+
+bool CAddressIndexer::SyncWithChain()
+{
+    while (true) {
+
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex *pindexNext;
+        bool fConnect;
+
+        {
+            LOCK2(cs_main, cs);
+
+            const CBlockIndex *pindexTip = chainActive.Tip();
+
+            if (!pindexTip || pindexBest == pindexTip) {
+                // Nothing left to do, drop blocks of forks we never connected
+                mapPendingBlocks.clear();
+                return true;
+            }
+
+            if (pindexBest && !chainActive.Contains(pindexBest)) {
+                // Rewind blocks which are not part of the active chain anymore
+                pindexNext = pindexBest;
+                fConnect = false;
+            } else {
+                pindexNext = pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis();
+                fConnect = true;
+            }
+        }
+
+        if (!ProcessBlock(pindexNext, fConnect))
+            return false;
+    }
+}
+
+void CAddressIndexer::Run()
+{
+    bool fLegacyErased = false;
+
+    while (true) {
+
+        if (!SyncWithChain()) {
+            LogPrintf("%s: address index sync failed at height %d, retrying\n", __func__, GetHeight());
+        } else if (!fLegacyErased) {
+            // Nothing reads the records older versions kept in blocks/index anymore,
+            // they stay until the index is synced to keep a downgrade possible until then
+            fLegacyErased = pblocktree->EraseLegacyAddressIndex();
+        }
+
+        boost::unique_lock<boost::mutex> lock(csNotify);
+
+        // Wait for the next block, retry failed syncs once in a while
+        if (!fNotified)
+            condNotify.timed_wait(lock, boost::posix_time::seconds(10));
+
+        fNotified = false;
+    }
+}
+
+int CAddressIndexer::GetHeight() const
+{
+    LOCK(cs);
+    return pindexBest ? pindexBest->nHeight : -1;
+}
+
+bool CAddressIndexer::IsSynced() const
+{
+    LOCK2(cs_main, cs);
+    return pindexBest == chainActive.Tip();
+}
+
+void CAddressIndexer::GetStatus(UniValue &obj) const
+{
+    LOCK2(cs_main, cs);
+    obj.push_back(Pair("height", pindexBest ? pindexBest->nHeight : -1));
+    obj.push_back(Pair("bestblockhash", pindexBest ? pindexBest->GetBlockHash().GetHex() : uint256().GetHex()));
+    obj.push_back(Pair("synced", pindexBest == chainActive.Tip()));
+}
+
+void ThreadAddressIndexer()
+{
+    RenameThread("smartcash-addridx");
+
+    LogPrintf("%s: started\n", __func__);
+
+    try {
+        paddressindexer->Run();
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("%s: interrupted\n", __func__);
+        throw;
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "ThreadAddressIndexer()");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "ThreadAddressIndexer()");
+    }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_INDEX_ADDRESSINDEXER_H
+#define SMARTCASH_INDEX_ADDRESSINDEXER_H
+
+#include "index/addressindexdb.h"
+#include "sync.h"
+#include "validationinterface.h"
+
+#include <map>
+#include <memory>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+class CScript;
+class UniValue;
+
+//! Maximum number of connected/disconnected blocks kept in memory for the indexer thread
+static const size_t MAX_ADDRESSINDEX_PENDING_BLOCKS = 32;
+
+/** Get the address index key of an output script. Returns false if the script type is not indexed. */
+bool GetAddressHashAndType(const CScript &script, uint160 &hashBytes, int &addressType);
+
+/** Build the address, spent and deposit index entries for a block. With fConnect=false the
+ *  entries undo the block: unspent outputs it spent are restored and the ones it created are removed. */
+bool BuildAddressIndexBlockData(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, bool fConnect, CAddressIndexBlockData &data);
+
+/**
+ * Maintains the optional address, spent and deposit indexes in their own database.
+ *
+ * The indexes are not written on the block connect path anymore. ConnectTip/DisconnectTip
+ * only hand over the block through the validation interface and the indexer thread
+ * follows chainActive on its own, reading missing blocks and their undo data from disk.
+ * This lets the indexer catch up after a restart and rewind its own reorgs.
+ */
+class CAddressIndexer : public CValidationInterface
+{
+    CAddressIndexDB *pdb;
+
+    mutable CCriticalSection cs;
+    //! Last block written to pdb (protected by cs)
+    const CBlockIndex *pindexBest;
+    //! Blocks received via the validation interface, used to avoid reading them from disk (protected by cs)
+    std::map<uint256, std::shared_ptr<const CBlock> > mapPendingBlocks;
+
+    CWaitableCriticalSection csNotify;
+    CConditionVariable condNotify;
+    bool fNotified;
+
+    void Notify();
+    void AddPendingBlock(const CBlock &block);
+    bool ProcessBlock(const CBlockIndex *pindex, bool fConnect);
+
+protected:
+    void BlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+    void BlockDisconnected(const CBlock &block, const CBlockIndex *pindex) override;
+
+public:
+    CAddressIndexer(CAddressIndexDB *pdbIn);
+    ~CAddressIndexer() { delete pdb; }
+
+    //! Load the best block marker. Returns false if the database doesn't match the block index.
+    bool Init();
+    //! Connect/disconnect blocks until the index matches chainActive.
+    bool SyncWithChain();
+    //! Main loop of the indexer thread.
+    void Run();
+
+    CAddressIndexDB *GetDB() { return pdb; }
+
+    int GetHeight() const;
+    bool IsSynced() const;
+    void GetStatus(UniValue &obj) const;
+};
+
+/** Global variable that points to the active address indexer (NULL if no such index is enabled) */
+extern CAddressIndexer *paddressindexer;
+
+void ThreadAddressIndexer();
+
+#endif // SMARTCASH_INDEX_ADDRESSINDEXER_H
@@ -0,0 +1,394 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/coinstatsindex.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "streams.h"
+#include "txdb.h"
+#include "undo.h"
+#include "univalue.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/thread.hpp>
+
+CCoinStatsIndex *pcoinstatsindex = NULL;
+
+void UpdateCoinSetHash(MuHash3072 &muhash, const COutPoint &outpoint, const Coin &coin, bool fAdd)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+
+    if (fAdd)
+        muhash.Insert((const unsigned char*)ss.data(), ss.size());
+    else
+        muhash.Remove((const unsigned char*)ss.data(), ss.size());
+}
+
+bool ApplyCoinStatsBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, CCoinStatsValue &stats, MuHash3072 &muhash)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    CAmount nFees = 0;
+    CAmount nCoinBaseOut = 0;
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (!tx.IsCoinBase() && !tx.IsZerocoinSpend()) {
+
+            const CTxUndo &txundo = blockundo.vtxundo[i - 1];
+
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                const Coin &coin = txundo.vprevout[j];
+                UpdateCoinSetHash(muhash, tx.vin[j].prevout, coin, false);
+                stats.nTransactionOutputs--;
+                stats.nTotalAmount -= coin.out.nValue;
+                nFees += coin.out.nValue;
+            }
+
+            nFees -= tx.GetValueOut();
+        }
+
+        if (tx.IsCoinBase())
+            nCoinBaseOut += tx.GetValueOut();
+
+        for (size_t k = 0; k < tx.vout.size(); k++) {
+            const CTxOut &out = tx.vout[k];
+
+            // Same as CCoinsViewCache::AddCoin, these outputs are never added to the coin set
+            if (out.scriptPubKey.IsUnspendable()) {
+                stats.nUnspendableAmount += out.nValue;
+                continue;
+            }
+
+            UpdateCoinSetHash(muhash, COutPoint(txhash, k), Coin(out, pindex->nHeight, tx.IsCoinBase()), true);
+            stats.nTransactionOutputs++;
+            stats.nTotalAmount += out.nValue;
+        }
+    }
+
+    stats.nTotalSupply += nCoinBaseOut - nFees;
+    stats.hashBlock = pindex->GetBlockHash();
+    muhash.Finalize(stats.hashCoinSet);
+
+    return true;
+}
+
+bool ReverseCoinSetBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, MuHash3072 &muhash)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        for (size_t k = 0; k < tx.vout.size(); k++) {
+            const CTxOut &out = tx.vout[k];
+            if (!out.scriptPubKey.IsUnspendable())
+                UpdateCoinSetHash(muhash, COutPoint(txhash, k), Coin(out, pindex->nHeight, tx.IsCoinBase()), false);
+        }
+
+        if (!tx.IsCoinBase() && !tx.IsZerocoinSpend()) {
+
+            const CTxUndo &txundo = blockundo.vtxundo[i - 1];
+
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+
+            for (size_t j = 0; j < tx.vin.size(); j++)
+                UpdateCoinSetHash(muhash, tx.vin[j].prevout, txundo.vprevout[j], true);
+        }
+    }
+
+    return true;
+}
+
+CCoinStatsIndex::CCoinStatsIndex(CBlockTreeDB *pdbIn) : pdb(pdbIn), pindexBest(NULL), fNotified(false)
+{
+}
+
+bool CCoinStatsIndex::Init()
+{
+    const Consensus::Params &consensusParams = Params().GetConsensus();
+    uint256 hashBest;
+    MuHash3072 muhash;
+
+    // Nothing written yet, or written before the coin set was kept as a MuHash
+    if (!pdb->ReadCoinStatsBestBlock(hashBest, muhash))
+        return true;
+
+    LOCK2(cs_main, cs);
+
+    BlockMap::iterator it = mapBlockIndex.find(hashBest);
+
+    if (it == mapBlockIndex.end())
+        return error("%s: best block %s of the coin stats index is unknown", __func__, hashBest.ToString());
+
+    // The index may be ahead of the chainstate after a crash, or on a fork after a reorg
+    // while it was disabled. The stats of the common ancestor are still valid, its coin
+    // set is what remains after taking the blocks above it back out.
+    const CBlockIndex *pindex = it->second;
+    while (pindex && !chainActive.Contains(pindex)) {
+
+        if (!pindex->pprev) {
+            muhash = MuHash3072();
+            pindex = NULL;
+            break;
+        }
+
+        CBlock block;
+        CBlockUndo blockundo;
+        CDiskBlockPos undoPos = pindex->GetUndoPos();
+
+        if (!ReadBlockFromDisk(block, pindex, consensusParams) || undoPos.IsNull() ||
+            !UndoReadFromDisk(blockundo, undoPos, pindex->pprev->GetBlockHash()) ||
+            !ReverseCoinSetBlock(block, blockundo, pindex, muhash))
+            return error("%s: failed to rewind the coin stats index past block %s", __func__, pindex->GetBlockHash().ToString());
+
+        pindex = pindex->pprev;
+    }
+
+    if (pindex && (!pdb->ReadCoinStats(pindex->nHeight, statsBest) || statsBest.hashBlock != pindex->GetBlockHash()))
+        return error("%s: coin stats of block %s are missing", __func__, pindex->GetBlockHash().ToString());
+
+    if (pindex) {
+        uint256 hashCoinSet;
+        muhash.Finalize(hashCoinSet);
+        if (hashCoinSet != statsBest.hashCoinSet)
+            return error("%s: coin set of block %s doesn't match its stats", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    pindexBest = pindex;
+    muhashBest = muhash;
+
+    LogPrintf("%s: coin stats index at height %d, chain at height %d\n", __func__, pindexBest ? pindexBest->nHeight : -1, chainActive.Height());
+
+    return true;
+}
+
+void CCoinStatsIndex::Notify()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csNotify);
+        fNotified = true;
+    }
+    condNotify.notify_one();
+}
+
+bool CCoinStatsIndex::WriteBlock(const CBlockIndex *pindex, const CCoinStatsValue &stats, const MuHash3072 &muhash)
+{
+    AssertLockHeld(cs);
+
+    if (!pdb->WriteCoinStats(pindex->nHeight, stats, muhash))
+        return error("%s: failed to write coin stats of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    pindexBest = pindex;
+    statsBest = stats;
+    muhashBest = muhash;
+
+    return true;
+}
+
+bool CCoinStatsIndex::BlockConnected(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex)
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs);
+
+    // Still catching up, the indexer thread gets to this block later. During the initial
+    // download it takes every block, finalizing the coin set costs a few milliseconds.
+    if (pindexBest != pindex->pprev || IsInitialBlockDownload()) {
+        Notify();
+        return true;
+    }
+
+    CCoinStatsValue stats = statsBest;
+    MuHash3072 muhash = muhashBest;
+
+    if (!ApplyCoinStatsBlock(block, blockundo, pindex, stats, muhash))
+        return false;
+
+    return WriteBlock(pindex, stats, muhash);
+}
+
+bool CCoinStatsIndex::BlockDisconnected(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex)
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs);
+
+    if (pindexBest != pindex)
+        return true;
+
+    MuHash3072 muhash = muhashBest;
+
+    if (!ReverseCoinSetBlock(block, blockundo, pindex, muhash))
+        return false;
+
+    CCoinStatsValue stats;
+
+    if (!pdb->ReadCoinStats(pindex->pprev->nHeight, stats) || stats.hashBlock != pindex->pprev->GetBlockHash())
+        return error("%s: coin stats of block %s are missing", __func__, pindex->pprev->GetBlockHash().ToString());
+
+    if (!pdb->EraseCoinStats(pindex->nHeight, stats.hashBlock, muhash))
+        return error("%s: failed to erase coin stats of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    pindexBest = pindex->pprev;
+    statsBest = stats;
+    muhashBest = muhash;
+
+    return true;
+}
+
+bool CCoinStatsIndex::SyncWithChain()
+{
+    const Consensus::Params &consensusParams = Params().GetConsensus();
+
+    while (true) {
+
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex *pindexNext;
+        CCoinStatsValue stats;
+        MuHash3072 muhash;
+        CDiskBlockPos undoPos;
+
+        {
+            LOCK2(cs_main, cs);
+
+            const CBlockIndex *pindexTip = chainActive.Tip();
+
+            if (!pindexTip || pindexBest == pindexTip)
+                return true;
+
+            pindexNext = pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis();
+            stats = statsBest;
+            muhash = muhashBest;
+            undoPos = pindexNext->GetUndoPos();
+        }
+
+        // Read and apply the block without holding cs_main
+        if (pindexNext->pprev) {
+
+            CBlock block;
+            CBlockUndo blockundo;
+
+            if (!ReadBlockFromDisk(block, pindexNext, consensusParams))
+                return error("%s: failed to read block %s", __func__, pindexNext->GetBlockHash().ToString());
+
+            if (undoPos.IsNull() || !UndoReadFromDisk(blockundo, undoPos, pindexNext->pprev->GetBlockHash()))
+                return error("%s: failed to read undo data of block %s", __func__, pindexNext->GetBlockHash().ToString());
+
+            if (!ApplyCoinStatsBlock(block, blockundo, pindexNext, stats, muhash))
+                return false;
+
+        } else {
+            // The outputs of the genesis block are not spendable
+            stats.SetNull();
+            stats.hashBlock = pindexNext->GetBlockHash();
+            muhash = MuHash3072();
+            muhash.Finalize(stats.hashCoinSet);
+        }
+
+        {
+            LOCK2(cs_main, cs);
+
+            // ConnectBlock or a reorg moved the index in the meantime, start over from there
+            if (pindexBest != pindexNext->pprev || !chainActive.Contains(pindexNext))
+                continue;
+
+            if (!WriteBlock(pindexNext, stats, muhash))
+                return false;
+        }
+
+        if (pindexNext->nHeight % 10000 == 0)
+            LogPrintf("%s: coin stats index at height %d\n", __func__, pindexNext->nHeight);
+    }
+}
+
+void CCoinStatsIndex::Run()
+{
+    while (true) {
+
+        if (!SyncWithChain()) {
+            LogPrintf("%s: coin stats index sync failed at height %d, retrying\n", __func__, GetHeight());
+        }
+
+        boost::unique_lock<boost::mutex> lock(csNotify);
+
+        // Wait until ConnectBlock skips a block, retry failed syncs once in a while
+        if (!fNotified)
+            condNotify.timed_wait(lock, boost::posix_time::seconds(10));
+
+        fNotified = false;
+    }
+}
+
+bool CCoinStatsIndex::Lookup(int nHeight, CCoinStatsValue &stats) const
+{
+    uint256 hashBlock;
+
+    {
+        LOCK2(cs_main, cs);
+
+        if (!pindexBest || nHeight < 0 || nHeight > pindexBest->nHeight)
+            return false;
+
+        if (nHeight == pindexBest->nHeight) {
+            stats = statsBest;
+            return true;
+        }
+
+        hashBlock = chainActive[nHeight]->GetBlockHash();
+    }
+
+    return pdb->ReadCoinStats(nHeight, stats) && stats.hashBlock == hashBlock;
+}
+
+int CCoinStatsIndex::GetHeight() const
+{
+    LOCK(cs);
+    return pindexBest ? pindexBest->nHeight : -1;
+}
+
+bool CCoinStatsIndex::IsSynced() const
+{
+    LOCK2(cs_main, cs);
+    return pindexBest == chainActive.Tip();
+}
+
+void CCoinStatsIndex::GetStatus(UniValue &obj) const
+{
+    LOCK2(cs_main, cs);
+    obj.push_back(Pair("height", pindexBest ? pindexBest->nHeight : -1));
+    obj.push_back(Pair("bestblockhash", pindexBest ? pindexBest->GetBlockHash().GetHex() : uint256().GetHex()));
+    obj.push_back(Pair("synced", pindexBest == chainActive.Tip()));
+}
+
+void ThreadCoinStatsIndex()
+{
+    RenameThread("smartcash-coinstats");
+
+    LogPrintf("%s: started\n", __func__);
+
+    try {
+        pcoinstatsindex->Run();
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("%s: interrupted\n", __func__);
+        throw;
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "ThreadCoinStatsIndex()");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "ThreadCoinStatsIndex()");
+    }
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_INDEX_COINSTATSINDEX_H
+#define SMARTCASH_INDEX_COINSTATSINDEX_H
+
+#include "crypto/muhash.h"
+#include "spentindex.h"
+#include "sync.h"
+
+class CBlock;
+class CBlockIndex;
+class CBlockTreeDB;
+class CBlockUndo;
+class COutPoint;
+class Coin;
+class UniValue;
+
+/** Add an unspent output to or remove it from the MuHash of the coin set, which doesn't depend
+ *  on the order the outputs were added in. */
+void UpdateCoinSetHash(MuHash3072 &muhash, const COutPoint &outpoint, const Coin &coin, bool fAdd);
+
+/** Advance the coin stats and coin set of the parent block by the outputs a block spends and creates */
+bool ApplyCoinStatsBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, CCoinStatsValue &stats, MuHash3072 &muhash);
+
+/** Take the outputs a block spends and creates back out of the coin set */
+bool ReverseCoinSetBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, MuHash3072 &muhash);
+
+/**
+ * Keeps the coin stats of every block of the active chain in the block tree database.
+ *
+ * ConnectBlock/DisconnectBlock update the index incrementally once it reached the tip,
+ * so money supply and UTXO set statistics at any height are a single lookup. After the
+ * index was enabled or fell behind, the indexer thread replays the missing blocks from
+ * their block and undo data until ConnectBlock can take over.
+ */
+class CCoinStatsIndex
+{
+    CBlockTreeDB *pdb;
+
+    mutable CCriticalSection cs;
+    //! Last block written to pdb, its stats and its coin set (protected by cs)
+    const CBlockIndex *pindexBest;
+    CCoinStatsValue statsBest;
+    MuHash3072 muhashBest;
+
+    CWaitableCriticalSection csNotify;
+    CConditionVariable condNotify;
+    bool fNotified;
+
+    void Notify();
+    bool WriteBlock(const CBlockIndex *pindex, const CCoinStatsValue &stats, const MuHash3072 &muhash);
+
+public:
+    CCoinStatsIndex(CBlockTreeDB *pdbIn);
+
+    //! Load the best block of the index and rewind it to the active chain.
+    bool Init();
+
+    //! Called by ConnectBlock/DisconnectBlock with cs_main held. Returns false if the database write failed.
+    bool BlockConnected(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex);
+    bool BlockDisconnected(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex);
+
+    //! Replay blocks until the index matches chainActive.
+    bool SyncWithChain();
+    //! Main loop of the indexer thread.
+    void Run();
+
+    //! Coin stats of the active chain at nHeight. Returns false if the index didn't reach nHeight yet.
+    bool Lookup(int nHeight, CCoinStatsValue &stats) const;
+
+    int GetHeight() const;
+    bool IsSynced() const;
+    void GetStatus(UniValue &obj) const;
+};
+
+/** Global variable that points to the coin stats index (NULL if -coinstatsindex is disabled) */
+extern CCoinStatsIndex *pcoinstatsindex;
+
+void ThreadCoinStatsIndex();
+
+#endif // SMARTCASH_INDEX_COINSTATSINDEX_H
@@ -11,6 +11,7 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "asynclog.h"
 #include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -19,6 +20,8 @@
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "index/addressindexer.h"
+#include "index/coinstatsindex.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -78,6 +81,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <atomic>
 #include <memory>
 
 #ifndef WIN32
@@ -145,6 +149,34 @@ enum BindFlags {
 };
 
 static const char* FEE_ESTIMATES_FILENAME="fee_estimates.dat";
+
+//! Seconds between appending the changes of the smartnode caches to their logs
+static const int SMARTNODE_CACHE_FLUSH_INTERVAL = 5 * 60;
+//! Seconds between two dumps of mempool.dat, so a crash doesn't lose all of it
+static const int MEMPOOL_DUMP_INTERVAL = 15 * 60;
+
+static std::unique_ptr<CJournaledFlatDB<CSmartnodeMan> > psmartnodecache;
+static std::unique_ptr<CJournaledFlatDB<CSmartnodePayments> > psmartnodepaymentscache;
+
+static void FlushSmartnodeCaches()
+{
+    if (psmartnodecache)
+        psmartnodecache->Flush(mnodeman);
+    if (psmartnodepaymentscache)
+        psmartnodepaymentscache->Flush(mnpayments);
+}
+
+//! Set once mempool.dat was loaded, an earlier dump would overwrite it with less
+static std::atomic<bool> fDumpMempoolLater(false);
+//! The InstantSend locks of mempool.dat need the smartnode list to be verified
+static std::atomic<bool> fSmartnodeCachesLoaded(false);
+
+static void DumpMempoolPeriodic()
+{
+    if (fDumpMempoolLater)
+        DumpMempool();
+}
+
 CClientUIInterface uiInterface; // Declared but not defined in ui_interface.h
 
 //////////////////////////////////////////////////////////////////////////////
@@ -266,17 +298,18 @@ void PrepareShutdown()
 
     bool fCache;
 
-    fCache = GetBoolArg("-cachenodelist", DEFAULT_CACHE_NODES);
-    if( fCache ){
-        CFlatDB<CSmartnodeMan> flatdb("sncache.dat", "magicSmartnodeCache");
-        flatdb.Dump(mnodeman);
-    }
+    // Append the last changes of the journaled caches, they are only compacted if a log outgrew its snapshot
+    if (psmartnodecache)
+        psmartnodecache->Dump(mnodeman);
 
-    fCache = GetBoolArg("-cachewinners", DEFAULT_CACHE_WINNERS);
-    if( fCache ){
-        CFlatDB<CSmartnodePayments> flatdb("snpayments.dat", "magicSmartnodePaymentsCache");
-        flatdb.Dump(mnpayments);
-    }
+    if (psmartnodepaymentscache)
+        psmartnodepaymentscache->Dump(mnpayments);
+
+    if (fInstantPayIndex && pblocktree)
+        instantsend.FlushInstantPayIndex();
+
+    if (fDumpMempoolLater)
+        DumpMempool();
 
     fCache = GetBoolArg("-cachefulfilled", DEFAULT_CACHE_NETFULLFILLED);
     if( fCache ){
@@ -320,13 +353,26 @@ void PrepareShutdown()
         pcoinsTip = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
+        delete pcoinsflusher;
+        pcoinsflusher = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
+        delete pcoinstatsindex;
+        pcoinstatsindex = NULL;
         delete pblocktree;
         pblocktree = NULL;
         delete prewards;
         prewards = NULL;
     }
+
+    if (paddressindexer) {
+        UnregisterValidationInterface(paddressindexer);
+        delete paddressindexer;
+        paddressindexer = NULL;
+    }
+
+    delete pvotedb;
+    pvotedb = NULL;
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         pwalletMain->Flush(true);
@@ -371,6 +417,7 @@ void Shutdown()
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopDebugLogWriter();
 }
 
 /**
@@ -435,6 +482,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-? or -help", _("Show options and exit"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the coins cache to disk in a background thread, so block validation continues during the write. The coins being written count against -dbcache (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -457,6 +505,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
@@ -471,7 +520,9 @@ std::string HelpMessage(HelpMessageMode mode)
     // ### SMARTCASH ###
     // txindex option is currently disabled, defaults to true.
     //strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-coinstatsindex", strprintf(_("Maintain coin statistics per block, used by the getmoneysupply and gettxoutsetinfo rpc calls (default: %u)"), DEFAULT_COINSTATSINDEX));
     strUsage += HelpMessageOpt("-depositindex", strprintf(_("Maintain a address deposit index, used by the SAPI and the getdeposits rpc call (not yet implemented) (default: %u)"), DEFAULT_DEPOSITINDEX));
+    strUsage += HelpMessageOpt("-addressindexdbcache=<n>", strprintf(_("Set the address index database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nAddressIndexMaxDbCache, nAddressIndexDefaultDbCache));
 
     strUsage += HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -490,6 +541,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msghandlerthreads=<n>", strprintf(_("Number of threads processing peer messages (1 to %d, default: %d)"), MAX_MESSAGE_HANDLER_THREADS, DEFAULT_MESSAGE_HANDLER_THREADS));
     strUsage += HelpMessageOpt("-minpeerprotocol=<n>", strprintf(_("Minimimum protocol <n> to connect (default: %u)"), MIN_PEER_PROTO_VERSION));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
@@ -500,6 +552,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-rpcserialversion", strprintf(_("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"), DEFAULT_RPC_SERIALIZE_VERSION));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Socket events mode, which must be one of: %s (default: %s)"), GetSupportedSocketEventsModes(), GetSocketEventsModeName(GetDefaultSocketEventsMode())));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
@@ -527,6 +580,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubaddressdelta=<address>", _("Enable publish address balance changes of connected and disconnected blocks in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrewardsround=<address>", _("Enable publish SmartRewards round start and finish in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubsmartnodelist=<address>", _("Enable publish smartnode list changes in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -555,10 +611,12 @@ std::string HelpMessage(HelpMessageMode mode)
     if (showDebug)
         strUsage += HelpMessageOpt("-nodebug", "Turn off debugging messages, same as -debug=0");
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
+    strUsage += HelpMessageOpt("-asynclog", strprintf(_("Write debug.log on a separate thread (default: %u)"), DEFAULT_ASYNCLOG));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
     {
+        strUsage += HelpMessageOpt("-logdropoverflow", strprintf("Drop debug messages instead of waiting if -asynclog falls behind (default: %u)", DEFAULT_LOGDROPOVERFLOW));
         strUsage += HelpMessageOpt("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS));
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
@@ -772,6 +830,13 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         LogPrintf("Stopping after block import\n");
         StartShutdown();
     }
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        while (!fRequestShutdown && !fSmartnodeCachesLoaded)
+            MilliSleep(10);
+        LoadMempool();
+        fDumpMempoolLater = !fRequestShutdown;
+    }
 }
 
 /** Sanity checks
@@ -945,19 +1010,6 @@ void InitParameterInteraction()
     }
 
     fInstantPayIndex = GetBoolArg("-instantpayindex", DEFAULT_INSTANTPAYINDEX);
-
-    // Make sure additional indexes are recalculated correctly in VerifyDB
-    // (we must reconnect blocks whenever we disconnect them for these indexes to work)
-    bool fAdditionalIndexes =
-        GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
-        GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
-        GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX) ||
-        GetBoolArg("-depositindex", DEFAULT_DEPOSITINDEX);
-
-    if (fAdditionalIndexes && GetArg("-checklevel", DEFAULT_CHECKLEVEL) < 4) {
-        mapArgs["-checklevel"] = "4";
-        LogPrintf("%s: parameter interaction: additional indexes -> setting -checklevel=4\n", __func__);
-    }
 }
 
 // static std::string ResolveErrMsg(const char * const optname, const std::string& strBind)
@@ -1069,7 +1121,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             "peers.dat",
             "netfulfilled.dat",
             "sncache.dat",
+            "sncache.dat.log",
             "snpayments.dat",
+            "snpayments.dat.log",
             "banlist.dat",
             "fee_estimates.dat"
             // WIP-VOTING uncomment
@@ -1735,13 +1789,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
-                delete pcoinsdbview;
                 delete pcoinscatcher;
+                // Commits a batch still in flight before the database goes away
+                delete pcoinsflusher;
+                delete pcoinsdbview;
                 delete pblocktree;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+                pcoinsflusher = new CCoinsViewBackgroundFlush(pcoinsdbview, GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH));
+                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsflusher);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
                 if (fReindex) {
@@ -1758,6 +1815,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 }
                 if (fRequestShutdown) break;
 
+                if (fInstantPayIndex && !pblocktree->UpgradeInstantPayIndex()) {
+                    strLoadError = _("Error upgrading block database");
+                    break;
+                }
+
                 if (!LoadBlockIndex()) {
                     strLoadError = _("Error loading block database");
                     break;
@@ -1860,6 +1922,59 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     LogPrintf(" rewards %15dms\n", GetTimeMillis() - nStart);
 
+    // ********************************************************* Step 7b: load address index
+
+    if (fAddressIndex || fSpentIndex || fDepositIndex) {
+
+        int64_t nAddressIndexCache = GetArg("-addressindexdbcache", nAddressIndexDefaultDbCache);
+        nAddressIndexCache = std::min(std::max(nAddressIndexCache, nMinDbCache), nAddressIndexMaxDbCache) << 20;
+        LogPrintf("* Using %.1fMiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+
+        uiInterface.InitMessage(_("Loading address index..."));
+
+        bool fWipe = fReindex || fReindexChainState;
+        CAddressIndexDB *paddressindexdb = new CAddressIndexDB(nAddressIndexCache, false, fWipe);
+
+        // Rebuild the index in the background if the enabled indexes changed
+        std::vector<std::pair<std::string, bool> > vecIndexFlags = {{"addressindex", fAddressIndex}, {"spentindex", fSpentIndex}, {"depositindex", fDepositIndex}};
+        for (const std::pair<std::string, bool> &flag : vecIndexFlags) {
+            bool fStored;
+            if (!paddressindexdb->ReadFlag(flag.first, fStored) || fStored != flag.second) {
+                fWipe = true;
+            }
+        }
+
+        paddressindexer = new CAddressIndexer(paddressindexdb);
+
+        if (fWipe || !paddressindexer->Init()) {
+            LogPrintf("Rebuilding address index\n");
+            delete paddressindexer;
+            paddressindexdb = new CAddressIndexDB(nAddressIndexCache, false, true);
+            paddressindexer = new CAddressIndexer(paddressindexdb);
+        }
+
+        for (const std::pair<std::string, bool> &flag : vecIndexFlags) {
+            paddressindexdb->WriteFlag(flag.first, flag.second);
+        }
+
+        // Indexes written before the balance ranking existed get it summed up once
+        if (fAddressIndex && !paddressindexdb->UpgradeAddressBalances())
+            return InitError(_("Failed to sum up the address balances"));
+
+        RegisterValidationInterface(paddressindexer);
+    }
+
+    if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+
+        pcoinstatsindex = new CCoinStatsIndex(pblocktree);
+
+        if (!pcoinstatsindex->Init()) {
+            LogPrintf("Rebuilding coin stats index\n");
+            delete pcoinstatsindex;
+            pcoinstatsindex = new CCoinStatsIndex(pblocktree);
+        }
+    }
+
     boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
@@ -2071,6 +2186,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+    if (paddressindexer)
+        threadGroup.create_thread(&ThreadAddressIndexer);
+    if (pcoinstatsindex)
+        threadGroup.create_thread(&ThreadCoinStatsIndex);
     if (chainActive.Tip() == NULL) {
         LogPrintf("Waiting for genesis block to be imported...\n");
         while (!fRequestShutdown && chainActive.Tip() == NULL)
@@ -2171,8 +2290,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         if( fCache ){
             strDBName = "sncache.dat";
             uiInterface.InitMessage(_("Loading smartnode cache..."));
-            CFlatDB<CSmartnodeMan> flatdb(strDBName, "magicSmartnodeCache");
-            if(!flatdb.Load(mnodeman)) {
+            psmartnodecache.reset(new CJournaledFlatDB<CSmartnodeMan>(strDBName, "magicSmartnodeCache"));
+            if(!psmartnodecache->Load(mnodeman)) {
                 InitError(_("Failed to load smartnode cache from") + "\n" + (pathDB / strDBName).string());
                 try {
                     boost::filesystem::remove((pathDB / strDBName).string());
@@ -2186,8 +2305,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         if( fCache ){
             strDBName = "snpayments.dat";
             uiInterface.InitMessage(_("Loading smartnode payment cache..."));
-            CFlatDB<CSmartnodePayments> flatdb(strDBName, "magicSmartnodePaymentsCache");
-            if(!flatdb.Load(mnpayments)) {
+            psmartnodepaymentscache.reset(new CJournaledFlatDB<CSmartnodePayments>(strDBName, "magicSmartnodePaymentsCache"));
+            if(!psmartnodepaymentscache->Load(mnpayments)) {
                 InitWarning(_("Failed to load smartnode payments cache from") + "\n" + (pathDB / strDBName).string());
                 try {
                     boost::filesystem::remove((pathDB / strDBName).string());
@@ -2212,6 +2331,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             }
         }
 
+        bool fVotingCacheLoaded = false;
+
         /* WIP-VOTING uncomment
         fCache = GetBoolArg("-cachevoting", DEFAULT_CACHE_VOTING);
         if( fCache ){
@@ -2226,12 +2347,24 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     LogPrintf("Unable to remove smartvoting.dat: %s\n", e.what());
                 }
             }else{
-                smartVoting.InitOnLoad();
+                fVotingCacheLoaded = true;
             }
         }
         */
+
+        // Votes evicted from the proposals' memory cache. Without the smartvoting
+        // cache the proposals are unknown, so their votes get synced again.
+        pvotedb = new CProposalVoteDB(nProposalVoteDbCache << 20, false, !fVotingCacheLoaded);
+
+        if( fVotingCacheLoaded )
+            smartVoting.InitOnLoad();
+
+        // Only the changes are written, so the caches survive a crash without a full dump
+        scheduler.scheduleEvery(&FlushSmartnodeCaches, SMARTNODE_CACHE_FLUSH_INTERVAL);
     }
 
+    fSmartnodeCachesLoaded = true;
+
     // ********************************************************* Step 11c: update block tip in SmartCash modules
 
     // force UpdatedBlockTip to initialize nCachedBlockHeight for DS, MN payments and budgets
@@ -2243,6 +2376,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     threadGroup.create_thread(boost::bind(&ThreadSmartnode, boost::ref(*g_connman)));
 
+    if (fInstantPayIndex)
+        scheduler.scheduleEvery(boost::bind(&CInstantSend::FlushInstantPayIndex, &instantsend), INSTANTPAY_INDEX_FLUSH_INTERVAL);
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL))
+        scheduler.scheduleEvery(&DumpMempoolPeriodic, MEMPOOL_DUMP_INTERVAL);
+
 //  WIP-VOTING uncomment
 //    threadGroup.create_thread(&ThreadSmartVoting);
 
@@ -2289,6 +2428,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     connOptions.uiInterface = &uiInterface;
     connOptions.nSendBufferMaxSize = 1000*GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.nMessageHandlerThreads = std::max(1, std::min((int)GetArg("-msghandlerthreads", DEFAULT_MESSAGE_HANDLER_THREADS), MAX_MESSAGE_HANDLER_THREADS));
+
+    std::string strSocketEventsMode = GetArg("-socketevents", GetSocketEventsModeName(GetDefaultSocketEventsMode()));
+    if (!ParseSocketEventsMode(strSocketEventsMode, connOptions.socketEventsMode))
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEventsMode, GetSupportedSocketEventsModes()));
 
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return InitError(strNodeError);
@@ -0,0 +1,161 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonwriter.h"
+
+#include "univalue.h"
+
+#include <assert.h>
+
+CJSONStreamWriter::CJSONStreamWriter(const ChunkHandler& handler, unsigned int nPrettyIndent, size_t nChunkSize) :
+    handler(handler), nPrettyIndent(nPrettyIndent), nChunkSize(nChunkSize), fKeyWritten(false), fFlushed(false)
+{
+    strBuffer.reserve(nChunkSize + 1024);
+}
+
+void CJSONStreamWriter::Write(const std::string& str)
+{
+    strBuffer += str;
+
+    if (strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+
+    handler(strBuffer);
+    strBuffer.clear();
+    fFlushed = true;
+}
+
+std::string CJSONStreamWriter::Release()
+{
+    std::string str;
+    str.swap(strBuffer);
+    return str;
+}
+
+void CJSONStreamWriter::BeginElement()
+{
+    // Top level value or the value of a member
+    if (vecLevels.empty() || fKeyWritten) {
+        fKeyWritten = false;
+        return;
+    }
+
+    Level& level = vecLevels.back();
+
+    // Same separators as UniValue::writeArray/writeObject
+    std::string str;
+    if (level.nElements) {
+        str += ",";
+        if (nPrettyIndent && !level.fObject)
+            str += " ";
+        if (nPrettyIndent)
+            str += "\n";
+    }
+    if (nPrettyIndent)
+        str.append(nPrettyIndent * vecLevels.size(), ' ');
+
+    level.nElements++;
+    Write(str);
+}
+
+void CJSONStreamWriter::Begin(bool fObject)
+{
+    BeginElement();
+    vecLevels.push_back(Level(fObject));
+    Write(nPrettyIndent ? (fObject ? "{\n" : "[\n") : (fObject ? "{" : "["));
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    Begin(true);
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    Begin(false);
+}
+
+void CJSONStreamWriter::End()
+{
+    assert(!vecLevels.empty() && !fKeyWritten);
+
+    Level level = vecLevels.back();
+
+    std::string str;
+    if (nPrettyIndent) {
+        if (level.nElements)
+            str += "\n";
+        str.append(nPrettyIndent * (vecLevels.size() - 1), ' ');
+    }
+    str += level.fObject ? "}" : "]";
+
+    vecLevels.pop_back();
+    Write(str);
+}
+
+void CJSONStreamWriter::Key(const std::string& strKey)
+{
+    assert(!vecLevels.empty() && vecLevels.back().fObject && !fKeyWritten);
+
+    BeginElement();
+    Write(UniValue(strKey).write() + (nPrettyIndent ? ": " : ":"));
+    fKeyWritten = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    assert(vecLevels.empty() || fKeyWritten || !vecLevels.back().fObject);
+
+    switch (value.getType()) {
+    case UniValue::VOBJ:
+        BeginObject();
+        Members(value);
+        End();
+        break;
+    case UniValue::VARR:
+        BeginArray();
+        for (unsigned int i = 0; i < value.size(); i++)
+            Value(value[i]);
+        End();
+        break;
+    case UniValue::VNUM:
+        BeginElement();
+        Write(value.getValStr());
+        break;
+    case UniValue::VBOOL:
+        BeginElement();
+        Write(value.isTrue() ? "true" : "false");
+        break;
+    case UniValue::VNULL:
+        BeginElement();
+        Write("null");
+        break;
+    case UniValue::VSTR:
+        BeginElement();
+        Write(value.write());
+        break;
+    }
+}
+
+void CJSONStreamWriter::Members(const UniValue& obj)
+{
+    assert(obj.isObject());
+
+    const std::vector<std::string> keys = obj.getKeys();
+    for (unsigned int i = 0; i < keys.size(); i++) {
+        Key(keys[i]);
+        Value(obj[i]);
+    }
+}
+
+void CJSONStreamWriter::Raw(const std::string& str)
+{
+    Write(str);
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_JSONWRITER_H
+#define SMARTCASH_JSONWRITER_H
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+class UniValue;
+
+//! Output collected before it is handed on
+static const size_t DEFAULT_JSON_CHUNK_SIZE = 256 * 1024;
+
+/**
+ * Writes JSON piece by piece with exactly the formatting of UniValue::write().
+ *
+ * The output is collected in a buffer that is passed to the chunk handler
+ * whenever it grows beyond the chunk size, so large replies never have to
+ * exist as one string. Nested UniValues are written element by element.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> ChunkHandler;
+
+    CJSONStreamWriter(const ChunkHandler& handler, unsigned int nPrettyIndent = 0, size_t nChunkSize = DEFAULT_JSON_CHUNK_SIZE);
+
+    void BeginObject();
+    void BeginArray();
+    //! Close the innermost object or array
+    void End();
+    //! Start the next member of the current object
+    void Key(const std::string& strKey);
+    //! Write a complete value as array element, object member or top level value
+    void Value(const UniValue& value);
+    //! Write the members of obj as members of the current object
+    void Members(const UniValue& obj);
+    //! Append str without any formatting
+    void Raw(const std::string& str);
+
+    //! Pass everything written so far to the chunk handler
+    void Flush();
+    //! Take everything written so far without passing it to the chunk handler
+    std::string Release();
+
+    //! True once the chunk handler was called
+    bool Flushed() const { return fFlushed; }
+
+private:
+    struct Level {
+        bool fObject;
+        size_t nElements;
+        Level(bool fObjectIn) : fObject(fObjectIn), nElements(0) {}
+    };
+
+    ChunkHandler handler;
+    unsigned int nPrettyIndent;
+    size_t nChunkSize;
+
+    std::string strBuffer;
+    std::vector<Level> vecLevels;
+    bool fKeyWritten;
+    bool fFlushed;
+
+    void Begin(bool fObject);
+    void BeginElement();
+    void Write(const std::string& str);
+};
+
+#endif // SMARTCASH_JSONWRITER_H
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include "support/allocators/pool.h"
+
 #include <stdlib.h>
 
 #include <map>
@@ -141,6 +143,15 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template<typename X, typename Y, typename Z, typename E, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z, E, PoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> >& m)
+{
+    // The nodes live in the chunks of the pool, the chunk pointers in a std::list
+    const PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* pool = m.get_allocator().resource();
+    size_t nChunks = pool->NumAllocatedChunks();
+    return (MallocUsage(sizeof(void*) * 3) + MallocUsage(pool->ChunkSizeBytes())) * nChunks + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
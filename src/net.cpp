@@ -32,6 +32,10 @@
 #include <fcntl.h>
 #endif
 
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -735,6 +739,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
             i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
 
             msg.nTime = nTimeMicros;
+            msg.nPriority = GetMessagePriority(msg.hdr.GetCommand());
             complete = true;
         }
     }
@@ -742,6 +747,12 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+int CNode::GetProcessPriority()
+{
+    LOCK(cs_vProcessMsg);
+    return vProcessMsg.empty() ? -1 : vProcessMsg.front().nPriority;
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -1103,11 +1114,272 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        RegisterEvents(pnode);
+    }
+}
+SocketEventsMode GetDefaultSocketEventsMode()
+{
+#ifdef HAVE_EPOLL
+    return SOCKETEVENTS_EPOLL;
+#else
+    return SOCKETEVENTS_SELECT;
+#endif
+}
+
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& mode)
+{
+    if (strMode == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef HAVE_EPOLL
+    if (strMode == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_SELECT: return "select";
+    case SOCKETEVENTS_EPOLL: return "epoll";
+    }
+    return "unknown";
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+#ifdef HAVE_EPOLL
+    return "select, epoll";
+#else
+    return "select";
+#endif
+}
+
+CSocketEvents::CSocketEvents(SocketEventsMode modeIn) : mode(modeIn), epollfd(-1)
+{
+#ifdef HAVE_EPOLL
+    if (mode == SOCKETEVENTS_EPOLL) {
+        epollfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollfd == -1) {
+            LogPrintf("%s: epoll_create1 failed (%s), falling back to select\n", __func__, NetworkErrorString(errno));
+            mode = SOCKETEVENTS_SELECT;
+        }
+    }
+#else
+    mode = SOCKETEVENTS_SELECT;
+#endif
+}
+
+CSocketEvents::~CSocketEvents()
+{
+#ifdef HAVE_EPOLL
+    if (epollfd != -1)
+        close(epollfd);
+#endif
+}
+
+bool CSocketEvents::Add(SOCKET hSocket, bool fEdgeTriggered)
+{
+#ifdef HAVE_EPOLL
+    if (mode == SOCKETEVENTS_EPOLL) {
+        struct epoll_event event;
+        event.data.fd = hSocket;
+        event.events = fEdgeTriggered ? (EPOLLIN | EPOLLOUT | EPOLLET) : EPOLLIN;
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+            LogPrintf("%s: epoll_ctl failed (%s)\n", __func__, NetworkErrorString(errno));
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+bool CSocketEvents::Remove(SOCKET hSocket)
+{
+#ifdef HAVE_EPOLL
+    if (mode == SOCKETEVENTS_EPOLL) {
+        struct epoll_event event;
+        if (epoll_ctl(epollfd, EPOLL_CTL_DEL, hSocket, &event) != 0)
+            return false;
+    }
+#endif
+    return true;
+}
+
+bool CSocketEvents::Wait(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeout)
+{
+#ifdef HAVE_EPOLL
+    if (mode == SOCKETEVENTS_EPOLL) {
+        recv_set.clear();
+        send_set.clear();
+        error_set.clear();
+
+        struct epoll_event events[256];
+        int nEvents = epoll_wait(epollfd, events, ARRAYLEN(events), nTimeout);
+        if (nEvents < 0) {
+            if (errno == EINTR)
+                return true;
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(errno));
+            return false;
+        }
+
+        for (int i = 0; i < nEvents; i++) {
+            SOCKET hSocket = events[i].data.fd;
+            if (events[i].events & EPOLLIN)
+                recv_set.insert(hSocket);
+            if (events[i].events & EPOLLOUT)
+                send_set.insert(hSocket);
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                error_set.insert(hSocket);
+        }
+        return true;
+    }
+#endif
+
+    struct timeval timeout;
+    timeout.tv_sec  = nTimeout / 1000;
+    timeout.tv_usec = (nTimeout % 1000) * 1000;
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+
+    // Errors are reported for every socket of interest
+    std::set<SOCKET> error_select(error_set);
+    error_select.insert(recv_set.begin(), recv_set.end());
+    error_select.insert(send_set.begin(), send_set.end());
+
+    BOOST_FOREACH(SOCKET hSocket, recv_set) {
+        FD_SET(hSocket, &fdsetRecv);
+    }
+    BOOST_FOREACH(SOCKET hSocket, send_set) {
+        FD_SET(hSocket, &fdsetSend);
+    }
+    BOOST_FOREACH(SOCKET hSocket, error_select) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+        have_fds = true;
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+        }
+        // Try to receive from all sockets, errors will show up there
+        recv_set.swap(error_select);
+        send_set.clear();
+        error_set.clear();
+        return false;
+    }
+
+    error_set.clear();
+    for (std::set<SOCKET>::iterator it = recv_set.begin(); it != recv_set.end(); ) {
+        if (FD_ISSET(*it, &fdsetRecv))
+            ++it;
+        else
+            recv_set.erase(it++);
+    }
+    for (std::set<SOCKET>::iterator it = send_set.begin(); it != send_set.end(); ) {
+        if (FD_ISSET(*it, &fdsetSend))
+            ++it;
+        else
+            send_set.erase(it++);
+    }
+    BOOST_FOREACH(SOCKET hSocket, error_select) {
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+
+    return true;
+}
+
+void CConnman::RegisterEvents(CNode *pnode)
+{
+    AssertLockHeld(cs_vNodes);
+
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET || !socketEvents || socketEvents->GetMode() != SOCKETEVENTS_EPOLL)
+        return;
+
+    if (socketEvents->Add(pnode->hSocket))
+        mapSocketNodes[pnode->hSocket] = pnode;
+}
+
+void CConnman::UnregisterEvents(CNode *pnode)
+{
+    AssertLockHeld(cs_vNodes);
+
+    if (!socketEvents || socketEvents->GetMode() != SOCKETEVENTS_EPOLL)
+        return;
+
+    for (std::map<SOCKET, CNode*>::iterator it = mapSocketNodes.begin(); it != mapSocketNodes.end(); ++it) {
+        if (it->second != pnode)
+            continue;
+        {
+            // A socket closed already has been removed from the epoll set by the kernel
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == it->first)
+                socketEvents->Remove(it->first);
+        }
+        mapSocketNodes.erase(it);
+        break;
+    }
+}
+
+void CConnman::InactivityCheck(CNode *pnode)
+{
+    int64_t nTime = GetSystemTimeInSeconds();
+    if (nTime - pnode->nTimeConnected > 60)
+    {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
+        {
+            LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
+        {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
+        {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        }
+        else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+        {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
+        }
+        else if (!pnode->fSuccessfullyConnected)
+        {
+            LogPrintf("version handshake timeout from %d\n", pnode->id);
+            pnode->fDisconnect = true;
+        }
     }
 }
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    int64_t nLastInactivityCheck = 0;
+    const bool fEpoll = socketEvents->GetMode() == SOCKETEVENTS_EPOLL;
+
     while (!interruptNet)
     {
         //
@@ -1131,6 +1403,10 @@ void CConnman::ThreadSocketHandler()
                     pnode->grantOutbound.Release();
                     pnode->grantSmartnodeOutbound.Release();
 
+                    // stop watching the socket
+                    UnregisterEvents(pnode);
+                    mapReceivableNodes.erase(pnode->id);
+
                     // close socket and cleanup
                     pnode->CloseSocketDisconnect();
 
@@ -1180,26 +1456,17 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
+        int nTimeout = 50; // frequency to poll pnode->vSend
 
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+        std::set<SOCKET> recv_set;
+        std::set<SOCKET> send_set;
+        std::set<SOCKET> error_set;
 
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
+        if (!fEpoll) {
+            BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+                recv_set.insert(hListenSocket.socket);
+            }
 
-        {
             LOCK(cs_vNodes);
             BOOST_FOREACH(CNode* pnode, vNodes)
             {
@@ -1225,46 +1492,44 @@ void CConnman::ThreadSocketHandler()
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
 
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
                 if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
+                    send_set.insert(pnode->hSocket);
                     continue;
                 }
                 if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
+                    recv_set.insert(pnode->hSocket);
+                } else {
+                    error_set.insert(pnode->hSocket);
+                }
+            }
+        } else {
+            // Nodes which still have data to receive need no waiting
+            BOOST_FOREACH(const PAIRTYPE(NodeId, CNode*)& item, mapReceivableNodes) {
+                CNode* pnode = item.second;
+                if (pnode->fPauseRecv)
+                    continue;
+                LOCK(pnode->cs_vSend);
+                if (pnode->vSendMsg.empty()) {
+                    nTimeout = 0;
+                    break;
                 }
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-        if (interruptNet)
-            return;
-
-        if (nSelect == SOCKET_ERROR)
+        if (!socketEvents->Wait(recv_set, send_set, error_set, nTimeout))
         {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
+            if (!interruptNet.sleep_for(std::chrono::milliseconds(nTimeout)))
                 return;
         }
+        if (interruptNet)
+            return;
 
         //
         // Accept new connections
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket))
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1273,7 +1538,38 @@ void CConnman::ThreadSocketHandler()
         //
         // Service each socket
         //
-        std::vector<CNode*> vNodesCopy = CopyNodeVector();
+        std::vector<CNode*> vNodesCopy;
+        std::set<CNode*> setSendable;
+        if (!fEpoll) {
+            vNodesCopy = CopyNodeVector();
+        } else {
+            // Only the nodes with ready sockets
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(SOCKET hSocket, recv_set) {
+                std::map<SOCKET, CNode*>::iterator it = mapSocketNodes.find(hSocket);
+                if (it != mapSocketNodes.end())
+                    mapReceivableNodes.emplace(it->second->id, it->second);
+            }
+            BOOST_FOREACH(SOCKET hSocket, error_set) {
+                std::map<SOCKET, CNode*>::iterator it = mapSocketNodes.find(hSocket);
+                if (it != mapSocketNodes.end())
+                    mapReceivableNodes.emplace(it->second->id, it->second);
+            }
+            BOOST_FOREACH(SOCKET hSocket, send_set) {
+                std::map<SOCKET, CNode*>::iterator it = mapSocketNodes.find(hSocket);
+                if (it != mapSocketNodes.end())
+                    setSendable.insert(it->second);
+            }
+            std::set<CNode*> setReady(setSendable);
+            BOOST_FOREACH(const PAIRTYPE(NodeId, CNode*)& item, mapReceivableNodes) {
+                setReady.insert(item.second);
+            }
+            BOOST_FOREACH(CNode* pnode, setReady) {
+                pnode->AddRef();
+                vNodesCopy.push_back(pnode);
+            }
+        }
+
         BOOST_FOREACH(CNode* pnode, vNodesCopy)
         {
             if (interruptNet)
@@ -1285,13 +1581,22 @@ void CConnman::ThreadSocketHandler()
             bool recvSet = false;
             bool sendSet = false;
             bool errorSet = false;
-            {
+            if (!fEpoll) {
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
+            } else {
+                bool fHasSendData;
+                {
+                    LOCK(pnode->cs_vSend);
+                    fHasSendData = !pnode->vSendMsg.empty();
+                }
+                // Same as above, drain the write buffer before receiving more
+                recvSet = !fHasSendData && !pnode->fPauseRecv && mapReceivableNodes.count(pnode->id);
+                sendSet = fHasSendData && setSendable.count(pnode);
             }
             if (recvSet || errorSet)
             {
@@ -1314,18 +1619,23 @@ void CConnman::ThreadSocketHandler()
                             RecordBytesRecv(nBytes);
                             if (notify) {
                                 size_t nSizeAdded = 0;
+                                int nAdded[MSG_PRIORITY_COUNT] = {};
                                 auto it(pnode->vRecvMsg.begin());
                                 for (; it != pnode->vRecvMsg.end(); ++it) {
                                     if (!it->complete())
                                         break;
                                     nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+                                    nAdded[it->nPriority]++;
                                 }
                                 {
                                     LOCK(pnode->cs_vProcessMsg);
                                     pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
                                     pnode->nProcessQueueSize += nSizeAdded;
                                     pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+                                    for (int i = 0; i < MSG_PRIORITY_COUNT; i++)
+                                        nQueuedMessages[i] += nAdded[i];
                                 }
+                                nHighPriorityReceived += nAdded[MSG_PRIORITY_HIGH];
                                 WakeMessageHandler();
                             }
                         }
@@ -1335,6 +1645,7 @@ void CConnman::ThreadSocketHandler()
                             if (!pnode->fDisconnect)
                                 LogPrint("net", "socket closed\n");
                             pnode->CloseSocketDisconnect();
+                            mapReceivableNodes.erase(pnode->id);
                         }
                         else if (nBytes < 0)
                         {
@@ -1345,6 +1656,12 @@ void CConnman::ThreadSocketHandler()
                                 if (!pnode->fDisconnect)
                                     LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
                                 pnode->CloseSocketDisconnect();
+                                mapReceivableNodes.erase(pnode->id);
+                            }
+                            else if (nErr == WSAEWOULDBLOCK)
+                            {
+                                // drained, wait for the next edge
+                                mapReceivableNodes.erase(pnode->id);
                             }
                         }
                     }
@@ -1362,41 +1679,21 @@ void CConnman::ThreadSocketHandler()
                     RecordBytesSent(nBytes);
                 }
             }
-
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetSystemTimeInSeconds();
-            if (nTime - pnode->nTimeConnected > 60)
-            {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
-                {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
-                {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
-                {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                }
-                else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
-                {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-                else if (!pnode->fSuccessfullyConnected)
-                {
-                    LogPrintf("version handshake timeout from %d\n", pnode->id);
-                    pnode->fDisconnect = true;
-                }
-            }
         }
         ReleaseNodeVector(vNodesCopy);
+
+        //
+        // Inactivity checking
+        //
+        int64_t nTime = GetSystemTimeInSeconds();
+        if (nTime != nLastInactivityCheck)
+        {
+            nLastInactivityCheck = nTime;
+            std::vector<CNode*> vNodesCheck = CopyNodeVector();
+            BOOST_FOREACH(CNode* pnode, vNodesCheck)
+                InactivityCheck(pnode);
+            ReleaseNodeVector(vNodesCheck);
+        }
     }
 }
 
@@ -2020,6 +2317,7 @@ bool CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        RegisterEvents(pnode);
     }
 
     return true;
@@ -2035,24 +2333,50 @@ void CConnman::ThreadMessageHandler()
     {
         std::vector<CNode*> vNodesCopy = CopyNodeVector();
 
+        // Serve the nodes with blocks or headers at the front of their queue first,
+        // smartnode and vote gossip last
+        std::vector<std::pair<int, CNode*> > vNodesByPriority;
+        vNodesByPriority.reserve(vNodesCopy.size());
+        BOOST_FOREACH(CNode* pnode, vNodesCopy)
+            vNodesByPriority.push_back(std::make_pair(pnode->GetProcessPriority(), pnode));
+        std::stable_sort(vNodesByPriority.begin(), vNodesByPriority.end(),
+                         [](const std::pair<int, CNode*>& a, const std::pair<int, CNode*>& b) { return a.first > b.first; });
+
+        const uint64_t nHighPriorityReceivedStart = nHighPriorityReceived;
         bool fMoreWork = false;
 
-        BOOST_FOREACH(CNode* pnode, vNodesCopy)
+        for (const auto& entry : vNodesByPriority)
         {
+            CNode* pnode = entry.second;
+
             if (pnode->fDisconnect)
                 continue;
 
+            // Start over if blocks or headers came in while we were busy with lower priority messages
+            if (entry.first < MSG_PRIORITY_HIGH && nHighPriorityReceived != nHighPriorityReceivedStart) {
+                fMoreWork = true;
+                break;
+            }
+
+            // Only one thread at a time may process a node, this keeps its messages in order
+            bool fExpected = false;
+            if (!pnode->fProcessing.compare_exchange_strong(fExpected, true))
+                continue;
+
             // Receive messages
             bool fMoreNodeWork = GetNodeSignals().ProcessMessages(pnode, *this, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
-            if (flagInterruptMsgProc)
+            if (flagInterruptMsgProc) {
+                pnode->fProcessing = false;
                 return;
+            }
 
             // Send messages
             {
                 LOCK(pnode->cs_sendProcessing);
                 GetNodeSignals().SendMessages(pnode, *this, flagInterruptMsgProc);
             }
+            pnode->fProcessing = false;
             if (flagInterruptMsgProc)
                 return;
         }
@@ -2067,6 +2391,40 @@ void CConnman::ThreadMessageHandler()
     }
 }
 
+bool CConnman::PollMessage(CNode* pnode, std::list<CNetMessage>& msgs, bool& fMoreWork)
+{
+    LOCK(pnode->cs_vProcessMsg);
+    if (pnode->vProcessMsg.empty())
+        return false;
+    msgs.splice(msgs.begin(), pnode->vProcessMsg, pnode->vProcessMsg.begin());
+    pnode->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+    pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+    nQueuedMessages[msgs.front().nPriority]--;
+    fMoreWork = !pnode->vProcessMsg.empty();
+    return true;
+}
+
+void CConnman::RecordMessageProcessingTime(const std::string& strCommand, int64_t nTimeMicros)
+{
+    LOCK(cs_msgProcStats);
+    MessageProcessingStats& stats = mapMsgProcStats[strCommand];
+    stats.nCount++;
+    stats.nTotalTime += nTimeMicros;
+    stats.nMaxTime = std::max(stats.nMaxTime, nTimeMicros);
+}
+
+std::map<std::string, CConnman::MessageProcessingStats> CConnman::GetMessageProcessingStats() const
+{
+    LOCK(cs_msgProcStats);
+    return mapMsgProcStats;
+}
+
+void CConnman::GetQueuedMessageCounts(int64_t (&nCounts)[MSG_PRIORITY_COUNT]) const
+{
+    for (int i = 0; i < MSG_PRIORITY_COUNT; i++)
+        nCounts[i] = nQueuedMessages[i];
+}
+
 bool CConnman::BindListenPort(const CService &addrBind, std::string& strError, bool fWhitelisted)
 {
     strError = "";
@@ -2254,6 +2612,10 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nBestHeight = 0;
     clientInterface = NULL;
     flagInterruptMsgProc = false;
+    nMessageHandlerThreads = 1;
+    for (int i = 0; i < MSG_PRIORITY_COUNT; i++)
+        nQueuedMessages[i] = 0;
+    nHighPriorityReceived = 0;
 }
 
 NodeId CConnman::GetNewNodeId()
@@ -2277,6 +2639,7 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
 
     nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
     nReceiveFloodSize = connOptions.nReceiveFloodSize;
+    nMessageHandlerThreads = std::max(1, std::min(connOptions.nMessageHandlerThreads, MAX_MESSAGE_HANDLER_THREADS));
 
     nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
     nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -2348,6 +2711,15 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
         fMsgProcWake = false;
     }
 
+    socketEvents.reset(new CSocketEvents(connOptions.socketEventsMode));
+    if (socketEvents->GetMode() != connOptions.socketEventsMode)
+        LogPrintf("%s: socket events mode %s not available, using %s\n", __func__,
+                  GetSocketEventsModeName(connOptions.socketEventsMode), GetSocketEventsModeName(socketEvents->GetMode()));
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+        // Level-triggered, only one connection is accepted per iteration
+        socketEvents->Add(hListenSocket.socket, false);
+    }
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2367,7 +2739,9 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     threadOpenSmartnodeConnections = std::thread(&TraceThread<std::function<void()> >, "mnbcon", std::function<void()>(std::bind(&CConnman::ThreadOpenSmartnodeConnections, this)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    LogPrintf("Using %d message handler threads\n", nMessageHandlerThreads);
+    for (int i = 0; i < nMessageHandlerThreads; i++)
+        threadMessageHandlers.push_back(std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this))));
 
     // Dump network addresses
     scheduler.scheduleEvery(boost::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL);
@@ -2431,8 +2805,11 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    BOOST_FOREACH(std::thread& thread, threadMessageHandlers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessageHandlers.clear();
     if (threadOpenSmartnodeConnections.joinable())
         threadOpenSmartnodeConnections.join();
     if (threadOpenConnections.joinable())
@@ -2468,6 +2845,9 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+    mapSocketNodes.clear();
+    mapReceivableNodes.clear();
+    socketEvents.reset();
     delete semOutbound;
     semOutbound = NULL;
     delete semAddnode;
@@ -2479,6 +2859,11 @@ void CConnman::Stop()
 void CConnman::DeleteNode(CNode* pnode)
 {
     assert(pnode);
+    {
+        LOCK(pnode->cs_vProcessMsg);
+        BOOST_FOREACH(const CNetMessage& msg, pnode->vProcessMsg)
+            nQueuedMessages[msg.nPriority]--;
+    }
     bool fUpdateConnectionTime = false;
     GetNodeSignals().FinalizeNode(pnode->GetId(), fUpdateConnectionTime);
     if(fUpdateConnectionTime)
@@ -2813,6 +3198,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nMinPingUsecTime = std::numeric_limits<int64_t>::max();
     fPauseRecv = false;
     fPauseSend = false;
+    fProcessing = false;
     nProcessQueueSize = 0;
     nPaymentMessagesInSync = 0;
 
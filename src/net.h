@@ -24,7 +24,10 @@
 #include <atomic>
 #include <condition_variable>
 #include <deque>
+#include <list>
+#include <map>
 #include <memory>
+#include <set>
 #include <stdint.h>
 #include <thread>
 
@@ -38,6 +41,7 @@
 
 class CAddrMan;
 class CScheduler;
+class CNetMessage;
 class CNode;
 
 namespace boost {
@@ -88,6 +92,10 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Default number of message handler threads */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 4;
+/** Maximum number of message handler threads */
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
@@ -96,6 +104,51 @@ static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Defaul
 
 typedef int64_t NodeId;
 
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_EPOLL = 1,
+};
+
+/** -socketevents default, epoll where available */
+SocketEventsMode GetDefaultSocketEventsMode();
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& mode);
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+/** Comma separated list of the supported -socketevents modes */
+std::string GetSupportedSocketEventsModes();
+
+/**
+ * Waits until sockets are ready for reading or writing.
+ *
+ * In epoll mode sockets are registered once with Add() and reported edge-triggered,
+ * i.e. a socket is only reported again after a recv()/send() on it returned
+ * WSAEWOULDBLOCK. Listening sockets are registered level-triggered.
+ * In select mode the sockets of interest are passed to every Wait() call.
+ */
+class CSocketEvents
+{
+private:
+    SocketEventsMode mode;
+    int epollfd;
+
+public:
+    explicit CSocketEvents(SocketEventsMode modeIn);
+    ~CSocketEvents();
+
+    SocketEventsMode GetMode() const { return mode; }
+
+    //! Register a socket (epoll mode only)
+    bool Add(SOCKET hSocket, bool fEdgeTriggered = true);
+    //! Unregister a socket (epoll mode only), must be called before closing it
+    bool Remove(SOCKET hSocket);
+
+    /**
+     * Wait up to nTimeout milliseconds for events. In select mode recv_set and send_set
+     * contain the sockets to wait for on input, in epoll mode they are ignored.
+     * Returns the ready sockets in recv_set, send_set and error_set.
+     */
+    bool Wait(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set, int nTimeout);
+};
+
 struct AddedNodeInfo
 {
     std::string strAddedNode;
@@ -146,6 +199,8 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
+        int nMessageHandlerThreads = 1;
     };
     CConnman(uint64_t nSeed0In, uint64_t nSeed1In);
     ~CConnman();
@@ -413,6 +468,24 @@ public:
     CSipHasher GetDeterministicRandomizer(uint64_t id) const;
 
     unsigned int GetReceiveFloodSize() const;
+
+    /** Take the next message off the process queue of a node. fMoreWork is set if more messages are queued. */
+    bool PollMessage(CNode* pnode, std::list<CNetMessage>& msgs, bool& fMoreWork);
+
+    /** Message handler statistics */
+    struct MessageProcessingStats
+    {
+        uint64_t nCount;
+        int64_t nTotalTime;   // microseconds
+        int64_t nMaxTime;     // microseconds
+
+        MessageProcessingStats() : nCount(0), nTotalTime(0), nMaxTime(0) {}
+    };
+    void RecordMessageProcessingTime(const std::string& strCommand, int64_t nTimeMicros);
+    std::map<std::string, MessageProcessingStats> GetMessageProcessingStats() const;
+    //! Number of messages waiting in the process queues of all nodes, per MessagePriority
+    void GetQueuedMessageCounts(int64_t (&nCounts)[MSG_PRIORITY_COUNT]) const;
+    int GetMessageHandlerThreads() const { return nMessageHandlerThreads; }
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -426,6 +499,9 @@ private:
     void ThreadOpenConnections();
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
+    void RegisterEvents(CNode* pnode);
+    void UnregisterEvents(CNode* pnode);
+    void InactivityCheck(CNode* pnode);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadOpenSmartnodeConnections();
@@ -505,6 +581,12 @@ private:
     std::vector<CNode*> vNodes;
     std::list<CNode*> vNodesDisconnected;
     mutable CCriticalSection cs_vNodes;
+
+    std::unique_ptr<CSocketEvents> socketEvents;
+    //! Sockets registered with socketEvents (protected by cs_vNodes)
+    std::map<SOCKET, CNode*> mapSocketNodes;
+    //! Nodes which got a read event and haven't been drained yet (socket handler thread only)
+    std::map<NodeId, CNode*> mapReceivableNodes;
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
@@ -533,6 +615,15 @@ private:
     std::mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc;
 
+    int nMessageHandlerThreads;
+    /** Messages in the process queues of all nodes, per MessagePriority */
+    std::atomic<int64_t> nQueuedMessages[MSG_PRIORITY_COUNT];
+    /** Number of high priority messages received so far, lets handler threads notice new blocks and headers */
+    std::atomic<uint64_t> nHighPriorityReceived;
+
+    mutable CCriticalSection cs_msgProcStats;
+    std::map<std::string, MessageProcessingStats> mapMsgProcStats;
+
     CThreadInterrupt interruptNet;
 
     std::thread threadDNSAddressSeed;
@@ -540,7 +631,7 @@ private:
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadOpenSmartnodeConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 };
 extern std::unique_ptr<CConnman> g_connman;
 void Discover(boost::thread_group& threadGroup);
@@ -669,6 +760,7 @@ public:
     unsigned int nDataPos;
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
+    MessagePriority nPriority;      // scheduling class, set once the message is complete
 
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
@@ -676,6 +768,7 @@ public:
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        nPriority = MSG_PRIORITY_NORMAL;
     }
 
     bool complete() const
@@ -767,6 +860,8 @@ public:
 
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    //! Set while a message handler thread processes this node, keeps its messages in order
+    std::atomic_bool fProcessing;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -853,6 +948,9 @@ public:
         return nRefCount;
     }
 
+    //! Priority of the next message in the process queue, -1 if there is none
+    int GetProcessPriority();
+
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
 
     void SetRecvVersion(int nVersionIn)
@@ -104,8 +104,31 @@ namespace {
 
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads = 0;
+
+    /**
+     * Serializes the message handlers across the message handler threads, except for
+     * the ones accepted by IsParallelMessage(). Taken before cs_main and the locks of
+     * the smartnode managers.
+     */
+    CCriticalSection cs_msgProcSerial;
 } // anon namespace
 
+/**
+ * Smartnode and InstantSend gossip which the managers protect with their own locks.
+ * These messages are processed concurrently, so a burst of them doesn't hold up blocks.
+ * Each of them is only passed to the manager owning it.
+ */
+static bool IsParallelMessage(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::MNANNOUNCE ||
+           strCommand == NetMsgType::MNPING ||
+           strCommand == NetMsgType::MNVERIFY ||
+           strCommand == NetMsgType::DSEG ||
+           strCommand == NetMsgType::SMARTNODEPAYMENTVOTE ||
+           strCommand == NetMsgType::SMARTNODEPAYMENTSYNC ||
+           strCommand == NetMsgType::TXLOCKVOTE;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Registration of network node signals.
@@ -648,12 +671,12 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return mapSporks.count(inv.hash);
 
     case MSG_SMARTNODE_PAYMENT_VOTE:
-        return mnpayments.mapSmartnodePaymentVotes.count(inv.hash);
+        return mnpayments.HasPaymentVote(inv.hash);
 
     case MSG_SMARTNODE_PAYMENT_BLOCK:
         {
             BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-            return mi != mapBlockIndex.end() && mnpayments.mapSmartnodeBlocks.find(mi->second->nHeight) != mnpayments.mapSmartnodeBlocks.end();
+            return mi != mapBlockIndex.end() && mnpayments.HasPaymentBlock(mi->second->nHeight);
         }
 
     case MSG_SMARTNODE_ANNOUNCE:
@@ -762,14 +785,20 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
                     if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, NetMsgType::BLOCK, block);
+                    {
+                        // Send the block as stored on disk, there is no need to deserialize it
+                        std::vector<unsigned char> vchBlock;
+                        if (!ReadRawBlockFromDisk(vchBlock, (*mi).second, Params().MessageStart()))
+                            assert(!"cannot load block from disk");
+                        connman.PushMessage(pfrom, NetMsgType::BLOCK, CFlatData(vchBlock));
+                    }
                     else // MSG_FILTERED_BLOCK)
                     {
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter)
                         {
@@ -864,10 +893,11 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 }
 
                 if (!pushed && inv.type == MSG_SMARTNODE_PAYMENT_VOTE) {
-                    if(mnpayments.HasVerifiedPaymentVote(inv.hash)) {
+                    CSmartnodePaymentVote vote;
+                    if(mnpayments.GetVerifiedPaymentVote(inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnpayments.mapSmartnodePaymentVotes[inv.hash];
+                        ss << vote;
                         connman.PushMessage(pfrom, NetMsgType::SMARTNODEPAYMENTVOTE, ss);
                         pushed = true;
                     }
@@ -875,18 +905,12 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
                 if (!pushed && inv.type == MSG_SMARTNODE_PAYMENT_BLOCK) {
                     BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                    LOCK(cs_mapSmartnodeBlocks);
-                    if (mi != mapBlockIndex.end() && mnpayments.mapSmartnodeBlocks.count(mi->second->nHeight)) {
-                        BOOST_FOREACH(CSmartnodePayee& payee, mnpayments.mapSmartnodeBlocks[mi->second->nHeight].vecPayees) {
-                            std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
-                            BOOST_FOREACH(uint256& hash, vecVoteHashes) {
-                                if(mnpayments.HasVerifiedPaymentVote(hash)) {
-                                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                                    ss.reserve(1000);
-                                    ss << mnpayments.mapSmartnodePaymentVotes[hash];
-                                    connman.PushMessage(pfrom, NetMsgType::SMARTNODEPAYMENTVOTE, ss);
-                                }
-                            }
+                    if (mi != mapBlockIndex.end() && mnpayments.HasPaymentBlock(mi->second->nHeight)) {
+                        BOOST_FOREACH(const CSmartnodePaymentVote& vote, mnpayments.GetBlockVotes(mi->second->nHeight)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << vote;
+                            connman.PushMessage(pfrom, NetMsgType::SMARTNODEPAYMENTVOTE, ss);
                         }
                         pushed = true;
                     }
@@ -1601,47 +1625,70 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
                 if (itByPrev == mapOrphanTransactionsByPrev.end())
                     continue;
+
+                // The orphans of a transaction all spend its outputs, so
+                // they are checked together. A batch takes at most one orphan
+                // per peer, so a peer found misbehaving gets none of its
+                // remaining orphans accepted
+                map<NodeId, std::vector<const CTransaction*> > mapOrphansByPeer;
                 for (set<uint256>::iterator mi = itByPrev->second.begin();
                      mi != itByPrev->second.end();
                      ++mi)
                 {
-                    const uint256& orphanHash = *mi;
-                    const CTransaction& orphanTx = mapOrphanTransactions[orphanHash].tx;
-                    NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
+                    const COrphanTx& orphan = mapOrphanTransactions[*mi];
+                    mapOrphansByPeer[orphan.fromPeer].push_back(&orphan.tx);
+                }
 
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2))
+                for (unsigned int nRound = 0; ; nRound++)
+                {
+                    std::vector<const CTransaction*> vOrphans;
+                    for (map<NodeId, std::vector<const CTransaction*> >::iterator it = mapOrphansByPeer.begin(); it != mapOrphansByPeer.end(); ++it)
                     {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        connman.RelayTransaction(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
-                        vEraseQueue.push_back(orphanHash);
+                        if (nRound < it->second.size() && !setMisbehaving.count(it->first))
+                            vOrphans.push_back(it->second[nRound]);
                     }
-                    else if (!fMissingInputs2)
+                    if (vOrphans.empty())
+                        break;
+
+                    // Keep the orphans' states apart from ours so someone can't setup nodes to counter-DoS based on orphan
+                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+                    // anyone relaying LegitTxX banned)
+                    std::vector<CTxAcceptResult> vResults;
+                    AcceptToMemoryPoolBatch(mempool, vOrphans, vResults, true);
+
+                    for (unsigned int j = 0; j < vOrphans.size(); j++)
                     {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0)
+                        const CTransaction& orphanTx = *vOrphans[j];
+                        const uint256& orphanHash = orphanTx.GetHash();
+                        NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
+                        CTxAcceptResult& result = vResults[j];
+
+                        if (result.fAccepted)
+                        {
+                            LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
+                            connman.RelayTransaction(orphanTx);
+                            vWorkQueue.push_back(orphanHash);
+                            vEraseQueue.push_back(orphanHash);
+                        }
+                        else if (!result.fMissingInputs)
                         {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+                            int nDos = 0;
+                            if (result.state.IsInvalid(nDos) && nDos > 0)
+                            {
+                                // Punish peer that gave us an invalid orphan tx
+                                Misbehaving(fromPeer, nDos);
+                                setMisbehaving.insert(fromPeer);
+                                LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+                            }
+                            // Has inputs but not accepted to mempool
+                            // Probably non-standard or insufficient fee/priority
+                            LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
+                            vEraseQueue.push_back(orphanHash);
+                            assert(recentRejects);
+                            recentRejects->insert(orphanHash);
                         }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                        assert(recentRejects);
-                        recentRejects->insert(orphanHash);
+                        mempool.check(pcoinsTip);
                     }
-                    mempool.check(pcoinsTip);
                 }
             }
 
@@ -2118,7 +2165,17 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             }
         }
 
-        if (found)
+        if (found && IsParallelMessage(strCommand))
+        {
+            // Only for the manager owning it, the other handlers expect cs_msgProcSerial
+            if (strCommand == NetMsgType::SMARTNODEPAYMENTVOTE || strCommand == NetMsgType::SMARTNODEPAYMENTSYNC)
+                mnpayments.ProcessMessage(pfrom, strCommand, vRecv, connman);
+            else if (strCommand == NetMsgType::TXLOCKVOTE)
+                instantsend.ProcessMessage(pfrom, strCommand, vRecv, connman);
+            else
+                mnodeman.ProcessMessage(pfrom, strCommand, vRecv, connman);
+        }
+        else if (found)
         {
             mnodeman.ProcessMessage(pfrom, strCommand, vRecv, connman);
             mnpayments.ProcessMessage(pfrom, strCommand, vRecv, connman);
@@ -2152,8 +2209,10 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
     //
     bool fMoreWork = false;
 
-    if (!pfrom->vRecvGetData.empty())
+    if (!pfrom->vRecvGetData.empty()) {
+        LOCK(cs_msgProcSerial);
         ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
+    }
 
     if (pfrom->fDisconnect)
         return false;
@@ -2166,16 +2225,9 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
             return false;
 
         std::list<CNetMessage> msgs;
-        {
-            LOCK(pfrom->cs_vProcessMsg);
-            if (pfrom->vProcessMsg.empty())
-                return false;
-            // Just take one message
-            msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
-            pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
-            pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman.GetReceiveFloodSize();
-            fMoreWork = !pfrom->vProcessMsg.empty();
-        }
+        // Just take one message
+        if (!connman.PollMessage(pfrom, msgs, fMoreWork))
+            return false;
         CNetMessage& msg(msgs.front());
 
         msg.SetVersion(pfrom->GetRecvVersion());
@@ -2212,9 +2264,15 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
 
         // Process message
         bool fRet = false;
+        int64_t nTimeStart = GetTimeMicros();
         try
         {
-            fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, connman, interruptMsgProc);
+            if (IsParallelMessage(strCommand)) {
+                fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, connman, interruptMsgProc);
+            } else {
+                LOCK(cs_msgProcSerial);
+                fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, connman, interruptMsgProc);
+            }
             if (interruptMsgProc)
                 return false;
             if (!pfrom->vRecvGetData.empty())
@@ -2244,6 +2302,11 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
             PrintExceptionContinue(NULL, "ProcessMessages()");
         }
 
+        int64_t nTimeProcess = GetTimeMicros() - nTimeStart;
+        connman.RecordMessageProcessingTime(strCommand, nTimeProcess);
+        LogPrint("bench", "    - %s from peer=%d: %.2fms (queued %.2fms)\n", SanitizeString(strCommand), pfrom->id,
+                 nTimeProcess * 0.001, (nTimeStart - msg.nTime) * 0.001);
+
         if (!fRet)
             LogPrint("net", "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
 
@@ -2256,6 +2319,8 @@ bool SendMessages(CNode* pto, CConnman& connman, std::atomic<bool>& interruptMsg
     const CChainParams chainParams = Params();
     const Consensus::Params& consensusParams = chainParams.GetConsensus();
     {
+        LOCK(cs_msgProcSerial);
+
         // Don't send anything until the version handshake is complete
         if (!pto->fSuccessfullyConnected || pto->fDisconnect)
             return true;
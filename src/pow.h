@@ -16,6 +16,12 @@ class uint256;
 
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&);
 unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params&);
+/** Number of entries in the retarget window limit tables */
+static const unsigned int RETARGET_WINDOW_LIMITS_SIZE = 5040;
+/** Target/actual block time ratios at which a retarget window of n+1 blocks stops growing */
+extern const float FastBlocksLimit[RETARGET_WINDOW_LIMITS_SIZE];
+extern const float SlowBlocksLimit[RETARGET_WINDOW_LIMITS_SIZE];
+
 unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex* pindexLast, uint32_t TargetBlocksSpacingSeconds, uint32_t PastBlocksMin, uint32_t PastBlocksMax);
 
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
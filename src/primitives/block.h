@@ -9,6 +9,7 @@
 #include "primitives/transaction.h"
 #include "serialize.h"
 #include "arith_uint256.h"
+#include "crypto/sha256.h"
 #include "utilstrencodings.h"
 #include "hash.h"
 
@@ -147,18 +148,21 @@ public:
     uint256 BuildMerkleTree() const
     {
         vMerkleTree.clear();
+        vMerkleTree.reserve(vtx.size() * 2 + 16); // Safe upper bound for the number of total nodes.
         for (unsigned int i = 0; i < vtx.size(); ++i){
             vMerkleTree.push_back(vtx[i].GetHash());
         }
         int j = 0;
         for (int nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
         {
-            for (int i = 0; i < nSize; i += 2)
-            {
-                int i2 = std::min(i+1, nSize-1);
-//                vMerkleTree.push_back(Hash(BEGIN(vMerkleTree[j+i]),  END(vMerkleTree[j+i]),
-                vMerkleTree.push_back(Hash4(BEGIN(vMerkleTree[j+i]),  END(vMerkleTree[j+i]),
-                                           BEGIN(vMerkleTree[j+i2]), END(vMerkleTree[j+i2])));
+            // The pairs of a level are adjacent, hash them in one batch. An odd
+            // last entry is paired with itself.
+            size_t nOut = vMerkleTree.size();
+            vMerkleTree.resize(nOut + (nSize + 1) / 2);
+            SHA256D64(vMerkleTree[nOut].begin(), vMerkleTree[j].begin(), nSize / 2);
+            if (nSize & 1) {
+                uint256 last[2] = { vMerkleTree[j+nSize-1], vMerkleTree[j+nSize-1] };
+                SHA256D64(vMerkleTree.back().begin(), last[0].begin(), 1);
             }
             j += nSize;
         }
@@ -307,3 +307,27 @@ const std::vector<std::string> &getAllNetMessageTypes()
 {
     return allNetMessageTypesVec;
 }
+
+MessagePriority GetMessagePriority(const std::string& strCommand)
+{
+    if (strCommand == NetMsgType::BLOCK ||
+        strCommand == NetMsgType::HEADERS ||
+        strCommand == NetMsgType::CMPCTBLOCK ||
+        strCommand == NetMsgType::BLOCKTXN)
+        return MSG_PRIORITY_HIGH;
+
+    if (strCommand == NetMsgType::MNANNOUNCE ||
+        strCommand == NetMsgType::MNPING ||
+        strCommand == NetMsgType::MNVERIFY ||
+        strCommand == NetMsgType::DSEG ||
+        strCommand == NetMsgType::SMARTNODEPAYMENTVOTE ||
+        strCommand == NetMsgType::SMARTNODEPAYMENTSYNC ||
+        strCommand == NetMsgType::TXLOCKVOTE ||
+        strCommand == NetMsgType::VOTINGSYNC ||
+        strCommand == NetMsgType::VOTINGPROPOSAL ||
+        strCommand == NetMsgType::VOTINGPROPOSALVOTE ||
+        strCommand == NetMsgType::SYNCSTATUSCOUNT)
+        return MSG_PRIORITY_LOW;
+
+    return MSG_PRIORITY_NORMAL;
+}
@@ -283,6 +283,17 @@ extern const char *MNVERIFY;
 /* Get a vector of all valid message types (see above) */
 const std::vector<std::string> &getAllNetMessageTypes();
 
+/** Scheduling classes of received messages, the message handler serves higher classes first */
+enum MessagePriority {
+    MSG_PRIORITY_LOW = 0,    // smartnode, InstantSend and voting gossip
+    MSG_PRIORITY_NORMAL = 1,
+    MSG_PRIORITY_HIGH = 2,   // blocks and headers
+    MSG_PRIORITY_COUNT
+};
+
+/* Get the scheduling class of a message type */
+MessagePriority GetMessagePriority(const std::string& strCommand);
+
 /** nServices flags */
 enum ServiceFlags : uint64_t {
     // Nothing
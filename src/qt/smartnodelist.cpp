@@ -313,30 +313,29 @@ void SmartnodeList::updateNodeList()
     ui->tableWidgetSmartnodes->setSortingEnabled(false);
     ui->tableWidgetSmartnodes->clearContents();
     ui->tableWidgetSmartnodes->setRowCount(0);
-    std::map<COutPoint, CSmartnode> mapSmartnodes = mnodeman.GetFullSmartnodeMap();
+    CSmartnodeListRef listSmartnodes = mnodeman.GetSmartnodeList();
 
     int offsetFromUtc = GetOffsetFromUtc();
 
-    for(auto& mnpair : mapSmartnodes)
+    for(const CSmartnodeListEntry& mn : *listSmartnodes)
     {
-        CSmartnode mn = mnpair.second;
         // populate list
         // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
-        SmartnodeWidgetItem *addressItem = new SmartnodeWidgetItem(QString::fromStdString(mn.addr.ToString()));
-        SmartnodeWidgetItem *protocolItem = new SmartnodeWidgetItem(QString::number(mn.nProtocolVersion));
+        SmartnodeWidgetItem *addressItem = new SmartnodeWidgetItem(QString::fromStdString(mn.info.addr.ToString()));
+        SmartnodeWidgetItem *protocolItem = new SmartnodeWidgetItem(QString::number(mn.info.nProtocolVersion));
         SmartnodeWidgetItem *statusItem = new SmartnodeWidgetItem(QString::fromStdString(mn.GetStatus()));
 
-        int activeSeconds = mn.lastPing.sigTime - mn.sigTime;
+        int activeSeconds = mn.info.nTimeLastPing - mn.info.sigTime;
         activeSeconds = activeSeconds < 0 ? 0: activeSeconds;
 
         QString activeSecondsTitle = QString::fromStdString(DurationToDHMS(activeSeconds));
         SmartnodeWidgetItem *activeSecondsItem = new SmartnodeWidgetItem(activeSecondsTitle, activeSeconds);
 
-        int lastSeen = mn.lastPing.sigTime + offsetFromUtc;
+        int lastSeen = mn.info.nTimeLastPing + offsetFromUtc;
         QString lastSeenTitle = QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M",lastSeen));
         SmartnodeWidgetItem *lastSeenItem = new SmartnodeWidgetItem(lastSeenTitle, lastSeen);
 
-        SmartnodeWidgetItem *pubkeyItem = new SmartnodeWidgetItem(QString::fromStdString(CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
+        SmartnodeWidgetItem *pubkeyItem = new SmartnodeWidgetItem(QString::fromStdString(CBitcoinAddress(mn.info.pubKeyCollateralAddress.GetID()).ToString()));
 
         if (strCurrentFilter != "")
         {
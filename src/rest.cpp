@@ -65,6 +65,8 @@ extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue&
 extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails);
+extern void mempoolToJSON(CJSONStreamWriter& writer);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
@@ -129,6 +131,16 @@ static bool CheckWarmup(HTTPRequest* req)
     return true;
 }
 
+//! Reply with obj, written in chunks if it's large
+static void WriteJSONReply(HTTPRequest* req, const UniValue& obj)
+{
+    req->WriteHeader("Content-Type", "application/json");
+    HTTPJSONReply reply(req, HTTPStatus::OK);
+    reply.Value(obj);
+    reply.Raw("\n");
+    reply.Finish();
+}
+
 static bool rest_headers(HTTPRequest* req,
                          const std::string& strURIPart)
 {
@@ -188,13 +200,15 @@ static bool rest_headers(HTTPRequest* req,
         return true;
     }
     case RF_JSON: {
-        UniValue jsonHeaders(UniValue::VARR);
+        req->WriteHeader("Content-Type", "application/json");
+        HTTPJSONReply reply(req, HTTPStatus::OK);
+        reply.BeginArray();
         BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-            jsonHeaders.push_back(blockheaderToJSON(pindex));
+            reply.Value(blockheaderToJSON(pindex));
         }
-        string strJSON = jsonHeaders.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTPStatus::OK, strJSON);
+        reply.End();
+        reply.Raw("\n");
+        reply.Finish();
         return true;
     }
     default: {
@@ -219,7 +233,6 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTPStatus::BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -229,35 +242,42 @@ static bool rest_block(HTTPRequest* req,
         pblockindex = mapBlockIndex[hash];
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTPStatus::NOT_FOUND, hashStr + " not available (pruned data)");
-
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-            return RESTERR(req, HTTPStatus::NOT_FOUND, hashStr + " not found");
     }
 
     switch (rf) {
     case RF_BINARY: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        string binaryBlock = ssBlock.str();
+        // The serialized block is returned as stored on disk
+        std::vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart()))
+            return RESTERR(req, HTTPStatus::NOT_FOUND, hashStr + " not found");
+        string binaryBlock(vchBlock.begin(), vchBlock.end());
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTPStatus::OK, binaryBlock);
         return true;
     }
 
     case RF_HEX: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart()))
+            return RESTERR(req, HTTPStatus::NOT_FOUND, hashStr + " not found");
+        string strHex = HexStr(vchBlock.begin(), vchBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTPStatus::OK, strHex);
         return true;
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
+        CBlock block;
+        {
+            LOCK(cs_main);
+            if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+                return RESTERR(req, HTTPStatus::NOT_FOUND, hashStr + " not found");
+        }
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTPStatus::OK, strJSON);
+        HTTPJSONReply reply(req, HTTPStatus::OK);
+        blockToJSON(reply, block, pblockindex, showTxDetails);
+        reply.Raw("\n");
+        reply.Finish();
         return true;
     }
 
@@ -342,11 +362,11 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTPStatus::OK, strJSON);
+        HTTPJSONReply reply(req, HTTPStatus::OK);
+        mempoolToJSON(reply);
+        reply.Raw("\n");
+        reply.Finish();
         return true;
     }
     default: {
@@ -396,9 +416,7 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     case RF_JSON: {
         UniValue objTx(UniValue::VOBJ);
         TxToJSON(tx, hashBlock, objTx);
-        string strJSON = objTx.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTPStatus::OK, strJSON);
+        WriteJSONReply(req, objTx);
         return true;
     }
 
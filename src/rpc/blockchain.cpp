@@ -9,6 +9,9 @@
 #include "checkpoints.h"
 #include "coins.h"
 #include "consensus/validation.h"
+#include "index/addressindexer.h"
+#include "index/coinstatsindex.h"
+#include "jsonwriter.h"
 #include "validation.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
@@ -91,50 +94,84 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/** The fields of blockToJSON before and after "tx", caller holds cs_main */
+static void blockFieldsToJSON(const CBlock& block, const CBlockIndex* blockindex, UniValue& before, UniValue& after)
 {
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
+    before.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
         confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
-    BOOST_FOREACH(const CTransaction&tx, block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(tx, uint256(), objTx);
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx.GetHash().GetHex());
-    }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    before.push_back(Pair("confirmations", confirmations));
+    before.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
+    before.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
+    before.push_back(Pair("weight", (int)::GetBlockWeight(block)));
+    before.push_back(Pair("height", blockindex->nHeight));
+    before.push_back(Pair("version", block.nVersion));
+    before.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
+    before.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+
+    after.push_back(Pair("time", block.GetBlockTime()));
+    after.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    after.push_back(Pair("nonce", (uint64_t)block.nNonce));
+    after.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    after.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    after.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+        after.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
     CBlockIndex *pnext = chainActive.Next(blockindex);
     if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+        after.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+}
+
+static UniValue blockTxToJSON(const CTransaction& tx, bool txDetails)
+{
+    if (!txDetails)
+        return tx.GetHash().GetHex();
+
+    UniValue objTx(UniValue::VOBJ);
+    TxToJSON(tx, uint256(), objTx);
+    return objTx;
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    UniValue result(UniValue::VOBJ);
+    UniValue after(UniValue::VOBJ);
+    blockFieldsToJSON(block, blockindex, result, after);
+    UniValue txs(UniValue::VARR);
+    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+        txs.push_back(blockTxToJSON(tx, txDetails));
+    result.push_back(Pair("tx", txs));
+    result.pushKVs(after);
     return result;
 }
 
+/**
+ * Same output as blockToJSON, written transaction by transaction. Takes cs_main
+ * for the block fields only, the block itself is not shared.
+ */
+void blockToJSON(CJSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue before(UniValue::VOBJ);
+    UniValue after(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        blockFieldsToJSON(block, blockindex, before, after);
+    }
+
+    writer.BeginObject();
+    writer.Members(before);
+    writer.Key("tx");
+    writer.BeginArray();
+    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+        writer.Value(blockTxToJSON(tx, txDetails));
+    writer.End();
+    writer.Members(after);
+    writer.End();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -201,11 +238,50 @@ std::string EntryDescriptionString()
            "    \"ancestorcount\" : n,    (numeric) number of in-mempool ancestor transactions (including this one)\n"
            "    \"ancestorsize\" : n,     (numeric) size of in-mempool ancestors (including this one)\n"
            "    \"ancestorfees\" : n,     (numeric) modified fees (see above) of in-mempool ancestors (including this one)\n"
+           "    \"clustercount\" : n,     (numeric) number of in-mempool transactions connected to this one (including this one)\n"
+           "    \"clustersize\" : n,      (numeric) size of the connected in-mempool transactions (including this one)\n"
+           "    \"clusterfees\" : n,      (numeric) modified fees (see above) of the connected in-mempool transactions (including this one)\n"
            "    \"depends\" : [           (array) unconfirmed transactions used as inputs for this transaction\n"
            "        \"transactionid\",    (string) parent transaction id\n"
            "       ... ]\n";
 }
 
+/** The verbose getrawmempool entry of e, caller holds mempool.cs */
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e)
+{
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.GetTxSize()));
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
+    info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee())));
+    info.push_back(Pair("time", e.GetTime()));
+    info.push_back(Pair("height", (int)e.GetHeight()));
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
+    info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+    info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
+    info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
+    info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
+    const CTxMemPool::TxCluster& cluster = mempool.GetCluster(mempool.mapTx.iterator_to(e));
+    info.push_back(Pair("clustercount", cluster.nCount));
+    info.push_back(Pair("clustersize", cluster.nSize));
+    info.push_back(Pair("clusterfees", cluster.nModFees));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends)
+    {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends));
+    return info;
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose)
@@ -213,36 +289,7 @@ UniValue mempoolToJSON(bool fVerbose = false)
         LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
-        {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
-            info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
-            info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH(const CTxIn& txin, tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends)
-            {
-                depends.push_back(dep);
-            }
-
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
-        }
+            o.push_back(Pair(e.GetTx().GetHash().ToString(), mempoolEntryToJSON(e)));
         return o;
     }
     else
@@ -258,6 +305,38 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+/**
+ * The verbose mempoolToJSON, written entry by entry. mempool.cs is only held
+ * while an entry is built, so transactions that leave the mempool meanwhile are
+ * left out.
+ */
+void mempoolToJSON(CJSONStreamWriter& writer)
+{
+    vector<uint256> vtxid;
+    {
+        LOCK(mempool.cs);
+        vtxid.reserve(mempool.mapTx.size());
+        BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+            vtxid.push_back(e.GetTx().GetHash());
+    }
+
+    writer.BeginObject();
+    BOOST_FOREACH(const uint256& hash, vtxid)
+    {
+        UniValue info;
+        {
+            LOCK(mempool.cs);
+            CTxMemPool::txiter it = mempool.mapTx.find(hash);
+            if (it == mempool.mapTx.end())
+                continue;
+            info = mempoolEntryToJSON(*it);
+        }
+        writer.Key(hash.ToString());
+        writer.Value(info);
+    }
+    writer.End();
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -289,6 +368,16 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose);
 }
 
+bool getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    // The txid list is left to getrawmempool
+    if (params.size() != 1 || !params[0].get_bool())
+        return false;
+
+    mempoolToJSON(writer);
+    return true;
+}
+
 UniValue getblockhashes(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 2)
@@ -555,20 +644,49 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
-
     if (!fVerbose)
     {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        // Return the block as stored on disk, there is no need to deserialize it
+        std::vector<unsigned char> vchBlock;
+        if(!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        std::string strHex = HexStr(vchBlock.begin(), vchBlock.end());
         return strHex;
     }
 
+    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
     return blockToJSON(block, pblockindex);
 }
 
+bool getblock_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    // Help, errors of the parameters and the hex data are left to getblock
+    if (params.size() < 1 || params.size() > 2 || (params.size() > 1 && !params[1].get_bool()))
+        return false;
+
+    uint256 hash(uint256S(params[0].get_str()));
+    CBlock block;
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
+        if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    }
+
+    blockToJSON(writer, block, pblockindex, false);
+    return true;
+}
+
 struct CCoinsStats
 {
     int nHeight;
@@ -638,28 +756,63 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "With -coinstatsindex this is a single lookup, otherwise the call scans the whole set and may take some time.\n"
+            "\nArguments:\n"
+            "1. height    (numeric, optional) The block height, requires -coinstatsindex (default: the current height)\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, only without the index\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, only without the index\n"
+            "  \"hash_coinset\": \"hash\",      (string) MuHash3072 of the unspent outputs, only with the index\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk, only at the current height\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"total_unspendable_amount\": x.xxx   (numeric) The amount sent to unspendable outputs, only with the index\n"
+            "  \"total_supply\": x.xxx          (numeric) The amount issued by coinbase transactions, only with the index\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "1000000")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
     UniValue ret(UniValue::VOBJ);
 
+    if (pcoinstatsindex && (params.size() || pcoinstatsindex->IsSynced())) {
+
+        int nHeight;
+        {
+            LOCK(cs_main);
+            nHeight = params.size() ? params[0].get_int() : chainActive.Height();
+            if (nHeight < 0 || nHeight > chainActive.Height())
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+        }
+
+        CCoinStatsValue stats;
+        if (!pcoinstatsindex->Lookup(nHeight, stats))
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("The coin stats index is still syncing, it is at height %d", pcoinstatsindex->GetHeight()));
+
+        ret.push_back(Pair("height", nHeight));
+        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+        ret.push_back(Pair("txouts", stats.nTransactionOutputs));
+        ret.push_back(Pair("hash_coinset", stats.hashCoinSet.GetHex()));
+        if (!params.size())
+            ret.push_back(Pair("disk_size", (uint64_t)pcoinsdbview->EstimateSize()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        ret.push_back(Pair("total_unspendable_amount", ValueFromAmount(stats.nUnspendableAmount)));
+        ret.push_back(Pair("total_supply", ValueFromAmount(stats.nTotalSupply)));
+        return ret;
+    }
+
+    if (params.size())
+        throw JSONRPCError(RPC_MISC_ERROR, "Statistics at a height require -coinstatsindex");
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview, stats)) {
@@ -859,6 +1012,23 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
             "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
             "  \"pruneheight\": xxxxxx,    (numeric) lowest-height complete block stored\n"
+            "  \"addressindex\": {         (object) state of the address/spent/deposit index, if enabled\n"
+            "     \"height\": xxxxxx,       (numeric) the height the index is built up to\n"
+            "     \"bestblockhash\": \"...\", (string) the hash of the last indexed block\n"
+            "     \"synced\": xx            (boolean) if the index has caught up with the chain\n"
+            "  },\n"
+            "  \"coinstatsindex\": {       (object) state of the coin stats index, if enabled\n"
+            "     \"height\": xxxxxx,       (numeric) the height the index is built up to\n"
+            "     \"bestblockhash\": \"...\", (string) the hash of the last indexed block\n"
+            "     \"synced\": xx            (boolean) if the index has caught up with the chain\n"
+            "  },\n"
+            "  \"backgroundflush\": {      (object) state of the coin database writer, with -backgroundflush\n"
+            "     \"pending\": xxxxxx,      (numeric) coins handed to the writer and not yet on disk\n"
+            "     \"flushes\": xxxxxx,      (numeric) batches written since startup\n"
+            "     \"lastcoins\": xxxxxx,    (numeric) coins of the last batch\n"
+            "     \"lastduration\": xxxxxx, (numeric) milliseconds the last batch took to write\n"
+            "     \"waittime\": xxxxxx      (numeric) milliseconds validation waited for the writer in total\n"
+            "  },\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -919,6 +1089,29 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 
         obj.push_back(Pair("pruneheight",        block->nHeight));
     }
+
+    if (paddressindexer) {
+        UniValue addressindex(UniValue::VOBJ);
+        paddressindexer->GetStatus(addressindex);
+        obj.push_back(Pair("addressindex", addressindex));
+    }
+
+    if (pcoinstatsindex) {
+        UniValue coinstatsindex(UniValue::VOBJ);
+        pcoinstatsindex->GetStatus(coinstatsindex);
+        obj.push_back(Pair("coinstatsindex", coinstatsindex));
+    }
+
+    if (pcoinsflusher && pcoinsflusher->IsAsync()) {
+        CCoinsFlushStats stats = pcoinsflusher->GetStats();
+        UniValue backgroundflush(UniValue::VOBJ);
+        backgroundflush.push_back(Pair("pending", (uint64_t)stats.nPendingCoins));
+        backgroundflush.push_back(Pair("flushes", stats.nFlushes));
+        backgroundflush.push_back(Pair("lastcoins", (uint64_t)stats.nLastCoins));
+        backgroundflush.push_back(Pair("lastduration", stats.nLastDuration / 1000));
+        backgroundflush.push_back(Pair("waittime", stats.nTotalWaitTime / 1000));
+        obj.push_back(Pair("backgroundflush", backgroundflush));
+    }
     return obj;
 }
 
@@ -145,6 +145,11 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getaddressmempool", 0},
     { "getaddresses", 0},
     { "getaddresses", 1},
+    { "getmoneysupply", 0},
+    { "getrichlist", 0},
+    { "getrichlist", 1},
+    { "getrichlist", 2},
+    { "gettxoutsetinfo", 0},
     { "getnewaddress", 1},
     { "getrandomkeypair", 0},
     { "dumpprivkey", 1},
@@ -5,7 +5,9 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "index/coinstatsindex.h"
 #include "init.h"
+#include "jsonwriter.h"
 #include "validation.h"
 #include "net.h"
 #include "netbase.h"
@@ -763,6 +765,58 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
     return result;
 }
 
+static void getAddressDeltas(const UniValue& params, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex)
+{
+    UniValue startValue = find_value(params[0].get_obj(), "start");
+    UniValue endValue = find_value(params[0].get_obj(), "end");
+
+    int start = 0;
+    int end = 0;
+
+    if (startValue.isNum() && endValue.isNum()) {
+        start = startValue.get_int();
+        end = endValue.get_int();
+        if (end < start) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
+        }
+    }
+
+    std::vector<std::pair<uint160, int> > addresses;
+
+    if (!getAddressesFromParams(params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (start > 0 && end > 0) {
+            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        } else {
+            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+    }
+}
+
+static UniValue addressDeltaToJSON(const std::pair<CAddressIndexKey, CAmount> &entry)
+{
+    std::string address;
+    if (!getAddressFromIndex(entry.first.type, entry.first.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.push_back(Pair("satoshis", entry.second));
+    delta.push_back(Pair("txid", entry.first.txhash.GetHex()));
+    delta.push_back(Pair("index", (int)entry.first.index));
+    delta.push_back(Pair("blockindex", (int)entry.first.txindex));
+    delta.push_back(Pair("height", entry.first.blockHeight));
+    delta.push_back(Pair("address", address));
+    return delta;
+}
+
 UniValue getaddressdeltas(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1 || !params[0].isObject())
@@ -796,59 +850,31 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         );
 
 
-    UniValue startValue = find_value(params[0].get_obj(), "start");
-    UniValue endValue = find_value(params[0].get_obj(), "end");
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    getAddressDeltas(params, addressIndex);
 
-    int start = 0;
-    int end = 0;
+    UniValue result(UniValue::VARR);
 
-    if (startValue.isNum() && endValue.isNum()) {
-        start = startValue.get_int();
-        end = endValue.get_int();
-        if (end < start) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
-        }
-    }
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        result.push_back(addressDeltaToJSON(*it));
 
-    std::vector<std::pair<uint160, int> > addresses;
+    return result;
+}
 
-    if (!getAddressesFromParams(params, addresses)) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
-    }
+bool getaddressdeltas_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() != 1 || !params[0].isObject())
+        return false;
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    getAddressDeltas(params, addressIndex);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
-
-    UniValue result(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
+    writer.BeginArray();
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        writer.Value(addressDeltaToJSON(*it));
+    writer.End();
 
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
-    }
-
-    return result;
+    return true;
 }
 
 UniValue getaddressbalance(const UniValue& params, bool fHelp)
@@ -1039,6 +1065,38 @@ UniValue getspentinfo(const UniValue& params, bool fHelp)
 }
 
 
+static void getAddressList(const UniValue& params, std::vector<CAddressListEntry> &addressList)
+{
+    bool fExcludeZeroBalances = params.size() ? params[0].get_bool() : true;
+    int64_t nEndBlockHeight = params.size() > 1 ? params[1].get_int64() : -1;
+
+    if (!GetAddresses(addressList, nEndBlockHeight, fExcludeZeroBalances)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Failed to load the address list.");
+    }
+
+    std::sort(addressList.begin(), addressList.end(),
+        [](const CAddressListEntry & a, const CAddressListEntry & b) -> bool
+    {
+        return a.balance > b.balance;
+    });
+}
+
+static UniValue addressListEntryToJSON(const CAddressListEntry &entry)
+{
+    std::string address;
+    if (!getAddressFromIndex(entry.type, entry.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue result(UniValue::VOBJ);
+
+    result.push_back(Pair("address", address));
+    result.push_back(Pair("received", entry.received));
+    result.push_back(Pair("balance", entry.balance));
+
+    return result;
+}
+
 UniValue getaddresses(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 2)
@@ -1053,52 +1111,140 @@ UniValue getaddresses(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getaddresses", "true")
         );
 
-    bool fExcludeZeroBalances = params.size() ? params[0].get_bool() : true;
-    int64_t nEndBlockHeight = params.size() > 1 ? params[1].get_int64() : -1;
     std::vector<CAddressListEntry> addressList;
+    getAddressList(params, addressList);
 
-    if (!GetAddresses(addressList, nEndBlockHeight, fExcludeZeroBalances)) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Failed to load the address list.");
-    }
+    UniValue result(UniValue::VARR);
 
-    std::sort(addressList.begin(), addressList.end(),
-        [](const CAddressListEntry & a, const CAddressListEntry & b) -> bool
-    {
-        return a.balance > b.balance;
-    });
+    for (std::vector<CAddressListEntry>::const_iterator it=addressList.begin(); it!=addressList.end(); it++)
+        result.push_back(addressListEntryToJSON(*it));
 
-    UniValue result(UniValue::VARR);
+    return result;
+}
 
-    for (std::vector<CAddressListEntry>::const_iterator it=addressList.begin(); it!=addressList.end(); it++) {
+bool getaddresses_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() > 2)
+        return false;
+
+    std::vector<CAddressListEntry> addressList;
+    getAddressList(params, addressList);
+
+    writer.BeginArray();
+    for (std::vector<CAddressListEntry>::const_iterator it=addressList.begin(); it!=addressList.end(); it++)
+        writer.Value(addressListEntryToJSON(*it));
+    writer.End();
+
+    return true;
+}
+
+UniValue getrichlist(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 3)
+        throw runtime_error(
+            "getrichlist ( count offset minbalance )\n"
+            "\nReturns the addresses with the largest balances, requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. count       (numeric, optional, default=100) The number of addresses to return\n"
+            "2. offset      (numeric, optional, default=0) The number of addresses to skip\n"
+            "3. minbalance  (numeric, optional, default=0) Only include addresses with at least this balance\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"holders\": n,          (numeric) The number of addresses with at least minbalance\n"
+            "  \"addresses\": [\n"
+            "    {\n"
+            "      \"rank\": n,         (numeric) The position in the list, starting at 1\n"
+            "      \"address\": \"xxx\",  (string) The address\n"
+            "      \"balance\": n,      (numeric) The current balance in satoshis\n"
+            "      \"received\": n      (numeric) The total amount received in satoshis\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrichlist", "")
+            + HelpExampleCli("getrichlist", "100 100 1000")
+            + HelpExampleRpc("getrichlist", "100, 0, 1000")
+        );
+
+    int nCount = params.size() > 0 ? params[0].get_int() : 100;
+    int nOffset = params.size() > 1 ? params[1].get_int() : 0;
+    CAmount nMinBalance = params.size() > 2 ? AmountFromValue(params[2]) : 0;
+
+    if (nCount < 0 || nOffset < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count or offset");
+
+    // Addresses without balance are not ranked
+    nMinBalance = std::max<CAmount>(nMinBalance, 1);
+
+    int nHolders;
+    std::vector<CAddressListEntry> vecEntries;
+
+    if (!GetRichListCount(nHolders, nMinBalance) || !GetRichList(vecEntries, nMinBalance, nOffset, nCount)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Failed to load the rich list.");
+    }
+
+    UniValue addresses(UniValue::VARR);
+
+    for (size_t i = 0; i < vecEntries.size(); i++) {
 
         std::string address;
-        if (!getAddressFromIndex(it->type, it->hashBytes, address)) {
+        if (!getAddressFromIndex(vecEntries[i].type, vecEntries[i].hashBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
 
         UniValue entry(UniValue::VOBJ);
 
+        entry.push_back(Pair("rank", (int64_t)(nOffset + i + 1)));
         entry.push_back(Pair("address", address));
-        entry.push_back(Pair("received", it->received));
-        entry.push_back(Pair("balance", it->balance));
+        entry.push_back(Pair("balance", vecEntries[i].balance));
+        entry.push_back(Pair("received", vecEntries[i].received));
 
-        result.push_back(entry);
+        addresses.push_back(entry);
     }
 
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("holders", nHolders));
+    result.push_back(Pair("addresses", addresses));
+
     return result;
 }
 
 UniValue getmoneysupply(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() )
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "getmoneysupply\n"
-            "\nPrint the current total money supply in the SmartCash blockchain.\n"
+            "getmoneysupply ( height )\n"
+            "\nPrint the total money supply in the SmartCash blockchain.\n"
+            "\nArguments:\n"
+            "1. height    (numeric, optional) The block height, requires -coinstatsindex (default: the current height)\n"
             "\nExamples:\n"
             + HelpExampleCli("getmoneysupply", "")
+            + HelpExampleCli("getmoneysupply", "1000000")
             + HelpExampleRpc("getmoneysupply", "")
         );
 
+    // A single lookup with the coin stats index
+    if (pcoinstatsindex && (params.size() || pcoinstatsindex->IsSynced())) {
+
+        int nHeight;
+        {
+            LOCK(cs_main);
+            nHeight = params.size() ? params[0].get_int() : chainActive.Height();
+            if (nHeight < 0 || nHeight > chainActive.Height())
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+        }
+
+        CCoinStatsValue stats;
+        if (!pcoinstatsindex->Lookup(nHeight, stats))
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("The coin stats index is still syncing, it is at height %d", pcoinstatsindex->GetHeight()));
+
+        return UniValueFromAmount(stats.nTotalAmount);
+    }
+
+    if (params.size())
+        throw JSONRPCError(RPC_MISC_ERROR, "The money supply at a height requires -coinstatsindex");
+
     std::vector<CAddressListEntry> addressList;
 
     if (!GetAddresses(addressList, true)) {
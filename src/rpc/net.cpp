@@ -363,6 +363,63 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     return obj;
 }
 
+UniValue getmessagehandlerinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getmessagehandlerinfo\n"
+            "\nReturns information about the message handler threads and the time spent per message type.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"threads\": n,             (numeric) Number of message handler threads\n"
+            "  \"queued\":                 (json object) Messages waiting to be processed\n"
+            "  {\n"
+            "    \"high\": n,              (numeric) Blocks and headers\n"
+            "    \"normal\": n,            (numeric) Everything else\n"
+            "    \"low\": n                (numeric) Smartnode, InstantSend and voting gossip\n"
+            "  },\n"
+            "  \"commands\":               (json object)\n"
+            "  {\n"
+            "    \"command\":              (json object) Statistics of a message type\n"
+            "    {\n"
+            "      \"count\": n,           (numeric) Number of processed messages\n"
+            "      \"totaltime\": n,       (numeric) Total processing time in microseconds\n"
+            "      \"maxtime\": n          (numeric) Longest processing time in microseconds\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmessagehandlerinfo", "")
+            + HelpExampleRpc("getmessagehandlerinfo", "")
+       );
+
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    int64_t nQueued[MSG_PRIORITY_COUNT];
+    g_connman->GetQueuedMessageCounts(nQueued);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("threads", g_connman->GetMessageHandlerThreads()));
+
+    UniValue queued(UniValue::VOBJ);
+    queued.push_back(Pair("high", nQueued[MSG_PRIORITY_HIGH]));
+    queued.push_back(Pair("normal", nQueued[MSG_PRIORITY_NORMAL]));
+    queued.push_back(Pair("low", nQueued[MSG_PRIORITY_LOW]));
+    obj.push_back(Pair("queued", queued));
+
+    UniValue commands(UniValue::VOBJ);
+    for (const auto& entry : g_connman->GetMessageProcessingStats()) {
+        UniValue stats(UniValue::VOBJ);
+        stats.push_back(Pair("count", entry.second.nCount));
+        stats.push_back(Pair("totaltime", entry.second.nTotalTime));
+        stats.push_back(Pair("maxtime", entry.second.nMaxTime));
+        commands.push_back(Pair(SanitizeString(entry.first), stats));
+    }
+    obj.push_back(Pair("commands", commands));
+    return obj;
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
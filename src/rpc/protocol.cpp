@@ -5,6 +5,7 @@
 
 #include "rpc/protocol.h"
 
+#include "jsonwriter.h"
 #include "random.h"
 #include "tinyformat.h"
 #include "util.h"
@@ -53,6 +54,20 @@ string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValu
     return reply.write() + "\n";
 }
 
+void JSONRPCWriteReply(CJSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id)
+{
+    // Same as JSONRPCReply without copying result into the reply object
+    writer.BeginObject();
+    writer.Key("result");
+    writer.Value(error.isNull() ? result : NullUniValue);
+    writer.Key("error");
+    writer.Value(error);
+    writer.Key("id");
+    writer.Value(id);
+    writer.End();
+    writer.Raw("\n");
+}
+
 UniValue JSONRPCError(int code, const string& message)
 {
     UniValue error(UniValue::VOBJ);
@@ -14,6 +14,8 @@
 
 #include <univalue.h>
 
+class CJSONStreamWriter;
+
 namespace HTTPStatus{
     //! HTTP status codes
     enum Codes
@@ -87,6 +89,8 @@ enum RPCErrorCode
 std::string JSONRPCRequest(const std::string& strMethod, const UniValue& params, const UniValue& id);
 UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id);
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
+//! Write the reply of JSONRPCReply to writer
+void JSONRPCWriteReply(CJSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
 /** Get name of RPC authentication cookie file */
@@ -266,163 +266,165 @@ UniValue stop(const UniValue& params, bool fHelp)
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode  streamActor
+  //  --------------------- ------------------------  -----------------------  ----------  -----------
     /* Overall control/query calls */
-    { "control",            "getinfo",                &getinfo,                true  }, /* uses wallet if enabled */
-    { "control",            "debug",                  &debug,                  true  },
-    { "control",            "help",                   &help,                   true  },
-    { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getinfo",                &getinfo,                true,  NULL }, /* uses wallet if enabled */
+    { "control",            "debug",                  &debug,                  true,  NULL },
+    { "control",            "help",                   &help,                   true,  NULL },
+    { "control",            "stop",                   &stop,                   true,  NULL },
 
     /* P2P networking */
-    { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
-    { "network",            "addnode",                &addnode,                true  },
-    { "network",            "disconnectnode",         &disconnectnode,         true  },
-    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true  },
-    { "network",            "getconnectioncount",     &getconnectioncount,     true  },
-    { "network",            "getnettotals",           &getnettotals,           true  },
-    { "network",            "getpeerinfo",            &getpeerinfo,            true  },
-    { "network",            "ping",                   &ping,                   true  },
-    { "network",            "setban",                 &setban,                 true  },
-    { "network",            "listbanned",             &listbanned,             true  },
-    { "network",            "clearbanned",            &clearbanned,            true  },
-    { "network",            "setnetworkactive",       &setnetworkactive,       true  },
+    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,  NULL },
+    { "network",            "addnode",                &addnode,                true,  NULL },
+    { "network",            "disconnectnode",         &disconnectnode,         true,  NULL },
+    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,  NULL },
+    { "network",            "getconnectioncount",     &getconnectioncount,     true,  NULL },
+    { "network",            "getnettotals",           &getnettotals,           true,  NULL },
+    { "network",            "getmessagehandlerinfo",  &getmessagehandlerinfo,  true,  NULL },
+    { "network",            "getpeerinfo",            &getpeerinfo,            true,  NULL },
+    { "network",            "ping",                   &ping,                   true,  NULL },
+    { "network",            "setban",                 &setban,                 true,  NULL },
+    { "network",            "listbanned",             &listbanned,             true,  NULL },
+    { "network",            "clearbanned",            &clearbanned,            true,  NULL },
+    { "network",            "setnetworkactive",       &setnetworkactive,       true,  NULL },
 
     /* Block chain and UTXO */
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
-    { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
-    { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
-    { "blockchain",         "getblockhash",           &getblockhash,           true  },
-    { "blockchain",         "getblockheader",         &getblockheader,         true  },
-    { "blockchain",         "getblockheaders",        &getblockheaders,        true  },
-    { "blockchain",         "getchaintips",           &getchaintips,           true  },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
-    { "blockchain",         "gettxout",               &gettxout,               true  },
-    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
-    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
-    { "blockchain",         "verifychain",            &verifychain,            true  },
-    { "blockchain",         "getspentinfo",           &getspentinfo,           false },
-    { "blockchain",         "getchaintxstats",        &getchaintxstats,        false },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  NULL },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  NULL },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  NULL },
+    { "blockchain",         "getblock",               &getblock,               true,  &getblock_stream },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true,  NULL },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  NULL },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,  NULL },
+    { "blockchain",         "getblockheaders",        &getblockheaders,        true,  NULL },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,  NULL },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  NULL },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  NULL },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  &getrawmempool_stream },
+    { "blockchain",         "gettxout",               &gettxout,               true,  NULL },
+    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true,  NULL },
+    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true,  NULL },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  NULL },
+    { "blockchain",         "verifychain",            &verifychain,            true,  NULL },
+    { "blockchain",         "getspentinfo",           &getspentinfo,           false, NULL },
+    { "blockchain",         "getchaintxstats",        &getchaintxstats,        false, NULL },
 
     /* Mining */
-    { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
-    { "mining",             "getmininginfo",          &getmininginfo,          true  },
-    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true  },
-    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true  },
-    { "mining",             "submitblock",            &submitblock,            true  },
+    { "mining",             "getblocktemplate",       &getblocktemplate,       true,  NULL },
+    { "mining",             "getmininginfo",          &getmininginfo,          true,  NULL },
+    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,  NULL },
+    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,  NULL },
+    { "mining",             "submitblock",            &submitblock,            true,  NULL },
 
     /* Coin generation */
-    { "generating",         "getgenerate",            &getgenerate,            true  },
-    { "generating",         "setgenerate",            &setgenerate,            true  },
-    { "generating",         "generate",               &generate,               true  },
+    { "generating",         "getgenerate",            &getgenerate,            true,  NULL },
+    { "generating",         "setgenerate",            &setgenerate,            true,  NULL },
+    { "generating",         "generate",               &generate,               true,  NULL },
 
     /* Raw transactions */
-    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "splitinputs",            &splitinputs,            true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
-    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
-    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
+    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,  NULL },
+    { "rawtransactions",    "splitinputs",            &splitinputs,            true,  NULL },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  NULL },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,  NULL },
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,  NULL },
+    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false, NULL },
+    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false, NULL }, /* uses wallet if enabled */
 #ifdef ENABLE_WALLET
-    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false },
+    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false, NULL },
 #endif
 
     /* Address index */
-    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
-    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false },
-    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false },
-    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false },
-    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false },
-    { "addressindex",       "getaddresses",           &getaddresses,           false },
-    { "addressindex",       "getmoneysupply",         &getmoneysupply,         false },
+    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true,  NULL },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false, NULL },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false, &getaddressdeltas_stream },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false, NULL },
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false, NULL },
+    { "addressindex",       "getaddresses",           &getaddresses,           false, &getaddresses_stream },
+    { "addressindex",       "getmoneysupply",         &getmoneysupply,         false, NULL },
+    { "addressindex",       "getrichlist",            &getrichlist,            false, NULL },
 
     /* Utility functions */
-    { "util",               "createmultisig",         &createmultisig,         true  },
-    { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
-    { "util",               "verifymessage",          &verifymessage,          true  },
-    { "util",               "estimatefee",            &estimatefee,            true  },
-    { "util",               "estimatepriority",       &estimatepriority,       true  },
-    { "util",               "estimatesmartfee",       &estimatesmartfee,       true  },
-    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true  },
-    { "util",               "getrandomkeypair",       &getrandomkeypair,       true  },
+    { "util",               "createmultisig",         &createmultisig,         true,  NULL },
+    { "util",               "validateaddress",        &validateaddress,        true,  NULL }, /* uses wallet if enabled */
+    { "util",               "verifymessage",          &verifymessage,          true,  NULL },
+    { "util",               "estimatefee",            &estimatefee,            true,  NULL },
+    { "util",               "estimatepriority",       &estimatepriority,       true,  NULL },
+    { "util",               "estimatesmartfee",       &estimatesmartfee,       true,  NULL },
+    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true,  NULL },
+    { "util",               "getrandomkeypair",       &getrandomkeypair,       true,  NULL },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        &invalidateblock,        true  },
-    { "hidden",             "reconsiderblock",        &reconsiderblock,        true  },
-    { "hidden",             "setmocktime",            &setmocktime,            true  },
+    { "hidden",             "invalidateblock",        &invalidateblock,        true,  NULL },
+    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,  NULL },
+    { "hidden",             "setmocktime",            &setmocktime,            true,  NULL },
 #ifdef ENABLE_WALLET
-    { "hidden",             "resendwallettransactions", &resendwallettransactions, true},
+    { "hidden",             "resendwallettransactions", &resendwallettransactions, true,  NULL },
 #endif
 
     /* SmartCash features */
-    { "smartcash",               "smartnode",             &smartnode,             true  },
-    { "smartcash",               "smartnodelist",         &smartnodelist,         true  },
-    { "smartcash",               "smartnodebroadcast",    &smartnodebroadcast,    true  },
+    { "smartcash",               "smartnode",             &smartnode,             true,  NULL },
+    { "smartcash",               "smartnodelist",         &smartnodelist,         true,  NULL },
+    { "smartcash",               "smartnodebroadcast",    &smartnodebroadcast,    true,  NULL },
   /* WIP-VOTING uncomment
-    { "smartcash",               "smartvoting",           &smartvoting,           true  },
-    { "smartcash",               "votekeys",              &votekeys,              true  },
+    { "smartcash",               "smartvoting",           &smartvoting,           true,  NULL },
+    { "smartcash",               "votekeys",              &votekeys,              true,  NULL },
   */
-    { "smartcash",               "snsync",                 &snsync,                 true  },
-    { "smartcash",               "spork",                  &spork,                  true  },
-    { "smartcash",               "smartrewards",           &smartrewards,           true  },
-    { "smartcash",               "termrewards",            &termrewards,            true  },
-    { "smartcash",               "smartmining",            &smartmining,            true  },
+    { "smartcash",               "snsync",                 &snsync,                 true,  NULL },
+    { "smartcash",               "spork",                  &spork,                  true,  NULL },
+    { "smartcash",               "smartrewards",           &smartrewards,           true,  NULL },
+    { "smartcash",               "termrewards",            &termrewards,            true,  NULL },
+    { "smartcash",               "smartmining",            &smartmining,            true,  NULL },
 #ifdef ENABLE_WALLET
 
     /* Wallet */
     //{ "wallet",             "keepass",                &keepass,                true },
-    { "wallet",             "instantsendtoaddress",   &instantsendtoaddress,   false },
-    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true  },
-    { "wallet",             "backupwallet",           &backupwallet,           true  },
-    { "wallet",             "dumpprivkey",            &dumpprivkey,            true  },
-    { "wallet",             "dumphdinfo",             &dumphdinfo,             true  },
-    { "wallet",             "dumpwallet",             &dumpwallet,             true  },
-    { "wallet",             "encryptwallet",          &encryptwallet,          true  },
-    { "wallet",             "getaccountaddress",      &getaccountaddress,      true  },
-    { "wallet",             "getaccount",             &getaccount,             true  },
-    { "wallet",             "getaddress",             &getaddress,             true  },
-    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true  },
-    { "wallet",             "getbalance",             &getbalance,             false },
-    { "wallet",             "getnewaddress",          &getnewaddress,          true  },
-    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true  },
-    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false },
-    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false },
-    { "wallet",             "gettransaction",         &gettransaction,         false },
-    { "wallet",             "abandontransaction",     &abandontransaction,     false },
-    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false },
-    { "wallet",             "getwalletinfo",          &getwalletinfo,          false },
-    { "wallet",             "importprivkey",          &importprivkey,          true  },
-    { "wallet",             "importwallet",           &importwallet,           true  },
-    { "wallet",             "importelectrumwallet",   &importelectrumwallet,   true  },
-    { "wallet",             "importaddress",          &importaddress,          true  },
-    { "wallet",             "importpubkey",           &importpubkey,           true  },
-    { "wallet",             "keypoolrefill",          &keypoolrefill,          true  },
-    { "wallet",             "listaccounts",           &listaccounts,           false },
-    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false },
-    { "wallet",             "listlockunspent",        &listlockunspent,        false },
-    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false },
-    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false },
-    { "wallet",             "listsinceblock",         &listsinceblock,         false },
-    { "wallet",             "listtransactions",       &listtransactions,       false },
-    { "wallet",             "listunspent",            &listunspent,            false },
-    { "wallet",             "lockunspent",            &lockunspent,            true  },
-    { "wallet",             "move",                   &movecmd,                false },
-    { "wallet",             "sendfrom",               &sendfrom,               false },
-    { "wallet",             "sendmany",               &sendmany,               false },
-    { "wallet",             "sendtoaddress",          &sendtoaddress,          false },
-    { "wallet",             "sendtoaddresslocked",    &sendtoaddresslocked,    false },
-    { "wallet",             "setaccount",             &setaccount,             true  },
-    { "wallet",             "settxfee",               &settxfee,               true  },
-    { "wallet",             "signmessage",            &signmessage,            true  },
-    { "wallet",             "walletlock",             &walletlock,             true  },
-    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true  },
-    { "wallet",             "walletpassphrase",       &walletpassphrase,       true  },
+    { "wallet",             "instantsendtoaddress",   &instantsendtoaddress,   false, NULL },
+    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true,  NULL },
+    { "wallet",             "backupwallet",           &backupwallet,           true,  NULL },
+    { "wallet",             "dumpprivkey",            &dumpprivkey,            true,  NULL },
+    { "wallet",             "dumphdinfo",             &dumphdinfo,             true,  NULL },
+    { "wallet",             "dumpwallet",             &dumpwallet,             true,  NULL },
+    { "wallet",             "encryptwallet",          &encryptwallet,          true,  NULL },
+    { "wallet",             "getaccountaddress",      &getaccountaddress,      true,  NULL },
+    { "wallet",             "getaccount",             &getaccount,             true,  NULL },
+    { "wallet",             "getaddress",             &getaddress,             true,  NULL },
+    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true,  NULL },
+    { "wallet",             "getbalance",             &getbalance,             false, NULL },
+    { "wallet",             "getnewaddress",          &getnewaddress,          true,  NULL },
+    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true,  NULL },
+    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false, NULL },
+    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false, NULL },
+    { "wallet",             "gettransaction",         &gettransaction,         false, NULL },
+    { "wallet",             "abandontransaction",     &abandontransaction,     false, NULL },
+    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false, NULL },
+    { "wallet",             "getwalletinfo",          &getwalletinfo,          false, NULL },
+    { "wallet",             "importprivkey",          &importprivkey,          true,  NULL },
+    { "wallet",             "importwallet",           &importwallet,           true,  NULL },
+    { "wallet",             "importelectrumwallet",   &importelectrumwallet,   true,  NULL },
+    { "wallet",             "importaddress",          &importaddress,          true,  NULL },
+    { "wallet",             "importpubkey",           &importpubkey,           true,  NULL },
+    { "wallet",             "keypoolrefill",          &keypoolrefill,          true,  NULL },
+    { "wallet",             "listaccounts",           &listaccounts,           false, NULL },
+    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false, NULL },
+    { "wallet",             "listlockunspent",        &listlockunspent,        false, NULL },
+    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false, NULL },
+    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false, NULL },
+    { "wallet",             "listsinceblock",         &listsinceblock,         false, NULL },
+    { "wallet",             "listtransactions",       &listtransactions,       false, NULL },
+    { "wallet",             "listunspent",            &listunspent,            false, NULL },
+    { "wallet",             "lockunspent",            &lockunspent,            true,  NULL },
+    { "wallet",             "move",                   &movecmd,                false, NULL },
+    { "wallet",             "sendfrom",               &sendfrom,               false, NULL },
+    { "wallet",             "sendmany",               &sendmany,               false, NULL },
+    { "wallet",             "sendtoaddress",          &sendtoaddress,          false, NULL },
+    { "wallet",             "sendtoaddresslocked",    &sendtoaddresslocked,    false, NULL },
+    { "wallet",             "setaccount",             &setaccount,             true,  NULL },
+    { "wallet",             "settxfee",               &settxfee,               true,  NULL },
+    { "wallet",             "signmessage",            &signmessage,            true,  NULL },
+    { "wallet",             "walletlock",             &walletlock,             true,  NULL },
+    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true,  NULL },
+    { "wallet",             "walletpassphrase",       &walletpassphrase,       true,  NULL },
 
 #endif // ENABLE_WALLET
 };
@@ -601,6 +603,34 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::executeStreamed(const std::string &strMethod, const UniValue &params, CJSONStreamWriter& writer) const
+{
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    if (!pcmd || !pcmd->streamActor)
+        return false;
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    bool fWritten;
+    try
+    {
+        fWritten = pcmd->streamActor(params, writer);
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+    return fWritten;
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
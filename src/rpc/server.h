@@ -21,6 +21,7 @@
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
 
+class CJSONStreamWriter;
 class CRPCCommand;
 
 namespace RPCServer
@@ -123,6 +124,14 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
+/**
+ * Writes the result of a call straight to the reply instead of building it as
+ * UniValue first, for results that can get very large. Returns false without
+ * writing anything if the call is left to the actor, e.g. for help or small
+ * results. Errors are thrown before the first write, locks are never held
+ * while writing.
+ */
+typedef bool(*rpcstreamfn_type)(const UniValue& params, CJSONStreamWriter& writer);
 
 class CRPCCommand
 {
@@ -131,6 +140,8 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    //! Optional, used for single JSON-RPC requests over HTTP
+    rpcstreamfn_type streamActor;
 };
 
 /**
@@ -154,6 +165,13 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method with its streamActor, if it has one.
+     * @returns false if nothing was written, call execute then.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    bool executeStreamed(const std::string &method, const UniValue &params, CJSONStreamWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -193,6 +211,7 @@ extern UniValue getconnectioncount(const UniValue& params, bool fHelp); // in rp
 extern UniValue getaddressmempool(const UniValue& params, bool fHelp);
 extern UniValue getaddressutxos(const UniValue& params, bool fHelp);
 extern UniValue getaddressdeltas(const UniValue& params, bool fHelp);
+extern bool getaddressdeltas_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getaddresstxids(const UniValue& params, bool fHelp);
 extern UniValue getaddressbalance(const UniValue& params, bool fHelp);
 
@@ -202,6 +221,7 @@ extern UniValue addnode(const UniValue& params, bool fHelp);
 extern UniValue disconnectnode(const UniValue& params, bool fHelp);
 extern UniValue getaddednodeinfo(const UniValue& params, bool fHelp);
 extern UniValue getnettotals(const UniValue& params, bool fHelp);
+extern UniValue getmessagehandlerinfo(const UniValue& params, bool fHelp);
 extern UniValue setban(const UniValue& params, bool fHelp);
 extern UniValue listbanned(const UniValue& params, bool fHelp);
 extern UniValue clearbanned(const UniValue& params, bool fHelp);
@@ -306,11 +326,13 @@ extern UniValue getdifficulty(const UniValue& params, bool fHelp);
 extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
+extern bool getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getblockhashes(const UniValue& params, bool fHelp);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
 extern UniValue getblockheaders(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
+extern bool getblock_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
 extern UniValue verifychain(const UniValue& params, bool fHelp);
@@ -320,7 +342,9 @@ extern UniValue reconsiderblock(const UniValue& params, bool fHelp);
 extern UniValue getchaintxstats(const UniValue& params, bool fHelp);
 extern UniValue getspentinfo(const UniValue& params, bool fHelp);
 extern UniValue getaddresses(const UniValue& params, bool fHelp);
+extern bool getaddresses_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getmoneysupply(const UniValue& params, bool fHelp);
+extern UniValue getrichlist(const UniValue& params, bool fHelp);
 extern UniValue sentinelping(const UniValue& params, bool fHelp);
 extern UniValue getrandomkeypair(const UniValue& params, bool fHelp);
 
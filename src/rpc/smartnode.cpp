@@ -621,15 +621,14 @@ UniValue smartnodelist(const UniValue& params, bool fHelp)
             obj.push_back(Pair(strOutpoint, s.first));
         }
     } else {
-        std::map<COutPoint, CSmartnode> mapSmartnodes = mnodeman.GetFullSmartnodeMap();
-        for (auto& mnpair : mapSmartnodes) {
-            CSmartnode mn = mnpair.second;
-            std::string strOutpoint = mnpair.first.ToStringShort();
+        CSmartnodeListRef listSmartnodes = mnodeman.GetSmartnodeList();
+        for (const CSmartnodeListEntry& mn : *listSmartnodes) {
+            std::string strOutpoint = mn.info.vin.prevout.ToStringShort();
             if (strMode == "activeseconds") {
                 if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (int64_t)(mn.lastPing.sigTime - mn.sigTime)));
+                obj.push_back(Pair(strOutpoint, (int64_t)(mn.info.nTimeLastPing - mn.info.sigTime)));
             } else if (strMode == "addr") {
-                std::string strAddress = mn.addr.ToString();
+                std::string strAddress = mn.info.addr.ToString();
                 if (strFilter !="" && strAddress.find(strFilter) == std::string::npos &&
                     strOutpoint.find(strFilter) == std::string::npos) continue;
                 obj.push_back(Pair(strOutpoint, strAddress));
@@ -637,13 +636,13 @@ UniValue smartnodelist(const UniValue& params, bool fHelp)
                 std::ostringstream streamFull;
                 streamFull << std::setw(18) <<
                                mn.GetStatus() << " " <<
-                               mn.nProtocolVersion << " " <<
-                               CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString() << " " <<
-                               (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
-                               (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
-                               mn.GetLastPaidTime() << " "  << std::setw(6) <<
-                               mn.GetLastPaidBlock() << " " <<
-                               mn.addr.ToString();
+                               mn.info.nProtocolVersion << " " <<
+                               CBitcoinAddress(mn.info.pubKeyCollateralAddress.GetID()).ToString() << " " <<
+                               (int64_t)mn.info.nTimeLastPing << " " << std::setw(8) <<
+                               (int64_t)(mn.info.nTimeLastPing - mn.info.sigTime) << " " << std::setw(10) <<
+                               mn.info.nTimeLastPaid << " "  << std::setw(6) <<
+                               mn.nBlockLastPaid << " " <<
+                               mn.info.addr.ToString();
                 std::string strFull = streamFull.str();
                 if (strFilter !="" && strFull.find(strFilter) == std::string::npos &&
                     strOutpoint.find(strFilter) == std::string::npos) continue;
@@ -652,39 +651,39 @@ UniValue smartnodelist(const UniValue& params, bool fHelp)
                 std::ostringstream streamInfo;
                 streamInfo << std::setw(18) <<
                                mn.GetStatus() << " " <<
-                               mn.nProtocolVersion << " " <<
-                               CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString() << " " <<
-                               (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
-                               (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " <<
-                               SafeIntVersionToString(mn.lastPing.nSentinelVersion) << " "  <<
-                               (mn.lastPing.fSentinelIsCurrent ? "current" : "expired") << " " <<
-                               mn.addr.ToString();
+                               mn.info.nProtocolVersion << " " <<
+                               CBitcoinAddress(mn.info.pubKeyCollateralAddress.GetID()).ToString() << " " <<
+                               (int64_t)mn.info.nTimeLastPing << " " << std::setw(8) <<
+                               (int64_t)(mn.info.nTimeLastPing - mn.info.sigTime) << " " <<
+                               SafeIntVersionToString(mn.nSentinelVersion) << " "  <<
+                               (mn.fSentinelIsCurrent ? "current" : "expired") << " " <<
+                               mn.info.addr.ToString();
                 std::string strInfo = streamInfo.str();
                 if (strFilter !="" && strInfo.find(strFilter) == std::string::npos &&
                     strOutpoint.find(strFilter) == std::string::npos) continue;
                 obj.push_back(Pair(strOutpoint, strInfo));
             } else if (strMode == "lastpaidblock") {
                 if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, mn.GetLastPaidBlock()));
+                obj.push_back(Pair(strOutpoint, mn.nBlockLastPaid));
             } else if (strMode == "lastpaidtime") {
                 if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, mn.GetLastPaidTime()));
+                obj.push_back(Pair(strOutpoint, mn.info.nTimeLastPaid));
             } else if (strMode == "lastseen") {
                 if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (int64_t)mn.lastPing.sigTime));
+                obj.push_back(Pair(strOutpoint, (int64_t)mn.info.nTimeLastPing));
             } else if (strMode == "payee") {
-                CBitcoinAddress address(mn.pubKeyCollateralAddress.GetID());
+                CBitcoinAddress address(mn.info.pubKeyCollateralAddress.GetID());
                 std::string strPayee = address.ToString();
                 if (strFilter !="" && strPayee.find(strFilter) == std::string::npos &&
                     strOutpoint.find(strFilter) == std::string::npos) continue;
                 obj.push_back(Pair(strOutpoint, strPayee));
             } else if (strMode == "protocol") {
-                if (strFilter !="" && strFilter != strprintf("%d", mn.nProtocolVersion) &&
+                if (strFilter !="" && strFilter != strprintf("%d", mn.info.nProtocolVersion) &&
                     strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (int64_t)mn.nProtocolVersion));
+                obj.push_back(Pair(strOutpoint, (int64_t)mn.info.nProtocolVersion));
             } else if (strMode == "pubkey") {
                 if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, HexStr(mn.pubKeySmartnode)));
+                obj.push_back(Pair(strOutpoint, HexStr(mn.info.pubKeySmartnode)));
             } else if (strMode == "status") {
                 std::string strStatus = mn.GetStatus();
                 if (strFilter !="" && strStatus.find(strFilter) == std::string::npos &&
@@ -733,9 +733,10 @@ bool SAPI::Error(HTTPRequest* req, SAPI::Codes code, const std::string &message)
 
 void SAPI::WriteReply(HTTPRequest *req, HTTPStatus::Codes status, const UniValue &obj)
 {
-    AddDefaultHeaders(req);
-    req->WriteHeader("Content-Type", "application/json");
-    req->WriteReply(status, JsonString(obj));
+    // Same output as JsonString(obj), large replies are sent while they are written
+    SAPI::JSONReply reply(req, status);
+    reply.Value(obj);
+    reply.Finish();
 }
 
 void SAPI::WriteReply(HTTPRequest *req, HTTPStatus::Codes status, const std::string &str)
@@ -755,6 +756,28 @@ void SAPI::WriteReply(HTTPRequest *req, const std::string &str)
     SAPI::WriteReply(req, HTTPStatus::OK, str);
 }
 
+SAPI::JSONReply::JSONReply(HTTPRequest *req, HTTPStatus::Codes status) :
+    HTTPJSONReply(req, status, DEFAULT_SAPI_JSON_INDENT), req(req)
+{
+    AddDefaultHeaders(req);
+    req->WriteHeader("Content-Type", "application/json");
+}
+
+void SAPI::JSONReply::Finish()
+{
+    Raw("\n");
+    HTTPJSONReply::Finish();
+}
+
+bool SAPI::JSONReply::Error(const SAPI::Result &error)
+{
+    if (Abort())
+        return SAPI::Error(req, HTTPStatus::BAD_REQUEST, error);
+
+    LogPrint("sapi", "%s: reply cut short: %s\n", __func__, error.message);
+    return false;
+}
+
 int64_t SAPI::GetStartTime() {
     return nStartTime;
 }
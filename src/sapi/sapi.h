@@ -114,6 +114,7 @@ namespace Keys{
     const std::string protocol = "protocol";
     const std::string status = "status";
     const std::string direction = "direction";
+    const std::string minBalance = "minBalance";
 }
 
 namespace Validation{
@@ -350,6 +351,25 @@ void WriteReply(HTTPRequest *req, HTTPStatus::Codes status, const std::string &s
 void WriteReply(HTTPRequest *req, const UniValue& obj);
 void WriteReply(HTTPRequest *req, const std::string &str);
 
+/**
+ * JSON reply of an endpoint that writes its result element by element, with the
+ * default headers and indent of WriteReply. An error found before anything was
+ * sent still becomes a regular error reply.
+ */
+class JSONReply : public HTTPJSONReply
+{
+private:
+    HTTPRequest* req;
+
+public:
+    JSONReply(HTTPRequest* req, HTTPStatus::Codes status = HTTPStatus::OK);
+
+    //! Send what is left, same as HTTPJSONReply::Finish
+    void Finish();
+    //! Give up on the reply, send error if possible. Returns false like SAPI::Error.
+    bool Error(const SAPI::Result &error);
+};
+
 bool CheckWarmup(HTTPRequest* req);
 
 SAPI::Limits::Client *GetClientLimiter(const CService &peer);
@@ -358,6 +378,9 @@ int64_t GetStartTime();
 
 }
 
+//! GetTransactionInfo that sets error instead of sending it, caller holds cs_main
+extern bool GetTransactionInfo(uint256 nHash, const CTransaction &tx, UniValue &txObj, bool showHex, SAPI::Result &error);
+
 extern bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &address);
 
 extern bool ParseHashStr(const string& strHash, uint256& v);
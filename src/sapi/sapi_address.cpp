@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include "base58.h"
+#include "index/addressindexer.h"
 #include "rpc/client.h"
 #include "sapi_validation.h"
 #include "sapi/sapi_address.h"
@@ -129,12 +130,13 @@ bool TimeLockedGroup(HTTPRequest* req, int blockHeight, const uint256 &txhash, c
     return true;
 }
 
-bool IsTimeLocked(HTTPRequest* req, int blockHeight, const uint256 &txhash, const CSmartAddress &address, bool &locked) {
+bool IsTimeLocked(int blockHeight, const uint256 &txhash, const CSmartAddress &address, bool &locked, SAPI::Result &error) {
     // Get block
     CBlock block;
     CBlockIndex* pBlockindex = chainActive[blockHeight];
     if (!ReadBlockFromDisk(block, pBlockindex, Params().GetConsensus())) {
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+        error = SAPI::Result(SAPI::BlockNotFound, "Can't read block from disk.");
+        return false;
     }
 
     // Find TX inside the block
@@ -143,7 +145,8 @@ bool IsTimeLocked(HTTPRequest* req, int blockHeight, const uint256 &txhash, cons
     });
 
     if (tx == block.vtx.end()) {
-        return SAPI::Error(req, SAPI::TxNotFound, "Can't find Tx ID in block");
+        error = SAPI::Result(SAPI::TxNotFound, "Can't find Tx ID in block");
+        return false;
     }
 
     // Find output based on the address
@@ -175,6 +178,14 @@ bool IsTimeLocked(HTTPRequest* req, int blockHeight, const uint256 &txhash, cons
     return true;
 }
 
+bool IsTimeLocked(HTTPRequest* req, int blockHeight, const uint256 &txhash, const CSmartAddress &address, bool &locked) {
+    SAPI::Result error;
+    if (!IsTimeLocked(blockHeight, txhash, address, locked, error))
+        return SAPI::Error(req, HTTPStatus::BAD_REQUEST, error);
+
+    return true;
+}
+
 static bool address_balance(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter);
 static bool address_balances(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter);
 static bool address_deposit(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter);
@@ -183,6 +194,7 @@ static bool address_utxos_amount(HTTPRequest* req, const std::map<std::string, s
 static bool address_transaction(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter);
 static bool address_transactions(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter);
 static bool address_mempool(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter);
+static bool address_richlist(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter);
 
 SAPI::EndpointGroup addressEndpoints = {
     "address",
@@ -255,6 +267,14 @@ SAPI::EndpointGroup addressEndpoints = {
 //                SAPI::BodyParameter(SAPI::Keys::ascending,   new SAPI::Validation::Bool(), true),
 //                SAPI::BodyParameter(SAPI::Keys::direction,   new SAPI::Validation::TxDirection(), true)
             }
+        },
+        {
+            "richlist", HTTPRequest::POST, UniValue::VOBJ, address_richlist,
+            {
+                SAPI::BodyParameter(SAPI::Keys::pageNumber,  new SAPI::Validation::IntRange(1,INT_MAX)),
+                SAPI::BodyParameter(SAPI::Keys::pageSize,    new SAPI::Validation::IntRange(1,1000)),
+                SAPI::BodyParameter(SAPI::Keys::minBalance,  new SAPI::Validation::AmountRange(0,MAX_MONEY), true)
+            }
         }
     }
 };
@@ -558,6 +578,68 @@ static bool address_mempool(HTTPRequest* req, const std::map<std::string, std::s
     return true;
 }
 
+static bool address_richlist(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter)
+{
+    int64_t nPageNumber = bodyParameter[SAPI::Keys::pageNumber].get_int64();
+    int64_t nPageSize = bodyParameter[SAPI::Keys::pageSize].get_int64();
+    CAmount nMinBalance = bodyParameter.exists(SAPI::Keys::minBalance) ? bodyParameter[SAPI::Keys::minBalance].get_amount() : 0;
+
+    // Addresses without balance are not ranked
+    nMinBalance = std::max<CAmount>(nMinBalance, 1);
+
+    int nHolders = 0;
+
+    if (!GetRichListCount(nHolders, nMinBalance))
+        return SAPI::Error(req, HTTPStatus::INTERNAL_SERVER_ERROR, "Rich list not available.");
+
+    int nPages = nHolders / nPageSize;
+    if( nHolders % nPageSize ) nPages++;
+
+    if (nPageNumber > std::max(nPages, 1))
+        return SAPI::Error(req, SAPI::PageOutOfRange, strprintf("Page number out of range: 1 - %d", nPages));
+
+    int nOffset = static_cast<int>(( nPageNumber - 1 ) * nPageSize);
+    std::vector<CAddressListEntry> vecEntries;
+
+    if (!GetRichList(vecEntries, nMinBalance, nOffset, static_cast<int>(nPageSize)))
+        return SAPI::Error(req, HTTPStatus::INTERNAL_SERVER_ERROR, "Rich list not available.");
+
+    UniValue arrAddresses(UniValue::VARR);
+
+    for (size_t i = 0; i < vecEntries.size(); i++) {
+        const CAddressListEntry &entry = vecEntries[i];
+        CSmartAddress address;
+
+        if (entry.type == 2) {
+            address = CSmartAddress(CScriptID(entry.hashBytes));
+        } else if (entry.type == 1) {
+            address = CSmartAddress(CKeyID(entry.hashBytes));
+        } else {
+            return SAPI::Error(req, HTTPStatus::INTERNAL_SERVER_ERROR, "Unknown address type.");
+        }
+
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("rank", static_cast<int64_t>(nOffset + i + 1));
+        obj.pushKV(SAPI::Keys::address, address.ToString());
+        obj.pushKV("balance", UniValueFromAmount(entry.balance));
+        obj.pushKV("received", UniValueFromAmount(entry.received));
+
+        arrAddresses.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+
+    result.pushKV("count", nHolders);
+    result.pushKV("pages", nPages);
+    result.pushKV("page", nPageNumber);
+    result.pushKV("blockHeight", paddressindexer ? paddressindexer->GetHeight() : -1);
+    result.pushKV("addresses", arrAddresses);
+
+    SAPI::WriteReply(req, result);
+
+    return true;
+}
+
 static bool GetUTXOCount(HTTPRequest* req, const CBitcoinAddress& address, int &count, CAddressUnspentKey &lastIndex){
 
     uint160 hashBytes;
@@ -847,7 +929,28 @@ static bool address_utxos(HTTPRequest* req, const std::map<std::string, std::str
 
     nTime2 = GetTimeMicros();
 
-    UniValue arrUtxos(UniValue::VARR);
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+
+    SAPI::JSONReply reply(req);
+    reply.BeginObject();
+    reply.Key("count");
+    reply.Value(nUtxoCount);
+    reply.Key("pages");
+    reply.Value(nPages);
+    reply.Key("page");
+    reply.Value(nPageNumber);
+    reply.Key("blockHeight");
+    reply.Value(nHeight);
+    reply.Key(SAPI::Keys::address);
+    reply.Value(addrStr);
+    reply.Key("script");
+    reply.Value(HexStr(addrScript.begin(), addrScript.end()));
+    reply.Key("utxos");
+    reply.BeginArray();
 
     for (const auto &unspentOutput : unspentOutputs) {
         const auto &key = unspentOutput.first;
@@ -862,9 +965,14 @@ static bool address_utxos(HTTPRequest* req, const std::map<std::string, std::str
 
         // Figure out if utxo is spendable (i.e. not time locked)
         bool fLocked = true;
-        if (!IsTimeLocked(req, key.nBlockHeight, key.txhash, address, fLocked)) {
-            return false;
+        SAPI::Result error;
+        bool fValid;
+        {
+            LOCK(cs_main);
+            fValid = IsTimeLocked(key.nBlockHeight, key.txhash, address, fLocked, error);
         }
+        if (!fValid)
+            return reply.Error(error);
 
         output.pushKV("txid", key.txhash.GetHex());
         output.pushKV("index", static_cast<int>(key.index));
@@ -873,30 +981,23 @@ static bool address_utxos(HTTPRequest* req, const std::map<std::string, std::str
         output.pushKV("inMempool", fInMempool);
         output.pushKV("spendable", !fLocked);
 
-        arrUtxos.push_back(output);
+        reply.Value(output);
     }
 
-    nTime3 = GetTimeMicros();
-
-    UniValue obj(UniValue::VOBJ);
+    reply.End();
+    reply.End();
 
-    obj.pushKV("count", nUtxoCount);
-    obj.pushKV("pages", nPages);
-    obj.pushKV("page", nPageNumber);
-    obj.pushKV("blockHeight", chainActive.Height());
-    obj.pushKV(SAPI::Keys::address, addrStr);
-    obj.pushKV("script", HexStr(addrScript.begin(), addrScript.end()));
-    obj.pushKV("utxos",arrUtxos);
+    nTime3 = GetTimeMicros();
 
-    SAPI::WriteReply(req, obj);
+    reply.Finish();
 
     nTime4 = GetTimeMicros();
 
     LogPrint("sapi-benchmark", "\naddress_utxos\n");
     LogPrint("sapi-benchmark", " Query utxos count: %.2fms\n", (nTime1 - nTime0) * 0.001);
     LogPrint("sapi-benchmark", " Query utxos: %.2fms\n", (nTime2 - nTime1) * 0.001);
-    LogPrint("sapi-benchmark", " Process utxos: %.2fms\n", (nTime3 - nTime2) * 0.001);
-    LogPrint("sapi-benchmark", " Write reply: %.2fms\n", (nTime4 - nTime3) * 0.001);
+    LogPrint("sapi-benchmark", " Process and write utxos: %.2fms\n", (nTime3 - nTime2) * 0.001);
+    LogPrint("sapi-benchmark", " Finish reply: %.2fms\n", (nTime4 - nTime3) * 0.001);
     LogPrint("sapi-benchmark", " Total: %.2fms\n\n", (nTime4 - nTime0) * 0.001);
 
     return true;
@@ -5,6 +5,8 @@
 #include "core_io.h"
 #include "sapi.h"
 #include "consensus/validation.h"
+#include "index/addressindexer.h"
+#include "index/coinstatsindex.h"
 #include "smartnode/instantx.h"
 #include "validation.h"
 #include "checkpoints.h"
@@ -29,6 +31,7 @@ SAPI::EndpointGroup blockchainEndpoints = {
         {"", HTTPRequest::GET, UniValue::VNULL, blockchain_info, {}},
         {"height", HTTPRequest::GET, UniValue::VNULL, blockchain_height, {}},
         {"supply", HTTPRequest::GET, UniValue::VNULL, blockchain_supply, {}},
+        {"supply/{height}", HTTPRequest::GET, UniValue::VNULL, blockchain_supply, {}},
         {"block/{blockinfo}", HTTPRequest::GET, UniValue::VNULL, blockchain_block, {}},
         {"block/transactions", HTTPRequest::POST, UniValue::VOBJ, blockchain_block_transactions,
          {
@@ -44,21 +47,41 @@ SAPI::EndpointGroup blockchainEndpoints = {
     }
 };
 
-static bool GetBlockInfo(HTTPRequest* req, CBlockIndex *blockindex, const CBlock &block, UniValue &blockObj)
+/** The block fields before and after the transactions, caller holds cs_main */
+static void GetBlockFields(CBlockIndex *blockindex, const CBlock &block, UniValue &before, UniValue &after)
 {
-    blockObj.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
+    before.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
         confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    blockObj.push_back(Pair("confirmations", confirmations));
-    blockObj.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
-    blockObj.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    blockObj.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    blockObj.push_back(Pair("height", blockindex->nHeight));
-    blockObj.push_back(Pair("version", block.nVersion));
-    blockObj.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    blockObj.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+    before.push_back(Pair("confirmations", confirmations));
+    before.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
+    before.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
+    before.push_back(Pair("weight", (int)::GetBlockWeight(block)));
+    before.push_back(Pair("height", blockindex->nHeight));
+    before.push_back(Pair("version", block.nVersion));
+    before.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
+    before.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+
+    after.push_back(Pair("time", block.GetBlockTime()));
+    after.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    after.push_back(Pair("nonce", (uint64_t)block.nNonce));
+    after.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    after.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    after.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+
+    if (blockindex->pprev)
+        after.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+    CBlockIndex *pnext = chainActive.Next(blockindex);
+    if (pnext)
+        after.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+}
+
+static bool GetBlockInfo(HTTPRequest* req, CBlockIndex *blockindex, const CBlock &block, UniValue &blockObj)
+{
+    UniValue after(UniValue::VOBJ);
+    GetBlockFields(blockindex, block, blockObj, after);
 
     UniValue txs(UniValue::VARR);
     BOOST_FOREACH(const CTransaction&tx, block.vtx)
@@ -71,23 +94,21 @@ static bool GetBlockInfo(HTTPRequest* req, CBlockIndex *blockindex, const CBlock
     }
 
     blockObj.push_back(Pair("tx", txs));
-    blockObj.push_back(Pair("time", block.GetBlockTime()));
-    blockObj.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    blockObj.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    blockObj.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    blockObj.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    blockObj.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
-
-    if (blockindex->pprev)
-        blockObj.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        blockObj.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    blockObj.pushKVs(after);
 
     return true;
 }
 
 bool GetTransactionInfo(HTTPRequest* req, uint256 nHash, const CTransaction &tx, UniValue &txObj, bool showHex)
+{
+    SAPI::Result error;
+    if (!GetTransactionInfo(nHash, tx, txObj, showHex, error))
+        return SAPI::Error(req, HTTPStatus::BAD_REQUEST, error);
+
+    return true;
+}
+
+bool GetTransactionInfo(uint256 nHash, const CTransaction &tx, UniValue &txObj, bool showHex, SAPI::Result &error)
 {
     if (showHex) {
       string strHex = EncodeHexTx(tx, SERIALIZE_TRANSACTION_NO_WITNESS);
@@ -110,8 +131,10 @@ bool GetTransactionInfo(HTTPRequest* req, uint256 nHash, const CTransaction &tx,
 	} else {
             CTransaction txInput;
             uint256 hashBlockIn;
-            if (!GetTransaction(txin.prevout.hash, txInput, Params().GetConsensus(), hashBlockIn, false))
-                return SAPI::Error(req, SAPI::TxNotFound, "No information available about one of the inputs.");
+            if (!GetTransaction(txin.prevout.hash, txInput, Params().GetConsensus(), hashBlockIn, false)) {
+                error = SAPI::Result(SAPI::TxNotFound, "No information available about one of the inputs.");
+                return false;
+            }
 
             const CTxOut& txout = txInput.vout[txin.prevout.n];
 
@@ -178,6 +201,12 @@ static bool blockchain_info(HTTPRequest* req, const std::map<std::string, std::s
         obj.push_back(Pair("chainwork",             chainActive.Tip()->nChainWork.GetHex()));
     }
 
+    if (paddressindexer) {
+        UniValue addressindex(UniValue::VOBJ);
+        paddressindexer->GetStatus(addressindex);
+        obj.push_back(Pair("addressindex", addressindex));
+    }
+
     SAPI::WriteReply(req, obj);
 
     return true;
@@ -185,10 +214,34 @@ static bool blockchain_info(HTTPRequest* req, const std::map<std::string, std::s
 
 static bool blockchain_supply(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter)
 {
-    LOCK(cs_main);
+    int64_t nHeight;
+
+    {
+        LOCK(cs_main);
+
+        nHeight = chainActive.Height();
+
+        if (mapPathParams.count("height") && !ParseInt64(mapPathParams.at("height"), &nHeight))
+            return SAPI::Error(req, SAPI::UIntOverflow, "Integer overflow.");
+
+        if (nHeight < 0 || nHeight > chainActive.Height())
+            return SAPI::Error(req, SAPI::BlockHeightOutOfRange, "Block height out of range");
+    }
 
     UniValue result(UniValue::VOBJ);
-    result.pushKV("CurrentSupply",  (int64_t)(143750 * 5000 * (1 + log(chainActive.Height()) - log(143750))) );
+    CCoinStatsValue stats;
+
+    if (pcoinstatsindex && pcoinstatsindex->Lookup(nHeight, stats)) {
+        result.pushKV("CurrentSupply", stats.nTotalSupply / COIN);
+        result.pushKV("height", nHeight);
+        result.pushKV("supply", UniValueFromAmount(stats.nTotalSupply));
+        result.pushKV("unspent", UniValueFromAmount(stats.nTotalAmount));
+        result.pushKV("unspendable", UniValueFromAmount(stats.nUnspendableAmount));
+    } else {
+        // The coin stats index is disabled or didn't get this far yet
+        result.pushKV("CurrentSupply", (int64_t)(143750 * 5000 * (1 + log(std::max<int64_t>(nHeight, 1)) - log(143750))));
+        result.pushKV("height", nHeight);
+    }
     SAPI::WriteReply(req, result);
 
     return true;
@@ -212,42 +265,68 @@ static bool blockchain_block(HTTPRequest* req, const std::map<std::string, std::
 
     std::string blockInfoStr = mapPathParams.at("blockinfo");
     uint256 hash;
+    CBlock block;
+    CBlockIndex* blockindex;
+    UniValue before(UniValue::VOBJ);
+    UniValue after(UniValue::VOBJ);
 
-    LOCK(cs_main);
+    {
+        LOCK(cs_main);
 
-    if( IsInteger(blockInfoStr) ){
+        if( IsInteger(blockInfoStr) ){
 
-        int64_t nHeight;
+            int64_t nHeight;
 
-        if( !ParseInt64(blockInfoStr, &nHeight) )
-            return SAPI::Error(req, SAPI::UIntOverflow, "Integer overflow.");
+            if( !ParseInt64(blockInfoStr, &nHeight) )
+                return SAPI::Error(req, SAPI::UIntOverflow, "Integer overflow.");
 
-        if ( nHeight < 0 ||  nHeight > chainActive.Height() )
-            return SAPI::Error(req, SAPI::BlockHeightOutOfRange, "Block height out of range");
+            if ( nHeight < 0 ||  nHeight > chainActive.Height() )
+                return SAPI::Error(req, SAPI::BlockHeightOutOfRange, "Block height out of range");
 
-        CBlockIndex* pblockindex = chainActive[nHeight];
-        hash = pblockindex->GetBlockHash();
-    }else if( !ParseHashStr(blockInfoStr, hash) ){
-        return SAPI::Error(req, SAPI::BlockNotSpecified, "No valid height or hash specified. Use /blockchain/block/<height or hash>");
-    }
+            CBlockIndex* pblockindex = chainActive[nHeight];
+            hash = pblockindex->GetBlockHash();
+        }else if( !ParseHashStr(blockInfoStr, hash) ){
+            return SAPI::Error(req, SAPI::BlockNotSpecified, "No valid height or hash specified. Use /blockchain/block/<height or hash>");
+        }
 
-    if (mapBlockIndex.count(hash) == 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not found");
+        if (mapBlockIndex.count(hash) == 0)
+            return SAPI::Error(req, SAPI::BlockNotFound, "Block not found");
 
-    CBlock block;
-    CBlockIndex* blockindex = mapBlockIndex[hash];
+        blockindex = mapBlockIndex[hash];
 
-    if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data)");
+        if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
+            return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data)");
 
-    if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk");
+        if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
+            return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk");
 
-    UniValue result(UniValue::VOBJ);
-    if (!GetBlockInfo(req, blockindex, block, result))
-        return false;
+        GetBlockFields(blockindex, block, before, after);
+    }
 
-    SAPI::WriteReply(req, result);
+    // Same output as GetBlockInfo, cs_main is only held while a transaction is looked up
+    SAPI::JSONReply reply(req);
+    reply.BeginObject();
+    reply.Members(before);
+    reply.Key("tx");
+    reply.BeginArray();
+    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+    {
+        UniValue txObj(UniValue::VOBJ);
+        SAPI::Result error;
+        bool fFound;
+        {
+            LOCK(cs_main);
+            fFound = GetTransactionInfo(tx.GetHash(), tx, txObj, false, error);
+        }
+        if (!fFound)
+            return reply.Error(error);
+
+        reply.Value(txObj);
+    }
+    reply.End();
+    reply.Members(after);
+    reply.End();
+    reply.Finish();
 
     return true;
 }
@@ -280,77 +359,73 @@ static bool blockchain_block_transactions(HTTPRequest* req, const std::map<std::
     int64_t nPageNumber = bodyParameter[SAPI::Keys::pageNumber].get_int64();
     int64_t nPageSize = bodyParameter[SAPI::Keys::pageSize].get_int64();
 
-    LOCK(cs_main);
-
     CBlock block;
-    CBlockIndex* blockindex = mapBlockIndex[nHash];
+    CBlockIndex* blockindex;
+    UniValue before(UniValue::VOBJ);
+    UniValue after(UniValue::VOBJ);
+    int nPages;
 
-    if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
+    {
+        LOCK(cs_main);
 
-    if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+        blockindex = mapBlockIndex[nHash];
 
-    int nTxCount = block.vtx.size();
-    int nPages = nTxCount / nPageSize;
-    if( nTxCount % nPageSize ) nPages++;
+        if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
+            return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
 
-    if (nPageNumber > nPages)
-        return SAPI::Error(req, SAPI::PageOutOfRange, strprintf("Page number out of range: 1 - %d.", nPages));
+        if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
+            return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
 
+        int nTxCount = block.vtx.size();
+        nPages = nTxCount / nPageSize;
+        if( nTxCount % nPageSize ) nPages++;
 
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+        if (nPageNumber > nPages)
+            return SAPI::Error(req, SAPI::PageOutOfRange, strprintf("Page number out of range: 1 - %d.", nPages));
 
-    UniValue txs(UniValue::VARR);
+        GetBlockFields(blockindex, block, before, after);
+    }
+
+    SAPI::JSONReply reply(req);
+    reply.BeginObject();
+    reply.Members(before);
+    reply.Key("transactions");
+    reply.BeginObject();
+    reply.Key("count");
+    reply.Value(static_cast<int64_t>(block.vtx.size()));
+    reply.Key("pages");
+    reply.Value(nPages);
+    reply.Key("page");
+    reply.Value(nPageNumber);
+    reply.Key("data");
+    reply.BeginArray();
 
     int nIndexOffset = static_cast<int>(( nPageNumber - 1 ) * nPageSize);
     auto tx = block.vtx.begin() + nIndexOffset;
+    int64_t nWritten = 0;
 
-    while(tx != block.vtx.end() && static_cast<int64_t>(txs.size()) < nPageSize )
+    while(tx != block.vtx.end() && nWritten < nPageSize )
     {
         UniValue txObj(UniValue::VOBJ);
-        if (!GetTransactionInfo(req, nHash, *tx, txObj, false)) {
-            return false;
+        SAPI::Result error;
+        bool fFound;
+        {
+            LOCK(cs_main);
+            fFound = GetTransactionInfo(nHash, *tx, txObj, false, error);
         }
-        txs.push_back(txObj);
+        if (!fFound)
+            return reply.Error(error);
+
+        reply.Value(txObj);
+        ++nWritten;
         ++tx;
     }
 
-    UniValue transactions(UniValue::VOBJ);
-
-    transactions.pushKV("count",static_cast<int64_t>(block.vtx.size()));
-    transactions.pushKV("pages", nPages);
-    transactions.pushKV("page", nPageNumber);
-    transactions.pushKV("data", txs);
-
-    result.push_back(Pair("transactions", transactions));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
-
-    if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-
-    SAPI::WriteReply(req, result);
+    reply.End();
+    reply.End();
+    reply.Members(after);
+    reply.End();
+    reply.Finish();
 
     return true;
 }
@@ -66,22 +66,22 @@ SAPI::EndpointGroup smartnodeEndpoints = {
 static bool CheckSmartnodes(HTTPRequest* req, std::vector<std::string> vecInfos, std::vector<UniValue> &vecResults)
 {
 
-    std::map<COutPoint, CSmartnode> mapSmartnodes = mnodeman.GetFullSmartnodeMap();
+    CSmartnodeListRef listSmartnodes = mnodeman.GetSmartnodeList();
 
-    for (auto& mnpair : mapSmartnodes) {
-        CSmartnode mn = mnpair.second;
-        std::string strOutpoint = strprintf("%s:%d", mnpair.first.hash.ToString(), mnpair.first.n);
+    for (const CSmartnodeListEntry& mn : *listSmartnodes) {
+        const COutPoint& outpoint = mn.info.vin.prevout;
+        std::string strOutpoint = strprintf("%s:%d", outpoint.hash.ToString(), outpoint.n);
 
         std::ostringstream streamFull;
         streamFull << std::setw(18) <<
                        mn.GetStatus() << " " <<
-                       mn.nProtocolVersion << " " <<
-                       CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString() << " " <<
-                       (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
-                       (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
-                       mn.GetLastPaidTime() << " "  << std::setw(6) <<
-                       mn.GetLastPaidBlock() << " " <<
-                       mn.addr.ToString();
+                       mn.info.nProtocolVersion << " " <<
+                       CBitcoinAddress(mn.info.pubKeyCollateralAddress.GetID()).ToString() << " " <<
+                       (int64_t)mn.info.nTimeLastPing << " " << std::setw(8) <<
+                       (int64_t)(mn.info.nTimeLastPing - mn.info.sigTime) << " " << std::setw(10) <<
+                       mn.info.nTimeLastPaid << " "  << std::setw(6) <<
+                       mn.nBlockLastPaid << " " <<
+                       mn.info.addr.ToString();
         std::string strFull = streamFull.str();
 
         for( auto info : vecInfos ){
@@ -92,13 +92,13 @@ static bool CheckSmartnodes(HTTPRequest* req, std::vector<std::string> vecInfos,
 
             node.pushKV("outpoint", strOutpoint);
             node.pushKV("status", mn.GetStatus());
-            node.pushKV("protocol", mn.nProtocolVersion);
-            node.pushKV("payee", CSmartAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
-            node.pushKV("lastSeen", mn.lastPing.sigTime);
-            node.pushKV("uptime", mn.lastPing.sigTime - mn.sigTime);
-            node.pushKV("lastPaidTime", mn.GetLastPaidTime());
-            node.pushKV("lastPaidBlock", mn.GetLastPaidBlock());
-            node.pushKV("ip", mn.addr.ToString());
+            node.pushKV("protocol", mn.info.nProtocolVersion);
+            node.pushKV("payee", CSmartAddress(mn.info.pubKeyCollateralAddress.GetID()).ToString());
+            node.pushKV("lastSeen", mn.info.nTimeLastPing);
+            node.pushKV("uptime", mn.info.nTimeLastPing - mn.info.sigTime);
+            node.pushKV("lastPaidTime", mn.info.nTimeLastPaid);
+            node.pushKV("lastPaidBlock", mn.nBlockLastPaid);
+            node.pushKV("ip", mn.info.addr.ToString());
 
             vecResults.push_back(node);
         }
@@ -150,23 +150,23 @@ static bool smartnodes_list(HTTPRequest* req, const std::map<std::string, std::s
 {
     UniValue obj(UniValue::VOBJ);
 
-    std::map<COutPoint, CSmartnode> mapSmartnodes = mnodeman.GetFullSmartnodeMap();
+    CSmartnodeListRef listSmartnodes = mnodeman.GetSmartnodeList();
 
-    for (auto& mnpair : mapSmartnodes) {
-        CSmartnode mn = mnpair.second;
+    for (const CSmartnodeListEntry& mn : *listSmartnodes) {
+        const COutPoint& outpoint = mn.info.vin.prevout;
 
         UniValue node(UniValue::VOBJ);
 
         node.pushKV("status", mn.GetStatus());
-        node.pushKV("protocol", mn.nProtocolVersion);
-        node.pushKV("payee", CSmartAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
-        node.pushKV("lastSeen", mn.lastPing.sigTime);
-        node.pushKV("uptime", mn.lastPing.sigTime - mn.sigTime);
-        node.pushKV("lastPaidTime", mn.GetLastPaidTime());
-        node.pushKV("lastPaidBlock", mn.GetLastPaidBlock());
-        node.pushKV("ip", mn.addr.ToString());
-
-        obj.pushKV(strprintf("%s:%d", mnpair.first.hash.ToString(), mnpair.first.n), node);
+        node.pushKV("protocol", mn.info.nProtocolVersion);
+        node.pushKV("payee", CSmartAddress(mn.info.pubKeyCollateralAddress.GetID()).ToString());
+        node.pushKV("lastSeen", mn.info.nTimeLastPing);
+        node.pushKV("uptime", mn.info.nTimeLastPing - mn.info.sigTime);
+        node.pushKV("lastPaidTime", mn.info.nTimeLastPaid);
+        node.pushKV("lastPaidBlock", mn.nBlockLastPaid);
+        node.pushKV("ip", mn.info.addr.ToString());
+
+        obj.pushKV(strprintf("%s:%d", outpoint.hash.ToString(), outpoint.n), node);
     }
 
     SAPI::WriteReply(req, obj);
@@ -228,15 +228,14 @@ static bool smartnodes_filter_list(HTTPRequest* req, const std::map<std::string,
 
     UniValue result(UniValue::VARR);
 
-    std::map<COutPoint, CSmartnode> mapSmartnodes = mnodeman.GetFullSmartnodeMap();
+    CSmartnodeListRef listSmartnodes = mnodeman.GetSmartnodeList();
 
-    for (auto& mnpair : mapSmartnodes) {
-        CSmartnode mn = mnpair.second;
+    for (const CSmartnodeListEntry& mn : *listSmartnodes) {
         if (((filterStatus == "*") || (mn.GetStatus() == filterStatus)) &&
-            ((filterProtocol < 0) || (mn.nProtocolVersion == filterProtocol))) {
+            ((filterProtocol < 0) || (mn.info.nProtocolVersion == filterProtocol))) {
             UniValue obj(UniValue::VOBJ);
-            obj.pushKV("payee", CSmartAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
-            obj.pushKV("ip", mn.addr.ToString());
+            obj.pushKV("payee", CSmartAddress(mn.info.pubKeyCollateralAddress.GetID()).ToString());
+            obj.pushKV("ip", mn.info.addr.ToString());
             result.push_back(obj);
         }
     }
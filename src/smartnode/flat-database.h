@@ -7,10 +7,16 @@
 
 #include "chainparams.h"
 #include "clientversion.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "streams.h"
+#include "sync.h"
 #include "util.h"
 
+#include <map>
+#include <set>
+#include <vector>
+
 #include <boost/filesystem.hpp>
 
 /** 
@@ -227,4 +233,492 @@ public:
 };
 
 
+/**
+*   Journaled Dumping and Loading
+*   -----------------------------
+*
+*   The object is stored as independent key/value records. The snapshot file
+*   holds all records, the change log next to it (<filename>.log) the records
+*   written and erased since the snapshot. Every record carries its own checksum,
+*   so a torn write at the end of the log only loses the last flush and a corrupted
+*   snapshot record only loses that entry.
+*
+*   T keeps track of the keys it changes. Flush() appends the records changed
+*   since the previous flush and compacts everything into a new snapshot once the
+*   log got too big. Dump() does the same at shutdown, but compacts as soon as the
+*   log is bigger than the snapshot. Both are safe to call at runtime.
+*
+*   T has to provide:
+*     void GetJournalRecords(flatdb_records_t& mapRecords) const;
+*     bool GetJournalChanges(flatdb_records_t& mapRecords, std::set<flatdb_bytes_t>& setErased);
+*     void LoadJournalRecords(const flatdb_records_t& mapRecords);   (throws on invalid data)
+*     void CheckAndRemove();
+*     void Clear();
+*     std::string ToString() const;
+*
+*   GetJournalChanges hands over the records written and the keys erased since
+*   its previous call and forgets them. It returns false if T lost track of its
+*   changes, e.g. after Clear(), everything is rewritten then. LoadJournalRecords
+*   starts without any changes.
+*/
+
+typedef std::vector<unsigned char> flatdb_bytes_t;
+typedef std::map<flatdb_bytes_t, flatdb_bytes_t> flatdb_records_t;
+
+/** The key of the record for a map entry, chPrefix and the serialized map key */
+template<typename K>
+flatdb_bytes_t GetFlatDBKey(char chPrefix, const K& key)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << chPrefix << key;
+    return flatdb_bytes_t(ssKey.begin(), ssKey.end());
+}
+
+/** Add a record keyed by chPrefix and the serialized key, like one map entry of AddFlatDBRecords */
+template<typename K, typename V>
+void AddFlatDBRecord(flatdb_records_t& mapRecords, char chPrefix, const K& key, const V& value)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << value;
+    mapRecords.emplace(GetFlatDBKey(chPrefix, key), flatdb_bytes_t(ssValue.begin(), ssValue.end()));
+}
+
+/** Add all entries of a map as records, keyed by chPrefix and the serialized map key */
+template<typename Map>
+void AddFlatDBRecords(flatdb_records_t& mapRecords, char chPrefix, const Map& mapEntries)
+{
+    for (const auto& entry : mapEntries) {
+        AddFlatDBRecord(mapRecords, chPrefix, entry.first, entry.second);
+    }
+}
+
+/** Add the records of the changed keys of a map, the keys which are not in it anymore go to setErased */
+template<typename Map, typename Keys>
+void AddFlatDBChanges(flatdb_records_t& mapRecords, std::set<flatdb_bytes_t>& setErased, char chPrefix,
+                      const Map& mapEntries, const Keys& setChanged)
+{
+    for (const auto& key : setChanged) {
+        typename Map::const_iterator it = mapEntries.find(key);
+        if (it != mapEntries.end())
+            AddFlatDBRecord(mapRecords, chPrefix, it->first, it->second);
+        else
+            setErased.insert(GetFlatDBKey(chPrefix, key));
+    }
+}
+
+/** Read the records added by AddFlatDBRecords with chPrefix back into a map */
+template<typename Map>
+void ReadFlatDBRecords(const flatdb_records_t& mapRecords, char chPrefix, Map& mapEntries)
+{
+    flatdb_records_t::const_iterator it = mapRecords.lower_bound(flatdb_bytes_t(1, chPrefix));
+    for (; it != mapRecords.end() && it->first[0] == (unsigned char)chPrefix; ++it) {
+        CDataStream ssKey(it->first, SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(it->second, SER_DISK, CLIENT_VERSION);
+        char chPrefixTmp;
+        typename Map::key_type key;
+        ssKey >> chPrefixTmp >> key;
+        ssValue >> mapEntries[key];
+    }
+}
+
+/** Add a single record, keyed by chPrefix only */
+template<typename V>
+void AddFlatDBRecord(flatdb_records_t& mapRecords, char chPrefix, const V& value)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << value;
+    mapRecords[flatdb_bytes_t(1, chPrefix)] = flatdb_bytes_t(ssValue.begin(), ssValue.end());
+}
+
+/** Read a record added by AddFlatDBRecord, returns false if there is none */
+template<typename V>
+bool ReadFlatDBRecord(const flatdb_records_t& mapRecords, char chPrefix, V& value)
+{
+    flatdb_records_t::const_iterator it = mapRecords.find(flatdb_bytes_t(1, chPrefix));
+    if (it == mapRecords.end())
+        return false;
+    CDataStream ssValue(it->second, SER_DISK, CLIENT_VERSION);
+    ssValue >> value;
+    return true;
+}
+
+template<typename T>
+class CJournaledFlatDB
+{
+private:
+
+    enum RecordType {
+        RECORD_HEADER = 0,
+        RECORD_WRITE = 1,
+        RECORD_ERASE = 2
+    };
+
+    enum ReadResult {
+        Ok,
+        FileError,
+        IncorrectHeader,
+        Truncated
+    };
+
+    //! Records above this size can only be the result of corruption
+    static const uint32_t MAX_RECORD_SIZE = 0x02000000;
+    //! Compact once the log is bigger than the snapshot, but not below this size
+    static const size_t MIN_COMPACT_LOG_SIZE = 1 << 20;
+
+    CCriticalSection cs;
+
+    boost::filesystem::path pathSnapshot;
+    boost::filesystem::path pathLog;
+    std::string strFilename;
+    std::string strMagicMessage;
+
+    //! Snapshot generation, the log is only replayed on top of the snapshot it belongs to
+    uint64_t nGeneration;
+    size_t nSnapshotSize;
+    size_t nLogSize;
+    //! Set if the files on disk can't be appended to or miss changes, they need to be rewritten
+    bool fCompact;
+
+    CDataStream HeaderRecord(uint64_t nGenerationIn) const
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << (unsigned char)RECORD_HEADER << strMagicMessage << FLATDATA(Params().MessageStart()) << nGenerationIn;
+        return ss;
+    }
+
+    //! Write a record as <size><payload><checksum>, returns the number of bytes written
+    static size_t WriteRecord(FILE* file, const CDataStream& ssPayload)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << (uint32_t)ssPayload.size();
+        ss.write(&ssPayload[0], ssPayload.size());
+        ss << Hash(ssPayload.begin(), ssPayload.end()).GetCheapHash();
+        if (fwrite(&ss[0], 1, ss.size(), file) != ss.size())
+            throw std::runtime_error(strprintf("failed to write record: %s", strerror(errno)));
+        return ss.size();
+    }
+
+    static size_t WriteDataRecord(FILE* file, const flatdb_bytes_t& vchKey, const flatdb_bytes_t& vchValue)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << (unsigned char)RECORD_WRITE << vchKey << vchValue;
+        return WriteRecord(file, ss);
+    }
+
+    static size_t WriteEraseRecord(FILE* file, const flatdb_bytes_t& vchKey)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << (unsigned char)RECORD_ERASE << vchKey;
+        return WriteRecord(file, ss);
+    }
+
+    /** Read the next record. Returns false at the end of the file or if the size is
+     *  garbage, fCorrupt is set if the record was there but had an invalid checksum. */
+    static bool ReadRecord(FILE* file, CDataStream& ssPayload, bool& fCorrupt)
+    {
+        unsigned char pchSize[4];
+        fCorrupt = false;
+        if (fread(pchSize, 1, sizeof(pchSize), file) != sizeof(pchSize))
+            return false;
+        uint32_t nSize = ReadLE32(pchSize);
+        if (nSize == 0 || nSize > MAX_RECORD_SIZE)
+            return false;
+        flatdb_bytes_t vchPayload(nSize + sizeof(uint64_t));
+        if (fread(&vchPayload[0], 1, vchPayload.size(), file) != vchPayload.size())
+            return false;
+        fCorrupt = Hash(vchPayload.begin(), vchPayload.begin() + nSize).GetCheapHash() != ReadLE64(&vchPayload[nSize]);
+        ssPayload.clear();
+        ssPayload.write((const char*)&vchPayload[0], nSize);
+        return true;
+    }
+
+    //! Read and check the header record, returns the generation of the file in nGenerationRet
+    ReadResult ReadHeader(FILE* file, uint64_t& nGenerationRet) const
+    {
+        CDataStream ssPayload(SER_DISK, CLIENT_VERSION);
+        bool fCorrupt;
+        if (!ReadRecord(file, ssPayload, fCorrupt) || fCorrupt)
+            return IncorrectHeader;
+        try {
+            unsigned char nType;
+            std::string strMagicMessageTmp;
+            unsigned char pchMsgTmp[4];
+            ssPayload >> nType >> strMagicMessageTmp >> FLATDATA(pchMsgTmp) >> nGenerationRet;
+            if (nType != RECORD_HEADER || strMagicMessageTmp != strMagicMessage ||
+                memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+                return IncorrectHeader;
+        } catch (const std::exception&) {
+            return IncorrectHeader;
+        }
+        return Ok;
+    }
+
+    /** Apply the records of a snapshot or log file to mapRecords. Stops at the first
+     *  truncated record, skips records with invalid checksums. */
+    ReadResult ReadRecords(FILE* file, flatdb_records_t& mapRecords, int& nRecords, int& nSkipped) const
+    {
+        CDataStream ssPayload(SER_DISK, CLIENT_VERSION);
+        bool fCorrupt;
+        while (ReadRecord(file, ssPayload, fCorrupt)) {
+            if (fCorrupt) {
+                nSkipped++;
+                continue;
+            }
+            try {
+                unsigned char nType;
+                flatdb_bytes_t vchKey;
+                ssPayload >> nType >> vchKey;
+                if (nType == RECORD_WRITE) {
+                    ssPayload >> mapRecords[vchKey];
+                } else if (nType == RECORD_ERASE) {
+                    mapRecords.erase(vchKey);
+                } else {
+                    nSkipped++;
+                    continue;
+                }
+            } catch (const std::exception&) {
+                nSkipped++;
+                continue;
+            }
+            nRecords++;
+        }
+        return feof(file) ? Ok : Truncated;
+    }
+
+    ReadResult Read(flatdb_records_t& mapRecords)
+    {
+        int nRecords = 0, nSkipped = 0;
+
+        FILE* file = fopen(pathSnapshot.string().c_str(), "rb");
+        if (!file)
+            return FileError;
+
+        uint64_t nGenerationSnapshot;
+        ReadResult result = ReadHeader(file, nGenerationSnapshot);
+        if (result == Ok && ReadRecords(file, mapRecords, nRecords, nSkipped) != Ok)
+            fCompact = true;
+        nSnapshotSize = ftell(file);
+        fclose(file);
+
+        if (result != Ok)
+            return result;
+
+        nGeneration = nGenerationSnapshot;
+
+        file = fopen(pathLog.string().c_str(), "rb");
+        if (file) {
+            uint64_t nGenerationLog;
+            // A log of an older generation is left over from an interrupted compaction
+            if (ReadHeader(file, nGenerationLog) == Ok && nGenerationLog == nGeneration) {
+                if (ReadRecords(file, mapRecords, nRecords, nSkipped) != Ok)
+                    fCompact = true;
+                nLogSize = ftell(file);
+            }
+            fclose(file);
+        }
+
+        if (nSkipped) {
+            LogPrintf("%s: skipped %d corrupted records in %s\n", __func__, nSkipped, strFilename);
+            fCompact = true;
+        }
+
+        LogPrint("flatdb", "%s: %d records from %s (snapshot %d bytes, log %d bytes)\n", __func__,
+                 nRecords, strFilename, nSnapshotSize, nLogSize);
+
+        return Ok;
+    }
+
+    bool Compact(const flatdb_records_t& mapRecords)
+    {
+        AssertLockHeld(cs);
+
+        // The changes were handed over already, keep compacting until it worked
+        fCompact = true;
+
+        boost::filesystem::path pathTmp = pathSnapshot;
+        pathTmp += ".new";
+
+        uint64_t nGenerationNew = nGeneration + 1;
+        size_t nSnapshotSizeNew = 0;
+
+        FILE* file = fopen(pathTmp.string().c_str(), "wb");
+        if (!file)
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
+        try {
+            nSnapshotSizeNew += WriteRecord(file, HeaderRecord(nGenerationNew));
+            for (const auto& record : mapRecords)
+                nSnapshotSizeNew += WriteDataRecord(file, record.first, record.second);
+        } catch (const std::exception& e) {
+            fclose(file);
+            return error("%s: I/O error - %s", __func__, e.what());
+        }
+        FileCommit(file);
+        fclose(file);
+
+        if (!RenameOver(pathTmp, pathSnapshot))
+            return error("%s: Failed to rename %s", __func__, pathTmp.string());
+
+        nGeneration = nGenerationNew;
+        nSnapshotSize = nSnapshotSizeNew;
+        nLogSize = 0;
+
+        // Start an empty log of the new generation, the old one doesn't match the snapshot anymore
+        file = fopen(pathLog.string().c_str(), "wb");
+        if (!file)
+            return error("%s: Failed to open file %s", __func__, pathLog.string());
+        try {
+            nLogSize = WriteRecord(file, HeaderRecord(nGeneration));
+        } catch (const std::exception& e) {
+            fclose(file);
+            return error("%s: I/O error - %s", __func__, e.what());
+        }
+        FileCommit(file);
+        fclose(file);
+
+        fCompact = false;
+
+        return true;
+    }
+
+    bool Append(const flatdb_records_t& mapRecords, const std::set<flatdb_bytes_t>& setErased)
+    {
+        AssertLockHeld(cs);
+
+        if (mapRecords.empty() && setErased.empty())
+            return true;
+
+        FILE* file = fopen(pathLog.string().c_str(), "ab");
+        if (!file) {
+            fCompact = true;
+            return error("%s: Failed to open file %s", __func__, pathLog.string());
+        }
+        try {
+            for (const auto& record : mapRecords)
+                nLogSize += WriteDataRecord(file, record.first, record.second);
+            for (const auto& vchKey : setErased)
+                nLogSize += WriteEraseRecord(file, vchKey);
+        } catch (const std::exception& e) {
+            fclose(file);
+            // The log may end with a partial record now
+            fCompact = true;
+            return error("%s: I/O error - %s", __func__, e.what());
+        }
+        FileCommit(file);
+        fclose(file);
+
+        return true;
+    }
+
+    /** Append the changes of objToSave, then compact if the log got bigger than nMaxLogSize */
+    bool Write(T& objToSave, size_t nMaxLogSize)
+    {
+        AssertLockHeld(cs);
+
+        int64_t nStart = GetTimeMillis();
+
+        flatdb_records_t mapRecords;
+        std::set<flatdb_bytes_t> setErased;
+        if (!objToSave.GetJournalChanges(mapRecords, setErased))
+            fCompact = true;
+
+        if (!fCompact && Append(mapRecords, setErased)) {
+            LogPrint("flatdb", "Flushed %s, %d written, %d erased  %dms\n", strFilename,
+                     mapRecords.size(), setErased.size(), GetTimeMillis() - nStart);
+        }
+
+        if (!fCompact && nLogSize <= nMaxLogSize)
+            return true;
+
+        mapRecords.clear();
+        objToSave.GetJournalRecords(mapRecords);
+        if (!Compact(mapRecords))
+            return false;
+
+        LogPrint("flatdb", "Compacted %s, %d records  %dms\n", strFilename, mapRecords.size(), GetTimeMillis() - nStart);
+
+        return true;
+    }
+
+public:
+    CJournaledFlatDB(std::string strFilenameIn, std::string strMagicMessageIn) :
+        nGeneration(0),
+        nSnapshotSize(0),
+        nLogSize(0),
+        fCompact(true)
+    {
+        pathSnapshot = GetDataDir() / strFilenameIn;
+        pathLog = GetDataDir() / (strFilenameIn + ".log");
+        strFilename = strFilenameIn;
+        strMagicMessage = strMagicMessageIn;
+    }
+
+    bool Load(T& objToLoad)
+    {
+        LOCK(cs);
+
+        int64_t nStart = GetTimeMillis();
+
+        LogPrintf("Reading info from %s...\n", strFilename);
+
+        flatdb_records_t mapRecords;
+        fCompact = false;
+        ReadResult readResult = Read(mapRecords);
+
+        if (readResult == FileError) {
+            LogPrintf("Missing file %s, will try to recreate\n", strFilename);
+        } else if (readResult != Ok) {
+            LogPrintf("Error reading %s: %s: File format is unknown or outdated, will try to recreate\n", strFilename, __func__);
+        }
+
+        try {
+            objToLoad.LoadJournalRecords(mapRecords);
+        } catch (const std::exception& e) {
+            objToLoad.Clear();
+            mapRecords.clear();
+            error("%s: Deserialize error - %s", __func__, e.what());
+            readResult = IncorrectHeader;
+        }
+
+        // Nothing usable on disk, start over with a new snapshot
+        if (readResult != Ok) {
+            fCompact = true;
+            return true;
+        }
+
+        LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
+        LogPrintf("     %s\n", objToLoad.ToString());
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
+
+        return true;
+    }
+
+    /** Append the changes since the last flush to the log, or compact if the log got too big */
+    bool Flush(T& objToSave)
+    {
+        LOCK(cs);
+        return Write(objToSave, std::max(nSnapshotSize, (size_t)MIN_COMPACT_LOG_SIZE));
+    }
+
+    /** Append the changes at shutdown, only compact if the log is bigger than the snapshot */
+    bool Dump(T& objToSave)
+    {
+        LOCK(cs);
+
+        int64_t nStart = GetTimeMillis();
+
+        LogPrintf("Writing info to %s...\n", strFilename);
+
+        if (!Write(objToSave, nSnapshotSize))
+            return false;
+
+        LogPrintf("%s dump finished  %dms\n", strFilename, GetTimeMillis() - nStart);
+        LogPrintf("     %s\n", objToSave.ToString());
+
+        return true;
+    }
+};
+
+
 #endif
@@ -47,6 +47,11 @@ CInstantSend instantsend;
 // CInstantSend
 //
 
+CInstantSend::CInstantSend() :
+    nCachedBlockHeight(0),
+    pLockedTxHashes(std::make_shared<const locked_tx_set_t>())
+{}
+
 void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if(fLiteMode) return; // disable all SmartCash specific functionality
@@ -70,8 +75,8 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
 
         {
             LOCK(cs_instantsend);
-            auto ret = mapTxLockVotes.emplace(nVoteHash, vote);
-            if (!ret.second) return;
+            if (mapTxLockVotes.count(nVoteHash)) return;
+            AddTxLockVote(nVoteHash, vote);
         }
 
         ProcessTxLockVote(pfrom, vote, connman);
@@ -92,7 +97,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
 
     // Check to see if we conflict with existing completed lock
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
+        auto it = mapLockedOutpoints.find(txin.prevout);
         if(it != mapLockedOutpoints.end() && it->second != txLockRequest.GetHash()) {
             // Conflicting with complete lock, proceed to see if we should cancel them both
             LogPrintf("CInstantSend::ProcessTxLockRequest -- WARNING: Found conflicting completed Transaction Lock, txid=%s, completed lock txid=%s\n",
@@ -103,7 +108,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Check to see if there are votes for conflicting request,
     // if so - do not fail, just warn user
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
+        auto it = mapVotedOutpoints.find(txin.prevout);
         if(it != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, it->second) {
                 if(hash != txLockRequest.GetHash()) {
@@ -126,7 +131,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // If this just happened - process orphan votes, lock inputs, resolve conflicting locks,
     // update transaction status forcing external script/zmq notifications.
     ProcessOrphanTxLockVotes();
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
     TryToFinalizeLockCandidate(itLockCandidate->second);
 
     return true;
@@ -140,7 +145,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
 
     uint256 txHash = txLockRequest.GetHash();
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) {
         LogPrintf("CInstantSend::CreateTxLockCandidate -- new, txid=%s\n", txHash.ToString());
 
@@ -244,14 +249,14 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         LogPrint("instantsend", "CInstantSend::Vote -- In the top %d (%d)\n", nSignaturesTotal, nRank);
 
-        std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
+        auto itVoted = mapVotedOutpoints.find(itOutpointLock->first);
 
         // Check to see if we already voted for this outpoint,
         // refuse to vote twice or to include the same outpoint in another tx
         bool fAlreadyVoted = false;
         if(itVoted != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, itVoted->second) {
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                auto it2 = mapTxLockCandidates.find(hash);
                 if(it2->second.HasSmartnodeVoted(itOutpointLock->first, activeSmartnode.outpoint)) {
                     // we already voted for this outpoint to be included either in the same tx or in a competing one,
                     // skip it anyway
@@ -281,7 +286,7 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         // vote constructed sucessfully, let's store and relay it
         uint256 nVoteHash = vote.GetHash();
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        AddTxLockVote(nVoteHash, vote);
         if(itOutpointLock->second.AddVote(vote)) {
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
                     txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
@@ -329,6 +334,8 @@ void CInstantSend::FinalizeIndex(const CTxLockCandidate &txLockCandidate, bool f
     it->second.receivedLocks = txLockCandidate.CountVotes();
     it->second.maxLocks = txLockCandidate.GetMaxVotes();
     it->second.elapsedTime = GetTimeMillis() - it->second.timeCreated;
+
+    mapLockIndexDirty[key] = it->second;
 }
 
 //received a consensus vote
@@ -356,7 +363,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
     // Smartnodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    auto it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end() || !it->second.txLockRequest) {
 
         if(it == mapTxLockCandidates.end()) {
@@ -429,7 +436,7 @@ bool CInstantSend::ProcessOrphanTxLockVote(const CTxLockVote& vote)
     uint256 txHash = vote.GetTxHash();
 
     // We shouldn't process orphan votes without a valid tx lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    auto it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end() || !it->second.txLockRequest)
         return false; // this shouldn never happen
 
@@ -463,14 +470,14 @@ void CInstantSend::UpdateVotedOutpoints(const CTxLockVote& vote, CTxLockCandidat
 
     uint256 txHash = vote.GetTxHash();
 
-    std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
+    auto it1 = mapVotedOutpoints.find(vote.GetOutpoint());
     if(it1 != mapVotedOutpoints.end()) {
         for (const auto& hash : it1->second) {
             if(hash != txHash) {
                 // same outpoint was already voted to be locked by another tx lock request,
                 // let's see if it was the same masternode who voted on this outpoint
                 // for another tx lock request
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                auto it2 = mapTxLockCandidates.find(hash);
                 if(it2 !=mapTxLockCandidates.end() && it2->second.HasSmartnodeVoted(vote.GetOutpoint(), vote.GetSmartnodeOutpoint())) {
                     // yes, it was the same masternode
                     LogPrintf("CInstantSend::%s -- smartnode sent conflicting votes! %s\n", __func__, vote.GetSmartnodeOutpoint().ToStringShort());
@@ -499,7 +506,7 @@ void CInstantSend::ProcessOrphanTxLockVotes()
     AssertLockHeld(cs_main);
     AssertLockHeld(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    auto it = mapTxLockVotesOrphan.begin();
     while(it != mapTxLockVotesOrphan.end()) {
         if(ProcessOrphanTxLockVote(it->second)) {
             mapTxLockVotesOrphan.erase(it++);
@@ -576,13 +583,17 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
         mapLockedOutpoints.insert(std::make_pair(it->first, txHash));
         ++it;
     }
+    if(IsTxLocked(txHash)) {
+        setLockedTxHashes.insert(txHash);
+        std::atomic_store(&pLockedTxHashes, std::make_shared<const locked_tx_set_t>(setLockedTxHashes));
+    }
     LogPrint("instantsend", "CInstantSend::LockTransactionInputs -- done, txid=%s\n", txHash.ToString());
 }
 
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
 {
     LOCK(cs_instantsend);
-    std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
+    auto it = mapLockedOutpoints.find(outpoint);
     if(it == mapLockedOutpoints.end()) return false;
     hashRet = it->second;
     return true;
@@ -605,8 +616,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
         if(GetLockedOutPointTxHash(txin.prevout, hashConflicting) && txHash != hashConflicting) {
             // completed lock which conflicts with another completed one?
             // this means that majority of MNs in the quorum for this specific tx input are malicious!
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
+            auto itLockCandidate = mapTxLockCandidates.find(txHash);
+            auto itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
             if(itLockCandidate == mapTxLockCandidates.end() || itLockCandidateConflicting == mapTxLockCandidates.end()) {
                 // safety check, should never really happen
                 LogPrintf("CInstantSend::ResolveConflicts -- ERROR: Found conflicting completed Transaction Lock, but one of txLockCandidate-s is missing, txid=%s, conflicting txid=%s\n",
@@ -617,8 +628,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
                     txHash.ToString(), hashConflicting.ToString());
             CTxLockRequest txLockRequest = itLockCandidate->second.txLockRequest;
             CTxLockRequest txLockRequestConflicting = itLockCandidateConflicting->second.txLockRequest;
-            itLockCandidate->second.SetConfirmedHeight(0); // expired
-            itLockCandidateConflicting->second.SetConfirmedHeight(0); // expired
+            SetConfirmedHeight(itLockCandidate->second, 0); // expired
+            SetConfirmedHeight(itLockCandidateConflicting->second, 0); // expired
             CheckAndRemove(); // clean up
             // AlreadyHave should still return "true" for both of them
             mapLockRequestRejected.insert(make_pair(txHash, txLockRequest));
@@ -670,7 +681,7 @@ int64_t CInstantSend::GetAverageSmartnodeOrphanVoteTime()
     // NOTE: should never actually call this function when mapSmartnodeOrphanVotes is empty
     if(mapSmartnodeOrphanVotes.empty()) return 0;
 
-    std::map<COutPoint, int64_t>::iterator it = mapSmartnodeOrphanVotes.begin();
+    auto it = mapSmartnodeOrphanVotes.begin();
     int64_t total = 0;
 
     while(it != mapSmartnodeOrphanVotes.end()) {
@@ -688,7 +699,7 @@ void CInstantSend::CheckAndRemove()
     LOCK(cs_instantsend);
 
     if( fInstantPayIndex ){
-        std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
+        auto itLockCandidate = mapTxLockCandidates.begin();
         // update index entries
         while(itLockCandidate != mapTxLockCandidates.end()) {
             CTxLockCandidate &txLockCandidate = itLockCandidate->second;
@@ -702,86 +713,68 @@ void CInstantSend::CheckAndRemove()
 
                 // Update the received votes to get some statistics how many valid votes
                 // arrive in time
-                if( it != mapLockIndex.end() && it->second.fProcessed && it->second.fValid ){
+                if( it != mapLockIndex.end() && it->second.fProcessed && it->second.fValid &&
+                    it->second.receivedLocks != txLockCandidate.CountVotes() ){
                     it->second.receivedLocks = txLockCandidate.CountVotes();
+                    mapLockIndexDirty[key] = it->second;
                 }
             }
 
             ++itLockCandidate;
         }
-
-        if( !pblocktree->WriteInstantPayLocks(mapLockIndex) ){
-            LogPrintf("CInstantSend::CheckAndRemove() - Failed to write instantpay index\n");
-        }
     }
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
-    // remove expired candidates
-    while(itLockCandidate != mapTxLockCandidates.end()) {
-        CTxLockCandidate &txLockCandidate = itLockCandidate->second;
-        uint256 txHash = txLockCandidate.GetHash();
-
-        if(txLockCandidate.IsExpired(nCachedBlockHeight)) {
-
-            if( fInstantPayIndex ){
-                CInstantPayIndexKey key(txLockCandidate.GetCreationTime(), txLockCandidate.GetHash());
-                mapLockIndex.erase(key);
-            }
-
+    // remove expired candidates together with their votes, they expire
+    // nInstantSendKeepLock blocks after the block the tx was included into
+    int nExpiredHeight = nCachedBlockHeight - Params().GetConsensus().nInstantSendKeepLock;
+    bool fRemovedLocks = false;
+    while(!mapConfirmedTxLockCandidates.empty() && mapConfirmedTxLockCandidates.begin()->first < nExpiredHeight) {
+        std::set<uint256> setTxHashes;
+        setTxHashes.swap(mapConfirmedTxLockCandidates.begin()->second);
+        mapConfirmedTxLockCandidates.erase(mapConfirmedTxLockCandidates.begin());
+        for(const uint256& txHash : setTxHashes) {
             LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
-            std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
-            while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
-                mapLockedOutpoints.erase(itOutpointLock->first);
-                mapVotedOutpoints.erase(itOutpointLock->first);
-                ++itOutpointLock;
-            }
-            mapLockRequestAccepted.erase(txHash);
-            mapLockRequestRejected.erase(txHash);
-            mapTxLockCandidates.erase(itLockCandidate++);
-        } else {
-            ++itLockCandidate;
+            fRemovedLocks |= setLockedTxHashes.count(txHash) > 0;
+            RemoveTxLockCandidate(txHash);
         }
     }
 
-    // remove expired votes
-    std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsExpired(nCachedBlockHeight)) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  smartnode=%s\n",
-                    itVote->second.GetTxHash().ToString(), itVote->second.GetSmartnodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
-        }
-    }
-
-    // remove timed out orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.IsTimedOut()) {
+    // Votes are visited in the order they were created, only the last
+    // INSTANTSEND_FAILED_TIMEOUT_SECONDS are looked at more than once
+    int64_t nNow = GetTime();
+    auto itTime = mapTxLockVoteTimes.begin();
+    while(itTime != mapTxLockVoteTimes.end() && nNow - itTime->first > INSTANTSEND_LOCK_TIMEOUT_SECONDS) {
+        const uint256 nVoteHash = itTime->second;
+        auto itVote = mapTxLockVotes.find(nVoteHash);
+        bool fFailedTimeout = nNow - itTime->first > INSTANTSEND_FAILED_TIMEOUT_SECONDS;
+
+        if(itVote == mapTxLockVotes.end()) {
+            // already removed with its candidate
+        } else if(mapTxLockVotesOrphan.count(nVoteHash) && itVote->second.IsTimedOut()) {
+            // remove timed out orphan votes
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing timed out orphan vote: txid=%s  smartnode=%s\n",
-                    itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetSmartnodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
-        }
-    }
-
-    // remove invalid votes and votes for failed lock attempts
-    itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsFailed()) {
+                    itVote->second.GetTxHash().ToString(), itVote->second.GetSmartnodeOutpoint().ToStringShort());
+            mapTxLockVotesOrphan.erase(nVoteHash);
+            RemoveTxLockVote(nVoteHash);
+        } else if(!fFailedTimeout) {
+            ++itTime;
+            continue;
+        } else if(itVote->second.IsFailed()) {
+            // remove invalid votes and votes for failed lock attempts
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  smartnode=%s\n",
                     itVote->second.GetTxHash().ToString(), itVote->second.GetSmartnodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
+            RemoveTxLockVote(nVoteHash);
         }
+        // votes of locked transactions stay until their candidate expires
+        mapTxLockVoteTimes.erase(itTime++);
+    }
+
+    if(fRemovedLocks) {
+        UpdateLockedTxHashes();
     }
 
     // remove timed out smartnode orphan votes (DOS protection)
-    std::map<COutPoint, int64_t>::iterator itSmartnodeOrphan = mapSmartnodeOrphanVotes.begin();
+    auto itSmartnodeOrphan = mapSmartnodeOrphanVotes.begin();
     while(itSmartnodeOrphan != mapSmartnodeOrphanVotes.end()) {
         if(itSmartnodeOrphan->second < GetTime()) {
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing timed out orphan smartnode vote: smartnode=%s\n",
@@ -824,7 +817,7 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    auto it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) return false;
     txLockRequestRet = it->second.txLockRequest;
 
@@ -835,13 +828,72 @@ bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
+    auto it = mapTxLockVotes.find(hash);
     if(it == mapTxLockVotes.end()) return false;
     txLockVoteRet = it->second;
 
     return true;
 }
 
+void CInstantSend::GetLockedTxVotes(std::map<uint256, std::vector<CTxLockVote> >& mapVotesRet)
+{
+    LOCK(cs_instantsend);
+
+    for (const uint256& txHash : setLockedTxHashes) {
+        auto itLockCandidate = mapTxLockCandidates.find(txHash);
+        if(itLockCandidate == mapTxLockCandidates.end()) continue;
+
+        std::vector<CTxLockVote>& vecVotes = mapVotesRet[txHash];
+        for (const auto& pairOutPointLock : itLockCandidate->second.mapOutPointLocks) {
+            std::vector<CTxLockVote> vecOutPointVotes = pairOutPointLock.second.GetVotes();
+            vecVotes.insert(vecVotes.end(), vecOutPointVotes.begin(), vecOutPointVotes.end());
+        }
+    }
+}
+
+bool CInstantSend::RestoreTxLock(const CTxLockRequest& txLockRequest, const std::vector<CTxLockVote>& vecVotes)
+{
+    LOCK(cs_main);
+#ifdef ENABLE_WALLET
+    LOCK(pwalletMain ? &pwalletMain->cs_wallet : NULL);
+#endif
+    LOCK2(mempool.cs, cs_instantsend);
+
+    uint256 txHash = txLockRequest.GetHash();
+
+    if(mapTxLockCandidates.count(txHash) || !txLockRequest.IsValid()) return false;
+
+    CTxLockCandidate txLockCandidate(txLockRequest);
+    BOOST_REVERSE_FOREACH(const CTxIn& txin, txLockRequest.vin) {
+        txLockCandidate.AddOutPointLock(txin.prevout);
+    }
+
+    // The ranks were checked when the votes arrived, the smartnodes still have to be known
+    std::vector<CTxLockVote> vecValidVotes;
+    for (const CTxLockVote& vote : vecVotes) {
+        if(vote.GetTxHash() == txHash && vote.CheckSignature() && txLockCandidate.AddVote(vote))
+            vecValidVotes.push_back(vote);
+    }
+
+    if(!txLockCandidate.IsAllOutPointsReady()) {
+        LogPrint("instantsend", "CInstantSend::RestoreTxLock -- not enough valid votes, txid=%s\n", txHash.ToString());
+        return false;
+    }
+
+    // The lock was indexed when it completed, so the restored candidate is not indexed again
+    auto itLockCandidate = mapTxLockCandidates.insert(std::make_pair(txHash, txLockCandidate)).first;
+    mapLockRequestAccepted.insert(std::make_pair(txHash, txLockRequest));
+    for (const CTxLockVote& vote : vecValidVotes) {
+        AddTxLockVote(vote.GetHash(), vote);
+        UpdateVotedOutpoints(vote, itLockCandidate->second);
+    }
+
+    TryToFinalizeLockCandidate(itLockCandidate->second);
+
+    LogPrint("instantsend", "CInstantSend::RestoreTxLock -- txid=%s, locked=%d\n", txHash.ToString(), IsTxLocked(txHash));
+    return IsTxLocked(txHash);
+}
+
 bool CInstantSend::IsInstantSendReadyToLock(const uint256& txHash)
 {
     if(!fEnableInstantSend || GetfLargeWorkForkFound() || GetfLargeWorkInvalidChainFound() ||
@@ -850,19 +902,67 @@ bool CInstantSend::IsInstantSendReadyToLock(const uint256& txHash)
     LOCK(cs_instantsend);
     // There must be a successfully verified lock request
     // and all outputs must be locked (i.e. have enough signatures)
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    auto it = mapTxLockCandidates.find(txHash);
     return it != mapTxLockCandidates.end() && it->second.IsAllOutPointsReady();
 }
 
+void CInstantSend::FlushInstantPayIndex()
+{
+    std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > vecEntries;
+
+    {
+        LOCK(cs_instantsend);
+        vecEntries.assign(mapLockIndexDirty.begin(), mapLockIndexDirty.end());
+        mapLockIndexDirty.clear();
+    }
+
+    if( vecEntries.empty() ) return;
+
+    // Write without cs_instantsend, lock messages are processed meanwhile
+    bool fWritten = pblocktree->WriteInstantPayIndex(vecEntries);
+
+    LOCK(cs_instantsend);
+
+    for( const auto& entry : vecEntries ){
+        if( !fWritten ){
+            // Retry with the next flush, unless a newer state is waiting already
+            mapLockIndexDirty.insert(entry);
+            continue;
+        }
+
+        auto it = mapLockIndex.find(entry.first);
+        if( it != mapLockIndex.end() ) it->second.fWritten = true;
+
+        auto itDirty = mapLockIndexDirty.find(entry.first);
+        if( itDirty != mapLockIndexDirty.end() ) itDirty->second.fWritten = true;
+    }
+
+    if( !fWritten ){
+        LogPrintf("CInstantSend::FlushInstantPayIndex -- Failed to write instantpay index\n");
+    }else{
+        LogPrint("instantsend", "CInstantSend::FlushInstantPayIndex -- Wrote %d entries\n", vecEntries.size());
+    }
+}
+
 bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
 {
     if(!fEnableInstantSend || GetfLargeWorkForkFound() || GetfLargeWorkInvalidChainFound() ||
         !sporkManager.IsSporkActive(SPORK_3_INSTANTSEND_BLOCK_FILTERING)) return false;
 
-    LOCK(cs_instantsend);
+    return std::atomic_load(&pLockedTxHashes)->count(txHash) > 0;
+}
+
+std::shared_ptr<const CInstantSend::locked_tx_set_t> CInstantSend::GetLockedTransactions() const
+{
+    return std::atomic_load(&pLockedTxHashes);
+}
+
+bool CInstantSend::IsTxLocked(const uint256& txHash)
+{
+    AssertLockHeld(cs_instantsend);
 
     // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) return false;
 
     // which should have outpoints
@@ -871,14 +971,118 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     // and all of these outputs must be included in mapLockedOutpoints with correct hash
     std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
     while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
-        uint256 hashLocked;
-        if(!GetLockedOutPointTxHash(itOutpointLock->first, hashLocked) || hashLocked != txHash) return false;
+        auto itLocked = mapLockedOutpoints.find(itOutpointLock->first);
+        if(itLocked == mapLockedOutpoints.end() || itLocked->second != txHash) return false;
         ++itOutpointLock;
     }
 
     return true;
 }
 
+void CInstantSend::UpdateLockedTxHashes()
+{
+    AssertLockHeld(cs_instantsend);
+
+    auto it = setLockedTxHashes.begin();
+    while(it != setLockedTxHashes.end()) {
+        if(!IsTxLocked(*it)) {
+            it = setLockedTxHashes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // readers keep the previous set until they drop it
+    std::atomic_store(&pLockedTxHashes, std::make_shared<const locked_tx_set_t>(setLockedTxHashes));
+}
+
+void CInstantSend::AddTxLockVote(const uint256& nVoteHash, const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    if(!mapTxLockVotes.emplace(nVoteHash, vote).second) return;
+    mapTxLockVoteHashes[vote.GetTxHash()].push_back(nVoteHash);
+    mapTxLockVoteTimes.emplace(vote.GetTimeCreated(), nVoteHash);
+}
+
+void CInstantSend::RemoveTxLockVote(const uint256& nVoteHash)
+{
+    AssertLockHeld(cs_instantsend);
+
+    auto itVote = mapTxLockVotes.find(nVoteHash);
+    if(itVote == mapTxLockVotes.end()) return;
+
+    auto itHashes = mapTxLockVoteHashes.find(itVote->second.GetTxHash());
+    if(itHashes != mapTxLockVoteHashes.end()) {
+        std::vector<uint256>& vecHashes = itHashes->second;
+        vecHashes.erase(std::remove(vecHashes.begin(), vecHashes.end(), nVoteHash), vecHashes.end());
+        if(vecHashes.empty()) {
+            mapTxLockVoteHashes.erase(itHashes);
+        }
+    }
+    // the time index entry is dropped when CheckAndRemove reaches it
+    mapTxLockVotes.erase(itVote);
+}
+
+void CInstantSend::SetConfirmedHeight(CTxLockCandidate& txLockCandidate, int nHeight)
+{
+    AssertLockHeld(cs_instantsend);
+
+    uint256 txHash = txLockCandidate.GetHash();
+    int nHeightOld = txLockCandidate.GetConfirmedHeight();
+
+    if(nHeightOld != -1) {
+        auto it = mapConfirmedTxLockCandidates.find(nHeightOld);
+        if(it != mapConfirmedTxLockCandidates.end()) {
+            it->second.erase(txHash);
+            if(it->second.empty()) {
+                mapConfirmedTxLockCandidates.erase(it);
+            }
+        }
+    }
+    if(nHeight != -1) {
+        mapConfirmedTxLockCandidates[nHeight].insert(txHash);
+    }
+
+    txLockCandidate.SetConfirmedHeight(nHeight);
+}
+
+void CInstantSend::RemoveTxLockCandidate(const uint256& txHash)
+{
+    AssertLockHeld(cs_instantsend);
+
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
+    if(itLockCandidate != mapTxLockCandidates.end()) {
+        CTxLockCandidate &txLockCandidate = itLockCandidate->second;
+
+        if( fInstantPayIndex ){
+            CInstantPayIndexKey key(txLockCandidate.GetCreationTime(), txHash);
+            mapLockIndex.erase(key);
+        }
+
+        std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
+        while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
+            mapLockedOutpoints.erase(itOutpointLock->first);
+            mapVotedOutpoints.erase(itOutpointLock->first);
+            ++itOutpointLock;
+        }
+        mapTxLockCandidates.erase(itLockCandidate);
+    }
+
+    mapLockRequestAccepted.erase(txHash);
+    mapLockRequestRejected.erase(txHash);
+
+    // votes expire together with the transaction they are voting for
+    auto itHashes = mapTxLockVoteHashes.find(txHash);
+    if(itHashes != mapTxLockVoteHashes.end()) {
+        for(const uint256& nVoteHash : itHashes->second) {
+            mapTxLockVotes.erase(nVoteHash);
+            mapTxLockVotesOrphan.erase(nVoteHash);
+        }
+        mapTxLockVoteHashes.erase(itHashes);
+    }
+}
+
 int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 {
     if(!fEnableInstantSend) return -1;
@@ -887,7 +1091,7 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         return itLockCandidate->second.CountVotes();
     }
@@ -906,7 +1110,7 @@ bool CInstantSend::IsTxLockCandidateTimedOut(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         return !itLockCandidate->second.IsAllOutPointsReady() &&
                 itLockCandidate->second.IsTimedOut();
@@ -919,7 +1123,7 @@ void CInstantSend::Relay(const uint256& txHash, CConnman& connman)
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         itLockCandidate->second.Relay(connman);
     }
@@ -958,41 +1162,24 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d\n", txHash.ToString(), nHeightNew);
 
     // Check lock candidates
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    auto itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d lock candidate updated\n",
                 txHash.ToString(), nHeightNew);
-        itLockCandidate->second.SetConfirmedHeight(nHeightNew);
-        // Loop through outpoint locks
-        std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
-        while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
-            // Check corresponding lock votes
-            std::vector<CTxLockVote> vVotes = itOutpointLock->second.GetVotes();
-            std::vector<CTxLockVote>::iterator itVote = vVotes.begin();
-            std::map<uint256, CTxLockVote>::iterator it;
-            while(itVote != vVotes.end()) {
-                uint256 nVoteHash = itVote->GetHash();
+        SetConfirmedHeight(itLockCandidate->second, nHeightNew);
+    }
+
+    // Check all votes for this tx, orphan or not
+    auto itHashes = mapTxLockVoteHashes.find(txHash);
+    if(itHashes != mapTxLockVoteHashes.end()) {
+        for(const uint256& nVoteHash : itHashes->second) {
+            auto itVote = mapTxLockVotes.find(nVoteHash);
+            if(itVote != mapTxLockVotes.end()) {
                 LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
                         txHash.ToString(), nHeightNew, nVoteHash.ToString());
-                it = mapTxLockVotes.find(nVoteHash);
-                if(it != mapTxLockVotes.end()) {
-                    it->second.SetConfirmedHeight(nHeightNew);
-                }
-                ++itVote;
+                itVote->second.SetConfirmedHeight(nHeightNew);
             }
-            ++itOutpointLock;
-        }
-    }
-
-    // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.GetTxHash() == txHash) {
-            LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                    txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
         }
-        ++itOrphanVote;
     }
 }
 
@@ -9,6 +9,11 @@
 #include "../utiltime.h"
 #include "primitives/transaction.h"
 #include "txdb.h"
+#include "txmempool.h"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 class CTxLockVote;
 class COutPointLock;
@@ -40,6 +45,8 @@ static const int INSTANTSEND_LOCK_TIMEOUT_SECONDS   = 15;
 // For how long we are going to keep invalid votes and votes for failed lock attempts,
 // must be greater than INSTANTSEND_LOCK_TIMEOUT_SECONDS
 static const int INSTANTSEND_FAILED_TIMEOUT_SECONDS = 60;
+// How often finished lock attempts are written to the instantpay index
+static const int INSTANTPAY_INDEX_FLUSH_INTERVAL    = 60;
 
 extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
@@ -47,25 +54,38 @@ extern int nCompleteTXLocks;
 
 class CInstantSend
 {
+public:
+    typedef std::unordered_set<uint256, SaltedTxidHasher> locked_tx_set_t;
+
 private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
     // maps for AlreadyHave
-    std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
-    std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
-    std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
-    std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher> mapLockRequestAccepted; // tx hash - tx
+    std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher> mapLockRequestRejected; // tx hash - tx
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher> mapTxLockVotes; // vote hash - vote
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher> mapTxLockVotesOrphan; // vote hash - vote
 
-    std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher> mapTxLockCandidates; // tx hash - lock candidate
 
-    std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; // utxo - tx hash set
-    std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
+    std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher> mapVotedOutpoints; // utxo - tx hash set
+    std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> mapLockedOutpoints; // utxo - tx hash
 
     //track smartnodes who voted with no txreq (for DOS protection)
-    std::map<COutPoint, int64_t> mapSmartnodeOrphanVotes; // mn outpoint - time
+    std::unordered_map<COutPoint, int64_t, SaltedOutpointHasher> mapSmartnodeOrphanVotes; // mn outpoint - time
+
+    // expiry indexes, so cleaning up only visits what expires
+    std::unordered_map<uint256, std::vector<uint256>, SaltedTxidHasher> mapTxLockVoteHashes; // tx hash - vote hashes
+    std::multimap<int64_t, uint256> mapTxLockVoteTimes; // vote creation time - vote hash
+    std::map<int, std::set<uint256> > mapConfirmedTxLockCandidates; // confirmed height - tx hashes
+
+    // locked transactions, a copy is published for lookups without cs_instantsend
+    locked_tx_set_t setLockedTxHashes;
+    std::shared_ptr<const locked_tx_set_t> pLockedTxHashes; // access with std::atomic_load/store only
 
     std::map<CInstantPayIndexKey, CInstantPayValue> mapLockIndex;
+    std::map<CInstantPayIndexKey, CInstantPayValue> mapLockIndexDirty; // finished or updated, not yet written
 
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void CreateEmptyTxLockCandidate(const uint256& txHash);
@@ -89,6 +109,14 @@ private:
 
     bool IsInstantSendReadyToLock(const uint256 &txHash);
 
+    void AddTxLockVote(const uint256& nVoteHash, const CTxLockVote& vote);
+    void RemoveTxLockVote(const uint256& nVoteHash);
+    void SetConfirmedHeight(CTxLockCandidate& txLockCandidate, int nHeight);
+    void RemoveTxLockCandidate(const uint256& txHash);
+    // verify if all inputs of the transaction are locked for it, cs_instantsend must be held
+    bool IsTxLocked(const uint256& txHash);
+    void UpdateLockedTxHashes();
+
 public:
     CCriticalSection cs_instantsend;
 
@@ -108,15 +136,26 @@ public:
 
     bool GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet);
 
-    // verify if transaction is currently locked
+    CInstantSend();
+
+    // verify if transaction is currently locked, doesn't take cs_instantsend
     bool IsLockedInstantSendTransaction(const uint256& txHash);
+    // all currently locked transactions, doesn't take cs_instantsend
+    std::shared_ptr<const locked_tx_set_t> GetLockedTransactions() const;
     // get the actual number of accepted lock signatures
     int GetTransactionLockSignatures(const uint256& txHash);
     // get instantsend confirmations (only)
     int GetConfirmations(const uint256 &nTXHash);
 
+    // votes of the completed locks, enough to restore them after a restart
+    void GetLockedTxVotes(std::map<uint256, std::vector<CTxLockVote> >& mapVotesRet);
+    // restore a completed lock from its votes, false if they don't lock the transaction (anymore)
+    bool RestoreTxLock(const CTxLockRequest& txLockRequest, const std::vector<CTxLockVote>& vecVotes);
+
     // remove expired entries from maps
     void CheckAndRemove();
+    // write the finished lock attempts to the instantpay index
+    void FlushInstantPayIndex();
     // verify if transaction lock timed out
     bool IsTxLockCandidateTimedOut(const uint256& txHash);
 
@@ -196,6 +235,7 @@ public:
     COutPoint GetSmartnodeOutpoint() const { return outpointSmartnode; }
 
     bool IsValid(CNode* pnode, CConnman& connman) const;
+    int64_t GetTimeCreated() const { return nTimeCreated; }
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
     bool IsExpired(int nHeight) const;
     bool IsTimedOut() const;
@@ -264,6 +304,7 @@ public:
     int CountVotes() const;
     int GetMaxVotes() const { return txLockRequest.GetMaxSignatures(); }
 
+    int GetConfirmedHeight() const { return nConfirmedHeight; }
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
     bool IsExpired(int nHeight) const;
     bool IsTimedOut() const;
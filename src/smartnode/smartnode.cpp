@@ -76,6 +76,7 @@ bool CSmartnode::UpdateFromNewBroadcast(CSmartnodeBroadcast& mnb, CConnman& conn
     if(mnb.lastPing == CSmartnodePing() || (mnb.lastPing != CSmartnodePing() && mnb.lastPing.CheckAndUpdate(this, true, nDos, connman))) {
         lastPing = mnb.lastPing;
         mnodeman.mapSeenSmartnodePing.insert(std::make_pair(lastPing.GetHash(), lastPing));
+        mnodeman.SetSeenPingChanged(lastPing.GetHash());
     }
     // if it matches our Smartnode privkey...
     if(fSmartNode && pubKeySmartnode == activeSmartnode.pubKeySmartnode) {
@@ -303,11 +304,8 @@ void CSmartnode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanB
     CScript mnpayee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
     // LogPrint("smartnode", "CSmartnode::UpdateLastPaidBlock -- searching for block with payment to %s\n", vin.prevout.ToStringShort());
 
-    LOCK(cs_mapSmartnodeBlocks);
-
     for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
-        if(mnpayments.mapSmartnodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapSmartnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2))
+        if(mnpayments.HasPayeeWithVotes(BlockReading->nHeight, mnpayee, 2))
         {
             CBlock block;
             if(!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
@@ -544,6 +542,7 @@ bool CSmartnodeBroadcast::CheckOutpoint(int& nDos)
             // not mnb fault, let it to be checked again later
             LogPrint("smartnode", "CSmartnodeBroadcast::CheckOutpoint -- Failed to aquire lock, addr=%s", addr.ToString());
             mnodeman.mapSeenSmartnodeBroadcast.erase(GetHash());
+            mnodeman.SetSeenBroadcastChanged(GetHash());
             return false;
         }
 
@@ -564,6 +563,7 @@ bool CSmartnodeBroadcast::CheckOutpoint(int& nDos)
                     Params().GetConsensus().nSmartnodeMinimumConfirmations, vin.prevout.ToStringShort());
             // maybe we miss few blocks, let this mnb to be checked again later
             mnodeman.mapSeenSmartnodeBroadcast.erase(GetHash());
+            mnodeman.SetSeenBroadcastChanged(GetHash());
             return false;
         }
         // remember the hash of the block where smartnode collateral had minimum required confirmations
@@ -847,6 +847,7 @@ bool CSmartnodePing::CheckAndUpdate(CSmartnode* pmn, bool fFromNewBroadcast, int
     uint256 hash = mnb.GetHash();
     if (mnodeman.mapSeenSmartnodeBroadcast.count(hash)) {
         mnodeman.mapSeenSmartnodeBroadcast[hash].second.lastPing = *this;
+        mnodeman.SetSeenBroadcastChanged(hash);
     }
 
     // force update, ignoring cache
@@ -11,6 +11,7 @@
 #include "netfulfilledman.h"
 #include "smartnodeman.h"
 #include "../util.h"
+#include "../validationinterface.h"
 #include "sapi/sapi.h"
 
 /** Smartnode manager */
@@ -18,15 +19,6 @@ CSmartnodeMan mnodeman;
 
 const std::string CSmartnodeMan::SERIALIZATION_VERSION_STRING = "CSmartnodeMan-Version-4";
 
-struct CompareLastPaidBlock
-{
-    bool operator()(const std::pair<int, CSmartnode*>& t1,
-                    const std::pair<int, CSmartnode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
-
 struct CompareScoreMN
 {
     bool operator()(const std::pair<arith_uint256, CSmartnode*>& t1,
@@ -36,16 +28,6 @@ struct CompareScoreMN
     }
 };
 
-struct CompareByAddr
-
-{
-    bool operator()(const CSmartnode* t1,
-                    const CSmartnode* t2) const
-    {
-        return t1->addr < t2->addr;
-    }
-};
-
 struct CompareRankPair
 {
     bool operator()(const CSmartnodeMan::rank_pair_t& t1,
@@ -57,7 +39,7 @@ struct CompareRankPair
 
 CSmartnodeMan::CSmartnodeMan()
 : cs(),
-  mapSmartnodes(),
+  smartnodes(),
   mAskedUsForSmartnodeList(),
   mWeAskedForSmartnodeList(),
   mWeAskedForSmartnodeListEntry(),
@@ -67,6 +49,7 @@ CSmartnodeMan::CSmartnodeMan()
   listScheduledMnbRequestConnections(),
   fSmartnodesAdded(false),
   fSmartnodesRemoved(false),
+  fJournalAll(true),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
   mapSeenSmartnodeBroadcast(),
@@ -74,12 +57,27 @@ CSmartnodeMan::CSmartnodeMan()
   nDsqCount(0)
 {}
 
+void CSmartnodeListDiff::Add(const smartnode_info_t& info)
+{
+    vecRemoved.erase(std::remove(vecRemoved.begin(), vecRemoved.end(), info.vin.prevout), vecRemoved.end());
+    vecAdded.push_back(info);
+}
+
+void CSmartnodeListDiff::Remove(const COutPoint& outpoint)
+{
+    vecAdded.erase(std::remove_if(vecAdded.begin(), vecAdded.end(),
+                                  [&outpoint](const smartnode_info_t& info) { return info.vin.prevout == outpoint; }),
+                   vecAdded.end());
+    vecRemoved.push_back(outpoint);
+}
+
 bool CSmartnodeMan::Add(CSmartnode &mn)
 {
     LOCK(cs);
     if (Has(mn.vin.prevout)) return false;
     LogPrint("smartnode", "CSmartnodeMan::Add -- Adding new Smartnode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
-    mapSmartnodes[mn.vin.prevout] = mn;
+    smartnodes.Add(mn);
+    diffPending.Add(mn.GetInfo());
     fSmartnodesAdded = true;
     return true;
 }
@@ -130,6 +128,7 @@ bool CSmartnodeMan::AllowMixing(const COutPoint &outpoint)
     nDsqCount++;
     pmn->nLastDsq = nDsqCount;
     pmn->fAllowMixingTx = true;
+    smartnodes.SetChanged(pmn);
 
     return true;
 }
@@ -142,6 +141,7 @@ bool CSmartnodeMan::DisallowMixing(const COutPoint &outpoint)
         return false;
     }
     pmn->fAllowMixingTx = false;
+    smartnodes.SetChanged(pmn);
 
     return true;
 }
@@ -154,6 +154,7 @@ bool CSmartnodeMan::PoSeBan(const COutPoint &outpoint)
         return false;
     }
     pmn->PoSeBan();
+    smartnodes.SetChanged(pmn);
 
     return true;
 }
@@ -163,8 +164,9 @@ void CSmartnodeMan::Check()
     LOCK2(cs_main, cs);
     LogPrint("smartnode", "CSmartnodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
-    for (auto& mnpair : mapSmartnodes) {
-        mnpair.second.Check();
+    for (auto& mn : smartnodes) {
+        mn.Check();
+        smartnodes.Update(&mn);
     }
 }
 
@@ -185,32 +187,37 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
         rank_pair_vec_t vecSmartnodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES smartnode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
-        std::map<COutPoint, CSmartnode>::iterator it = mapSmartnodes.begin();
-        while (it != mapSmartnodes.end()) {
-            CSmartnodeBroadcast mnb = CSmartnodeBroadcast(it->second);
+        // Erase moves the last smartnode to it, which is checked next
+        CSmartnodeRegistry::iterator it = smartnodes.begin();
+        while (it != smartnodes.end()) {
+            const COutPoint outpoint = it->vin.prevout;
+            CSmartnodeBroadcast mnb = CSmartnodeBroadcast(*it);
             uint256 hash = mnb.GetHash();
             // If collateral was spent ...
-            if (it->second.IsOutpointSpent()) {
-                LogPrint("smartnode", "CSmartnodeMan::CheckAndRemove -- Removing Spent Smartnode: %s  addr=%s  %i now\n", it->second.GetStateString(), it->second.addr.ToString(), size() - 1);
+            if (it->IsOutpointSpent()) {
+                LogPrint("smartnode", "CSmartnodeMan::CheckAndRemove -- Removing Spent Smartnode: %s  addr=%s  %i now\n", it->GetStateString(), it->addr.ToString(), size() - 1);
 
                 // erase all of the broadcasts we've seen from this txin, ...
                 mapSeenSmartnodeBroadcast.erase(hash);
-                mWeAskedForSmartnodeListEntry.erase(it->first);
+                setJournalBroadcasts.insert(hash);
+                mWeAskedForSmartnodeListEntry.erase(outpoint);
 
                 // and finally remove it from the list
-                it->second.FlagGovernanceItemsAsDirty();
-                mapSmartnodes.erase(it++);
+                it->FlagGovernanceItemsAsDirty();
+                diffPending.Remove(outpoint);
+                it = smartnodes.Erase(it);
                 fSmartnodesRemoved = true;
             // If node is older than the min peer version, remove it.
-            } else if (it->second.nProtocolVersion < MIN_PEER_PROTO_VERSION) {
-                LogPrint("smartnode", "CSmartnodeMan::CheckAndRemove -- Removing Old Version Smartnode: %s  addr=%s  %i now\n", it->second.GetStateString(), it->second.addr.ToString(), size() - 1);
-                it->second.FlagGovernanceItemsAsDirty();
-                mapSmartnodes.erase(it++);
+            } else if (it->nProtocolVersion < MIN_PEER_PROTO_VERSION) {
+                LogPrint("smartnode", "CSmartnodeMan::CheckAndRemove -- Removing Old Version Smartnode: %s  addr=%s  %i now\n", it->GetStateString(), it->addr.ToString(), size() - 1);
+                it->FlagGovernanceItemsAsDirty();
+                diffPending.Remove(outpoint);
+                it = smartnodes.Erase(it);
                 fSmartnodesRemoved=true;
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
                             smartnodeSync.IsSynced() &&
-                            it->second.IsNewStartRequired() &&
+                            it->IsNewStartRequired() &&
                             !IsMnbRecoveryRequested(hash);
                 if(fAsk) {
                     // this mn is in a non-recoverable state and we haven't asked other nodes yet
@@ -224,7 +231,7 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
                     // ask first MNB_RECOVERY_QUORUM_TOTAL smartnodes we can connect to and we haven't asked recently
                     for(int i = 0; setRequested.size() < MNB_RECOVERY_QUORUM_TOTAL && i < (int)vecSmartnodeRanks.size(); i++) {
                         // avoid banning
-                        if(mWeAskedForSmartnodeListEntry.count(it->first) && mWeAskedForSmartnodeListEntry[it->first].count(vecSmartnodeRanks[i].second.addr)) continue;
+                        if(mWeAskedForSmartnodeListEntry.count(outpoint) && mWeAskedForSmartnodeListEntry[outpoint].count(vecSmartnodeRanks[i].second.addr)) continue;
                         // didn't ask recently, ok to ask now
                         CService addr = vecSmartnodeRanks[i].second.addr;
                         setRequested.insert(addr);
@@ -232,7 +239,7 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
                         fAskedForMnbRecovery = true;
                     }
                     if(fAskedForMnbRecovery) {
-                        LogPrint("smartnode", "CSmartnodeMan::CheckAndRemove -- Recovery initiated, smartnode=%s\n", it->first.ToStringShort());
+                        LogPrint("smartnode", "CSmartnodeMan::CheckAndRemove -- Recovery initiated, smartnode=%s\n", outpoint.ToStringShort());
                         nAskForMnbRecovery--;
                     }
                     // wait for mnb recovery replies for MNB_RECOVERY_WAIT_SECONDS seconds
@@ -332,6 +339,7 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
         while(it4 != mapSeenSmartnodePing.end()){
             if((*it4).second.IsExpired()) {
                 LogPrint("smartnode", "CSmartnodeMan::CheckAndRemove -- Removing expired Smartnode ping: hash=%s\n", (*it4).second.GetHash().ToString());
+                setJournalPings.insert(it4->first);
                 mapSeenSmartnodePing.erase(it4++);
             } else {
                 ++it4;
@@ -352,7 +360,7 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
         LogPrintf("CSmartnodeMan::CheckAndRemove -- %s\n", ToString());
     }
 
-    if(fSmartnodesRemoved) {
+    if(fSmartnodesAdded || fSmartnodesRemoved) {
         NotifySmartnodeUpdates(connman);
     }
 }
@@ -360,7 +368,11 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
 void CSmartnodeMan::Clear()
 {
     LOCK(cs);
-    mapSmartnodes.clear();
+    for (const auto& mn : smartnodes) {
+        diffPending.Remove(mn.vin.prevout);
+    }
+    fSmartnodesRemoved = !smartnodes.empty();
+    smartnodes.Clear();
     mAskedUsForSmartnodeList.clear();
     mWeAskedForSmartnodeList.clear();
     mWeAskedForSmartnodeListEntry.clear();
@@ -368,6 +380,96 @@ void CSmartnodeMan::Clear()
     mapSeenSmartnodePing.clear();
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
+    fJournalAll = true;
+}
+
+void CSmartnodeMan::GetJournalRecords(flatdb_records_t& mapRecords) const
+{
+    LOCK(cs);
+    for (const auto& mn : smartnodes) {
+        AddFlatDBRecord(mapRecords, 'n', mn.vin.prevout, mn);
+    }
+    AddFlatDBRecords(mapRecords, 'b', mapSeenSmartnodeBroadcast);
+    AddFlatDBRecords(mapRecords, 'p', mapSeenSmartnodePing);
+    AddFlatDBRecord(mapRecords, 's', GetJournalState());
+}
+
+bool CSmartnodeMan::GetJournalChanges(flatdb_records_t& mapRecords, std::set<flatdb_bytes_t>& setErased)
+{
+    LOCK(cs);
+
+    std::set<COutPoint> setSmartnodes;
+    smartnodes.TakeChanged(setSmartnodes);
+    std::set<uint256> setBroadcasts, setPings;
+    setBroadcasts.swap(setJournalBroadcasts);
+    setPings.swap(setJournalPings);
+
+    // The state record is small, it is only compared to the last one
+    flatdb_bytes_t vchState = GetJournalState();
+    uint256 hashState = Hash(vchState.begin(), vchState.end());
+    bool fStateChanged = hashState != hashJournalState;
+    hashJournalState = hashState;
+
+    if (fJournalAll) {
+        fJournalAll = false;
+        return false;
+    }
+
+    for (const COutPoint& outpoint : setSmartnodes) {
+        const CSmartnode* pmn = smartnodes.Find(outpoint);
+        if (pmn)
+            AddFlatDBRecord(mapRecords, 'n', outpoint, *pmn);
+        else
+            setErased.insert(GetFlatDBKey('n', outpoint));
+    }
+    AddFlatDBChanges(mapRecords, setErased, 'b', mapSeenSmartnodeBroadcast, setBroadcasts);
+    AddFlatDBChanges(mapRecords, setErased, 'p', mapSeenSmartnodePing, setPings);
+    if (fStateChanged)
+        AddFlatDBRecord(mapRecords, 's', vchState);
+
+    return true;
+}
+
+flatdb_bytes_t CSmartnodeMan::GetJournalState() const
+{
+    AssertLockHeld(cs);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << SERIALIZATION_VERSION_STRING;
+    ss << mAskedUsForSmartnodeList << mWeAskedForSmartnodeList << mWeAskedForSmartnodeListEntry;
+    ss << mMnbRecoveryRequests << mMnbRecoveryGoodReplies << nLastWatchdogVoteTime << nDsqCount;
+    return flatdb_bytes_t(ss.begin(), ss.end());
+}
+
+void CSmartnodeMan::LoadJournalRecords(const flatdb_records_t& mapRecords)
+{
+    Clear();
+
+    flatdb_bytes_t vchState;
+    if (!ReadFlatDBRecord(mapRecords, 's', vchState))
+        return;
+
+    LOCK(cs);
+    CDataStream ss(vchState, SER_DISK, CLIENT_VERSION);
+    std::string strVersion;
+    ss >> strVersion;
+    if (strVersion != SERIALIZATION_VERSION_STRING)
+        return;
+    ss >> mAskedUsForSmartnodeList >> mWeAskedForSmartnodeList >> mWeAskedForSmartnodeListEntry;
+    ss >> mMnbRecoveryRequests >> mMnbRecoveryGoodReplies >> nLastWatchdogVoteTime >> nDsqCount;
+
+    std::map<COutPoint, CSmartnode> mapSmartnodes;
+    ReadFlatDBRecords(mapRecords, 'n', mapSmartnodes);
+    for (const auto& mnpair : mapSmartnodes) {
+        smartnodes.Add(mnpair.second);
+    }
+    ReadFlatDBRecords(mapRecords, 'b', mapSeenSmartnodeBroadcast);
+    ReadFlatDBRecords(mapRecords, 'p', mapSeenSmartnodePing);
+
+    // What was just read is on disk already
+    std::set<COutPoint> setSmartnodes;
+    smartnodes.TakeChanged(setSmartnodes);
+    hashJournalState = Hash(vchState.begin(), vchState.end());
+    fJournalAll = false;
 }
 
 int CSmartnodeMan::CountSmartnodes(int nProtocolVersion)
@@ -377,15 +479,9 @@ int CSmartnodeMan::CountSmartnodes(int nProtocolVersion)
     TRY_LOCK(cs,locked);
     if( !locked ) return nodes;
 
-    int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinSmartnodePaymentsProto() : nProtocolVersion;
 
-    for (auto& mnpair : mapSmartnodes) {
-        if(mnpair.second.nProtocolVersion < nProtocolVersion) continue;
-        nCount++;
-    }
-
-    return (nodes = nCount);
+    return (nodes = smartnodes.Count(nProtocolVersion));
 }
 
 int CSmartnodeMan::CountEnabled(int nProtocolVersion)
@@ -395,15 +491,9 @@ int CSmartnodeMan::CountEnabled(int nProtocolVersion)
     TRY_LOCK(cs,locked);
     if( !locked ) return enabled;
 
-    int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinSmartnodePaymentsProto() : nProtocolVersion;
 
-    for (auto& mnpair : mapSmartnodes) {
-        if(mnpair.second.nProtocolVersion < nProtocolVersion || !mnpair.second.IsEnabled()) continue;
-        nCount++;
-    }
-
-    return (enabled = nCount);
+    return (enabled = smartnodes.Count(nProtocolVersion, CSmartnode::SMARTNODE_ENABLED));
 }
 
 void CSmartnodeMan::CountStates(std::map<std::string,int64_t> &mapStates)
@@ -412,8 +502,8 @@ void CSmartnodeMan::CountStates(std::map<std::string,int64_t> &mapStates)
 
     mapStates.clear();
 
-    for (auto& mnpair : mapSmartnodes) {
-        mapStates[mnpair.second.GetStatus()]++;
+    for (const auto& stateCount : smartnodes.CountByState()) {
+        mapStates[CSmartnode::StateToString(stateCount.first)] += stateCount.second;
     }
 }
 
@@ -423,10 +513,10 @@ int CSmartnodeMan::CountByIP(int nNetworkType)
     LOCK(cs);
     int nNodeCount = 0;
 
-    for (auto& mnpair : mapSmartnodes)
-        if ((nNetworkType == NET_IPV4 && mnpair.second.addr.IsIPv4()) ||
-            (nNetworkType == NET_TOR  && mnpair.second.addr.IsTor())  ||
-            (nNetworkType == NET_IPV6 && mnpair.second.addr.IsIPv6())) {
+    for (auto& mn : smartnodes)
+        if ((nNetworkType == NET_IPV4 && mn.addr.IsIPv4()) ||
+            (nNetworkType == NET_TOR  && mn.addr.IsTor())  ||
+            (nNetworkType == NET_IPV6 && mn.addr.IsIPv6())) {
                 nNodeCount++;
         }
 
@@ -464,63 +554,65 @@ void CSmartnodeMan::DsegUpdate(CNode* pnode, CConnman& connman)
 CSmartnode* CSmartnodeMan::Find(const COutPoint &outpoint)
 {
     LOCK(cs);
-    auto it = mapSmartnodes.find(outpoint);
-    return it == mapSmartnodes.end() ? NULL : &(it->second);
+    return smartnodes.Find(outpoint);
 }
 
 bool CSmartnodeMan::Get(const COutPoint& outpoint, CSmartnode& smartnodeRet)
 {
     // Theses mutexes are recursive so double locking by the same thread is safe.
     LOCK(cs);
-    auto it = mapSmartnodes.find(outpoint);
-    if (it == mapSmartnodes.end()) {
+    CSmartnode* pmn = smartnodes.Find(outpoint);
+    if (!pmn) {
         return false;
     }
 
-    smartnodeRet = it->second;
+    smartnodeRet = *pmn;
     return true;
 }
 
 bool CSmartnodeMan::GetSmartnodeInfo(const COutPoint& outpoint, smartnode_info_t& mnInfoRet)
 {
     LOCK(cs);
-    auto it = mapSmartnodes.find(outpoint);
-    if (it == mapSmartnodes.end()) {
+    CSmartnode* pmn = smartnodes.Find(outpoint);
+    if (!pmn) {
         return false;
     }
-    mnInfoRet = it->second.GetInfo();
+    mnInfoRet = pmn->GetInfo();
     return true;
 }
 
 bool CSmartnodeMan::GetSmartnodeInfo(const CPubKey& pubKeySmartnode, smartnode_info_t& mnInfoRet)
 {
     LOCK(cs);
-    for (auto& mnpair : mapSmartnodes) {
-        if (mnpair.second.pubKeySmartnode == pubKeySmartnode) {
-            mnInfoRet = mnpair.second.GetInfo();
-            return true;
-        }
+    CSmartnode* pmn = smartnodes.FindByPubKey(pubKeySmartnode);
+    if (!pmn) {
+        return false;
     }
-    return false;
+    mnInfoRet = pmn->GetInfo();
+    return true;
 }
 
 bool CSmartnodeMan::GetSmartnodeInfo(const CScript& payee, smartnode_info_t& mnInfoRet)
 {
+    // Smartnodes are paid to the P2PKH script of their collateral key
+    CTxDestination dest;
+    if (!ExtractDestination(payee, dest) || !boost::get<CKeyID>(&dest) || GetScriptForDestination(dest) != payee) {
+        return false;
+    }
+
     LOCK(cs);
-    for (auto& mnpair : mapSmartnodes) {
-        CScript scriptCollateralAddress = GetScriptForDestination(mnpair.second.pubKeyCollateralAddress.GetID());
-        if (scriptCollateralAddress == payee) {
-            mnInfoRet = mnpair.second.GetInfo();
-            return true;
-        }
+    CSmartnode* pmn = smartnodes.FindByCollateral(boost::get<CKeyID>(dest));
+    if (!pmn) {
+        return false;
     }
-    return false;
+    mnInfoRet = pmn->GetInfo();
+    return true;
 }
 
 bool CSmartnodeMan::Has(const COutPoint& outpoint)
 {
     LOCK(cs);
-    return mapSmartnodes.find(outpoint) != mapSmartnodes.end();
+    return smartnodes.Find(outpoint) != NULL;
 }
 
 //
@@ -544,7 +636,7 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     // Need LOCK2 here to ensure consistent locking order because the GetBlockHash call below locks cs_main
     LOCK2(cs_main,cs);
 
-    std::vector<std::pair<int, CSmartnode*> > vecSmartnodeLastPaid;
+    std::vector<CSmartnode*> vecSmartnodeLastPaid;
 
     /*
         Make a vector with all of the last paid times
@@ -557,23 +649,25 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     if( !nPayoutsPerBlock ) nPayoutsPerBlock = 1;
 
     int nMnCount = CountSmartnodes();
+    int nMinProtocol = mnpayments.GetMinSmartnodePaymentsProto();
 
-    for (auto& mnpair : mapSmartnodes) {
-        if(!mnpair.second.IsValidForPayment()) continue;
+    // The payment queue holds the smartnodes valid for payment, sorted low to high by last paid block
+    for (const auto& queued : smartnodes.GetPaymentQueue()) {
+        CSmartnode* pmn = smartnodes.Find(queued.second);
 
         //check protocol version
-        if(mnpair.second.nProtocolVersion < mnpayments.GetMinSmartnodePaymentsProto()) continue;
+        if(pmn->nProtocolVersion < nMinProtocol) continue;
 
         //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mnpair.second, nBlockHeight)) continue;
+        if(mnpayments.IsScheduled(*pmn, nBlockHeight)) continue;
 
         //it's too new, wait for a cycle
-        if(fFilterSigTime && mnpair.second.sigTime + int(nMnCount * 55 /  ( double( nPayoutsPerBlock ) / nPayoutInterval ) ) > GetAdjustedTime()) continue;
+        if(fFilterSigTime && pmn->sigTime + int(nMnCount * 55 /  ( double( nPayoutsPerBlock ) / nPayoutInterval ) ) > GetAdjustedTime()) continue;
 
         //make sure it has at least as many confirmations as the smartnode cycle time
-        if(GetUTXOConfirmations(mnpair.first) < int(nMnCount / ( double( nPayoutsPerBlock ) / nPayoutInterval ) ) ) continue;
+        if(GetUTXOConfirmations(queued.second) < int(nMnCount / ( double( nPayoutsPerBlock ) / nPayoutInterval ) ) ) continue;
 
-        vecSmartnodeLastPaid.push_back(std::make_pair(mnpair.second.GetLastPaidBlock(), &mnpair.second));
+        vecSmartnodeLastPaid.push_back(pmn);
     }
 
     nCountRet = (int)vecSmartnodeLastPaid.size();
@@ -582,9 +676,6 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     if(fFilterSigTime && nCountRet < nMnCount/3)
         return GetNextSmartnodesInQueueForPayment(nBlockHeight, false, nCountRet, mnInfoRet);
 
-    // Sort them low to high
-    sort(vecSmartnodeLastPaid.begin(), vecSmartnodeLastPaid.end(), CompareLastPaidBlock());
-
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
         LogPrintf("CSmartnode::GetNextSmartnodesInQueueForPayment -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight - 101);
@@ -599,9 +690,9 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
 
     std::vector<std::pair<arith_uint256, CSmartnode*>> vecTopTenthScores;
 
-    for (const auto& s : vecSmartnodeLastPaid) {
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
-        vecTopTenthScores.push_back(std::make_pair(nScore,s.second));
+    for (CSmartnode* pmn : vecSmartnodeLastPaid) {
+        arith_uint256 nScore = pmn->CalculateScore(blockHash);
+        vecTopTenthScores.push_back(std::make_pair(nScore, pmn));
         nCountTenth++;
         if(nCountTenth >= nTenthNetwork) break;
     }
@@ -632,13 +723,13 @@ bool CSmartnodeMan::GetSmartnodeScores(const uint256& nBlockHash, CSmartnodeMan:
 
     AssertLockHeld(cs);
 
-    if (mapSmartnodes.empty())
+    if (smartnodes.empty())
         return false;
 
     // calculate scores
-    for (auto& mnpair : mapSmartnodes) {
-        if (mnpair.second.nProtocolVersion >= nMinProtocol) {
-            vecSmartnodeScoresRet.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
+    for (auto& mn : smartnodes) {
+        if (mn.nProtocolVersion >= nMinProtocol) {
+            vecSmartnodeScoresRet.push_back(std::make_pair(mn.CalculateScore(nBlockHash), &mn));
         }
     }
 
@@ -838,6 +929,7 @@ void CSmartnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         if(mapSeenSmartnodePing.count(nHash)) return; //seen
         mapSeenSmartnodePing.insert(std::make_pair(nHash, mnp));
+        setJournalPings.insert(nHash);
 
         LogPrint("smartnode", "MNPING -- Smartnode ping, smartnode=%s new\n", mnp.outpoint.ToStringShort());
 
@@ -848,7 +940,9 @@ void CSmartnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         if(pmn && pmn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
+        bool fUpdated = mnp.CheckAndUpdate(pmn, false, nDos, connman);
+        if(pmn) smartnodes.Update(pmn);
+        if(fUpdated) return;
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -918,13 +1012,13 @@ void CSmartnodeMan::SyncSingle(CNode* pnode, const COutPoint& outpoint, CConnman
 
     LOCK(cs);
 
-    auto it = mapSmartnodes.find(outpoint);
+    CSmartnode* pmn = smartnodes.Find(outpoint);
 
-    if(it != mapSmartnodes.end()) {
-        if (it->second.addr.IsRFC1918() || (MainNet() && it->second.addr.IsLocal())) return; // do not send local network masternode
+    if(pmn) {
+        if (pmn->addr.IsRFC1918() || (MainNet() && pmn->addr.IsLocal())) return; // do not send local network masternode
         // NOTE: send masternode regardless of its current state, the other node will need it to verify old votes.
-        LogPrint("smartnode", "CSmartnodeMan::%s -- Sending Smartnode entry: smartnode=%s  addr=%s\n", __func__, outpoint.ToStringShort(), it->second.addr.ToString());
-        PushDsegInvs(pnode, it->second);
+        LogPrint("smartnode", "CSmartnodeMan::%s -- Sending Smartnode entry: smartnode=%s  addr=%s\n", __func__, outpoint.ToStringShort(), pmn->addr.ToString());
+        PushDsegInvs(pnode, *pmn);
         LogPrintf("CSmartnodeMan::%s -- Sent 1 Smartnode inv to peer=%d\n", __func__, pnode->id);
     }
 }
@@ -955,11 +1049,11 @@ void CSmartnodeMan::SyncAll(CNode* pnode, CConnman& connman)
 
     LOCK(cs);
 
-    for (const auto& mnpair : mapSmartnodes) {
-        if (mnpair.second.addr.IsRFC1918() || ( MainNet() && mnpair.second.addr.IsLocal())) continue; // do not send local network masternode
+    for (const auto& mn : smartnodes) {
+        if (mn.addr.IsRFC1918() || ( MainNet() && mn.addr.IsLocal())) continue; // do not send local network masternode
         // NOTE: send masternode regardless of its current state, the other node will need it to verify old votes.
-        LogPrint("smartnode", "CSmartnodeMan::%s -- Sending Smartnode entry: smartnode=%s  addr=%s\n", __func__, mnpair.first.ToStringShort(), mnpair.second.addr.ToString());
-        PushDsegInvs(pnode, mnpair.second);
+        LogPrint("smartnode", "CSmartnodeMan::%s -- Sending Smartnode entry: smartnode=%s  addr=%s\n", __func__, mn.vin.prevout.ToStringShort(), mn.addr.ToString());
+        PushDsegInvs(pnode, mn);
         nInvCount++;
     }
 
@@ -979,6 +1073,8 @@ void CSmartnodeMan::PushDsegInvs(CNode* pnode, const CSmartnode& mn)
     pnode->PushInventory(CInv(MSG_SMARTNODE_PING, hashMNP));
     mapSeenSmartnodeBroadcast.insert(std::make_pair(hashMNB, std::make_pair(GetTime(), mnb)));
     mapSeenSmartnodePing.insert(std::make_pair(hashMNP, mnp));
+    setJournalBroadcasts.insert(hashMNB);
+    setJournalPings.insert(hashMNP);
 }
 
 // Verification of smartnodes via unique direct requests.
@@ -1025,12 +1121,7 @@ void CSmartnodeMan::DoFullVerificationStep(CConnman& connman)
     int nOffset = MAX_POSE_RANK + nMyRank - 1;
     if(nOffset >= (int)vecSmartnodeRanks.size()) return;
 
-    std::vector<CSmartnode*> vSortedByAddr;
-    for (auto& mnpair : mapSmartnodes) {
-        vSortedByAddr.push_back(&mnpair.second);
-    }
-
-    sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
+    std::vector<CSmartnode*> vSortedByAddr = smartnodes.GetSortedByAddr();
 
     it = vecSmartnodeRanks.begin() + nOffset;
     while(it != vecSmartnodeRanks.end()) {
@@ -1066,22 +1157,19 @@ void CSmartnodeMan::DoFullVerificationStep(CConnman& connman)
 
 void CSmartnodeMan::CheckSameAddr()
 {
-    if(!smartnodeSync.IsSynced() || mapSmartnodes.empty() || Params().NetworkIDString() == CBaseChainParams::TESTNET) return;
+    if(!smartnodeSync.IsSynced() || Params().NetworkIDString() == CBaseChainParams::TESTNET) return;
 
     std::vector<CSmartnode*> vBan;
-    std::vector<CSmartnode*> vSortedByAddr;
 
     {
         LOCK(cs);
 
+        if(smartnodes.empty()) return;
+
         CSmartnode* pprevSmartnode = NULL;
         CSmartnode* pverifiedSmartnode = NULL;
 
-        for (auto& mnpair : mapSmartnodes) {
-            vSortedByAddr.push_back(&mnpair.second);
-        }
-
-        sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
+        std::vector<CSmartnode*> vSortedByAddr = smartnodes.GetSortedByAddr();
 
         BOOST_FOREACH(CSmartnode* pmn, vSortedByAddr) {
             // check only (pre)enabled smartnodes
@@ -1108,12 +1196,13 @@ void CSmartnodeMan::CheckSameAddr()
             }
             pprevSmartnode = pmn;
         }
-    }
 
-    // ban duplicates
-    BOOST_FOREACH(CSmartnode* pmn, vBan) {
-        LogPrintf("CSmartnodeMan::CheckSameAddr -- increasing PoSe ban score for smartnode %s\n", pmn->vin.prevout.ToStringShort());
-        pmn->IncreasePoSeBanScore();
+        // ban duplicates, while the pointers are still valid
+        BOOST_FOREACH(CSmartnode* pmn, vBan) {
+            LogPrintf("CSmartnodeMan::CheckSameAddr -- increasing PoSe ban score for smartnode %s\n", pmn->vin.prevout.ToStringShort());
+            pmn->IncreasePoSeBanScore();
+            smartnodes.SetChanged(pmn);
+        }
     }
 }
 
@@ -1255,44 +1344,43 @@ void CSmartnodeMan::ProcessVerifyReply(CNode* pnode, CSmartnodeVerification& mnv
         std::vector<CSmartnode*> vpSmartnodesToBan;
         std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(false), mnv.nonce, blockHash.ToString());
 
-        for (auto& mnpair : mapSmartnodes) {
-            if(CAddress(mnpair.second.addr, NODE_NETWORK) == pnode->addr) {
-                if(CMessageSigner::VerifyMessage(mnpair.second.pubKeySmartnode, mnv.vchSig1, strMessage1, strError)) {
-                    // found it!
-                    prealSmartnode = &mnpair.second;
-                    if(!mnpair.second.IsPoSeVerified()) {
-                        mnpair.second.DecreasePoSeBanScore();
-                    }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
-
-                    // we can only broadcast it if we are an activated smartnode
-                    if(activeSmartnode.outpoint == COutPoint()) continue;
-                    // update ...
-                    mnv.addr = mnpair.second.addr;
-                    mnv.vin1 = mnpair.second.vin;
-                    mnv.vin2 = CTxIn(activeSmartnode.outpoint);
-                    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
-                                            mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
-                    // ... and sign it
-                    if(!CMessageSigner::SignMessage(strMessage2, mnv.vchSig2, activeSmartnode.keySmartnode)) {
-                        LogPrintf("SmartnodeMan::ProcessVerifyReply -- SignMessage() failed\n");
-                        return;
-                    }
+        BOOST_FOREACH(CSmartnode* pmn, smartnodes.FindByAddr(pnode->addr)) {
+            if(CMessageSigner::VerifyMessage(pmn->pubKeySmartnode, mnv.vchSig1, strMessage1, strError)) {
+                // found it!
+                prealSmartnode = pmn;
+                if(!pmn->IsPoSeVerified()) {
+                    pmn->DecreasePoSeBanScore();
+                    smartnodes.SetChanged(pmn);
+                }
+                netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
+
+                // we can only broadcast it if we are an activated smartnode
+                if(activeSmartnode.outpoint == COutPoint()) continue;
+                // update ...
+                mnv.addr = pmn->addr;
+                mnv.vin1 = pmn->vin;
+                mnv.vin2 = CTxIn(activeSmartnode.outpoint);
+                std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
+                                        mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+                // ... and sign it
+                if(!CMessageSigner::SignMessage(strMessage2, mnv.vchSig2, activeSmartnode.keySmartnode)) {
+                    LogPrintf("SmartnodeMan::ProcessVerifyReply -- SignMessage() failed\n");
+                    return;
+                }
 
-                    std::string strError;
+                std::string strError;
 
-                    if(!CMessageSigner::VerifyMessage(activeSmartnode.pubKeySmartnode, mnv.vchSig2, strMessage2, strError)) {
-                        LogPrintf("SmartnodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
-                        return;
-                    }
+                if(!CMessageSigner::VerifyMessage(activeSmartnode.pubKeySmartnode, mnv.vchSig2, strMessage2, strError)) {
+                    LogPrintf("SmartnodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
+                    return;
+                }
 
-                    mWeAskedForVerification[pnode->addr] = mnv;
-                    mapSeenSmartnodeVerification.insert(std::make_pair(mnv.GetHash(), mnv));
-                    mnv.Relay();
+                mWeAskedForVerification[pnode->addr] = mnv;
+                mapSeenSmartnodeVerification.insert(std::make_pair(mnv.GetHash(), mnv));
+                mnv.Relay();
 
-                } else {
-                    vpSmartnodesToBan.push_back(&mnpair.second);
-                }
+            } else {
+                vpSmartnodesToBan.push_back(pmn);
             }
         }
         // no real smartnode found?...
@@ -1308,6 +1396,7 @@ void CSmartnodeMan::ProcessVerifyReply(CNode* pnode, CSmartnodeVerification& mnv
         // increase ban score for everyone else
         BOOST_FOREACH(CSmartnode* pmn, vpSmartnodesToBan) {
             pmn->IncreasePoSeBanScore();
+            smartnodes.SetChanged(pmn);
             LogPrint("smartnode", "CSmartnodeMan::ProcessVerifyReply -- increased PoSe ban score for %s addr %s, new score %d\n",
                         prealSmartnode->vin.prevout.ToStringShort(), pnode->addr.ToString(), pmn->nPoSeBanScore);
         }
@@ -1418,12 +1507,12 @@ void CSmartnodeMan::ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerific
 
             // increase ban score for everyone else with the same addr
             int nCount = 0;
-            for (auto& mnpair : mapSmartnodes) {
-                 if(mnpair.second.addr != mnv.addr || mnpair.first == mnv.vin1.prevout) continue;
-                 mnpair.second.IncreasePoSeBanScore();
+            BOOST_FOREACH(CSmartnode* pmn, smartnodes.FindByAddr(mnv.addr)) {
+                 if(pmn->vin.prevout == mnv.vin1.prevout) continue;
+                 pmn->IncreasePoSeBanScore();
                  nCount++;
                  LogPrint("smartnode", "CSmartnodeMan::ProcessVerifyBroadcast -- SAPI failed PoSe score increased for %s addr %s, new score %d\n",
-                             mnpair.first.ToStringShort(), mnpair.second.addr.ToString(), mnpair.second.nPoSeBanScore);
+                             pmn->vin.prevout.ToStringShort(), pmn->addr.ToString(), pmn->nPoSeBanScore);
              }
              if(nCount)
                  LogPrintf("CSmartnodeMan::ProcessVerifyBroadcast -- SAPI failed -- PoSe score increased for %d fake smartnodes, addr %s\n",
@@ -1437,6 +1526,7 @@ void CSmartnodeMan::ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerific
 */
         if(!pmn1->IsPoSeVerified()) {
             pmn1->DecreasePoSeBanScore();
+            smartnodes.SetChanged(pmn1);
         }
 
         mnv.Relay();
@@ -1446,12 +1536,13 @@ void CSmartnodeMan::ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerific
 
         // increase ban score for everyone else with the same addr
         int nCount = 0;
-        for (auto& mnpair : mapSmartnodes) {
-            if(mnpair.second.addr != mnv.addr || mnpair.first == mnv.vin1.prevout) continue;
-            mnpair.second.IncreasePoSeBanScore();
+        BOOST_FOREACH(CSmartnode* pmn, smartnodes.FindByAddr(mnv.addr)) {
+            if(pmn->vin.prevout == mnv.vin1.prevout) continue;
+            pmn->IncreasePoSeBanScore();
+            smartnodes.SetChanged(pmn);
             nCount++;
             LogPrint("smartnode", "CSmartnodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
-                        mnpair.first.ToStringShort(), mnpair.second.addr.ToString(), mnpair.second.nPoSeBanScore);
+                        pmn->vin.prevout.ToStringShort(), pmn->addr.ToString(), pmn->nPoSeBanScore);
         }
         if(nCount)
             LogPrintf("CSmartnodeMan::ProcessVerifyBroadcast -- PoSe score increased for %d fake smartnodes, addr %s\n",
@@ -1463,7 +1554,7 @@ std::string CSmartnodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Smartnodes: " << (int)mapSmartnodes.size() <<
+    info << "Smartnodes: " << (int)smartnodes.size() <<
             ", peers who asked us for Smartnode list: " << (int)mAskedUsForSmartnodeList.size() <<
             ", peers we asked for Smartnode list: " << (int)mWeAskedForSmartnodeList.size() <<
             ", entries in Smartnode list we asked for: " << (int)mWeAskedForSmartnodeListEntry.size() <<
@@ -1477,6 +1568,8 @@ void CSmartnodeMan::UpdateSmartnodeList(CSmartnodeBroadcast mnb, CConnman& connm
     LOCK2(cs_main, cs);
     mapSeenSmartnodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
     mapSeenSmartnodeBroadcast.insert(std::make_pair(mnb.GetHash(), std::make_pair(GetTime(), mnb)));
+    setJournalPings.insert(mnb.lastPing.GetHash());
+    setJournalBroadcasts.insert(mnb.GetHash());
 
     LogPrintf("CSmartnodeMan::UpdateSmartnodeList -- smartnode=%s  addr=%s\n", mnb.vin.prevout.ToStringShort(), mnb.addr.ToString());
 
@@ -1486,10 +1579,15 @@ void CSmartnodeMan::UpdateSmartnodeList(CSmartnodeBroadcast mnb, CConnman& connm
             smartnodeSync.BumpAssetLastTime("CSmartnodeMan::UpdateSmartnodeList - new");
         }
     } else {
-        CSmartnodeBroadcast mnbOld = mapSeenSmartnodeBroadcast[CSmartnodeBroadcast(*pmn).GetHash()].second;
-        if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
+        uint256 hashOld = CSmartnodeBroadcast(*pmn).GetHash();
+        CSmartnodeBroadcast mnbOld = mapSeenSmartnodeBroadcast[hashOld].second;
+        setJournalBroadcasts.insert(hashOld);
+        bool fUpdated = pmn->UpdateFromNewBroadcast(mnb, connman);
+        smartnodes.Update(pmn);
+        if(fUpdated) {
             smartnodeSync.BumpAssetLastTime("CSmartnodeMan::UpdateSmartnodeList - seen");
             mapSeenSmartnodeBroadcast.erase(mnbOld.GetHash());
+            setJournalBroadcasts.insert(mnbOld.GetHash());
         }
     }
 }
@@ -1510,6 +1608,7 @@ bool CSmartnodeMan::CheckMnbAndUpdateSmartnodeList(CNode* pfrom, CSmartnodeBroad
             if(GetTime() - mapSeenSmartnodeBroadcast[hash].first > SMARTNODE_NEW_START_REQUIRED_SECONDS - SMARTNODE_MIN_MNP_SECONDS * 2) {
                 LogPrint("smartnode", "CSmartnodeMan::CheckMnbAndUpdateSmartnodeList -- smartnode=%s seen update\n", mnb.vin.prevout.ToStringShort());
                 mapSeenSmartnodeBroadcast[hash].first = GetTime();
+                setJournalBroadcasts.insert(hash);
                 smartnodeSync.BumpAssetLastTime("CSmartnodeMan::CheckMnbAndUpdateSmartnodeList - seen");
             }
             // did we ask this node for it?
@@ -1536,6 +1635,7 @@ bool CSmartnodeMan::CheckMnbAndUpdateSmartnodeList(CNode* pfrom, CSmartnodeBroad
             return true;
         }
         mapSeenSmartnodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
+        setJournalBroadcasts.insert(hash);
 
         LogPrint("smartnode", "CSmartnodeMan::CheckMnbAndUpdateSmartnodeList -- smartnode=%s new\n", mnb.vin.prevout.ToStringShort());
 
@@ -1547,13 +1647,18 @@ bool CSmartnodeMan::CheckMnbAndUpdateSmartnodeList(CNode* pfrom, CSmartnodeBroad
         // search Smartnode list
         CSmartnode* pmn = Find(mnb.vin.prevout);
         if(pmn) {
-            CSmartnodeBroadcast mnbOld = mapSeenSmartnodeBroadcast[CSmartnodeBroadcast(*pmn).GetHash()].second;
-            if(!mnb.Update(pmn, nDos, connman)) {
+            uint256 hashOld = CSmartnodeBroadcast(*pmn).GetHash();
+            CSmartnodeBroadcast mnbOld = mapSeenSmartnodeBroadcast[hashOld].second;
+            setJournalBroadcasts.insert(hashOld);
+            bool fUpdated = mnb.Update(pmn, nDos, connman);
+            smartnodes.Update(pmn);
+            if(!fUpdated) {
                 LogPrint("smartnode", "CSmartnodeMan::CheckMnbAndUpdateSmartnodeList -- Update() failed, smartnode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
             if(hash != mnbOld.GetHash()) {
                 mapSeenSmartnodeBroadcast.erase(mnbOld.GetHash());
+                setJournalBroadcasts.insert(mnbOld.GetHash());
             }
             return true;
         }
@@ -1590,7 +1695,7 @@ void CSmartnodeMan::UpdateLastPaid(const CBlockIndex* pindex)
 {
     LOCK(cs);
 
-    if(fLiteMode || !smartnodeSync.IsWinnersListSynced() || mapSmartnodes.empty()) return;
+    if(fLiteMode || !smartnodeSync.IsWinnersListSynced() || smartnodes.empty()) return;
 
     static bool IsFirstRun = true;
     // Do full scan on first run or if we are not a smartnode
@@ -1600,8 +1705,9 @@ void CSmartnodeMan::UpdateLastPaid(const CBlockIndex* pindex)
     // LogPrint("mnpayments", "CSmartnodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
     //                         nCachedBlockHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
-    for (auto& mnpair: mapSmartnodes) {
-        mnpair.second.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+    for (auto& mn : smartnodes) {
+        mn.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+        smartnodes.Update(&mn);
     }
 
     IsFirstRun = false;
@@ -1615,6 +1721,7 @@ void CSmartnodeMan::UpdateWatchdogVoteTime(const COutPoint& outpoint, uint64_t n
         return;
     }
     pmn->UpdateWatchdogVoteTime(nVoteTime);
+    smartnodes.SetChanged(pmn);
     nLastWatchdogVoteTime = GetTime();
 }
 
@@ -1633,25 +1740,27 @@ bool CSmartnodeMan::AddGovernanceVote(const COutPoint& outpoint, uint256 nGovern
         return false;
     }
     pmn->AddGovernanceVote(nGovernanceObjectHash);
+    smartnodes.SetChanged(pmn);
     return true;
 }
 
 void CSmartnodeMan::RemoveGovernanceObject(uint256 nGovernanceObjectHash)
 {
     LOCK(cs);
-    for(auto& mnpair : mapSmartnodes) {
-        mnpair.second.RemoveGovernanceObject(nGovernanceObjectHash);
+    for(auto& mn : smartnodes) {
+        if(!mn.mapGovernanceObjectsVotedOn.count(nGovernanceObjectHash)) continue;
+        mn.RemoveGovernanceObject(nGovernanceObjectHash);
+        smartnodes.SetChanged(&mn);
     }
 }
 
 void CSmartnodeMan::CheckSmartnode(const CPubKey& pubKeySmartnode, bool fForce)
 {
     LOCK2(cs_main, cs);
-    for (auto& mnpair : mapSmartnodes) {
-        if (mnpair.second.pubKeySmartnode == pubKeySmartnode) {
-            mnpair.second.Check(fForce);
-            return;
-        }
+    CSmartnode* pmn = smartnodes.FindByPubKey(pubKeySmartnode);
+    if (pmn) {
+        pmn->Check(fForce);
+        smartnodes.Update(pmn);
     }
 }
 
@@ -1670,13 +1779,16 @@ void CSmartnodeMan::SetSmartnodeLastPing(const COutPoint& outpoint, const CSmart
         return;
     }
     pmn->lastPing = mnp;
+    smartnodes.Update(pmn);
 
     mapSeenSmartnodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+    setJournalPings.insert(mnp.GetHash());
 
     CSmartnodeBroadcast mnb(*pmn);
     uint256 hash = mnb.GetHash();
     if(mapSeenSmartnodeBroadcast.count(hash)) {
         mapSeenSmartnodeBroadcast[hash].second.lastPing = mnp;
+        setJournalBroadcasts.insert(hash);
     }
 }
 
@@ -1712,7 +1824,15 @@ void CSmartnodeMan::NotifySmartnodeUpdates(CConnman& connman)
     //     governance.UpdateCachesAndClean();
     // }
 
-    LOCK(cs);
-    fSmartnodesAdded = false;
-    fSmartnodesRemoved = false;
+    CSmartnodeListDiff diff;
+    {
+        LOCK(cs);
+        fSmartnodesAdded = false;
+        fSmartnodesRemoved = false;
+        std::swap(diff, diffPending);
+    }
+
+    if(!diff.IsEmpty()) {
+        GetMainSignals().SmartnodeListChanged(diff);
+    }
 }
@@ -6,6 +6,8 @@
 #define SMARTNODEMAN_H
 
 #include "smartnode.h"
+#include "smartnoderegistry.h"
+#include "flat-database.h"
 #include "../sync.h"
 
 using namespace std;
@@ -16,6 +18,21 @@ struct CSmartNodeWinners;
 
 extern CSmartnodeMan mnodeman;
 
+/**
+ * Smartnodes added to and removed from the list since the last notification.
+ * An outpoint is in at most one of the lists, an added entry replaces one
+ * the listener may already know.
+ */
+struct CSmartnodeListDiff
+{
+    std::vector<smartnode_info_t> vecAdded;
+    std::vector<COutPoint> vecRemoved;
+
+    void Add(const smartnode_info_t& info);
+    void Remove(const COutPoint& outpoint);
+    bool IsEmpty() const { return vecAdded.empty() && vecRemoved.empty(); }
+};
+
 class CSmartnodeMan
 {
 public:
@@ -48,8 +65,8 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
-    // map to hold all MNs
-    std::map<COutPoint, CSmartnode> mapSmartnodes;
+    // all MNs, indexed by outpoint, keys, address, state and payment queue
+    CSmartnodeRegistry smartnodes;
     // who's asked for the Smartnode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForSmartnodeList;
     // who we asked for the Smartnode list and the last time
@@ -73,6 +90,17 @@ private:
     /// Set when smartnodes are removed, cleared when CSmartVotingManager is notified
     bool fSmartnodesRemoved;
 
+    /// List changes not yet sent to the validation interface listeners
+    CSmartnodeListDiff diffPending;
+
+    /// Seen broadcasts and pings changed since the last GetJournalChanges, the smartnodes track their own
+    std::set<uint256> setJournalBroadcasts;
+    std::set<uint256> setJournalPings;
+    /// Hash of the state record last handed to the journal
+    uint256 hashJournalState;
+    /// Set by Clear, the journal has to be rewritten as a whole
+    bool fJournalAll;
+
     std::vector<uint256> vecDirtyGovernanceObjectHashes;
 
     int64_t nLastWatchdogVoteTime;
@@ -83,6 +111,9 @@ private:
 
     bool GetSmartnodeScores(const uint256& nBlockHash, score_pair_vec_t& vecSmartnodeScoresRet, int nMinProtocol = 0);
 
+    /// The small maps and counters, serialized for the 's' journal record
+    flatdb_bytes_t GetJournalState() const;
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CSmartnodeBroadcast> > mapSeenSmartnodeBroadcast;
@@ -108,7 +139,7 @@ public:
             READWRITE(strVersion);
         }
 
-        READWRITE(mapSmartnodes);
+        READWRITE(smartnodes);
         READWRITE(mAskedUsForSmartnodeList);
         READWRITE(mWeAskedForSmartnodeList);
         READWRITE(mWeAskedForSmartnodeListEntry);
@@ -124,6 +155,15 @@ public:
         }
     }
 
+    /// Records for CJournaledFlatDB, the small maps and counters share one record
+    void GetJournalRecords(flatdb_records_t& mapRecords) const;
+    bool GetJournalChanges(flatdb_records_t& mapRecords, std::set<flatdb_bytes_t>& setErased);
+    void LoadJournalRecords(const flatdb_records_t& mapRecords);
+
+    /// Whoever changes mapSeenSmartnodeBroadcast or mapSeenSmartnodePing has to tell the journal
+    void SetSeenBroadcastChanged(const uint256& hash) { LOCK(cs); setJournalBroadcasts.insert(hash); }
+    void SetSeenPingChanged(const uint256& hash) { LOCK(cs); setJournalPings.insert(hash); }
+
     CSmartnodeMan();
 
     /// Add an entry
@@ -177,8 +217,8 @@ public:
     /// Same as above but use current block height
     bool GetNextSmartnodesInQueueForPayment(bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet);
 
-    /// Find a random entry
-    std::map<COutPoint, CSmartnode> GetFullSmartnodeMap() { return mapSmartnodes; }
+    /// The list of all smartnodes for RPC, SAPI and the GUI, shared until the next change
+    CSmartnodeListRef GetSmartnodeList() { LOCK(cs); return smartnodes.GetList(); }
 
     bool GetSmartnodeRanks(rank_pair_vec_t& vecSmartnodeRanksRet, int nBlockHeight = -1, int nMinProtocol = 0);
     bool GetSmartnodeRank(const COutPoint &outpoint, int& nRankRet, int nBlockHeight = -1, int nMinProtocol = 0);
@@ -198,7 +238,7 @@ public:
     void ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerification& mnv);
 
     /// Return the number of (unique) Smartnodes
-    int size() { return mapSmartnodes.size(); }
+    int size() { return smartnodes.size(); }
 
     std::string ToString() const;
 
@@ -21,10 +21,6 @@
 /** Object for who's going to get paid on which blocks */
 CSmartnodePayments mnpayments;
 
-CCriticalSection cs_vecPayees;
-CCriticalSection cs_mapSmartnodeBlocks;
-CCriticalSection cs_mapSmartnodePaymentVotes;
-
 struct CompareBlockPayees
 {
     bool operator()(const CSmartnodePayee& t1,
@@ -200,14 +196,75 @@ UniValue SmartNodePayments::GetPaymentBlockObject(int nBlockHeight)
 
 void CSmartnodePayments::Clear()
 {
-    LOCK2(cs_mapSmartnodeBlocks, cs_mapSmartnodePaymentVotes);
+    LOCK(cs);
     mapSmartnodeBlocks.clear();
     mapSmartnodePaymentVotes.clear();
+    mapVoteHeights.clear();
+    fJournalAll = true;
+}
+
+void CSmartnodePayments::GetJournalRecords(flatdb_records_t& mapRecords) const
+{
+    LOCK(cs);
+    AddFlatDBRecords(mapRecords, 'v', mapSmartnodePaymentVotes);
+    AddFlatDBRecords(mapRecords, 'b', mapSmartnodeBlocks);
+}
+
+bool CSmartnodePayments::GetJournalChanges(flatdb_records_t& mapRecords, std::set<flatdb_bytes_t>& setErased)
+{
+    LOCK(cs);
+
+    std::set<uint256> setVotes;
+    std::set<int> setBlocks;
+    setVotes.swap(setJournalVotes);
+    setBlocks.swap(setJournalBlocks);
+
+    if (fJournalAll) {
+        fJournalAll = false;
+        return false;
+    }
+
+    AddFlatDBChanges(mapRecords, setErased, 'v', mapSmartnodePaymentVotes, setVotes);
+    AddFlatDBChanges(mapRecords, setErased, 'b', mapSmartnodeBlocks, setBlocks);
+
+    return true;
+}
+
+void CSmartnodePayments::LoadJournalRecords(const flatdb_records_t& mapRecords)
+{
+    std::map<uint256, CSmartnodePaymentVote> mapVotes;
+    ReadFlatDBRecords(mapRecords, 'v', mapVotes);
+
+    LOCK(cs);
+    Clear();
+    ReadFlatDBRecords(mapRecords, 'b', mapSmartnodeBlocks);
+    for(const auto& vote : mapVotes) {
+        bool fInserted;
+        InsertVote(vote.first, vote.second, fInserted);
+    }
+
+    // What was just read is on disk already
+    setJournalVotes.clear();
+    setJournalBlocks.clear();
+    fJournalAll = false;
+}
+
+CSmartnodePaymentVote& CSmartnodePayments::InsertVote(const uint256& nHash, const CSmartnodePaymentVote& vote, bool& fInserted)
+{
+    AssertLockHeld(cs);
+
+    auto res = mapSmartnodePaymentVotes.emplace(nHash, vote);
+    fInserted = res.second;
+    if(fInserted) {
+        mapVoteHeights[vote.nBlockHeight].push_back(nHash);
+        setJournalVotes.insert(nHash);
+    }
+    return res.first->second;
 }
 
 bool CSmartnodePayments::UpdateLastVote(const CSmartnodePaymentVote& vote)
 {
-    LOCK(cs_mapSmartnodePaymentVotes);
+    LOCK(cs);
 
     const auto it = mapSmartnodesLastVote.find(vote.vinSmartnode.prevout);
     if (it != mapSmartnodesLastVote.end()) {
@@ -383,26 +440,29 @@ void CSmartnodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand, C
         // Ignore any payments messages until smartnode list is synced
         if(!smartnodeSync.IsSmartnodeListSynced()) return;
 
+        // Check the range first, votes are only stored for heights which expire
+        int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
+
+        if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight + MNPAYMENTS_FUTURE_VOTES * 2) {
+            LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
+            return;
+        }
+
         {
-            LOCK(cs_mapSmartnodePaymentVotes);
+            LOCK(cs);
 
-            auto res = mapSmartnodePaymentVotes.emplace(nHash, vote);
+            bool fInserted;
+            CSmartnodePaymentVote& voteStored = InsertVote(nHash, vote, fInserted);
 
             // Avoid processing same vote multiple times if it was already verified earlier
-            if(!res.second && res.first->second.IsVerified()) {
+            if(!fInserted && voteStored.IsVerified()) {
                 LogPrint("mnpayments", "SMARTNODEPAYMENTVOTE -- hash=%s, nBlockHeight=%d/%d seen\n",
                             nHash.ToString(), vote.nBlockHeight, nCachedBlockHeight);
                 return;
             }
 
-            res.first->second.MarkAsNotVerified();
-        }
-
-        int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
-
-        if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight + MNPAYMENTS_FUTURE_VOTES * 2) {
-            LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
-            return;
+            voteStored.MarkAsNotVerified();
+            setJournalVotes.insert(nHash);
         }
 
         std::string strError = "";
@@ -481,7 +541,7 @@ bool CSmartnodePaymentVote::Sign()
 
 bool CSmartnodePayments::GetBlockPayees(int nBlockHeight, CScriptVector& payees)
 {
-    LOCK(cs_mapSmartnodeBlocks);
+    LOCK(cs);
 
     auto it = mapSmartnodeBlocks.find(nBlockHeight);
     return it != mapSmartnodeBlocks.end() && it->second.GetBestPayees(payees);
@@ -491,10 +551,10 @@ bool CSmartnodePayments::GetBlockPayees(int nBlockHeight, CScriptVector& payees)
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 blocks of votes
 bool CSmartnodePayments::IsScheduled(CSmartnode& mn, int nNotBlockHeight)
 {
-    LOCK(cs_mapSmartnodeBlocks);
-
     if(!smartnodeSync.IsSmartnodeListSynced()) return false;
 
+    LOCK(cs);
+
     CScript mnpayee;
     mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
 
@@ -504,8 +564,9 @@ bool CSmartnodePayments::IsScheduled(CSmartnode& mn, int nNotBlockHeight)
     for(int64_t h = nCachedBlockHeight; h <= nCachedBlockHeight + MNPAYMENTS_FUTURE_VOTES + interval - 1; h++){
         interval = SmartNodePayments::PayoutInterval(h);
         if(h == nNotBlockHeight) continue;
-        if(mapSmartnodeBlocks.count(h) &&
-           mapSmartnodeBlocks[h].GetBestPayees(payees) &&
+        auto it = mapSmartnodeBlocks.find(h);
+        if(it != mapSmartnodeBlocks.end() &&
+           it->second.GetBestPayees(payees) &&
            std::find(payees.begin(),payees.end(), mnpayee) != payees.end() ) {
             return true;
         }
@@ -521,14 +582,19 @@ bool CSmartnodePayments::AddOrUpdatePaymentVote(const CSmartnodePaymentVote& vot
 
     uint256 nVoteHash = vote.GetHash();
 
-    if(HasVerifiedPaymentVote(nVoteHash)) return false;
+    LOCK(cs);
+
+    bool fInserted;
+    CSmartnodePaymentVote& voteStored = InsertVote(nVoteHash, vote, fInserted);
 
-    LOCK2(cs_mapSmartnodeBlocks, cs_mapSmartnodePaymentVotes);
+    if(!fInserted && voteStored.IsVerified()) return false;
 
-    mapSmartnodePaymentVotes[nVoteHash] = vote;
+    voteStored = vote;
+    setJournalVotes.insert(nVoteHash);
 
     auto it = mapSmartnodeBlocks.emplace(vote.nBlockHeight, CSmartnodeBlockPayees(vote.nBlockHeight)).first;
     it->second.AddPayees(vote);
+    setJournalBlocks.insert(vote.nBlockHeight);
 
     LogPrint("mnpayments", "CSmartnodePayments::AddOrUpdatePaymentVote -- added, nHeight=%d, hash=%s\n",it->second.nBlockHeight, nVoteHash.ToString());
 
@@ -536,17 +602,64 @@ bool CSmartnodePayments::AddOrUpdatePaymentVote(const CSmartnodePaymentVote& vot
 }
 
 
-bool CSmartnodePayments::HasVerifiedPaymentVote(uint256 hashIn)
+bool CSmartnodePayments::HasPaymentVote(const uint256& hashIn) const
+{
+    LOCK(cs);
+    return mapSmartnodePaymentVotes.count(hashIn);
+}
+
+bool CSmartnodePayments::HasVerifiedPaymentVote(const uint256& hashIn) const
 {
-    LOCK(cs_mapSmartnodePaymentVotes);
-    std::map<uint256, CSmartnodePaymentVote>::iterator it = mapSmartnodePaymentVotes.find(hashIn);
+    LOCK(cs);
+    auto it = mapSmartnodePaymentVotes.find(hashIn);
     return it != mapSmartnodePaymentVotes.end() && it->second.IsVerified();
 }
 
-void CSmartnodeBlockPayees::AddPayees(const CSmartnodePaymentVote& vote)
+bool CSmartnodePayments::GetVerifiedPaymentVote(const uint256& hashIn, CSmartnodePaymentVote& voteRet) const
+{
+    LOCK(cs);
+    auto it = mapSmartnodePaymentVotes.find(hashIn);
+    if(it == mapSmartnodePaymentVotes.end() || !it->second.IsVerified()) return false;
+    voteRet = it->second;
+    return true;
+}
+
+bool CSmartnodePayments::HasPaymentBlock(int nBlockHeight) const
+{
+    LOCK(cs);
+    return mapSmartnodeBlocks.count(nBlockHeight);
+}
+
+std::vector<CSmartnodePaymentVote> CSmartnodePayments::GetBlockVotes(int nBlockHeight) const
+{
+    LOCK(cs);
+
+    std::vector<CSmartnodePaymentVote> vecVotes;
+
+    auto itBlock = mapSmartnodeBlocks.find(nBlockHeight);
+    if(itBlock == mapSmartnodeBlocks.end()) return vecVotes;
+
+    for(const CSmartnodePayee& payee : itBlock->second.vecPayees) {
+        for(const uint256& hash : payee.GetVoteHashes()) {
+            auto it = mapSmartnodePaymentVotes.find(hash);
+            if(it != mapSmartnodePaymentVotes.end() && it->second.IsVerified()) {
+                vecVotes.push_back(it->second);
+            }
+        }
+    }
+
+    return vecVotes;
+}
+
+bool CSmartnodePayments::HasPayeeWithVotes(int nBlockHeight, const CScript& payeeIn, int nVotesReq)
 {
-    LOCK(cs_vecPayees);
+    LOCK(cs);
+    auto it = mapSmartnodeBlocks.find(nBlockHeight);
+    return it != mapSmartnodeBlocks.end() && it->second.HasPayeeWithVotes(payeeIn, nVotesReq);
+}
 
+void CSmartnodeBlockPayees::AddPayees(const CSmartnodePaymentVote& vote)
+{
     bool found;
 
     BOOST_FOREACH(const CScript& scriptPubKey, vote.payees)
@@ -571,8 +684,6 @@ void CSmartnodeBlockPayees::AddPayees(const CSmartnodePaymentVote& vote)
 
 bool CSmartnodeBlockPayees::GetBestPayees(CScriptVector& payeesRet)
 {
-    LOCK(cs_vecPayees);
-
     payeesRet.clear();
 
     size_t expectedPayees = SmartNodePayments::PayoutsPerBlock(nBlockHeight);
@@ -604,8 +715,6 @@ bool CSmartnodeBlockPayees::GetBestPayees(CScriptVector& payeesRet)
 
 bool CSmartnodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq)
 {
-    LOCK(cs_vecPayees);
-
     BOOST_FOREACH(CSmartnodePayee& payee, vecPayees) {
         if (payee.GetVoteCount() >= nVotesReq && payee.GetPayee() == payeeIn) {
             return true;
@@ -618,8 +727,6 @@ bool CSmartnodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, int nVotes
 
 bool CSmartnodeBlockPayees::IsTransactionValid(const CTransaction& txNew, CAmount expectedNodeReward)
 {
-    LOCK(cs_vecPayees);
-
     int foundPayees = 0;
     int foundMinVotes = 0;
     int expectedPayees =  SmartNodePayments::PayoutsPerBlock(nBlockHeight);
@@ -674,8 +781,6 @@ bool CSmartnodeBlockPayees::IsTransactionValid(const CTransaction& txNew, CAmoun
 
 std::string CSmartnodeBlockPayees::GetRequiredPaymentsString()
 {
-    LOCK(cs_vecPayees);
-
     std::string strRequiredPayments = "Unknown";
     int nInterval = SmartNodePayments::PayoutInterval(nBlockHeight);
     int nPayouts = SmartNodePayments::PayoutsPerBlock(nBlockHeight);
@@ -700,8 +805,6 @@ std::string CSmartnodeBlockPayees::GetRequiredPaymentsString()
 
 UniValue CSmartnodeBlockPayees::GetPaymentBlockObject()
 {
-    LOCK(cs_vecPayees);
-
     UniValue obj(UniValue::VOBJ);
     UniValue votes(UniValue::VOBJ);
 
@@ -762,10 +865,11 @@ std::string CSmartnodePayments::GetRequiredPaymentsString(int nHeight)
 
     if( !nInterval || nHeight % nInterval || !nPayouts ) return "NoRewardBlock";
 
-    LOCK(cs_mapSmartnodeBlocks);
+    LOCK(cs);
 
-    if(mapSmartnodeBlocks.count(nHeight)){
-        return mapSmartnodeBlocks[nHeight].GetRequiredPaymentsString();
+    auto it = mapSmartnodeBlocks.find(nHeight);
+    if(it != mapSmartnodeBlocks.end()){
+        return it->second.GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -778,10 +882,11 @@ UniValue CSmartnodePayments::GetPaymentBlockObject(int nHeight)
 
     if( !nInterval || nHeight % nInterval || !nPayouts ) return "NoRewardBlock";
 
-    LOCK(cs_mapSmartnodeBlocks);
+    LOCK(cs);
 
-    if(mapSmartnodeBlocks.count(nHeight)){
-        return mapSmartnodeBlocks[nHeight].GetPaymentBlockObject();
+    auto it = mapSmartnodeBlocks.find(nHeight);
+    if(it != mapSmartnodeBlocks.end()){
+        return it->second.GetPaymentBlockObject();
     }
 
     UniValue obj(UniValue::VOBJ);
@@ -796,10 +901,11 @@ UniValue CSmartnodePayments::GetPaymentBlockObject(int nHeight)
 
 bool CSmartnodePayments::IsTransactionValid(const CTransaction& txNew, int nBlockHeight, CAmount expectedNodeReward)
 {
-    LOCK(cs_mapSmartnodeBlocks);
+    LOCK(cs);
 
-    if(mapSmartnodeBlocks.count(nBlockHeight)){
-        return mapSmartnodeBlocks[nBlockHeight].IsTransactionValid(txNew, expectedNodeReward);
+    auto it = mapSmartnodeBlocks.find(nBlockHeight);
+    if(it != mapSmartnodeBlocks.end()){
+        return it->second.IsTransactionValid(txNew, expectedNodeReward);
     }
 
     return true;
@@ -809,22 +915,29 @@ void CSmartnodePayments::CheckAndRemove()
 {
     if(!smartnodeSync.IsSmartNodeSyncStarted()) return;
 
-    LOCK2(cs_mapSmartnodeBlocks, cs_mapSmartnodePaymentVotes);
-
     int nLimit = GetStorageLimit();
 
-    std::map<uint256, CSmartnodePaymentVote>::iterator it = mapSmartnodePaymentVotes.begin();
-    while(it != mapSmartnodePaymentVotes.end()) {
-        CSmartnodePaymentVote vote = (*it).second;
+    LOCK(cs);
 
-        if(nCachedBlockHeight - vote.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CSmartnodePayments::CheckAndRemove -- Removing old Smartnode payment: nBlockHeight=%d\n", vote.nBlockHeight);
-            mapSmartnodePaymentVotes.erase(it++);
-            mapSmartnodeBlocks.erase(vote.nBlockHeight);
-        } else {
-            ++it;
+    // Both maps are ordered by height, so only the expired heights are visited
+    int nFirstBlock = nCachedBlockHeight - nLimit;
+
+    auto it = mapVoteHeights.begin();
+    while(it != mapVoteHeights.end() && it->first < nFirstBlock) {
+        LogPrint("mnpayments", "CSmartnodePayments::CheckAndRemove -- Removing old Smartnode payments: nBlockHeight=%d, votes=%d\n", it->first, it->second.size());
+        for(const uint256& hash : it->second) {
+            mapSmartnodePaymentVotes.erase(hash);
+            setJournalVotes.insert(hash);
         }
+        mapVoteHeights.erase(it++);
     }
+
+    auto itBlockEnd = mapSmartnodeBlocks.lower_bound(nFirstBlock);
+    for(auto itBlock = mapSmartnodeBlocks.begin(); itBlock != itBlockEnd; ++itBlock) {
+        setJournalBlocks.insert(itBlock->first);
+    }
+    mapSmartnodeBlocks.erase(mapSmartnodeBlocks.begin(), itBlockEnd);
+
     LogPrintf("CSmartnodePayments::CheckAndRemove -- %s\n", ToString());
 }
 
@@ -1062,21 +1175,20 @@ std::string CSmartnodePaymentVote::ToString() const
 // Send only votes for future blocks, node should request every other missing payment block individually
 void CSmartnodePayments::Sync(CNode* pnode, CConnman& connman)
 {
-    LOCK(cs_mapSmartnodeBlocks);
-
     if(!smartnodeSync.IsWinnersListSynced()) return;
 
+    LOCK(cs);
+
     int nInvCount = 0;
 
-    for(int h = nCachedBlockHeight; h < nCachedBlockHeight + (MNPAYMENTS_FUTURE_VOTES * 2); h++) {
-        if(mapSmartnodeBlocks.count(h)) {
-            BOOST_FOREACH(CSmartnodePayee& payee, mapSmartnodeBlocks[h].vecPayees) {
-                std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
-                BOOST_FOREACH(uint256& hash, vecVoteHashes) {
-                    if(!HasVerifiedPaymentVote(hash)) continue;
-                    pnode->PushInventory(CInv(MSG_SMARTNODE_PAYMENT_VOTE, hash));
-                    nInvCount++;
-                }
+    auto itEnd = mapSmartnodeBlocks.lower_bound(nCachedBlockHeight + (MNPAYMENTS_FUTURE_VOTES * 2));
+    for(auto itBlock = mapSmartnodeBlocks.lower_bound(nCachedBlockHeight); itBlock != itEnd; ++itBlock) {
+        for(const CSmartnodePayee& payee : itBlock->second.vecPayees) {
+            for(const uint256& hash : payee.GetVoteHashes()) {
+                auto it = mapSmartnodePaymentVotes.find(hash);
+                if(it == mapSmartnodePaymentVotes.end() || !it->second.IsVerified()) continue;
+                pnode->PushInventory(CInv(MSG_SMARTNODE_PAYMENT_VOTE, hash));
+                nInvCount++;
             }
         }
     }
@@ -1090,10 +1202,11 @@ void CSmartnodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& con
 {
     if(!smartnodeSync.IsSmartnodeListSynced()) return;
 
-    LOCK2(cs_main, cs_mapSmartnodeBlocks);
+    int nLimit = GetStorageLimit();
+
+    LOCK2(cs_main, cs);
 
     std::vector<CInv> vToFetch;
-    int nLimit = GetStorageLimit();
 
     const CBlockIndex *pindex = chainActive.Tip();
 
@@ -1176,6 +1289,8 @@ std::string CSmartnodePayments::ToString() const
 {
     std::ostringstream info;
 
+    LOCK(cs);
+
     info << "Votes: " << (int)mapSmartnodePaymentVotes.size() <<
             ", Blocks: " << (int)mapSmartnodeBlocks.size();
 
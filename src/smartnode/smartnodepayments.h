@@ -10,8 +10,11 @@
 #include "../key.h"
 #include "../net_processing.h"
 #include "smartnode.h"
+#include "flat-database.h"
 #include "../utilstrencodings.h"
 
+#include <unordered_map>
+
 class CSmartnodePayments;
 class CSmartnodePaymentVote;
 class CSmartnodeBlockPayees;
@@ -21,10 +24,6 @@ static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
 static const int MNPAYMENTS_NO_RANK                     = INT_MAX;
 static const int MNPAYMENTS_FUTURE_VOTES                = 20;
 
-extern CCriticalSection cs_vecPayees;
-extern CCriticalSection cs_mapSmartnodeBlocks;
-extern CCriticalSection cs_mapSmartnodePayeeVotes;
-
 extern CSmartnodePayments mnpayments;
 
 namespace SmartNodePayments{
@@ -92,7 +91,7 @@ public:
     int GetVoteCount() const { return vecVoteHashes.size(); }
 };
 
-// Keep track of votes for payees from smartnodes
+// Keep track of votes for payees from smartnodes, guarded by the lock of CSmartnodePayments
 class CSmartnodeBlockPayees
 {
 public:
@@ -189,12 +188,17 @@ public:
     bool IsValid(CNode* pnode, int nValidationHeight, std::string& strError, CConnman& connman);
     void Relay(CConnman& connman);
 
-    bool IsVerified() { return !vchSig.empty(); }
+    bool IsVerified() const { return !vchSig.empty(); }
     void MarkAsNotVerified() { vchSig.clear(); }
 
     std::string ToString() const;
 };
 
+struct CPaymentVoteHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+
 //
 // Smartnode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -211,26 +215,67 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
-public:
-    std::map<uint256, CSmartnodePaymentVote> mapSmartnodePaymentVotes;
+    // protects the votes, the blocks and the vote heights
+    mutable CCriticalSection cs;
+
+    // All known votes by hash
+    std::unordered_map<uint256, CSmartnodePaymentVote, CPaymentVoteHasher> mapSmartnodePaymentVotes;
+    // Payees by block height
     std::map<int, CSmartnodeBlockPayees> mapSmartnodeBlocks;
+    // Hashes of the known votes by block height, expired heights are dropped from the front
+    std::map<int, std::vector<uint256> > mapVoteHeights;
+
+    // Votes and blocks changed since the last GetJournalChanges
+    std::set<uint256> setJournalVotes;
+    std::set<int> setJournalBlocks;
+    // Set by Clear, the journal has to be rewritten as a whole
+    bool fJournalAll;
+
+    /// Store a vote which is not known yet, returns the stored vote
+    CSmartnodePaymentVote& InsertVote(const uint256& nHash, const CSmartnodePaymentVote& vote, bool& fInserted);
+
+public:
     std::map<COutPoint, int> mapSmartnodesLastVote;
     std::map<COutPoint, int> mapSmartnodesDidNotVote;
 
-    CSmartnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000) {}
+    CSmartnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000), fJournalAll(true) {}
 
     ADD_SERIALIZE_METHODS
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        READWRITE(mapSmartnodePaymentVotes);
+        LOCK(cs);
+        std::map<uint256, CSmartnodePaymentVote> mapVotes;
+        if(!ser_action.ForRead()) {
+            mapVotes.insert(mapSmartnodePaymentVotes.begin(), mapSmartnodePaymentVotes.end());
+        }
+        READWRITE(mapVotes);
         READWRITE(mapSmartnodeBlocks);
+        if(ser_action.ForRead()) {
+            mapSmartnodePaymentVotes.clear();
+            mapVoteHeights.clear();
+            for(const auto& vote : mapVotes) {
+                bool fInserted;
+                InsertVote(vote.first, vote.second, fInserted);
+            }
+        }
     }
 
+    /// Records for CJournaledFlatDB, one per payment vote and per block
+    void GetJournalRecords(flatdb_records_t& mapRecords) const;
+    bool GetJournalChanges(flatdb_records_t& mapRecords, std::set<flatdb_bytes_t>& setErased);
+    void LoadJournalRecords(const flatdb_records_t& mapRecords);
+
     void Clear();
 
     bool AddOrUpdatePaymentVote(const CSmartnodePaymentVote& vote);
-    bool HasVerifiedPaymentVote(uint256 hashIn);
+    bool HasPaymentVote(const uint256& hashIn) const;
+    bool HasVerifiedPaymentVote(const uint256& hashIn) const;
+    bool GetVerifiedPaymentVote(const uint256& hashIn, CSmartnodePaymentVote& voteRet) const;
+    bool HasPaymentBlock(int nBlockHeight) const;
+    /// Verified votes of all payees of a block
+    std::vector<CSmartnodePaymentVote> GetBlockVotes(int nBlockHeight) const;
+    bool HasPayeeWithVotes(int nBlockHeight, const CScript& payeeIn, int nVotesReq);
     bool ProcessBlock(int nBlockHeight, CConnman& connman);
     void CheckPreviousBlockVotes(int nPrevBlockHeight);
 
@@ -251,8 +296,8 @@ public:
     void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutSmartNodes);
     std::string ToString() const;
 
-    int GetBlockCount() { return mapSmartnodeBlocks.size(); }
-    int GetVoteCount() { return mapSmartnodePaymentVotes.size(); }
+    int GetBlockCount() const { LOCK(cs); return mapSmartnodeBlocks.size(); }
+    int GetVoteCount() const { LOCK(cs); return mapSmartnodePaymentVotes.size(); }
 
     bool IsEnoughData();
     int GetStorageLimit();
@@ -0,0 +1,229 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "smartnoderegistry.h"
+
+#include <assert.h>
+
+CSmartnodeListEntry::CSmartnodeListEntry(const CSmartnode& mn) :
+    info(mn), nBlockLastPaid(mn.nBlockLastPaid),
+    nSentinelVersion(mn.lastPing.nSentinelVersion), fSentinelIsCurrent(mn.lastPing.fSentinelIsCurrent)
+{
+    info.nTimeLastPing = mn.lastPing.sigTime;
+    info.fInfoValid = true;
+}
+
+CSmartnodeRegistry::IndexedState::IndexedState(const CSmartnode& mn) :
+    nActiveState(mn.nActiveState), nProtocolVersion(mn.nProtocolVersion), addr(mn.addr),
+    keyIDSmartnode(mn.pubKeySmartnode.GetID()), keyIDCollateral(mn.pubKeyCollateralAddress.GetID()),
+    nBlockLastPaid(mn.nBlockLastPaid), nTimeLastPaid(mn.nTimeLastPaid), sigTime(mn.sigTime),
+    nTimeLastPing(mn.lastPing.sigTime), nSentinelVersion(mn.lastPing.nSentinelVersion),
+    fSentinelIsCurrent(mn.lastPing.fSentinelIsCurrent)
+{
+}
+
+bool CSmartnodeRegistry::IndexedState::operator==(const IndexedState& other) const
+{
+    return nActiveState == other.nActiveState &&
+           nProtocolVersion == other.nProtocolVersion &&
+           addr == other.addr &&
+           keyIDSmartnode == other.keyIDSmartnode &&
+           keyIDCollateral == other.keyIDCollateral &&
+           nBlockLastPaid == other.nBlockLastPaid &&
+           nTimeLastPaid == other.nTimeLastPaid &&
+           sigTime == other.sigTime &&
+           nTimeLastPing == other.nTimeLastPing &&
+           nSentinelVersion == other.nSentinelVersion &&
+           fSentinelIsCurrent == other.fSentinelIsCurrent;
+}
+
+template<typename K>
+static void EraseIndexEntry(std::multimap<K, COutPoint>& mapIndex, const K& key, const COutPoint& outpoint)
+{
+    auto range = mapIndex.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == outpoint) {
+            mapIndex.erase(it);
+            return;
+        }
+    }
+}
+
+void CSmartnodeRegistry::AddToIndexes(const IndexedState& indexed, const COutPoint& outpoint)
+{
+    mapByKeyIDSmartnode.emplace(indexed.keyIDSmartnode, outpoint);
+    mapByKeyIDCollateral.emplace(indexed.keyIDCollateral, outpoint);
+    mapByAddr.emplace(indexed.addr, outpoint);
+    mapCountByStateProtocol[std::make_pair(indexed.nActiveState, indexed.nProtocolVersion)]++;
+    // CSmartnode::IsValidForPayment
+    if (indexed.nActiveState == CSmartnode::SMARTNODE_ENABLED)
+        setPaymentQueue.insert(std::make_pair(indexed.nBlockLastPaid, outpoint));
+}
+
+void CSmartnodeRegistry::RemoveFromIndexes(const IndexedState& indexed, const COutPoint& outpoint)
+{
+    EraseIndexEntry(mapByKeyIDSmartnode, indexed.keyIDSmartnode, outpoint);
+    EraseIndexEntry(mapByKeyIDCollateral, indexed.keyIDCollateral, outpoint);
+    EraseIndexEntry(mapByAddr, indexed.addr, outpoint);
+    auto itCount = mapCountByStateProtocol.find(std::make_pair(indexed.nActiveState, indexed.nProtocolVersion));
+    assert(itCount != mapCountByStateProtocol.end());
+    if (--itCount->second == 0)
+        mapCountByStateProtocol.erase(itCount);
+    setPaymentQueue.erase(std::make_pair(indexed.nBlockLastPaid, outpoint));
+}
+
+bool CSmartnodeRegistry::Add(const CSmartnode& mn)
+{
+    const COutPoint& outpoint = mn.vin.prevout;
+    if (!mapByOutpoint.emplace(outpoint, vecSmartnodes.size()).second)
+        return false;
+
+    vecSmartnodes.push_back(mn);
+    vecIndexed.push_back(IndexedState(mn));
+    AddToIndexes(vecIndexed.back(), outpoint);
+    list.reset();
+    setChanged.insert(outpoint);
+    return true;
+}
+
+CSmartnodeRegistry::iterator CSmartnodeRegistry::Erase(iterator it)
+{
+    size_t nPos = it - vecSmartnodes.begin();
+    COutPoint outpoint = it->vin.prevout;
+
+    RemoveFromIndexes(vecIndexed[nPos], outpoint);
+    mapByOutpoint.erase(outpoint);
+
+    if (nPos + 1 != vecSmartnodes.size()) {
+        vecSmartnodes[nPos] = vecSmartnodes.back();
+        vecIndexed[nPos] = vecIndexed.back();
+        mapByOutpoint[vecSmartnodes[nPos].vin.prevout] = nPos;
+    }
+    vecSmartnodes.pop_back();
+    vecIndexed.pop_back();
+    list.reset();
+    setChanged.insert(outpoint);
+
+    return vecSmartnodes.begin() + nPos;
+}
+
+void CSmartnodeRegistry::Clear()
+{
+    vecSmartnodes.clear();
+    vecIndexed.clear();
+    mapByOutpoint.clear();
+    mapByKeyIDSmartnode.clear();
+    mapByKeyIDCollateral.clear();
+    mapByAddr.clear();
+    mapCountByStateProtocol.clear();
+    setPaymentQueue.clear();
+    list.reset();
+    setChanged.clear();
+}
+
+void CSmartnodeRegistry::Update(const CSmartnode* pmn)
+{
+    size_t nPos = pmn - vecSmartnodes.data();
+    assert(nPos < vecSmartnodes.size());
+
+    IndexedState indexed(*pmn);
+    if (indexed == vecIndexed[nPos])
+        return;
+
+    RemoveFromIndexes(vecIndexed[nPos], pmn->vin.prevout);
+    vecIndexed[nPos] = indexed;
+    AddToIndexes(indexed, pmn->vin.prevout);
+    list.reset();
+    setChanged.insert(pmn->vin.prevout);
+}
+
+void CSmartnodeRegistry::SetChanged(const CSmartnode* pmn)
+{
+    assert(size_t(pmn - vecSmartnodes.data()) < vecSmartnodes.size());
+    setChanged.insert(pmn->vin.prevout);
+}
+
+void CSmartnodeRegistry::TakeChanged(std::set<COutPoint>& setChangedRet)
+{
+    setChangedRet.clear();
+    setChangedRet.swap(setChanged);
+}
+
+CSmartnode* CSmartnodeRegistry::Find(const COutPoint& outpoint)
+{
+    auto it = mapByOutpoint.find(outpoint);
+    return it == mapByOutpoint.end() ? NULL : &vecSmartnodes[it->second];
+}
+
+const CSmartnode* CSmartnodeRegistry::Find(const COutPoint& outpoint) const
+{
+    auto it = mapByOutpoint.find(outpoint);
+    return it == mapByOutpoint.end() ? NULL : &vecSmartnodes[it->second];
+}
+
+CSmartnode* CSmartnodeRegistry::FindByPubKey(const CPubKey& pubKeySmartnode)
+{
+    auto range = mapByKeyIDSmartnode.equal_range(pubKeySmartnode.GetID());
+    for (auto it = range.first; it != range.second; ++it) {
+        CSmartnode* pmn = Find(it->second);
+        if (pmn->pubKeySmartnode == pubKeySmartnode)
+            return pmn;
+    }
+    return NULL;
+}
+
+CSmartnode* CSmartnodeRegistry::FindByCollateral(const CKeyID& keyIDCollateral)
+{
+    auto it = mapByKeyIDCollateral.find(keyIDCollateral);
+    return it == mapByKeyIDCollateral.end() ? NULL : Find(it->second);
+}
+
+std::vector<CSmartnode*> CSmartnodeRegistry::FindByAddr(const CService& addr)
+{
+    std::vector<CSmartnode*> vecResult;
+    auto range = mapByAddr.equal_range(addr);
+    for (auto it = range.first; it != range.second; ++it)
+        vecResult.push_back(Find(it->second));
+    return vecResult;
+}
+
+std::vector<CSmartnode*> CSmartnodeRegistry::GetSortedByAddr()
+{
+    std::vector<CSmartnode*> vecResult;
+    vecResult.reserve(mapByAddr.size());
+    for (const auto& entry : mapByAddr)
+        vecResult.push_back(Find(entry.second));
+    return vecResult;
+}
+
+int CSmartnodeRegistry::Count(int nMinProtocol, int nState) const
+{
+    int nCount = 0;
+    for (const auto& entry : mapCountByStateProtocol) {
+        if (entry.first.second < nMinProtocol || (nState != -1 && entry.first.first != nState))
+            continue;
+        nCount += entry.second;
+    }
+    return nCount;
+}
+
+std::map<int, int> CSmartnodeRegistry::CountByState() const
+{
+    std::map<int, int> mapResult;
+    for (const auto& entry : mapCountByStateProtocol)
+        mapResult[entry.first.first] += entry.second;
+    return mapResult;
+}
+
+CSmartnodeListRef CSmartnodeRegistry::GetList() const
+{
+    if (!list) {
+        std::shared_ptr<std::vector<CSmartnodeListEntry> > listNew = std::make_shared<std::vector<CSmartnodeListEntry> >();
+        listNew->reserve(vecSmartnodes.size());
+        for (const CSmartnode& mn : vecSmartnodes)
+            listNew->push_back(CSmartnodeListEntry(mn));
+        list = listNew;
+    }
+    return list;
+}
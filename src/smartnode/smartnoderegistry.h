@@ -0,0 +1,169 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTNODEREGISTRY_H
+#define SMARTNODEREGISTRY_H
+
+#include "smartnode.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/** A row of the smartnode lists shown by RPC, SAPI and the GUI */
+struct CSmartnodeListEntry
+{
+    smartnode_info_t info;
+    int nBlockLastPaid;
+    uint32_t nSentinelVersion;
+    bool fSentinelIsCurrent;
+
+    explicit CSmartnodeListEntry(const CSmartnode& mn);
+
+    std::string GetStatus() const { return CSmartnode::StateToString(info.nActiveState); }
+};
+
+/** Shared and never changed once built, readers don't need a lock */
+typedef std::shared_ptr<const std::vector<CSmartnodeListEntry> > CSmartnodeListRef;
+
+/**
+ * The smartnodes known to CSmartnodeMan, stored contiguously and indexed by
+ * outpoint. The secondary indexes (smartnode key, collateral key, address,
+ * counts by state and protocol, and the payment queue) follow Add, Erase and
+ * Update. Whoever changes a smartnode in place must call Update afterwards,
+ * or SetChanged if only fields outside the indexes changed, so the journal of
+ * mncache.dat picks it up.
+ *
+ * Erase moves the last smartnode into the freed slot and Add may reallocate,
+ * so pointers and iterators must not be kept across them. Not thread safe,
+ * the owner's lock protects it.
+ */
+class CSmartnodeRegistry
+{
+public:
+    typedef std::vector<CSmartnode>::iterator iterator;
+    typedef std::vector<CSmartnode>::const_iterator const_iterator;
+    /** The enabled smartnodes ordered by last paid block, then outpoint */
+    typedef std::set<std::pair<int, COutPoint> > payment_queue_t;
+
+private:
+    /** The fields of a smartnode the indexes and the list snapshot depend on, as of its last Add or Update */
+    struct IndexedState
+    {
+        int nActiveState;
+        int nProtocolVersion;
+        CService addr;
+        CKeyID keyIDSmartnode;
+        CKeyID keyIDCollateral;
+        int nBlockLastPaid;
+        int64_t nTimeLastPaid;
+        int64_t sigTime;
+        int64_t nTimeLastPing;
+        uint32_t nSentinelVersion;
+        bool fSentinelIsCurrent;
+
+        explicit IndexedState(const CSmartnode& mn);
+        bool operator==(const IndexedState& other) const;
+    };
+
+    std::vector<CSmartnode> vecSmartnodes;
+    //! Parallel to vecSmartnodes
+    std::vector<IndexedState> vecIndexed;
+
+    std::unordered_map<COutPoint, size_t, SaltedOutpointHasher> mapByOutpoint;
+    std::multimap<CKeyID, COutPoint> mapByKeyIDSmartnode;
+    std::multimap<CKeyID, COutPoint> mapByKeyIDCollateral;
+    std::multimap<CService, COutPoint> mapByAddr;
+    std::map<std::pair<int, int>, int> mapCountByStateProtocol;
+    payment_queue_t setPaymentQueue;
+
+    //! Rebuilt by GetList after any change
+    mutable CSmartnodeListRef list;
+
+    //! Smartnodes added, erased or changed since the last TakeChanged
+    std::set<COutPoint> setChanged;
+
+    void AddToIndexes(const IndexedState& indexed, const COutPoint& outpoint);
+    void RemoveFromIndexes(const IndexedState& indexed, const COutPoint& outpoint);
+
+public:
+    iterator begin() { return vecSmartnodes.begin(); }
+    iterator end() { return vecSmartnodes.end(); }
+    const_iterator begin() const { return vecSmartnodes.begin(); }
+    const_iterator end() const { return vecSmartnodes.end(); }
+    size_t size() const { return vecSmartnodes.size(); }
+    bool empty() const { return vecSmartnodes.empty(); }
+
+    /** Returns false if there is a smartnode with the same outpoint already */
+    bool Add(const CSmartnode& mn);
+    /** Returns the iterator to the smartnode moved into the slot, or end() */
+    iterator Erase(iterator it);
+    void Clear();
+
+    /** Refresh the indexes after pmn was changed in place */
+    void Update(const CSmartnode* pmn);
+    /** pmn was changed in place, but none of the indexed fields */
+    void SetChanged(const CSmartnode* pmn);
+    /** Hand over the outpoints of the smartnodes changed since the last call, erased ones included */
+    void TakeChanged(std::set<COutPoint>& setChangedRet);
+
+    CSmartnode* Find(const COutPoint& outpoint);
+    const CSmartnode* Find(const COutPoint& outpoint) const;
+    /** The first smartnode with this smartnode key, NULL if there is none */
+    CSmartnode* FindByPubKey(const CPubKey& pubKeySmartnode);
+    /** The first smartnode paying to this collateral key, NULL if there is none */
+    CSmartnode* FindByCollateral(const CKeyID& keyIDCollateral);
+    /** All smartnodes announced with this address */
+    std::vector<CSmartnode*> FindByAddr(const CService& addr);
+    /** All smartnodes, ordered by address */
+    std::vector<CSmartnode*> GetSortedByAddr();
+
+    /** Smartnodes with at least nMinProtocol, only the ones in nState unless it is -1 */
+    int Count(int nMinProtocol, int nState = -1) const;
+    /** Number of smartnodes by state, states without any are left out */
+    std::map<int, int> CountByState() const;
+
+    const payment_queue_t& GetPaymentQueue() const { return setPaymentQueue; }
+
+    /** The list rows of all smartnodes, only rebuilt if something changed since the last call */
+    CSmartnodeListRef GetList() const;
+
+    // Same format as the std::map<COutPoint, CSmartnode> used before
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        unsigned int nSize = GetSizeOfCompactSize(vecSmartnodes.size());
+        for (const CSmartnode& mn : vecSmartnodes)
+            nSize += ::GetSerializeSize(mn.vin.prevout, nType, nVersion) + ::GetSerializeSize(mn, nType, nVersion);
+        return nSize;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        WriteCompactSize(s, vecSmartnodes.size());
+        for (const CSmartnode& mn : vecSmartnodes) {
+            ::Serialize(s, mn.vin.prevout, nType, nVersion);
+            ::Serialize(s, mn, nType, nVersion);
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        Clear();
+        unsigned int nSize = ReadCompactSize(s);
+        for (unsigned int i = 0; i < nSize; i++) {
+            COutPoint outpoint;
+            CSmartnode mn;
+            ::Unserialize(s, outpoint, nType, nVersion);
+            ::Unserialize(s, mn, nType, nVersion);
+            Add(mn);
+        }
+    }
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include "smartrewards/rewardspayments.h"
 #include "ui_interface.h"
 #include "validation.h"
+#include "validationinterface.h"
 
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/range/irange.hpp>
@@ -1028,6 +1029,8 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
 
     cache.ApplyRoundUpdateResult(result);
 
+    bool fRoundStarted = false;
+
     // For the first round we have special parameter..
     if (!round->number) {
         if ((MainNet() && pIndex->GetBlockTime() > nFirstRoundStartTime) ||
@@ -1043,6 +1046,7 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
 
             // Evaluate the round and update the next rounds parameter.
             EvaluateRound(first);
+            fRoundStarted = true;
         }
     }
 
@@ -1086,12 +1090,18 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
 
         // Evaluate the round and update the next rounds parameter.
         EvaluateRound(next);
+        fRoundStarted = true;
     }
 
     UpdatePercentage();
 
     cache.UpdateHeights(GetBlockHeight(pIndex), cache.GetCurrentBlock()->nHeight);
 
+    if (fRoundStarted) {
+        const CSmartRewardsRoundResult* pResult = cache.GetLastRoundResult();
+        GetMainSignals().SmartRewardsRoundStarted(*cache.GetCurrentRound(), pResult && pResult->round.number ? pResult : nullptr);
+    }
+
     if (LogAcceptCategory("smartrewards-bench")) {
         int nTime2 = GetTimeMicros();
         double dProcessingTime = (nTime2 - nTime1) * 0.001;
@@ -1134,6 +1144,8 @@ bool CSmartRewards::CommitUndoBlock(CBlockIndex* pIndex, const CSmartRewardsUpda
 
     cache.ApplyRoundUpdateResult(undoUpdate);
 
+    bool fRoundReopened = false;
+
     // If just hit the last round's threshold
     if ((MainNet() && pRound->number < nRewardsFirstAutomatedRound - 1 && pIndex->GetBlockTime() < pRound->endBlockTime) ||
         (((TestNet() && pRound->number > 1) || pRound->number >= nRewardsFirstAutomatedRound - 1) && pIndex->nHeight == pRound->startBlockHeight)) {
@@ -1167,12 +1179,17 @@ bool CSmartRewards::CommitUndoBlock(CBlockIndex* pIndex, const CSmartRewardsUpda
                 delete itDb->second;
             }
         }
+
+        fRoundReopened = true;
     }
 
     UpdatePercentage();
 
     cache.UpdateHeights(GetBlockHeight(pIndex), cache.GetCurrentBlock()->nHeight);
 
+    if (fRoundReopened)
+        GetMainSignals().SmartRewardsRoundReopened(*cache.GetCurrentRound());
+
     int nTime2 = GetTimeMicros();
 
     if (LogAcceptCategory("smartrewards-block")) {
@@ -396,6 +396,9 @@ void CSmartVotingManager::UpdateCachesAndClean()
             nTimeExpired = std::numeric_limits<int64_t>::max();
 
             mapErasedProposals.insert(std::make_pair(nHash, nTimeExpired));
+            if(pvotedb) {
+                pvotedb->EraseProposal(nHash);
+            }
             mapProposals.erase(it++);
         } else {
 
@@ -630,7 +633,7 @@ void CSmartVotingManager::SyncProposalWithVotes(CNode* pnode, const uint256& nPr
     LogPrint("proposal", "CSmartVotingManager::%s -- syncing proposal: %s, peer=%d\n", __func__, strHash, pnode->id);
     pnode->PushInventory(CInv(MSG_VOTING_PROPOSAL, it->first));
 
-    auto fileVotes = proposal.GetVoteFile();
+    const auto& fileVotes = proposal.GetVoteFile();
     std::string strError;
     for (const auto& vote : fileVotes.GetVotes()) {
         uint256 nVoteHash = vote.GetHash();
@@ -850,10 +853,10 @@ void CSmartVotingManager::RequestProposal(CNode* pfrom, const uint256& nHash, CC
 
         if(pProposal) {
             filter = CBloomFilter(Params().GetConsensus().nVotingFilterElements, SMARTVOTING_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CProposalVote> vecVotes = pProposal->GetVoteFile().GetVotes();
-            nVoteCount = vecVotes.size();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                filter.insert(vecVotes[i].GetHash());
+            std::vector<uint256> vecVoteHashes = pProposal->GetVoteFile().GetVoteHashes();
+            nVoteCount = vecVoteHashes.size();
+            for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+                filter.insert(vecVoteHashes[i]);
             }
         }
     }
@@ -992,9 +995,9 @@ void CSmartVotingManager::RebuildIndexes()
     cmapVoteToProposal.Clear();
     for(proposal_m_it it = mapProposals.begin(); it != mapProposals.end(); ++it) {
         CProposal& proposal = it->second;
-        std::vector<CProposalVote> vecVotes = proposal.GetVoteFile().GetVotes();
-        for(size_t i = 0; i < vecVotes.size(); ++i) {
-            cmapVoteToProposal.Insert(vecVotes[i].GetHash(), &proposal);
+        std::vector<uint256> vecVoteHashes = proposal.GetVoteFile().GetVoteHashes();
+        for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+            cmapVoteToProposal.Insert(vecVoteHashes[i], &proposal);
         }
     }
 }
@@ -1004,6 +1007,9 @@ void CSmartVotingManager::InitOnLoad()
     LOCK(cs);
     int64_t nStart = GetTimeMillis();
     LogPrintf("Preparing votingkey indexes...\n");
+    for(proposal_m_it it = mapProposals.begin(); it != mapProposals.end(); ++it) {
+        it->second.LoadVoteFile();
+    }
     RebuildIndexes();
     LogPrintf("Votingkey indexes prepared  %dms\n", GetTimeMillis() - nStart);
     LogPrintf("     %s\n", ToString());
@@ -39,6 +39,10 @@ CProposal::CProposal() :
     mapCurrentVKVotes(),
     cmmapOrphanVotes(),
     fileVotes(),
+    fTallyValid(false),
+    nTallyPowerSeq(0),
+    mapTallyPower(),
+    mapTally(),
     cs()
 {
 
@@ -61,6 +65,10 @@ CProposal::CProposal(const CProposal &other) :
     mapCurrentVKVotes(other.mapCurrentVKVotes),
     cmmapOrphanVotes(other.cmmapOrphanVotes),
     fileVotes(other.fileVotes),
+    fTallyValid(false),
+    nTallyPowerSeq(0),
+    mapTallyPower(),
+    mapTally(),
     cs()
 {}
 
@@ -86,6 +94,10 @@ void CProposal::swap(CProposal &first, CProposal &second)
     swap(first.fDirtyCache, second.fDirtyCache);
     swap(first.fExpired, second.fExpired);
     swap(first.nCreationHeight, second.nCreationHeight);
+
+    // tallies get rebuilt on the next request
+    first.fTallyValid = false;
+    second.fTallyValid = false;
 }
 
 
@@ -406,6 +418,16 @@ bool CProposal::ProcessVote(CNode* pfrom,
 //        return false;
 //    }
 
+    if(fTallyValid) {
+        // Move the voting power of this key from the previous to the new outcome
+        auto itPower = mapTallyPower.find(vote.GetVoteKey());
+        if(itPower == mapTallyPower.end()) {
+            itPower = mapTallyPower.emplace(vote.GetVoteKey(), std::max<int64_t>(0, ::GetVotingPower(vote.GetVoteKey()))).first;
+        }
+        AddToTally(eSignal, voteInstanceRef.eOutcome, -itPower->second);
+        AddToTally(eSignal, vote.GetOutcome(), itPower->second);
+    }
+
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     fileVotes.AddVote(vote);
     InvalidateVoteCache();
@@ -426,6 +448,8 @@ void CProposal::ClearVoteKeyVotes()
 //            ++it;
 //        }
     }
+
+    fTallyValid = false;
 }
 
 void CProposal::UpdateLocalValidity()
@@ -591,20 +615,95 @@ bool CProposal::IsCollateralValid(std::string& strError, int& fMissingConfirmati
     return true;
 }
 
+void CProposal::AddToTally(int nSignal, vote_outcome_enum_t eOutcome, int64_t nPower) const
+{
+    AssertLockHeld(cs);
+
+    switch(eOutcome){
+    case VOTE_OUTCOME_YES:
+        mapTally[nSignal].nYesPower += nPower;
+        break;
+    case VOTE_OUTCOME_NO:
+        mapTally[nSignal].nNoPower += nPower;
+        break;
+    case VOTE_OUTCOME_ABSTAIN:
+        mapTally[nSignal].nAbstainPower += nPower;
+        break;
+    case VOTE_OUTCOME_NONE:
+        break;
+    }
+}
+
+/**
+*   Bring the tallies up to date with the voting power changes since the last call.
+*   Only the vote keys whose power changed get touched, the full recount happens
+*   after loading the proposal or when the change log has moved on too far.
+*/
+
+void CProposal::UpdateTally() const
+{
+    AssertLockHeld(cs);
+
+    std::set<CVoteKey> setChanged;
+
+    if( fTallyValid && GetVotingPowerChanges(nTallyPowerSeq, setChanged) ){
+
+        for( const CVoteKey &voteKey : setChanged ){
+
+            vote_m_cit it = mapCurrentVKVotes.find(voteKey);
+            if( it == mapCurrentVKVotes.end() ) continue;
+
+            int64_t nPower = std::max<int64_t>(0, ::GetVotingPower(voteKey));
+            int64_t &nTallyPower = mapTallyPower[voteKey];
+
+            if( nPower == nTallyPower ) continue;
+
+            for( const auto &instance : it->second.mapInstances )
+                AddToTally(instance.first, instance.second.eOutcome, nPower - nTallyPower);
+
+            nTallyPower = nPower;
+        }
+
+        return;
+    }
+
+    nTallyPowerSeq = GetVotingPowerChangeSeq();
+    mapTallyPower.clear();
+    mapTally.clear();
+
+    for( const auto &votepair : mapCurrentVKVotes ){
+
+        int64_t nPower = std::max<int64_t>(0, ::GetVotingPower(votepair.first));
+        mapTallyPower[votepair.first] = nPower;
+
+        for( const auto &instance : votepair.second.mapInstances )
+            AddToTally(instance.first, instance.second.eOutcome, nPower);
+    }
+
+    fTallyValid = true;
+}
+
 int64_t CProposal::GetVotingPower(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const
 {
     LOCK(cs);
 
-    int64_t nTotalPower = 0;
-    for (const auto& votepair : mapCurrentVKVotes) {
-        const vote_rec_t& recVote = votepair.second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 != recVote.mapInstances.end() && it2->second.eOutcome == eVoteOutcomeIn) {
-            int64_t nPower = ::GetVotingPower(votepair.first);
-            nTotalPower += std::max<int64_t>(0,nPower);
-        }
+    UpdateTally();
+
+    auto it = mapTally.find(eVoteSignalIn);
+    if( it == mapTally.end() ) return 0;
+
+    switch(eVoteOutcomeIn){
+    case VOTE_OUTCOME_YES:
+        return it->second.nYesPower;
+    case VOTE_OUTCOME_NO:
+        return it->second.nNoPower;
+    case VOTE_OUTCOME_ABSTAIN:
+        return it->second.nAbstainPower;
+    case VOTE_OUTCOME_NONE:
+        break;
     }
-    return nTotalPower;
+
+    return 0;
 }
 
 CVoteOutcomes CProposal::GetVotingPower(const std::set<CVoteKey> &setVoteKeys, vote_signal_enum_t eVoteSignalIn) const
@@ -675,9 +774,15 @@ CAmount CProposal::GetAbstainPower(vote_signal_enum_t eVoteSignalIn) const
 
 CVoteResult CProposal::GetVotingResult(vote_signal_enum_t eVoteSignalIn) const
 {
-    return CVoteResult(GetYesPower(eVoteSignalIn),
-                       GetNoPower(eVoteSignalIn),
-                       GetAbstainPower(eVoteSignalIn));
+    LOCK(cs);
+
+    UpdateTally();
+
+    const CVoteOutcomes &outcomes = mapTally[eVoteSignalIn];
+
+    return CVoteResult(outcomes.nYesPower,
+                       outcomes.nNoPower,
+                       outcomes.nAbstainPower);
 }
 
 void CProposal::GetActiveVoteKeys(std::set<CVoteKey> &setVoteKeys) const
@@ -194,10 +194,21 @@ protected:
 
     CProposalVoteFile fileVotes;
 
+    /// voting power tallies per signal, updated incrementally on votes and voting power changes
+    mutable bool fTallyValid;
+    /// position in the voting power change log the tallies include
+    mutable uint64_t nTallyPowerSeq;
+    /// voting power each vote key contributes to the tallies
+    mutable std::map<CVoteKey, int64_t> mapTallyPower;
+    mutable std::map<int, CVoteOutcomes> mapTally;
+
 private:
     /// critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    void AddToTally(int nSignal, vote_outcome_enum_t eOutcome, int64_t nPower) const;
+    void UpdateTally() const;
+
 public:
 
     CProposal();
@@ -281,6 +292,12 @@ public:
         return fileVotes;
     }
 
+    /// Connect the votes loaded from the cache with the vote database
+    void LoadVoteFile() {
+        LOCK(cs);
+        fileVotes.Load(GetHash());
+    }
+
     void UpdateLocalValidity();
     void UpdateSentinelVariables();
 
@@ -327,6 +344,9 @@ public:
             READWRITE(fExpired);
             READWRITE(mapCurrentVKVotes);
             READWRITE(fileVotes);
+            if(ser_action.ForRead()) {
+                fTallyValid = false;
+            }
             LogPrint("proposal", "CProposal::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
     }
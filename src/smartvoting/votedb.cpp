@@ -1,64 +1,216 @@
 // Copyright (c) 2014-2017 The Dash Core developers
+// Copyright (c) 2018-2020 The SmartCash developers
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "votedb.h"
 
+#include "util.h"
+
+#include <set>
+
+#include <boost/thread.hpp>
+
+static const char DB_PROPOSAL_VOTE = 'v';
+
+CProposalVoteDB *pvotedb = NULL;
+
+CProposalVoteDB::CProposalVoteDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "votes", nCacheSize, fMemory, fWipe) {
+}
+
+bool CProposalVoteDB::WriteVote(const CProposalVote& vote) {
+    return Write(std::make_pair(DB_PROPOSAL_VOTE, std::make_pair(vote.GetProposalHash(), vote.GetHash())), vote);
+}
+
+bool CProposalVoteDB::HaveVote(const uint256& nProposalHash, const uint256& nHash) {
+    return Exists(std::make_pair(DB_PROPOSAL_VOTE, std::make_pair(nProposalHash, nHash)));
+}
+
+bool CProposalVoteDB::ReadVote(const uint256& nProposalHash, const uint256& nHash, CProposalVote& vote) {
+    return Read(std::make_pair(DB_PROPOSAL_VOTE, std::make_pair(nProposalHash, nHash)), vote);
+}
+
+bool CProposalVoteDB::ReadVotes(const uint256& nProposalHash, std::vector<CProposalVote>& vecVotes) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_PROPOSAL_VOTE, std::make_pair(nProposalHash, uint256())));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (pcursor->GetKey(key) && key.first == DB_PROPOSAL_VOTE && key.second.first == nProposalHash) {
+            CProposalVote vote;
+            if (pcursor->GetValue(vote)) {
+                vecVotes.push_back(vote);
+                pcursor->Next();
+            } else {
+                return error("failed to get proposal vote");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CProposalVoteDB::ReadVoteHashes(const uint256& nProposalHash, std::vector<uint256>& vecHashes) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_PROPOSAL_VOTE, std::make_pair(nProposalHash, uint256())));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (pcursor->GetKey(key) && key.first == DB_PROPOSAL_VOTE && key.second.first == nProposalHash) {
+            vecHashes.push_back(key.second.second);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CProposalVoteDB::EraseVotes(const uint256& nProposalHash, const std::vector<uint256>& vecHashes) {
+    CDBBatch batch(*this);
+    for (const uint256& nHash : vecHashes)
+        batch.Erase(std::make_pair(DB_PROPOSAL_VOTE, std::make_pair(nProposalHash, nHash)));
+    return WriteBatch(batch);
+}
+
+bool CProposalVoteDB::EraseProposal(const uint256& nProposalHash) {
+    std::vector<uint256> vecHashes;
+    return ReadVoteHashes(nProposalHash, vecHashes) && EraseVotes(nProposalHash, vecHashes);
+}
+
 CProposalVoteFile::CProposalVoteFile()
-    : nMemoryVotes(0),
+    : nProposalHash(),
+      nVoteCount(0),
       listVotes(),
       mapVoteIndex()
 {}
 
 CProposalVoteFile::CProposalVoteFile(const CProposalVoteFile& other)
-    : nMemoryVotes(other.nMemoryVotes),
+    : nProposalHash(other.nProposalHash),
+      nVoteCount(other.nVoteCount),
       listVotes(other.listVotes),
       mapVoteIndex()
 {
     RebuildIndex();
 }
 
+void CProposalVoteFile::Load(const uint256& nProposalHashIn)
+{
+    nProposalHash = nProposalHashIn;
+
+    if(!pvotedb) {
+        nVoteCount = listVotes.size();
+        return;
+    }
+
+    std::vector<uint256> vecHashes;
+    pvotedb->ReadVoteHashes(nProposalHash, vecHashes);
+
+    // Votes of a cache written without (or with a lost) vote database
+    std::set<uint256> setHashes(vecHashes.begin(), vecHashes.end());
+    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
+        if(!setHashes.count(it->GetHash())) {
+            pvotedb->WriteVote(*it);
+            setHashes.insert(it->GetHash());
+        }
+    }
+
+    nVoteCount = setHashes.size();
+
+    TrimMemory();
+}
+
 void CProposalVoteFile::AddVote(const CProposalVote& vote)
 {
     uint256 nHash = vote.GetHash();
     // make sure to never add/update already known votes
     if (HasVote(nHash))
         return;
+    nProposalHash = vote.GetProposalHash();
+    if (pvotedb)
+        pvotedb->WriteVote(vote);
     listVotes.push_front(vote);
     mapVoteIndex.emplace(nHash, listVotes.begin());
-    ++nMemoryVotes;
+    ++nVoteCount;
+    TrimMemory();
 }
 
 bool CProposalVoteFile::HasVote(const uint256& nHash) const
 {
-    return mapVoteIndex.find(nHash) != mapVoteIndex.end();
+    if (mapVoteIndex.find(nHash) != mapVoteIndex.end())
+        return true;
+    return !IsInMemory() && pvotedb->HaveVote(nProposalHash, nHash);
 }
 
 bool CProposalVoteFile::SerializeVoteToStream(const uint256& nHash, CDataStream& ss) const
 {
     vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
+    if(it != mapVoteIndex.end()) {
+        ss << *(it->second);
+        return true;
+    }
+
+    CProposalVote vote;
+    if(IsInMemory() || !pvotedb->ReadVote(nProposalHash, nHash, vote)) {
         return false;
     }
-    ss << *(it->second);
+    ss << vote;
     return true;
 }
 
 std::vector<CProposalVote> CProposalVoteFile::GetVotes() const
 {
     std::vector<CProposalVote> vecResult;
+    if(!IsInMemory()) {
+        pvotedb->ReadVotes(nProposalHash, vecResult);
+        return vecResult;
+    }
     for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
         vecResult.push_back(*it);
     }
     return vecResult;
 }
 
+std::vector<uint256> CProposalVoteFile::GetVoteHashes() const
+{
+    std::vector<uint256> vecResult;
+    if(!IsInMemory()) {
+        pvotedb->ReadVoteHashes(nProposalHash, vecResult);
+        return vecResult;
+    }
+    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
+        vecResult.push_back(it->GetHash());
+    }
+    return vecResult;
+}
+
 void CProposalVoteFile::RemoveVotesFromVotingKey(const CVoteKey &voteKey)
 {
+    std::set<uint256> setErase;
+
+    if(!IsInMemory()) {
+        std::vector<CProposalVote> vecVotes;
+        pvotedb->ReadVotes(nProposalHash, vecVotes);
+        for(const CProposalVote& vote : vecVotes) {
+            if(vote.GetVoteKey() == voteKey) {
+                setErase.insert(vote.GetHash());
+            }
+        }
+    }
+
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         if(it->GetVoteKey() == voteKey) {
-            --nMemoryVotes;
+            setErase.insert(it->GetHash());
             mapVoteIndex.erase(it->GetHash());
             listVotes.erase(it++);
         }
@@ -66,23 +218,45 @@ void CProposalVoteFile::RemoveVotesFromVotingKey(const CVoteKey &voteKey)
             ++it;
         }
     }
+
+    if(setErase.empty()) {
+        return;
+    }
+
+    nVoteCount -= setErase.size();
+
+    if(pvotedb) {
+        pvotedb->EraseVotes(nProposalHash, std::vector<uint256>(setErase.begin(), setErase.end()));
+    }
 }
 
 void CProposalVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
-    nMemoryVotes = 0;
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         CProposalVote& vote = *it;
         uint256 nHash = vote.GetHash();
         if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
             mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
             ++it;
         }
         else {
             listVotes.erase(it++);
+            --nVoteCount;
         }
     }
 }
+
+void CProposalVoteFile::TrimMemory()
+{
+    // Without a database there is nowhere to evict to
+    if(!pvotedb) {
+        return;
+    }
+
+    while((int)listVotes.size() > MAX_MEMORY_VOTES) {
+        mapVoteIndex.erase(listVotes.back().GetHash());
+        listVotes.pop_back();
+    }
+}
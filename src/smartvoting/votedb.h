@@ -1,4 +1,5 @@
 // Copyright (c) 2014-2017 The Dash Core developers
+// Copyright (c) 2018-2020 The SmartCash developers
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
@@ -8,18 +9,44 @@
 #include <list>
 #include <map>
 
+#include "dbwrapper.h"
 #include "voting.h"
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
 
+//! Database cache of the proposal vote database (MiB)
+static const int64_t nProposalVoteDbCache = 8;
+
+/** Access to the votes of all proposals (votes/) */
+class CProposalVoteDB : public CDBWrapper
+{
+public:
+    CProposalVoteDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CProposalVoteDB(const CProposalVoteDB&);
+    void operator=(const CProposalVoteDB&);
+public:
+    bool WriteVote(const CProposalVote& vote);
+    bool HaveVote(const uint256& nProposalHash, const uint256& nHash);
+    bool ReadVote(const uint256& nProposalHash, const uint256& nHash, CProposalVote& vote);
+    bool ReadVotes(const uint256& nProposalHash, std::vector<CProposalVote>& vecVotes);
+    //! Only reads the keys, the votes are not deserialized
+    bool ReadVoteHashes(const uint256& nProposalHash, std::vector<uint256>& vecHashes);
+    bool EraseVotes(const uint256& nProposalHash, const std::vector<uint256>& vecHashes);
+    bool EraseProposal(const uint256& nProposalHash);
+};
+
+/** Global variable that points to the proposal vote database (NULL keeps all votes in memory) */
+extern CProposalVoteDB *pvotedb;
+
 /**
  * Represents the collection of votes associated with a given CProposal
  * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
+ * which older votes are only available from the vote database.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Votes are written to the database when they are added, so evicting them from
+ * memory is free and only the recent votes end up in the smartvoting cache file.
  */
 class CProposalVoteFile
 {
@@ -37,10 +64,14 @@ public: // Types
     typedef vote_m_t::const_iterator vote_m_cit;
 
 private:
-    static const int MAX_MEMORY_VOTES = -1;
+    static const int MAX_MEMORY_VOTES = 1000;
 
-    int nMemoryVotes;
+    uint256 nProposalHash;
 
+    /// Votes in memory and on disk
+    int nVoteCount;
+
+    /// Most recent votes first
     vote_l_t listVotes;
 
     vote_m_t mapVoteIndex;
@@ -50,27 +81,35 @@ public:
 
     CProposalVoteFile(const CProposalVoteFile& other);
 
+    /**
+     * Set the proposal after loading the file from the cache and make sure
+     * the vote database has all votes which are held in memory
+     */
+    void Load(const uint256& nProposalHashIn);
+
     /**
      * Add a vote to the file
      */
     void AddVote(const CProposalVote& vote);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Return true if the vote with this hash is known, in memory or on disk
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Retrieve a vote from memory or disk
      */
     bool SerializeVoteToStream(const uint256& nHash, CDataStream& ss) const;
 
-    int GetVoteCount() {
-        return nMemoryVotes;
+    int GetVoteCount() const {
+        return nVoteCount;
     }
 
     std::vector<CProposalVote> GetVotes() const;
 
+    std::vector<uint256> GetVoteHashes() const;
+
     void RemoveVotesFromVotingKey(const CVoteKey &voteKey);
 
     ADD_SERIALIZE_METHODS
@@ -78,15 +117,21 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        READWRITE(nMemoryVotes);
+        READWRITE(nVoteCount);
         READWRITE(listVotes);
         if(ser_action.ForRead()) {
             RebuildIndex();
         }
     }
 private:
+    bool IsInMemory() const {
+        return pvotedb == NULL || nVoteCount == (int)listVotes.size();
+    }
+
     void RebuildIndex();
 
+    void TrimMemory();
+
 };
 
 #endif
@@ -5,19 +5,129 @@
 #include "votevalidation.h"
 
 #include "init.h"
+#include "index/addressindexer.h"
 #include "smartnode/smartnodesync.h"
 #include "smartvoting/manager.h"
 #include "spentindex.h"
+#include "undo.h"
 #include "validation.h"
 #include "wallet/wallet.h"
 #include "txdb.h"
 
+#include <deque>
+
 static CCriticalSection cs;
 
+/** Balance of the vote address of all active vote keys. Loaded once from the address
+ *  index, afterwards kept up to date by ConnectBlock/DisconnectBlock (protected by cs). */
 static std::map<CVoteKey, CVotingPower> mapActiveVoteKeys;
+/** Address index key -> vote key of all entries in mapActiveVoteKeys (protected by cs) */
+static std::map<std::pair<uint160, int>, CVoteKey> mapActiveVoteAddresses;
+/** Height the loaded voting power is valid for (protected by cs) */
+static int nVotingPowerHeight = -1;
+
+/** Log of vote keys whose voting power changed, used to update proposal tallies (protected by cs) */
+static uint64_t nVotingPowerChangeSeq = 0;
+static std::deque<std::pair<uint64_t, CVoteKey> > dequeVotingPowerChanges;
 
 bool GetBalanceDelta(const CSmartAddress &address, int nStartBlock, int nEndBlock, CAmount &delta);
 
+static void AddVotingPowerChange(const CVoteKey &voteKey)
+{
+    AssertLockHeld(cs);
+
+    dequeVotingPowerChanges.push_back(std::make_pair(++nVotingPowerChangeSeq, voteKey));
+
+    while( dequeVotingPowerChanges.size() > nVotingPowerChangesMax )
+        dequeVotingPowerChanges.pop_front();
+}
+
+/** Remove the vote keys which are not active anymore and return the ones
+ *  which still need to be loaded from the address index. */
+static void UpdateActiveVoteKeys(const std::set<CVoteKey> &setActiveKeys, std::vector<std::pair<CVoteKey, CSmartAddress> > &vecUnloaded)
+{
+    LOCK(cs);
+
+    for (auto it = mapActiveVoteKeys.begin(); it != mapActiveVoteKeys.end();){
+
+        // Check if the address we validate is not longer active
+        if( setActiveKeys.size() && !setActiveKeys.count(it->first) ){
+
+            uint160 hashBytes;
+            int type = 0;
+
+            if( it->second.address.GetIndexKey(hashBytes, type) )
+                mapActiveVoteAddresses.erase(std::make_pair(hashBytes, type));
+
+            if( it->second.IsValid() )
+                AddVotingPowerChange(it->first);
+
+            it = mapActiveVoteKeys.erase(it);
+            continue;
+        }
+
+        if( !it->second.IsValid() )
+            vecUnloaded.push_back(std::make_pair(it->first, it->second.address));
+
+        ++it;
+    }
+}
+
+/** Load the initial voting power of new vote keys from the address index. This is the only
+ *  place where the address index gets scanned, each vote key is loaded once. Returns false
+ *  if the keys need to be loaded again because the chain moved while reading the index. */
+static bool LoadVotingPower(const std::vector<std::pair<CVoteKey, CSmartAddress> > &vecUnloaded)
+{
+    const CBlockIndex *pindexSnapshot;
+
+    {
+        LOCK(cs_main);
+
+        // The balances have to match the chain the block deltas get applied to
+        if( !paddressindexer || !paddressindexer->IsSynced() )
+            return false;
+
+        pindexSnapshot = chainActive.Tip();
+    }
+
+    if( !pindexSnapshot )
+        return false;
+
+    std::vector<std::pair<CVoteKey, CAmount> > vecLoaded;
+
+    for( auto it : vecUnloaded ){
+
+        CAmount nBalance = 0;
+
+        if( GetBalanceDelta(it.second, 0, pindexSnapshot->nHeight, nBalance) )
+            vecLoaded.push_back(std::make_pair(it.first, nBalance));
+    }
+
+    // ConnectBlock/DisconnectBlock run with cs_main held, so no delta can
+    // get lost between the tip check and marking the keys as loaded.
+    LOCK2(cs_main, cs);
+
+    if( chainActive.Tip() != pindexSnapshot )
+        return false;
+
+    nVotingPowerHeight = pindexSnapshot->nHeight;
+
+    for( auto it : vecLoaded ){
+
+        auto itKey = mapActiveVoteKeys.find(it.first);
+
+        if( itKey == mapActiveVoteKeys.end() || itKey->second.IsValid() )
+            continue;
+
+        itKey->second.nPower = it.second;
+        itKey->second.nBlockHeight = std::max(1, pindexSnapshot->nHeight);
+
+        AddVotingPowerChange(it.first);
+    }
+
+    return vecLoaded.size() == vecUnloaded.size();
+}
+
 void ThreadSmartVoting()
 {
     static bool fOneThread;
@@ -32,6 +142,7 @@ void ThreadSmartVoting()
 
     // Check if we have some unparsed votekey registrations every block
     int nLastChecked = 0;
+    bool fPendingLoad = false;
 
     while (true)
     {
@@ -43,7 +154,7 @@ void ThreadSmartVoting()
 
             int nHeight = chainActive.Height();
 
-            if( nHeight == nLastChecked ) continue;
+            if( nHeight == nLastChecked && !fPendingLoad ) continue;
 
             nLastChecked = nHeight;
 
@@ -92,70 +203,119 @@ void ThreadSmartVoting()
 
             }
 
-            LOCK(cs);
+            std::vector<std::pair<CVoteKey, CSmartAddress> > vecUnloaded;
 
-            for (auto it = mapActiveVoteKeys.begin(); it != mapActiveVoteKeys.end();){
+            UpdateActiveVoteKeys(setActiveKeys, vecUnloaded);
 
-                // Check if the address we validate is not longer active
-                if( setActiveKeys.size() && !setActiveKeys.count(it->first) ){
-                    it = mapActiveVoteKeys.erase(it);
-                    continue;
-                }
+            fPendingLoad = vecUnloaded.size() && !LoadVotingPower(vecUnloaded);
+        }
+    }
+}
+
+bool GetBalanceDelta(const CSmartAddress &address, int nStartBlock, int nEndBlock, CAmount &delta)
+{
+    uint160 hashBytes;
+    int type = 0;
 
-                int nStart = 0;
+    if (!address.GetIndexKey(hashBytes, type)) {
+        return false;
+    }
 
-                if( it->second.IsValid() ){
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-                    if( it->second.nBlockHeight < nHeight ){
-                        nStart = it->second.nBlockHeight + 1;
-                    }else{
-                        ++it;
-                        continue;
-                    }
+    if ( !GetAddressIndex(hashBytes, type, addressIndex, nStartBlock, nEndBlock) ) {
+        return false;
+    }
 
-                }
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        delta += it->second;
 
-                if( nHeight < nValidationConfirmations ){
-                    ++it;
-                    continue;
-                }
+    return true;
+}
 
-                if( ( nHeight - nStart ) < nValidationConfirmations ){
-                    ++it;
-                    continue;
-                }
+void GetVotingPowerDeltas(const CBlock &block, const CBlockUndo &blockundo, CVotingPowerDeltas &mapDeltas)
+{
+    LOCK(cs);
 
-                CAmount nDelta = 0;
+    if( mapActiveVoteAddresses.empty() )
+        return;
 
-                if( GetBalanceDelta(it->second.address, nStart, nHeight, nDelta) ){
-                    it->second.nPower += nDelta;
-                    it->second.nBlockHeight = nHeight;
-                }
+    uint160 hashBytes;
+    int type;
 
-                ++it;
+    for( const CTransaction &tx : block.vtx ){
+        for( const CTxOut &out : tx.vout ){
 
-            }
+            if( !GetAddressHashAndType(out.scriptPubKey, hashBytes, type) )
+                continue;
+
+            auto it = mapActiveVoteAddresses.find(std::make_pair(hashBytes, type));
+
+            if( it != mapActiveVoteAddresses.end() )
+                mapDeltas[it->second] += out.nValue;
+        }
+    }
+
+    for( const CTxUndo &txundo : blockundo.vtxundo ){
+        for( const Coin &coin : txundo.vprevout ){
+
+            if( !GetAddressHashAndType(coin.out.scriptPubKey, hashBytes, type) )
+                continue;
+
+            auto it = mapActiveVoteAddresses.find(std::make_pair(hashBytes, type));
+
+            if( it != mapActiveVoteAddresses.end() )
+                mapDeltas[it->second] -= coin.out.nValue;
         }
     }
 }
 
-bool GetBalanceDelta(const CSmartAddress &address, int nStartBlock, int nEndBlock, CAmount &delta)
+void ApplyVotingPowerDeltas(const CVotingPowerDeltas &mapDeltas, const CBlockIndex *pindex, bool fConnect)
 {
-    uint160 hashBytes;
-    int type = 0;
+    AssertLockHeld(cs_main);
+    LOCK(cs);
 
-    if (!address.GetIndexKey(hashBytes, type)) {
-        return false;
+    nVotingPowerHeight = fConnect ? pindex->nHeight : pindex->nHeight - 1;
+
+    for( auto delta : mapDeltas ){
+
+        auto it = mapActiveVoteKeys.find(delta.first);
+
+        // Keys which are not loaded yet get the balance including this block from the address index
+        if( it == mapActiveVoteKeys.end() || !it->second.IsValid() )
+            continue;
+
+        int64_t nPowerBefore = it->second.nPower / COIN;
+
+        it->second.nPower += fConnect ? delta.second : -delta.second;
+
+        if( it->second.nPower / COIN != nPowerBefore )
+            AddVotingPowerChange(delta.first);
     }
+}
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+uint64_t GetVotingPowerChangeSeq()
+{
+    LOCK(cs);
+    return nVotingPowerChangeSeq;
+}
 
-    if ( !GetAddressIndex(hashBytes, type, addressIndex, nStartBlock, nEndBlock) ) {
+bool GetVotingPowerChanges(uint64_t &nSeq, std::set<CVoteKey> &setChanged)
+{
+    LOCK(cs);
+
+    if( nSeq == nVotingPowerChangeSeq )
+        return true;
+
+    if( dequeVotingPowerChanges.empty() || nSeq + 1 < dequeVotingPowerChanges.front().first ){
+        nSeq = nVotingPowerChangeSeq;
         return false;
     }
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
-        delta += it->second;
+    for( auto it = dequeVotingPowerChanges.begin() + (nSeq + 1 - dequeVotingPowerChanges.front().first); it != dequeVotingPowerChanges.end(); ++it )
+        setChanged.insert(it->second);
+
+    nSeq = nVotingPowerChangeSeq;
 
     return true;
 }
@@ -168,6 +328,7 @@ void GetVotingPower(const CVoteKey &voteKey, CVotingPower &votingPower)
     if( it != mapActiveVoteKeys.end() && it->second.IsValid() ){
         votingPower = it->second;
         votingPower.nPower /= COIN;
+        votingPower.nBlockHeight = nVotingPowerHeight;
     }else{
         votingPower.SetNull();
     }
@@ -195,7 +356,11 @@ void AddActiveVoteKey(const CVoteKey &voteKey)
 
     if( !mapActiveVoteKeys.count(voteKey) ){
         CVoteKeyValue voteKeyValue;
-        if(GetVoteKeyValue(voteKey, voteKeyValue) )
+        uint160 hashBytes;
+        int type = 0;
+        if( GetVoteKeyValue(voteKey, voteKeyValue) && voteKeyValue.voteAddress.GetIndexKey(hashBytes, type) ){
             mapActiveVoteKeys.insert(std::make_pair(voteKey, CVotingPower(voteKeyValue.voteAddress)));
+            mapActiveVoteAddresses[std::make_pair(hashBytes, type)] = voteKey;
+        }
     }
 }
@@ -7,6 +7,7 @@
 
 #include <list>
 #include <map>
+#include <set>
 
 #include "smarthive/hive.h"
 #include "voting.h"
@@ -14,8 +15,12 @@
 #include "streams.h"
 #include "uint256.h"
 
-// Update all vote's voting power every nValidationConfirmations blocks
-static const int nValidationConfirmations = 6;
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+// Number of voting power changes kept for incremental proposal tally updates
+static const size_t nVotingPowerChangesMax = 10000;
 // Check unparsed registrations every x seconds and remove them after n tries
 static const int nRegistrationCheckInterval = 2;
 static const int nRegistrationCheckMaxTries = 40;
@@ -36,9 +41,24 @@ struct CVotingPower{
     }
 };
 
+typedef std::map<CVoteKey, CAmount> CVotingPowerDeltas;
+
 void ThreadSmartVoting();
 void AddActiveVoteKey(const CVoteKey &voteKey);
 void GetVotingPower(const CVoteKey &voteKey, CVotingPower &votingPower);
 int64_t GetVotingPower(const CVoteKey &voteKey);
 
+/** Collect the balance changes of the active vote keys' addresses in a block, in a
+ *  single pass over its outputs and the spent outputs in its undo data. */
+void GetVotingPowerDeltas(const CBlock &block, const CBlockUndo &blockundo, CVotingPowerDeltas &mapDeltas);
+/** Apply the deltas of a connected (fConnect=true) or disconnected block. Called from
+ *  ConnectBlock/DisconnectBlock with cs_main held. */
+void ApplyVotingPowerDeltas(const CVotingPowerDeltas &mapDeltas, const CBlockIndex *pindex, bool fConnect);
+
+/** Current position in the voting power change log. */
+uint64_t GetVotingPowerChangeSeq();
+/** Vote keys whose voting power changed since nSeq, nSeq is moved to the current position.
+ *  Returns false if the changes are not available anymore and all power has to be re-read. */
+bool GetVotingPowerChanges(uint64_t &nSeq, std::set<CVoteKey> &setChanged);
+
 #endif
@@ -409,6 +409,78 @@ struct CAddressListEntry {
     bool IsNull(){ return hashBytes.IsNull(); }
 };
 
+/** Total received and current balance of an address */
+struct CAddressBalanceValue {
+    CAmount received;
+    CAmount balance;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(received);
+        READWRITE(balance);
+    }
+
+    CAddressBalanceValue(CAmount nReceived, CAmount nBalance) {
+        received = nReceived;
+        balance = nBalance;
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        received = 0;
+        balance = 0;
+    }
+
+    bool IsNull() const {
+        return received == 0 && balance == 0;
+    }
+};
+
+/** Address with a positive balance, ordered by descending balance */
+struct CAddressBalanceRankKey {
+    CAmount balance;
+    unsigned int type;
+    uint160 hashBytes;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 29;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        // Inverted, so that iterating forward starts with the largest balance
+        ser_writedata64be(s, std::numeric_limits<int64_t>::max() - balance);
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        balance = std::numeric_limits<int64_t>::max() - ser_readdata64be(s);
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s, nType, nVersion);
+    }
+
+    CAddressBalanceRankKey(CAmount nBalance, unsigned int addressType, uint160 addressHash) {
+        balance = nBalance;
+        type = addressType;
+        hashBytes = addressHash;
+    }
+
+    CAddressBalanceRankKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        type = 0;
+        hashBytes.SetNull();
+    }
+};
+
 struct CDepositIndexKey {
     unsigned int type;
     uint160 hashBytes;
@@ -813,5 +885,100 @@ struct CInstantPayIndexIteratorTimeKey {
     }
 };
 
+/** Entries of one time bucket of the instantpay index and the entries of all earlier buckets */
+struct CInstantPayBucket {
+    int nCountBefore;
+    int nCount;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nCountBefore);
+        READWRITE(nCount);
+    }
+
+    CInstantPayBucket(int countBefore, int count) {
+        nCountBefore = countBefore;
+        nCount = count;
+    }
+
+    CInstantPayBucket() {
+        SetNull();
+    }
+
+    void SetNull() {
+        nCountBefore = 0;
+        nCount = 0;
+    }
+};
+
+/** Position of the first entry of a bucket in the instantpay index, maps to the bucket */
+struct CInstantPayRankKey {
+    unsigned int rank;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 4;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata32be(s, rank);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        rank = ser_readdata32be(s);
+    }
+
+    CInstantPayRankKey(unsigned int nRank) {
+        rank = nRank;
+    }
+
+    CInstantPayRankKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        rank = 0;
+    }
+};
+
+/** Coin statistics of the chain up to and including a block, stored per height */
+struct CCoinStatsValue {
+    uint256 hashBlock;
+    //! Number and total amount of the unspent outputs
+    uint64_t nTransactionOutputs;
+    CAmount nTotalAmount;
+    //! Amount issued by the coinbase transactions, without the fees they collect
+    CAmount nTotalSupply;
+    //! Amount sent to provably unspendable outputs, which never enter the UTXO set
+    CAmount nUnspendableAmount;
+    //! Finalized MuHash3072 of the unspent outputs, see UpdateCoinSetHash
+    uint256 hashCoinSet;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(hashBlock);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+        READWRITE(nTotalSupply);
+        READWRITE(nUnspendableAmount);
+        READWRITE(hashCoinSet);
+    }
+
+    CCoinStatsValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        hashBlock.SetNull();
+        nTransactionOutputs = 0;
+        nTotalAmount = 0;
+        nTotalSupply = 0;
+        nUnspendableAmount = 0;
+        hashCoinSet.SetNull();
+    }
+};
 
 #endif // BITCOIN_SPENTINDEX_H
@@ -0,0 +1,219 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+#include "index/addressindexdb.h"
+#include "random.h"
+#include "txdb.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressbalance_tests, BasicTestingSetup)
+
+static uint160 AddressHash(unsigned char n)
+{
+    return uint160(std::vector<unsigned char>(20, n));
+}
+
+static void AddEntry(CAddressIndexBlockData &data, const uint160 &hashBytes, int nHeight, CAmount nValue)
+{
+    data.addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, nHeight, data.addressIndex.size(), GetRandHash(), 0, nValue < 0), nValue));
+}
+
+BOOST_AUTO_TEST_CASE(addressbalance_rankkey_order)
+{
+    uint160 hash1 = AddressHash(1), hash2 = AddressHash(2);
+
+    // Keys sort by descending balance, addresses with the same balance by type and hash
+    std::vector<CAddressBalanceRankKey> vecKeys = {
+        CAddressBalanceRankKey(MAX_MONEY, 1, hash1),
+        CAddressBalanceRankKey(100 * COIN, 1, hash1),
+        CAddressBalanceRankKey(100 * COIN, 1, hash2),
+        CAddressBalanceRankKey(100 * COIN, 2, hash1),
+        CAddressBalanceRankKey(COIN + 1, 1, hash1),
+        CAddressBalanceRankKey(COIN, 1, hash1),
+        CAddressBalanceRankKey(1, 1, hash1),
+    };
+
+    std::vector<std::vector<unsigned char> > vecSerialized;
+    for (const CAddressBalanceRankKey &key : vecKeys) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << key;
+        BOOST_CHECK_EQUAL(ss.size(), 29U);
+        vecSerialized.push_back(std::vector<unsigned char>(ss.begin(), ss.end()));
+
+        CAddressBalanceRankKey keyRead;
+        ss >> keyRead;
+        BOOST_CHECK_EQUAL(keyRead.balance, key.balance);
+        BOOST_CHECK_EQUAL(keyRead.type, key.type);
+        BOOST_CHECK(keyRead.hashBytes == key.hashBytes);
+    }
+
+    for (size_t i = 1; i < vecSerialized.size(); i++)
+        BOOST_CHECK(vecSerialized[i - 1] < vecSerialized[i]);
+}
+
+BOOST_AUTO_TEST_CASE(addressbalance_connect_disconnect)
+{
+    CAddressIndexDB db(1 << 20, true);
+    BOOST_CHECK(db.UpgradeAddressBalances());
+
+    uint160 hashA = AddressHash(10), hashB = AddressHash(11), hashC = AddressHash(12);
+
+    CAddressIndexBlockData block1;
+    AddEntry(block1, hashA, 1, 50 * COIN);
+    AddEntry(block1, hashB, 1, 20 * COIN);
+    AddEntry(block1, hashC, 1, 5 * COIN);
+    BOOST_CHECK(db.WriteBlock(block1, true, GetRandHash()));
+
+    // A sends 30 to C, B empties its address into A
+    CAddressIndexBlockData block2;
+    AddEntry(block2, hashA, 2, -30 * COIN);
+    AddEntry(block2, hashC, 2, 30 * COIN);
+    AddEntry(block2, hashB, 2, -20 * COIN);
+    AddEntry(block2, hashA, 2, 20 * COIN);
+    BOOST_CHECK(db.WriteBlock(block2, true, GetRandHash()));
+
+    std::vector<CAddressListEntry> vecEntries;
+    BOOST_CHECK(db.ReadRichList(vecEntries, 1));
+    BOOST_REQUIRE_EQUAL(vecEntries.size(), 2U);
+    BOOST_CHECK(vecEntries[0].hashBytes == hashA);
+    BOOST_CHECK_EQUAL(vecEntries[0].balance, 40 * COIN);
+    BOOST_CHECK_EQUAL(vecEntries[0].received, 70 * COIN);
+    BOOST_CHECK(vecEntries[1].hashBytes == hashC);
+    BOOST_CHECK_EQUAL(vecEntries[1].balance, 35 * COIN);
+    BOOST_CHECK_EQUAL(vecEntries[1].received, 35 * COIN);
+
+    int nCount;
+    BOOST_CHECK(db.ReadRichListCount(nCount, 0));
+    BOOST_CHECK_EQUAL(nCount, 2);
+    BOOST_CHECK(db.ReadRichListCount(nCount, 36 * COIN));
+    BOOST_CHECK_EQUAL(nCount, 1);
+    BOOST_CHECK(db.ReadRichListCount(nCount, 41 * COIN));
+    BOOST_CHECK_EQUAL(nCount, 0);
+
+    // Paging and thresholds
+    vecEntries.clear();
+    BOOST_CHECK(db.ReadRichList(vecEntries, 1, 1, 1));
+    BOOST_REQUIRE_EQUAL(vecEntries.size(), 1U);
+    BOOST_CHECK(vecEntries[0].hashBytes == hashC);
+    vecEntries.clear();
+    BOOST_CHECK(db.ReadRichList(vecEntries, 36 * COIN));
+    BOOST_CHECK_EQUAL(vecEntries.size(), 1U);
+
+    // The emptied address keeps its history but isn't ranked
+    CAddressBalanceValue value;
+    BOOST_CHECK(db.ReadAddressBalance(hashB, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 0);
+    BOOST_CHECK_EQUAL(value.received, 20 * COIN);
+
+    // Disconnecting block 2 restores the ranking of block 1
+    BOOST_CHECK(db.WriteBlock(block2, false, GetRandHash()));
+    vecEntries.clear();
+    BOOST_CHECK(db.ReadRichList(vecEntries, 1));
+    BOOST_REQUIRE_EQUAL(vecEntries.size(), 3U);
+    BOOST_CHECK(vecEntries[0].hashBytes == hashA);
+    BOOST_CHECK(vecEntries[1].hashBytes == hashB);
+    BOOST_CHECK(vecEntries[2].hashBytes == hashC);
+    BOOST_CHECK_EQUAL(vecEntries[2].received, 5 * COIN);
+    BOOST_CHECK(db.ReadRichListCount(nCount, 1));
+    BOOST_CHECK_EQUAL(nCount, 3);
+
+    // Disconnecting block 1 leaves nothing behind
+    BOOST_CHECK(db.WriteBlock(block1, false, GetRandHash()));
+    vecEntries.clear();
+    BOOST_CHECK(db.ReadRichList(vecEntries, 1));
+    BOOST_CHECK(vecEntries.empty());
+    BOOST_CHECK(db.ReadAddressBalance(hashA, 1, value));
+    BOOST_CHECK(value.IsNull());
+    BOOST_CHECK(db.ReadRichListCount(nCount, 1));
+    BOOST_CHECK_EQUAL(nCount, 0);
+}
+
+BOOST_AUTO_TEST_CASE(addressbalance_upgrade)
+{
+    CAddressIndexDB db(1 << 20, true);
+
+    std::vector<uint160> vecHashes;
+    CAddressIndexBlockData block;
+    for (int i = 0; i < 50; i++) {
+        vecHashes.push_back(AddressHash(i + 1));
+        AddEntry(block, vecHashes.back(), 1, (i + 1) * COIN);
+        if (i % 5 == 0)
+            AddEntry(block, vecHashes.back(), 1, -(i + 1) * COIN);
+    }
+
+    // Written before the balances existed, the balance records are summed up once
+    BOOST_CHECK(db.WriteBlock(block, true, GetRandHash()));
+    BOOST_CHECK(db.WriteFlag("addressbalances", false));
+    BOOST_CHECK(db.UpgradeAddressBalances());
+
+    std::vector<CAddressListEntry> vecEntries;
+    BOOST_CHECK(db.ReadRichList(vecEntries, 1));
+    BOOST_REQUIRE_EQUAL(vecEntries.size(), 40U);
+    BOOST_CHECK(vecEntries[0].hashBytes == vecHashes[49]);
+    BOOST_CHECK_EQUAL(vecEntries[0].balance, 50 * COIN);
+    for (size_t i = 1; i < vecEntries.size(); i++)
+        BOOST_CHECK(vecEntries[i - 1].balance > vecEntries[i].balance);
+
+    int nCount;
+    BOOST_CHECK(db.ReadRichListCount(nCount, 1));
+    BOOST_CHECK_EQUAL(nCount, 40);
+
+    CAddressBalanceValue value;
+    BOOST_CHECK(db.ReadAddressBalance(vecHashes[0], 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 0);
+    BOOST_CHECK_EQUAL(value.received, COIN);
+
+    // The full scan of getaddresses returns the same list
+    std::vector<CAddressListEntry> vecAddresses;
+    BOOST_CHECK(db.ReadAddresses(vecAddresses, -1, true));
+    BOOST_CHECK_EQUAL(vecAddresses.size(), 40U);
+}
+
+BOOST_AUTO_TEST_CASE(addressbalance_legacy_index_erase)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint160 hashBytes;
+    uint256 txid = GetRandHash();
+
+    // Records of the address indexes from before they got their own database
+    CAddressIndexKey addressKey(1, hashBytes, 5, 1, txid, 0, false);
+    CAddressUnspentKey unspentKey(1, hashBytes, txid, 0, 5);
+    CSpentIndexKey spentKey(txid, 0);
+    CDepositIndexKey depositKey(1, hashBytes, 1500000000, txid);
+    for (int i = 0; i < 100; i++) {
+        addressKey.index = i;
+        unspentKey.index = i;
+        spentKey.outputIndex = i;
+        depositKey.timestamp++;
+        BOOST_CHECK(db.Write(std::make_pair('a', addressKey), (CAmount)COIN));
+        BOOST_CHECK(db.Write(std::make_pair('u', unspentKey), CAddressUnspentValue(COIN, CScript(), 5)));
+        BOOST_CHECK(db.Write(std::make_pair('p', spentKey), CSpentIndexValue()));
+        BOOST_CHECK(db.Write(std::make_pair('d', depositKey), CDepositValue(COIN, 5)));
+    }
+
+    CCoinStatsValue stats;
+    stats.hashBlock = GetRandHash();
+    stats.nTotalSupply = 101 * COIN;
+    BOOST_CHECK(db.WriteCoinStats(5, stats, MuHash3072()));
+
+    BOOST_CHECK(db.EraseLegacyAddressIndex());
+    BOOST_CHECK(!db.Exists(std::make_pair('a', addressKey)));
+    BOOST_CHECK(!db.Exists(std::make_pair('u', unspentKey)));
+    BOOST_CHECK(!db.Exists(std::make_pair('p', spentKey)));
+    BOOST_CHECK(!db.Exists(std::make_pair('d', depositKey)));
+
+    bool fErased;
+    BOOST_CHECK(db.ReadFlag("legacyaddressindexerased", fErased) && fErased);
+
+    // The coin stats don't share a prefix with them
+    CCoinStatsValue statsRead;
+    BOOST_CHECK(db.ReadCoinStats(5, statsRead));
+    BOOST_CHECK(statsRead.hashBlock == stats.hashBlock);
+    BOOST_CHECK_EQUAL(statsRead.nTotalSupply, 101 * COIN);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "asynclog.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+BOOST_FIXTURE_TEST_SUITE(asynclog_tests, BasicTestingSetup)
+
+struct LogSink {
+    boost::mutex mutex;
+    std::vector<std::pair<int64_t, std::string> > vecWritten;
+    int nFlushes;
+    //! Keeps the writer busy so the queue fills up
+    boost::mutex mutexBlock;
+
+    LogSink() : nFlushes(0) {}
+
+    void Write(int64_t nTimeMicros, const std::string& str)
+    {
+        boost::mutex::scoped_lock lockBlock(mutexBlock);
+        boost::mutex::scoped_lock lock(mutex);
+        vecWritten.push_back(std::make_pair(nTimeMicros, str));
+    }
+
+    void Flush()
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        nFlushes++;
+    }
+
+    CAsyncLogWriter::WriteFunction WriteFunction() { return boost::bind(&LogSink::Write, this, _1, _2); }
+    CAsyncLogWriter::FlushFunction FlushFunction() { return boost::bind(&LogSink::Flush, this); }
+};
+
+static void PushMessages(CAsyncLogWriter* pwriter, int nThread, int nCount)
+{
+    for (int i = 0; i < nCount; i++)
+        pwriter->Push(nThread, strprintf("%d %d\n", nThread, i));
+}
+
+BOOST_AUTO_TEST_CASE(asynclog_order)
+{
+    LogSink sink;
+    CAsyncLogWriter writer(sink.WriteFunction(), sink.FlushFunction());
+    writer.Start();
+
+    for (int i = 0; i < 10000; i++)
+        BOOST_CHECK(writer.Push(i % 3 ? i : -1, strprintf("message %d\n", i)));
+
+    // Stop writes everything that is still queued
+    writer.Stop();
+
+    BOOST_REQUIRE_EQUAL(sink.vecWritten.size(), 10000U);
+    for (int i = 0; i < 10000; i++) {
+        BOOST_CHECK_EQUAL(sink.vecWritten[i].first, i % 3 ? i : -1);
+        BOOST_CHECK_EQUAL(sink.vecWritten[i].second, strprintf("message %d\n", i));
+    }
+    BOOST_CHECK(sink.nFlushes > 0);
+    BOOST_CHECK_EQUAL(writer.GetDropped(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(asynclog_block_overflow)
+{
+    LogSink sink;
+    CAsyncLogWriter writer(sink.WriteFunction(), sink.FlushFunction(), false, 16);
+    writer.Start();
+
+    // Several threads log far more than the queue holds, nothing gets lost
+    // and every thread's messages stay in order.
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(PushMessages, &writer, i, 2000));
+    threads.join_all();
+    writer.Stop();
+
+    BOOST_REQUIRE_EQUAL(sink.vecWritten.size(), 8000U);
+    BOOST_CHECK_EQUAL(writer.GetDropped(), 0U);
+
+    std::vector<int> vecNext(4, 0);
+    for (const auto& written : sink.vecWritten) {
+        int nThread = written.first;
+        BOOST_REQUIRE(nThread >= 0 && nThread < 4);
+        BOOST_CHECK_EQUAL(written.second, strprintf("%d %d\n", nThread, vecNext[nThread]));
+        vecNext[nThread]++;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(asynclog_drop_overflow)
+{
+    LogSink sink;
+    CAsyncLogWriter writer(sink.WriteFunction(), sink.FlushFunction(), true, 16);
+    writer.Start();
+
+    // Stall the writer so the queue can't make room
+    {
+        boost::mutex::scoped_lock lockBlock(sink.mutexBlock);
+        int nPushed = 0;
+        for (int i = 0; i < 100; i++)
+            nPushed += writer.Push(0, strprintf("message %d\n", i));
+        BOOST_CHECK(nPushed < 100);
+        BOOST_CHECK_EQUAL(writer.GetDropped(), 100U - nPushed);
+    }
+
+    writer.Stop();
+
+    // The writer reports what it had to drop
+    uint64_t nDropped = writer.GetDropped();
+    BOOST_CHECK_EQUAL(sink.vecWritten.size(), 100U - nDropped + 1);
+    bool fReported = false;
+    for (const auto& written : sink.vecWritten)
+        fReported |= written.second == strprintf("Log queue full, dropped %u messages\n", nDropped);
+    BOOST_CHECK(fReported);
+}
+
+BOOST_AUTO_TEST_CASE(asynclog_byte_limit)
+{
+    LogSink sink;
+    CAsyncLogWriter writer(sink.WriteFunction(), sink.FlushFunction(), true, 1024, 100);
+
+    // Not started: the queue holds whatever fits into the byte limit
+    BOOST_CHECK(writer.Push(-1, std::string(60, 'a')));
+    BOOST_CHECK(!writer.Push(-1, std::string(60, 'b')));
+    BOOST_CHECK(writer.Push(-1, std::string(40, 'c')));
+    BOOST_CHECK_EQUAL(writer.GetDropped(), 1U);
+
+    writer.Drain();
+    BOOST_CHECK_EQUAL(sink.nFlushes, 1);
+    BOOST_REQUIRE_EQUAL(sink.vecWritten.size(), 3U);
+    BOOST_CHECK_EQUAL(sink.vecWritten[1].second, std::string(60, 'a'));
+    BOOST_CHECK_EQUAL(sink.vecWritten[2].second, std::string(40, 'c'));
+
+    // Written messages free up the space again
+    BOOST_CHECK(writer.Push(-1, std::string(60, 'd')));
+}
+
+BOOST_AUTO_TEST_CASE(asynclog_oversize)
+{
+    LogSink sink;
+    CAsyncLogWriter writer(sink.WriteFunction(), sink.FlushFunction(), false, 16, 100);
+
+    // Not started: a message over the byte limit only goes into an empty queue
+    BOOST_CHECK(writer.Push(-1, std::string(150, 'a')));
+    BOOST_CHECK(!writer.Push(-1, std::string(150, 'b')));
+    BOOST_CHECK_EQUAL(writer.GetDropped(), 1U);
+    writer.Drain();
+
+    // Blocking: each one waits for the queue to run empty instead of forever
+    writer.Start();
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK(writer.Push(i, std::string(150 + i, 'c')));
+    writer.Stop();
+
+    BOOST_REQUIRE_EQUAL(sink.vecWritten.size(), 12U);
+    BOOST_CHECK_EQUAL(sink.vecWritten[1].second, std::string(150, 'a'));
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK_EQUAL(sink.vecWritten[i + 2].second, std::string(150 + i, 'c'));
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(asynclog_drain_on_crash)
+{
+    LogSink sink;
+    CAsyncLogWriter writer(sink.WriteFunction(), sink.FlushFunction(), true, 16);
+
+    for (int i = 0; i < 5; i++)
+        BOOST_CHECK(writer.Push(i, strprintf("message %d\n", i)));
+
+    int fds[2];
+    BOOST_REQUIRE(pipe(fds) == 0);
+    writer.DrainOnCrash(fds[1]);
+    close(fds[1]);
+
+    std::string strRead;
+    char buf[256];
+    ssize_t nRead;
+    while ((nRead = read(fds[0], buf, sizeof(buf))) > 0)
+        strRead.append(buf, nRead);
+    close(fds[0]);
+
+    // Raw messages in order, the queue is left empty and the sink untouched
+    BOOST_CHECK_EQUAL(strRead, "message 0\nmessage 1\nmessage 2\nmessage 3\nmessage 4\n");
+    BOOST_CHECK(sink.vecWritten.empty());
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
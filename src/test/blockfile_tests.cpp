@@ -0,0 +1,60 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/consensus.h"
+#include "streams.h"
+#include "validation.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfile_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(read_raw_block_test)
+{
+    const CChainParams& chainparams = Params();
+    const CBlockIndex* pindex = chainActive.Genesis();
+    BOOST_REQUIRE(pindex != NULL);
+
+    // The raw block must match the serialization of the deserialized block
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()));
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+
+    std::vector<unsigned char> vchBlock;
+    BOOST_REQUIRE(ReadRawBlockFromDisk(vchBlock, pindex, chainparams.MessageStart()));
+    BOOST_CHECK(vchBlock == std::vector<unsigned char>(ssBlock.begin(), ssBlock.end()));
+
+    // Wrong message start or position
+    CMessageHeader::MessageStartChars messageStart = {0, 0, 0, 0};
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, pindex, messageStart));
+    BOOST_CHECK(vchBlock.empty());
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, CDiskBlockPos(pindex->GetBlockPos().nFile, 0), chainparams.MessageStart()));
+}
+
+BOOST_AUTO_TEST_CASE(read_raw_block_size_test)
+{
+    const CChainParams& chainparams = Params();
+    std::vector<unsigned char> vchBlock;
+
+    // Records too small for a block header or too large for a block are rejected
+    unsigned int nFile = 1000;
+    for (unsigned int nSize : {0U, 79U, MAX_BLOCK_SERIALIZED_SIZE + 1}) {
+        CDiskBlockPos pos(nFile++, 0);
+        {
+            CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
+            BOOST_REQUIRE(!fileout.IsNull());
+            fileout << FLATDATA(chainparams.MessageStart()) << nSize;
+            std::vector<unsigned char> vchData(std::min(nSize, 100U));
+            fileout.write((const char*)vchData.data(), vchData.size());
+        }
+        pos.nPos = 8;
+        BOOST_CHECK(!ReadRawBlockFromDisk(vchBlock, pos, chainparams.MessageStart()));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
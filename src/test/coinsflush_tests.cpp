@@ -0,0 +1,92 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "random.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinsflush_tests, BasicTestingSetup)
+
+static Coin MakeCoin(int nHeight)
+{
+    CScript script = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, nHeight % 256) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return Coin(CTxOut(nHeight * COIN, script), nHeight, false);
+}
+
+BOOST_AUTO_TEST_CASE(coinsflush_background)
+{
+    CCoinsViewDB db(1 << 20, true);
+    std::vector<COutPoint> vecOutPoints;
+    for (int i = 0; i < 1000; i++)
+        vecOutPoints.push_back(COutPoint(GetRandHash(), i % 3));
+
+    uint256 hashBlock1 = GetRandHash();
+    uint256 hashBlock2 = GetRandHash();
+
+    {
+        CCoinsViewBackgroundFlush flusher(&db, true);
+        CCoinsViewCache tip(&flusher);
+
+        for (size_t i = 0; i < vecOutPoints.size(); i++)
+            tip.AddCoin(vecOutPoints[i], MakeCoin(i + 1), false);
+        tip.SetBestBlock(hashBlock1);
+        BOOST_CHECK(tip.Flush());
+        BOOST_CHECK_EQUAL(tip.GetCacheSize(), 0U);
+
+        // The coins are readable while and after they are written
+        BOOST_CHECK(flusher.GetBestBlock() == hashBlock1);
+        for (size_t i = 0; i < vecOutPoints.size(); i += 10) {
+            BOOST_CHECK(tip.HaveCoin(vecOutPoints[i]));
+            BOOST_CHECK_EQUAL(tip.AccessCoin(vecOutPoints[i]).nHeight, i + 1);
+        }
+
+        // Spending continues on the emptied cache, the next flush waits for the previous one
+        for (size_t i = 0; i < vecOutPoints.size(); i += 2)
+            BOOST_CHECK(tip.SpendCoin(vecOutPoints[i]));
+        tip.SetBestBlock(hashBlock2);
+        BOOST_CHECK(tip.Flush());
+        BOOST_CHECK(!flusher.HaveCoin(vecOutPoints[0]));
+        BOOST_CHECK(flusher.HaveCoin(vecOutPoints[1]));
+
+        BOOST_CHECK(flusher.WaitForFlush());
+        CCoinsFlushStats stats = flusher.GetStats();
+        BOOST_CHECK_EQUAL(stats.nFlushes, 2U);
+        BOOST_CHECK_EQUAL(stats.nPendingCoins, 0U);
+        BOOST_CHECK_EQUAL(stats.nLastCoins, vecOutPoints.size() / 2);
+
+        // Handed over, but only written by the destructor
+        tip.AddCoin(COutPoint(hashBlock1, 0), MakeCoin(1), false);
+        BOOST_CHECK(tip.Flush());
+    }
+
+    // Everything reached the database, including the tip marker
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    for (size_t i = 0; i < vecOutPoints.size(); i++)
+        BOOST_CHECK_EQUAL(db.HaveCoin(vecOutPoints[i]), i % 2 == 1);
+    BOOST_CHECK(db.HaveCoin(COutPoint(hashBlock1, 0)));
+}
+
+BOOST_AUTO_TEST_CASE(coinsflush_synchronous)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewBackgroundFlush flusher(&db, false);
+    CCoinsViewCache tip(&flusher);
+
+    COutPoint outpoint(GetRandHash(), 0);
+    uint256 hashBlock = GetRandHash();
+    tip.AddCoin(outpoint, MakeCoin(1), false);
+    tip.SetBestBlock(hashBlock);
+    BOOST_CHECK(tip.Flush());
+
+    // Without the background writer the database is up to date right away
+    BOOST_CHECK(db.HaveCoin(outpoint));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK_EQUAL(flusher.GetStats().nFlushes, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "coins.h"
+#include "index/coinstatsindex.h"
+#include "random.h"
+#include "txdb.h"
+#include "undo.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinstatsindex_tests, BasicTestingSetup)
+
+static CScript RandomScript()
+{
+    return CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, GetRandInt(256)) << OP_EQUALVERIFY << OP_CHECKSIG;
+}
+
+static CMutableTransaction CoinBase(int nHeight, const std::vector<CAmount> &vecAmounts)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    for (CAmount nAmount : vecAmounts)
+        tx.vout.push_back(CTxOut(nAmount, RandomScript()));
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(coinstatsindex_apply)
+{
+    CCoinStatsValue stats;
+    MuHash3072 muhash;
+    uint256 hash1 = GetRandHash(), hash2 = GetRandHash();
+    CBlockIndex index1, index2;
+    index1.nHeight = 1;
+    index1.phashBlock = &hash1;
+    index2.nHeight = 2;
+    index2.phashBlock = &hash2;
+    index2.pprev = &index1;
+
+    // Block 1 mines 105 coins, 5 of them are burned
+    CMutableTransaction coinbase1 = CoinBase(1, {100 * COIN, 5 * COIN});
+    coinbase1.vout[1].scriptPubKey = CScript() << OP_RETURN;
+    CBlock block1;
+    block1.vtx.push_back(CTransaction(coinbase1));
+    BOOST_CHECK(ApplyCoinStatsBlock(block1, CBlockUndo(), &index1, stats, muhash));
+    uint256 hashCoinSet1 = stats.hashCoinSet;
+
+    BOOST_CHECK(stats.hashBlock == hash1);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 1U);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, 100 * COIN);
+    BOOST_CHECK_EQUAL(stats.nUnspendableAmount, 5 * COIN);
+    BOOST_CHECK_EQUAL(stats.nTotalSupply, 105 * COIN);
+
+    // Block 2 mines 50 coins and collects the fee of a transaction spending the first coinbase
+    CMutableTransaction spend;
+    spend.vin.push_back(CTxIn(COutPoint(coinbase1.GetHash(), 0)));
+    spend.vout.push_back(CTxOut(60 * COIN, RandomScript()));
+    spend.vout.push_back(CTxOut(39 * COIN, RandomScript()));
+    CMutableTransaction coinbase2 = CoinBase(2, {51 * COIN});
+    CBlock block2;
+    block2.vtx.push_back(CTransaction(coinbase2));
+    block2.vtx.push_back(CTransaction(spend));
+
+    CBlockUndo blockundo2;
+    blockundo2.vtxundo.push_back(CTxUndo());
+    blockundo2.vtxundo[0].vprevout.push_back(Coin(coinbase1.vout[0], 1, true));
+
+    // Undo data that doesn't match the block is rejected
+    CCoinStatsValue statsInvalid = stats;
+    MuHash3072 muhashInvalid = muhash;
+    BOOST_CHECK(!ApplyCoinStatsBlock(block2, CBlockUndo(), &index2, statsInvalid, muhashInvalid));
+
+    BOOST_CHECK(ApplyCoinStatsBlock(block2, blockundo2, &index2, stats, muhash));
+    BOOST_CHECK(stats.hashBlock == hash2);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 3U);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, 150 * COIN);
+    BOOST_CHECK_EQUAL(stats.nUnspendableAmount, 5 * COIN);
+    BOOST_CHECK_EQUAL(stats.nTotalSupply, 155 * COIN);
+
+    // The set hash only depends on the unspent outputs, not on the history
+    MuHash3072 muhashSet;
+    uint256 hashCoinSet;
+    UpdateCoinSetHash(muhashSet, COutPoint(spend.GetHash(), 1), Coin(spend.vout[1], 2, false), true);
+    UpdateCoinSetHash(muhashSet, COutPoint(coinbase2.GetHash(), 0), Coin(coinbase2.vout[0], 2, true), true);
+    muhashSet.Finalize(hashCoinSet);
+    BOOST_CHECK(hashCoinSet != stats.hashCoinSet);
+    UpdateCoinSetHash(muhashSet, COutPoint(spend.GetHash(), 0), Coin(spend.vout[0], 2, false), true);
+    muhashSet.Finalize(hashCoinSet);
+    BOOST_CHECK(hashCoinSet == stats.hashCoinSet);
+
+    // A coin with a different height is a different coin
+    UpdateCoinSetHash(muhashSet, COutPoint(spend.GetHash(), 0), Coin(spend.vout[0], 2, false), false);
+    UpdateCoinSetHash(muhashSet, COutPoint(spend.GetHash(), 0), Coin(spend.vout[0], 3, false), true);
+    muhashSet.Finalize(hashCoinSet);
+    BOOST_CHECK(hashCoinSet != stats.hashCoinSet);
+
+    // Taking block 2 back out leaves the coin set of block 1
+    BOOST_CHECK(ReverseCoinSetBlock(block2, blockundo2, &index2, muhash));
+    muhash.Finalize(hashCoinSet);
+    BOOST_CHECK(hashCoinSet == hashCoinSet1);
+}
+
+BOOST_AUTO_TEST_CASE(coinstatsindex_db)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint256 hashBest;
+    MuHash3072 muhash, muhashRead;
+    BOOST_CHECK(!db.ReadCoinStatsBestBlock(hashBest, muhashRead));
+
+    std::vector<CCoinStatsValue> vecStats;
+    std::vector<MuHash3072> vecMuHash;
+    for (int nHeight = 0; nHeight < 10; nHeight++) {
+        uint256 hashCoin = GetRandHash();
+        muhash.Insert(hashCoin.begin(), hashCoin.size());
+        CCoinStatsValue stats;
+        stats.hashBlock = GetRandHash();
+        stats.nTransactionOutputs = nHeight * 3;
+        stats.nTotalAmount = nHeight * 100 * COIN;
+        stats.nTotalSupply = nHeight * 101 * COIN;
+        stats.nUnspendableAmount = nHeight * COIN;
+        muhash.Finalize(stats.hashCoinSet);
+        BOOST_CHECK(db.WriteCoinStats(nHeight, stats, muhash));
+        vecStats.push_back(stats);
+        vecMuHash.push_back(muhash);
+    }
+
+    uint256 hashCoinSet;
+    BOOST_CHECK(db.ReadCoinStatsBestBlock(hashBest, muhashRead));
+    BOOST_CHECK(hashBest == vecStats.back().hashBlock);
+    muhashRead.Finalize(hashCoinSet);
+    BOOST_CHECK(hashCoinSet == vecStats.back().hashCoinSet);
+
+    CCoinStatsValue stats;
+    BOOST_CHECK(db.ReadCoinStats(4, stats));
+    BOOST_CHECK(stats.hashBlock == vecStats[4].hashBlock);
+    BOOST_CHECK(stats.hashCoinSet == vecStats[4].hashCoinSet);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 12U);
+    BOOST_CHECK_EQUAL(stats.nTotalSupply, 404 * COIN);
+
+    // Disconnecting the tip moves the best block back
+    BOOST_CHECK(db.EraseCoinStats(9, vecStats[8].hashBlock, vecMuHash[8]));
+    BOOST_CHECK(!db.ReadCoinStats(9, stats));
+    BOOST_CHECK(db.ReadCoinStatsBestBlock(hashBest, muhashRead));
+    BOOST_CHECK(hashBest == vecStats[8].hashBlock);
+    muhashRead.Finalize(hashCoinSet);
+    BOOST_CHECK(hashCoinSet == vecStats[8].hashCoinSet);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,217 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "smartnode/flat-database.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(flatdb_tests, TestingSetup)
+
+/** Minimal journaled object */
+struct CJournalTestObject
+{
+    std::map<int, std::string> mapEntries;
+    std::string strState;
+
+    std::set<int> setChanged;
+    bool fStateChanged;
+    bool fJournalAll;
+
+    CJournalTestObject() : fStateChanged(false), fJournalAll(true) {}
+
+    void Set(int nKey, const std::string& strValue)
+    {
+        mapEntries[nKey] = strValue;
+        setChanged.insert(nKey);
+    }
+
+    void Erase(int nKey)
+    {
+        mapEntries.erase(nKey);
+        setChanged.insert(nKey);
+    }
+
+    void SetState(const std::string& strStateIn)
+    {
+        strState = strStateIn;
+        fStateChanged = true;
+    }
+
+    void GetJournalRecords(flatdb_records_t& mapRecords) const
+    {
+        AddFlatDBRecords(mapRecords, 'e', mapEntries);
+        AddFlatDBRecord(mapRecords, 's', strState);
+    }
+
+    bool GetJournalChanges(flatdb_records_t& mapRecords, std::set<flatdb_bytes_t>& setErased)
+    {
+        std::set<int> setKeys;
+        setKeys.swap(setChanged);
+        bool fState = fStateChanged;
+        fStateChanged = false;
+
+        if (fJournalAll) {
+            fJournalAll = false;
+            return false;
+        }
+
+        AddFlatDBChanges(mapRecords, setErased, 'e', mapEntries, setKeys);
+        if (fState)
+            AddFlatDBRecord(mapRecords, 's', strState);
+        return true;
+    }
+
+    void LoadJournalRecords(const flatdb_records_t& mapRecords)
+    {
+        Clear();
+        ReadFlatDBRecords(mapRecords, 'e', mapEntries);
+        ReadFlatDBRecord(mapRecords, 's', strState);
+        fJournalAll = false;
+    }
+
+    void CheckAndRemove() {}
+
+    void Clear()
+    {
+        mapEntries.clear();
+        strState.clear();
+        setChanged.clear();
+        fStateChanged = false;
+        fJournalAll = true;
+    }
+
+    std::string ToString() const
+    {
+        return strprintf("Entries: %d", mapEntries.size());
+    }
+};
+
+static CJournalTestObject LoadObject(const std::string& strFilename)
+{
+    CJournalTestObject obj;
+    CJournaledFlatDB<CJournalTestObject> flatdb(strFilename, "magicJournalTest");
+    BOOST_CHECK(flatdb.Load(obj));
+    return obj;
+}
+
+BOOST_AUTO_TEST_CASE(journal_flush_and_compact)
+{
+    CJournalTestObject obj;
+    for (int i = 0; i < 100; i++)
+        obj.Set(i, strprintf("entry %d", i));
+    obj.SetState("first");
+
+    {
+        CJournaledFlatDB<CJournalTestObject> flatdb("journal.dat", "magicJournalTest");
+        CJournalTestObject objEmpty;
+        BOOST_CHECK(flatdb.Load(objEmpty));
+        // Nothing on disk yet, the first flush writes a snapshot
+        BOOST_CHECK(flatdb.Flush(obj));
+        uintmax_t nLogSize = boost::filesystem::file_size(GetDataDir() / "journal.dat.log");
+
+        // Unchanged records are not written again
+        BOOST_CHECK(flatdb.Flush(obj));
+        BOOST_CHECK_EQUAL(boost::filesystem::file_size(GetDataDir() / "journal.dat.log"), nLogSize);
+
+        obj.Erase(5);
+        obj.Set(7, "changed");
+        obj.Set(200, "added");
+        obj.SetState("second");
+        BOOST_CHECK(flatdb.Flush(obj));
+        BOOST_CHECK(boost::filesystem::file_size(GetDataDir() / "journal.dat.log") > nLogSize);
+    }
+
+    // Snapshot and log together give the last flushed state
+    CJournalTestObject objLoaded = LoadObject("journal.dat");
+    BOOST_CHECK(objLoaded.mapEntries == obj.mapEntries);
+    BOOST_CHECK_EQUAL(objLoaded.strState, "second");
+
+    {
+        CJournaledFlatDB<CJournalTestObject> flatdb("journal.dat", "magicJournalTest");
+        BOOST_CHECK(flatdb.Load(objLoaded));
+        uintmax_t nSnapshotSize = boost::filesystem::file_size(GetDataDir() / "journal.dat");
+        uintmax_t nLogSize = boost::filesystem::file_size(GetDataDir() / "journal.dat.log");
+
+        // The log is still smaller than the snapshot, so the shutdown dump only appends
+        objLoaded.Erase(7);
+        BOOST_CHECK(flatdb.Dump(objLoaded));
+        BOOST_CHECK_EQUAL(boost::filesystem::file_size(GetDataDir() / "journal.dat"), nSnapshotSize);
+        BOOST_CHECK(boost::filesystem::file_size(GetDataDir() / "journal.dat.log") > nLogSize);
+    }
+
+    CJournalTestObject objDumped = LoadObject("journal.dat");
+    BOOST_CHECK_EQUAL(objDumped.mapEntries.size(), 99U);
+    BOOST_CHECK(!objDumped.mapEntries.count(7));
+    BOOST_CHECK(objDumped.mapEntries.count(200));
+}
+
+BOOST_AUTO_TEST_CASE(journal_dump_compacts_big_log)
+{
+    CJournalTestObject obj;
+    obj.Set(0, "entry");
+    obj.Set(1, "entry");
+
+    uintmax_t nLogSize;
+    {
+        CJournaledFlatDB<CJournalTestObject> flatdb("big.dat", "magicJournalTest");
+        CJournalTestObject objEmpty;
+        BOOST_CHECK(flatdb.Load(objEmpty));
+        BOOST_CHECK(flatdb.Flush(obj));
+        nLogSize = boost::filesystem::file_size(GetDataDir() / "big.dat.log");
+
+        // Flushes only compact once the log reaches MIN_COMPACT_LOG_SIZE
+        for (int i = 0; i < 20; i++) {
+            obj.Set(0, strprintf("value %d", i));
+            BOOST_CHECK(flatdb.Flush(obj));
+        }
+        BOOST_CHECK(boost::filesystem::file_size(GetDataDir() / "big.dat.log") > boost::filesystem::file_size(GetDataDir() / "big.dat"));
+
+        // The log outgrew the snapshot, the shutdown dump compacts it
+        obj.Erase(1);
+        BOOST_CHECK(flatdb.Dump(obj));
+        BOOST_CHECK_EQUAL(boost::filesystem::file_size(GetDataDir() / "big.dat.log"), nLogSize);
+    }
+
+    // The log of the previous snapshot is not replayed after compaction
+    CJournalTestObject objCompacted = LoadObject("big.dat");
+    BOOST_CHECK_EQUAL(objCompacted.mapEntries.size(), 1U);
+    BOOST_CHECK_EQUAL(objCompacted.mapEntries[0], "value 19");
+}
+
+BOOST_AUTO_TEST_CASE(journal_torn_log)
+{
+    CJournalTestObject obj;
+    for (int i = 0; i < 10; i++)
+        obj.Set(i, "entry");
+
+    {
+        CJournaledFlatDB<CJournalTestObject> flatdb("torn.dat", "magicJournalTest");
+        CJournalTestObject objEmpty;
+        BOOST_CHECK(flatdb.Load(objEmpty));
+        BOOST_CHECK(flatdb.Flush(obj));
+        obj.Set(10, "first flush");
+        BOOST_CHECK(flatdb.Flush(obj));
+        obj.Set(11, "second flush");
+        BOOST_CHECK(flatdb.Flush(obj));
+    }
+
+    // Cut the last record in half, like a crash during the write
+    boost::filesystem::path pathLog = GetDataDir() / "torn.dat.log";
+    boost::filesystem::resize_file(pathLog, boost::filesystem::file_size(pathLog) - 5);
+
+    CJournalTestObject objLoaded = LoadObject("torn.dat");
+    BOOST_CHECK_EQUAL(objLoaded.mapEntries.size(), 11U);
+    BOOST_CHECK(objLoaded.mapEntries.count(10));
+    BOOST_CHECK(!objLoaded.mapEntries.count(11));
+
+    // A file of another format is recreated
+    FILE* file = fopen((GetDataDir() / "other.dat").string().c_str(), "wb");
+    fputs("not a journal", file);
+    fclose(file);
+    CJournalTestObject objOther = LoadObject("other.dat");
+    BOOST_CHECK(objOther.mapEntries.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
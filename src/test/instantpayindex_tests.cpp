@@ -0,0 +1,87 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "txdb.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(instantpayindex_tests, BasicTestingSetup)
+
+typedef std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > instantpay_entries_t;
+
+static void CheckRange(CBlockTreeDB& db, const std::vector<CInstantPayIndexKey>& vecAll, int nStart, int nEnd)
+{
+    std::vector<CInstantPayIndexKey> vecRange;
+    for (const CInstantPayIndexKey& key : vecAll) {
+        if (key.timestamp >= (unsigned int)nStart && key.timestamp <= (unsigned int)nEnd)
+            vecRange.push_back(key);
+    }
+
+    int nCount, nFirst, nLast;
+    BOOST_CHECK(db.ReadInstantPayIndexCount(nCount, nFirst, nLast, nStart, nEnd));
+    BOOST_CHECK_EQUAL(nCount, (int)vecRange.size());
+    if (vecRange.empty())
+        return;
+    BOOST_CHECK_EQUAL(nFirst, (int)vecRange.front().timestamp);
+    BOOST_CHECK_EQUAL(nLast, (int)vecRange.back().timestamp);
+
+    // Pages in both directions
+    for (int nOffset : {0, 1, nCount / 2, nCount - 1}) {
+        size_t nPageSize = std::min(7, nCount - nOffset);
+
+        instantpay_entries_t vecPage;
+        BOOST_CHECK(db.ReadInstantPayIndex(vecPage, nFirst, nOffset, nPageSize, false));
+        BOOST_CHECK_EQUAL(vecPage.size(), nPageSize);
+        for (size_t i = 0; i < vecPage.size(); i++)
+            BOOST_CHECK(vecPage[i].first == vecRange[nOffset + i]);
+
+        vecPage.clear();
+        BOOST_CHECK(db.ReadInstantPayIndex(vecPage, nLast, nOffset, nPageSize, true));
+        BOOST_CHECK_EQUAL(vecPage.size(), nPageSize);
+        for (size_t i = 0; i < vecPage.size(); i++)
+            BOOST_CHECK(vecPage[i].first == vecRange[vecRange.size() - 1 - nOffset - i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(instantpayindex_buckets)
+{
+    CBlockTreeDB db(1 << 20, true);
+    BOOST_CHECK(db.UpgradeInstantPayIndex());
+
+    std::vector<CInstantPayIndexKey> vecAll;
+    unsigned int nTime = 1500000000;
+
+    // Mostly appended, some flushes reach back into earlier buckets
+    for (int nFlush = 0; nFlush < 20; nFlush++) {
+        instantpay_entries_t vecEntries;
+        for (int i = 0; i < 15; i++) {
+            unsigned int nEntryTime = nTime + GetRandInt(300);
+            if (nFlush % 5 == 4)
+                nEntryTime -= INSTANTPAY_INDEX_BUCKET_SECONDS * (1 + GetRandInt(5));
+            CInstantPayIndexKey key(nEntryTime, GetRandHash());
+            vecEntries.push_back(std::make_pair(key, CInstantPayValue(true, 5, 6, 100)));
+            vecAll.push_back(key);
+        }
+        // Rewriting known entries doesn't count them again
+        if (nFlush > 0)
+            vecEntries.push_back(std::make_pair(vecAll.front(), CInstantPayValue(true, 6, 6, 100)));
+        BOOST_CHECK(db.WriteInstantPayIndex(vecEntries));
+        nTime += GetRandInt(3 * INSTANTPAY_INDEX_BUCKET_SECONDS);
+    }
+    std::sort(vecAll.begin(), vecAll.end());
+
+    CheckRange(db, vecAll, 0, std::numeric_limits<int>::max());
+    CheckRange(db, vecAll, vecAll[10].timestamp, vecAll[250].timestamp);
+    CheckRange(db, vecAll, vecAll[100].timestamp + 1, vecAll[101].timestamp + INSTANTPAY_INDEX_BUCKET_SECONDS);
+    CheckRange(db, vecAll, vecAll.back().timestamp + 1, vecAll.back().timestamp + 100);
+
+    // Counting the buckets again gives the same result
+    db.WriteFlag("instantpaybuckets", false);
+    BOOST_CHECK(db.UpgradeInstantPayIndex());
+    CheckRange(db, vecAll, vecAll[3].timestamp, vecAll[200].timestamp);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonwriter.h"
+#include "rpc/protocol.h"
+#include "test/test_bitcoin.h"
+
+#include <univalue.h>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonwriter_tests, BasicTestingSetup)
+
+static void AppendChunk(std::vector<std::string>* pvecChunks, const std::string& strChunk)
+{
+    pvecChunks->push_back(strChunk);
+}
+
+static std::string StreamWrite(const UniValue& value, unsigned int nPrettyIndent, size_t nChunkSize, size_t* pnChunks = NULL)
+{
+    std::vector<std::string> vecChunks;
+    CJSONStreamWriter writer(boost::bind(AppendChunk, &vecChunks, _1), nPrettyIndent, nChunkSize);
+    writer.Value(value);
+    writer.Flush();
+
+    std::string str;
+    for (const std::string& strChunk : vecChunks) {
+        BOOST_CHECK(!strChunk.empty());
+        str += strChunk;
+    }
+    if (pnChunks)
+        *pnChunks = vecChunks.size();
+    return str;
+}
+
+static UniValue TestValue()
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("string", "quote \" backslash \\ newline \n tab \t");
+    obj.pushKV("int", 42);
+    obj.pushKV("negative", (int64_t)-7);
+    obj.pushKV("real", 0.5);
+    obj.pushKV("true", true);
+    obj.pushKV("false", false);
+    obj.pushKV("null", NullUniValue);
+    obj.pushKV("emptyobject", UniValue(UniValue::VOBJ));
+    obj.pushKV("emptyarray", UniValue(UniValue::VARR));
+    obj.pushKV("key \"escaped\"", "value");
+
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < 100; i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("index", i);
+        UniValue nested(UniValue::VARR);
+        nested.push_back(i);
+        nested.push_back(UniValue(UniValue::VARR));
+        nested.push_back(strprintf("entry %d", i));
+        entry.pushKV("nested", nested);
+        arr.push_back(entry);
+    }
+    obj.pushKV("array", arr);
+
+    return obj;
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_identical)
+{
+    UniValue value = TestValue();
+
+    // Containers, scalars and top level scalars, compact and indented like RPC and SAPI replies
+    std::vector<UniValue> vecValues = {value, value["array"], value["emptyobject"], value["emptyarray"], value["string"], value["int"], NullUniValue};
+
+    for (const UniValue& val : vecValues) {
+        for (unsigned int nIndent : {0, 1, 2, 4}) {
+            std::string strExpected = val.write(nIndent);
+            BOOST_CHECK_EQUAL(StreamWrite(val, nIndent, DEFAULT_JSON_CHUNK_SIZE), strExpected);
+            BOOST_CHECK_EQUAL(StreamWrite(val, nIndent, 1), strExpected);
+            BOOST_CHECK_EQUAL(StreamWrite(val, nIndent, 100), strExpected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_chunks)
+{
+    UniValue value = TestValue();
+    std::string strExpected = value.write(2);
+
+    // Chunks are passed on once they reach the chunk size
+    size_t nChunks;
+    BOOST_CHECK_EQUAL(StreamWrite(value, 2, 256, &nChunks), strExpected);
+    BOOST_CHECK(nChunks > 1);
+    BOOST_CHECK(nChunks <= strExpected.size() / 256 + 1);
+
+    BOOST_CHECK_EQUAL(StreamWrite(value, 2, strExpected.size() + 1, &nChunks), strExpected);
+    BOOST_CHECK_EQUAL(nChunks, 1U);
+
+    // Small replies never reach the handler
+    std::vector<std::string> vecChunks;
+    CJSONStreamWriter writer(boost::bind(AppendChunk, &vecChunks, _1), 0, 1024);
+    writer.BeginArray();
+    writer.Value(UniValue("small"));
+    writer.End();
+    writer.Raw("\n");
+    BOOST_CHECK(!writer.Flushed());
+    BOOST_CHECK_EQUAL(writer.Release(), "[\"small\"]\n");
+    BOOST_CHECK(vecChunks.empty());
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_members)
+{
+    UniValue value = TestValue();
+    UniValue before(UniValue::VOBJ), after(UniValue::VOBJ);
+    before.pushKV("string", value["string"]);
+    before.pushKV("int", value["int"]);
+    after.pushKV("real", value["real"]);
+
+    UniValue expected = before;
+    expected.pushKV("array", value["array"]);
+    expected.pushKV("real", value["real"]);
+
+    // Members around an array written element by element, like a streamed block
+    for (unsigned int nIndent : {0, 2}) {
+        std::vector<std::string> vecChunks;
+        CJSONStreamWriter writer(boost::bind(AppendChunk, &vecChunks, _1), nIndent, 32);
+        writer.BeginObject();
+        writer.Members(before);
+        writer.Key("array");
+        writer.BeginArray();
+        for (size_t i = 0; i < value["array"].size(); i++)
+            writer.Value(value["array"][i]);
+        writer.End();
+        writer.Members(UniValue(UniValue::VOBJ));
+        writer.Members(after);
+        writer.End();
+        writer.Flush();
+
+        std::string str;
+        for (const std::string& strChunk : vecChunks)
+            str += strChunk;
+        BOOST_CHECK_EQUAL(str, expected.write(nIndent));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_rpc_reply)
+{
+    UniValue result = TestValue();
+    UniValue id("id");
+
+    std::vector<std::string> vecChunks;
+    CJSONStreamWriter writer(boost::bind(AppendChunk, &vecChunks, _1), 0, 64);
+    JSONRPCWriteReply(writer, result, NullUniValue, id);
+    writer.Flush();
+    std::string strReply;
+    for (const std::string& strChunk : vecChunks)
+        strReply += strChunk;
+    BOOST_CHECK_EQUAL(strReply, JSONRPCReply(result, NullUniValue, id));
+
+    UniValue error = JSONRPCError(RPC_MISC_ERROR, "error");
+    CJSONStreamWriter writerError(boost::bind(AppendChunk, &vecChunks, _1));
+    JSONRPCWriteReply(writerError, result, error, id);
+    BOOST_CHECK_EQUAL(writerError.Release(), JSONRPCReply(result, error, id));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
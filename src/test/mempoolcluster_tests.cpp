@@ -0,0 +1,352 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txmempool.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(mempoolcluster_tests, BasicTestingSetup)
+
+static CMutableTransaction SpendTx(const std::vector<COutPoint> &vPrevouts, int nOutputs, int nTag)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(vPrevouts.size());
+    for (size_t i = 0; i < vPrevouts.size(); i++)
+        tx.vin[i].prevout = vPrevouts[i];
+    if (vPrevouts.empty()) {
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << nTag;
+    }
+    tx.vout.resize(nOutputs);
+    for (int i = 0; i < nOutputs; i++) {
+        tx.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[i].nValue = COIN;
+    }
+    return tx;
+}
+
+static CMutableTransaction SpendTx(const CMutableTransaction &txParent, int nTag)
+{
+    return SpendTx(std::vector<COutPoint>(1, COutPoint(txParent.GetHash(), 0)), 1, nTag);
+}
+
+static void AddTx(CTxMemPool &pool, CMutableTransaction &tx, CAmount nFee)
+{
+    TestMemPoolEntryHelper entry;
+    pool.addUnchecked(tx.GetHash(), entry.Fee(nFee).FromTx(tx, &pool));
+}
+
+static const CTxMemPool::TxCluster &GetCluster(CTxMemPool &pool, const CMutableTransaction &tx)
+{
+    CTxMemPool::txiter it = pool.mapTx.find(tx.GetHash());
+    BOOST_REQUIRE(it != pool.mapTx.end());
+    return pool.GetCluster(it);
+}
+
+// The cached descendant state matches a full walk for every entry
+static void CheckDescendantState(CTxMemPool &pool)
+{
+    LOCK(pool.cs);
+    for (CTxMemPool::txiter it = pool.mapTx.begin(); it != pool.mapTx.end(); ++it) {
+        CTxMemPool::setEntries setDescendants;
+        pool.CalculateDescendants(it, setDescendants);
+        CTxMemPool::TxCluster descendants;
+        BOOST_FOREACH(CTxMemPool::txiter descendantIt, setDescendants)
+            descendants.Add(*descendantIt);
+        BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), descendants.nCount);
+        BOOST_CHECK_EQUAL(it->GetSizeWithDescendants(), descendants.nSize);
+        BOOST_CHECK_EQUAL(it->GetModFeesWithDescendants(), descendants.nModFees);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mempoolcluster_merge_split)
+{
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    // Two chains, A with three and B with two transactions
+    CMutableTransaction txA0 = SpendTx(std::vector<COutPoint>(), 1, 1);
+    CMutableTransaction txA1 = SpendTx(txA0, 2);
+    CMutableTransaction txA2 = SpendTx(txA1, 3);
+    CMutableTransaction txB0 = SpendTx(std::vector<COutPoint>(), 1, 4);
+    CMutableTransaction txB1 = SpendTx(txB0, 5);
+    AddTx(pool, txA0, 1000);
+    AddTx(pool, txA1, 2000);
+    AddTx(pool, txA2, 3000);
+    AddTx(pool, txB0, 4000);
+    AddTx(pool, txB1, 5000);
+
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 2U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA0).nCount, 3U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA2).nModFees, 6000);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txB0).nCount, 2U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txB1).nModFees, 9000);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA0).nSize + GetCluster(pool, txB0).nSize, pool.GetTotalTxSize());
+
+    // C spends both chains and joins them
+    std::vector<COutPoint> vPrevouts;
+    vPrevouts.push_back(COutPoint(txA2.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txB1.GetHash(), 0));
+    CMutableTransaction txC = SpendTx(vPrevouts, 1, 6);
+    AddTx(pool, txC, 6000);
+
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 1U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA0).nCount, 6U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txB0).nModFees, 21000);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txC).nSize, pool.GetTotalTxSize());
+    BOOST_CHECK_EQUAL(GetCluster(pool, txC).nRoots, 2U);
+
+    // Fee deltas count for the cluster
+    pool.PrioritiseTransaction(txB0.GetHash(), txB0.GetHash().ToString(), 0, 500);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA0).nModFees, 21500);
+
+    // Mining C splits the cluster again
+    pool.remove(txC, removed, false);
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 2U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA1).nCount, 3U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txB1).nCount, 2U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txB1).nModFees, 9500);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA1).nRoots, 1U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txB1).nRoots, 1U);
+
+    // Mining the root of a chain leaves the rest of it together
+    pool.remove(txA0, removed, false);
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 2U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA2).nCount, 2U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA2).nModFees, 5000);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txA2).nRoots, 1U);
+
+    // Removing everything leaves no clusters behind
+    pool.remove(txA1, removed, true);
+    pool.remove(txB0, removed, true);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 0U);
+    CheckDescendantState(pool);
+}
+
+BOOST_AUTO_TEST_CASE(mempoolcluster_fanout)
+{
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    // A payout: the root pays ten outputs, each spent by a chain of three
+    CMutableTransaction txRoot = SpendTx(std::vector<COutPoint>(), 10, 1);
+    AddTx(pool, txRoot, 10000);
+    std::vector<CMutableTransaction> vChains;
+    for (int i = 0; i < 10; i++) {
+        vChains.push_back(SpendTx(std::vector<COutPoint>(1, COutPoint(txRoot.GetHash(), i)), 1, 0));
+        AddTx(pool, vChains.back(), 1000);
+        for (int j = 0; j < 2; j++) {
+            vChains.push_back(SpendTx(vChains.back(), 0));
+            AddTx(pool, vChains.back(), 1000);
+        }
+    }
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 1U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txRoot).nCount, 31U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txRoot).nModFees, 40000);
+    CheckDescendantState(pool);
+
+    // Mining the root leaves ten separate chains
+    pool.remove(txRoot, removed, false);
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 10U);
+    for (size_t i = 0; i < vChains.size(); i++) {
+        BOOST_CHECK_EQUAL(GetCluster(pool, vChains[i]).nCount, 3U);
+        BOOST_CHECK_EQUAL(GetCluster(pool, vChains[i]).nModFees, 3000);
+        BOOST_CHECK_EQUAL(GetCluster(pool, vChains[i]).nRoots, 1U);
+    }
+    CheckDescendantState(pool);
+
+    // Conflicting out one link of every chain splits off the chain tails
+    CTxMemPool pool2(CFeeRate(0));
+    AddTx(pool2, txRoot, 10000);
+    for (size_t i = 0; i < vChains.size(); i++)
+        AddTx(pool2, vChains[i], 1000);
+    for (size_t i = 1; i < vChains.size(); i += 3)
+        pool2.remove(vChains[i], removed, true);
+    BOOST_CHECK_EQUAL(pool2.GetClusterCount(), 1U);
+    BOOST_CHECK_EQUAL(GetCluster(pool2, txRoot).nCount, 11U);
+    BOOST_CHECK_EQUAL(pool2.mapTx.find(txRoot.GetHash())->GetCountWithDescendants(), 11U);
+    CheckDescendantState(pool2);
+}
+
+BOOST_AUTO_TEST_CASE(mempoolcluster_remove_descendant_state)
+{
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    // A long chain, conflicted out from the middle
+    std::vector<CMutableTransaction> vChain(1, SpendTx(std::vector<COutPoint>(), 1, 1));
+    AddTx(pool, vChain.back(), 1000);
+    for (int i = 1; i < 200; i++) {
+        vChain.push_back(SpendTx(vChain.back(), 0));
+        AddTx(pool, vChain.back(), 1000 + i);
+    }
+    BOOST_CHECK_EQUAL(pool.mapTx.find(vChain[0].GetHash())->GetCountWithDescendants(), 200U);
+
+    pool.remove(vChain[120], removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 80U);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(vChain[0].GetHash())->GetCountWithDescendants(), 120U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, vChain[0]).nCount, 120U);
+    CheckDescendantState(pool);
+
+    // A diamond P -> C1, C2 -> G -> X, removing C1 takes G and X along
+    CMutableTransaction txP = SpendTx(std::vector<COutPoint>(), 2, 2);
+    CMutableTransaction txC1 = SpendTx(std::vector<COutPoint>(1, COutPoint(txP.GetHash(), 0)), 1, 0);
+    CMutableTransaction txC2 = SpendTx(std::vector<COutPoint>(1, COutPoint(txP.GetHash(), 1)), 1, 0);
+    std::vector<COutPoint> vPrevouts;
+    vPrevouts.push_back(COutPoint(txC1.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txC2.GetHash(), 0));
+    CMutableTransaction txG = SpendTx(vPrevouts, 1, 0);
+    CMutableTransaction txX = SpendTx(txG, 0);
+    AddTx(pool, txP, 100);
+    AddTx(pool, txC1, 200);
+    AddTx(pool, txC2, 300);
+    AddTx(pool, txG, 400);
+    AddTx(pool, txX, 500);
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 2U);
+    CheckDescendantState(pool);
+
+    pool.remove(txC1, removed, true);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txP.GetHash())->GetCountWithDescendants(), 2U);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txP.GetHash())->GetModFeesWithDescendants(), 400);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txC2.GetHash())->GetCountWithDescendants(), 1U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txC2).nCount, 2U);
+    CheckDescendantState(pool);
+
+    // Evicting everything by size keeps the state consistent along the way
+    while (pool.size() > 0) {
+        pool.TrimToSize(pool.DynamicMemoryUsage() * 9 / 10);
+        CheckDescendantState(pool);
+    }
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(mempoolcluster_trim)
+{
+    CTxMemPool pool(CFeeRate(0));
+
+    // A and B both paid by C, all at the same feerate, and a better paying H
+    CMutableTransaction txA = SpendTx(std::vector<COutPoint>(), 1, 1);
+    CMutableTransaction txB = SpendTx(std::vector<COutPoint>(), 1, 2);
+    std::vector<COutPoint> vPrevouts;
+    vPrevouts.push_back(COutPoint(txA.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txB.GetHash(), 0));
+    CMutableTransaction txC = SpendTx(vPrevouts, 1, 0);
+    CMutableTransaction txH = SpendTx(std::vector<COutPoint>(), 1, 3);
+    AddTx(pool, txA, 10 * ::GetSerializeSize(txA, SER_NETWORK, PROTOCOL_VERSION));
+    AddTx(pool, txB, 10 * ::GetSerializeSize(txB, SER_NETWORK, PROTOCOL_VERSION));
+    AddTx(pool, txC, 10 * ::GetSerializeSize(txC, SER_NETWORK, PROTOCOL_VERSION));
+    AddTx(pool, txH, 100000);
+    const CTxMemPool::TxCluster cluster = GetCluster(pool, txC);
+    BOOST_CHECK_EQUAL(cluster.nCount, 3U);
+    BOOST_CHECK_EQUAL(cluster.nRoots, 2U);
+    BOOST_CHECK_EQUAL(cluster.nUsage + GetCluster(pool, txH).nUsage, CTxMemPool::GetEntryUsage(*pool.mapTx.find(txA.GetHash())) +
+        CTxMemPool::GetEntryUsage(*pool.mapTx.find(txB.GetHash())) + CTxMemPool::GetEntryUsage(*pool.mapTx.find(txC.GetHash())) +
+        CTxMemPool::GetEntryUsage(*pool.mapTx.find(txH.GetHash())));
+
+    // Freeing a single byte doesn't take the whole cluster
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(pool.exists(txH.GetHash()));
+    BOOST_CHECK(pool.size() >= 2U);
+    BOOST_CHECK(pool.size() < 4U);
+    CheckDescendantState(pool);
+
+    // Freeing the usage of the cluster evicts all of it, the rolling fee is
+    // bumped by the package feerate
+    CTxMemPool pool2(CFeeRate(0));
+    AddTx(pool2, txA, 10 * ::GetSerializeSize(txA, SER_NETWORK, PROTOCOL_VERSION));
+    AddTx(pool2, txB, 10 * ::GetSerializeSize(txB, SER_NETWORK, PROTOCOL_VERSION));
+    AddTx(pool2, txC, 10 * ::GetSerializeSize(txC, SER_NETWORK, PROTOCOL_VERSION));
+    AddTx(pool2, txH, 100000);
+    pool2.TrimToSize(pool2.DynamicMemoryUsage() - cluster.nUsage);
+    BOOST_CHECK_EQUAL(pool2.size(), 1U);
+    BOOST_CHECK(pool2.exists(txH.GetHash()));
+    BOOST_CHECK_EQUAL(pool2.GetClusterCount(), 1U);
+    BOOST_CHECK(pool2.GetMinFee(1).GetFeePerK() >= CFeeRate(10000).GetFeePerK());
+}
+
+BOOST_AUTO_TEST_CASE(mempoolcluster_reorg)
+{
+    CTxMemPool pool(CFeeRate(0));
+
+    // A block with R0 and R1 spending it is disconnected while the mempool
+    // holds a chain of 50 spending R1 and a chain of 120 spending R0
+    CMutableTransaction txR0 = SpendTx(std::vector<COutPoint>(), 2, 1);
+    CMutableTransaction txR1 = SpendTx(txR0, 0);
+    std::vector<CMutableTransaction> vChain(1, SpendTx(txR1, 0));
+    AddTx(pool, vChain.back(), 1000);
+    for (int i = 1; i < 50; i++) {
+        vChain.push_back(SpendTx(vChain.back(), 0));
+        AddTx(pool, vChain.back(), 1000);
+    }
+    vChain.push_back(SpendTx(std::vector<COutPoint>(1, COutPoint(txR0.GetHash(), 1)), 1, 0));
+    AddTx(pool, vChain.back(), 1000);
+    for (int i = 1; i < 120; i++) {
+        vChain.push_back(SpendTx(vChain.back(), 0));
+        AddTx(pool, vChain.back(), 1000);
+    }
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 2U);
+
+    AddTx(pool, txR0, 5000);
+    AddTx(pool, txR1, 5000);
+    std::vector<uint256> vHashUpdate;
+    vHashUpdate.push_back(txR0.GetHash());
+    vHashUpdate.push_back(txR1.GetHash());
+    pool.UpdateTransactionsFromBlock(vHashUpdate);
+
+    BOOST_CHECK_EQUAL(pool.GetClusterCount(), 1U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txR0).nRoots, 1U);
+    BOOST_CHECK_EQUAL(GetCluster(pool, txR0).nModFees, 180000);
+
+    // R0 is the only root and takes its state from the cluster, even though
+    // it has more than 100 descendants outside of the block
+    CTxMemPool::txiter it = pool.mapTx.find(txR0.GetHash());
+    BOOST_CHECK(!it->IsDirty());
+    BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), 172U);
+    BOOST_CHECK_EQUAL(it->GetModFeesWithDescendants(), 180000);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txR1.GetHash())->GetCountWithDescendants(), 51U);
+    CheckDescendantState(pool);
+}
+
+BOOST_AUTO_TEST_CASE(mempoolcluster_ancestor_limits)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    LOCK(pool.cs);
+
+    // A root paying 30 children
+    CMutableTransaction txRoot = SpendTx(std::vector<COutPoint>(), 30, 1);
+    AddTx(pool, txRoot, 1000);
+    std::vector<CMutableTransaction> vChildren;
+    for (int i = 0; i < 30; i++) {
+        vChildren.push_back(SpendTx(std::vector<COutPoint>(1, COutPoint(txRoot.GetHash(), i)), 1, 0));
+        AddTx(pool, vChildren.back(), 1000);
+    }
+    CMutableTransaction txNew = SpendTx(vChildren[7], 0);
+    CTxMemPoolEntry entryNew = entry.FromTx(txNew);
+    CTxMemPool::setEntries setAncestors;
+    std::string errString;
+
+    // The cluster is within the limits
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(entryNew, setAncestors, 100, 1000000, 100, 1000000, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 2U);
+
+    // The cluster is not, but the ancestors are
+    setAncestors.clear();
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(entryNew, setAncestors, 10, 1000000, 100, 1000000, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 2U);
+
+    // The root has too many descendants
+    setAncestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(entryNew, setAncestors, 100, 1000000, 31, 1000000, errString));
+    BOOST_CHECK_EQUAL(errString, strprintf("too many descendants for tx %s [limit: %u]", txRoot.GetHash().ToString(), 31));
+
+    // Too many ancestors
+    setAncestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(entryNew, setAncestors, 2, 1000000, 100, 1000000, errString));
+    BOOST_CHECK_EQUAL(errString, strprintf("too many unconfirmed ancestors [limit: %u]", 2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
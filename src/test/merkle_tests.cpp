@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "consensus/merkle.h"
+#include "crypto/sha256.h"
 #include "test/test_bitcoin.h"
 #include "random.h"
 
@@ -68,7 +69,7 @@ BOOST_AUTO_TEST_CASE(merkle_test)
 {
     for (int i = 0; i < 32; i++) {
         // Try 32 block sizes: all sizes from 0 to 16 inclusive, and then 15 random sizes.
-        int ntx = (i <= 16) ? i : 17 + (insecure_rand() % 4000);
+        int ntx = (i <= 16) ? i : 17 + GetRandInt(4000);
         // Try up to 3 mutations.
         for (int mutate = 0; mutate <= 3; mutate++) {
             int duplicate1 = mutate >= 1 ? 1 << ctz(ntx) : 0; // The last how many transactions to duplicate first.
@@ -121,7 +122,7 @@ BOOST_AUTO_TEST_CASE(merkle_test)
                     // If ntx <= 16, try all branches. Otherise, try 16 random ones.
                     int mtx = loop;
                     if (ntx > 16) {
-                        mtx = insecure_rand() % ntx;
+                        mtx = GetRandInt(ntx);
                     }
                     std::vector<uint256> newBranch = BlockMerkleBranch(block, mtx);
                     std::vector<uint256> oldBranch = BlockGetMerkleBranch(block, merkleTree, mtx);
@@ -133,4 +134,60 @@ BOOST_AUTO_TEST_CASE(merkle_test)
     }
 }
 
+// Merkle root hashing one pair at a time, for comparison with the batched SHA256D64 code.
+static uint256 ScalarMerkleRoot(std::vector<uint256> hashes, bool* fMutated)
+{
+    bool mutated = false;
+    while (hashes.size() > 1) {
+        std::vector<uint256> next;
+        for (size_t i = 0; i < hashes.size(); i += 2) {
+            size_t i2 = std::min(i + 1, hashes.size() - 1);
+            if (i2 == i + 1 && hashes[i] == hashes[i2])
+                mutated = true;
+            uint256 h;
+            CHash256().Write(hashes[i].begin(), 32).Write(hashes[i2].begin(), 32).Finalize(h.begin());
+            next.push_back(h);
+        }
+        hashes.swap(next);
+    }
+    *fMutated = mutated;
+    return hashes.empty() ? uint256() : hashes[0];
+}
+
+BOOST_AUTO_TEST_CASE(merkle_sha256d64_test)
+{
+    // Use the widest SHA256D64 kernel the CPU supports
+    SHA256AutoDetect();
+
+    const size_t sizes[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000, 1023, 1024, 1025, 10000 };
+    for (size_t nLeaves : sizes) {
+        std::vector<uint256> leaves(nLeaves);
+        for (size_t i = 0; i < nLeaves; i++)
+            leaves[i] = GetRandHash();
+
+        bool scalarMutated, batchedMutated;
+        BOOST_CHECK(ComputeMerkleRoot(leaves, &batchedMutated) == ScalarMerkleRoot(leaves, &scalarMutated));
+        BOOST_CHECK(!batchedMutated && !scalarMutated);
+
+        // Duplicated last pair
+        if (nLeaves >= 2 && nLeaves % 2 == 0) {
+            leaves[nLeaves - 1] = leaves[nLeaves - 2];
+            BOOST_CHECK(ComputeMerkleRoot(leaves, &batchedMutated) == ScalarMerkleRoot(leaves, &scalarMutated));
+            BOOST_CHECK(batchedMutated && scalarMutated);
+        }
+    }
+
+    // The merkle tree of CBlock is built with the same kernels
+    for (int ntx = 0; ntx < 40; ntx++) {
+        CBlock block;
+        block.vtx.resize(ntx);
+        for (int j = 0; j < ntx; j++) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = j;
+            block.vtx[j] = mtx;
+        }
+        BOOST_CHECK(block.BuildMerkleTree() == BlockMerkleRoot(block));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -10,9 +10,17 @@
 #include "streams.h"
 #include "net.h"
 #include "chainparams.h"
+#include "netbase.h"
 
 using namespace std;
 
+static CNetAddr ResolveIP(const char* ip)
+{
+    CNetAddr addr;
+    LookupHost(ip, addr, false);
+    return addr;
+}
+
 class CAddrManSerializationMock : public CAddrMan
 {
 public:
@@ -22,7 +30,7 @@ public:
     void MakeDeterministic()
     {
         nKey.SetNull();
-        seed_insecure_rand(true);
+        insecure_rand = FastRandomContext(true);
     }
 };
 
@@ -51,8 +59,8 @@ public:
         int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
         s << nUBuckets;
 
-        CAddress addr = CAddress(CService("252.1.1.1", 7777), NODE_NONE);
-        CAddrInfo info = CAddrInfo(addr, CNetAddr("252.2.2.2"));
+        CAddress addr = CAddress(LookupNumeric("252.1.1.1", 7777), NODE_NONE);
+        CAddrInfo info = CAddrInfo(addr, ResolveIP("252.2.2.2"));
         s << info;
     }
 };
@@ -74,14 +82,14 @@ BOOST_AUTO_TEST_CASE(caddrdb_read)
     CAddrManUncorrupted addrmanUncorrupted;
     addrmanUncorrupted.MakeDeterministic();
 
-    CService addr1 = CService("250.7.1.1", 8333);
-    CService addr2 = CService("250.7.2.2", 9999);
-    CService addr3 = CService("250.7.3.3", 9999);
+    CService addr1 = LookupNumeric("250.7.1.1", 8333);
+    CService addr2 = LookupNumeric("250.7.2.2", 9999);
+    CService addr3 = LookupNumeric("250.7.3.3", 9999);
 
     // Add three addresses to new table.
-    addrmanUncorrupted.Add(CAddress(addr1, NODE_NONE), CService("252.5.1.1", 8333));
-    addrmanUncorrupted.Add(CAddress(addr2, NODE_NONE), CService("252.5.1.1", 8333));
-    addrmanUncorrupted.Add(CAddress(addr3, NODE_NONE), CService("252.5.1.1", 8333));
+    addrmanUncorrupted.Add(CAddress(addr1, NODE_NONE), LookupNumeric("252.5.1.1", 8333));
+    addrmanUncorrupted.Add(CAddress(addr2, NODE_NONE), LookupNumeric("252.5.1.1", 8333));
+    addrmanUncorrupted.Add(CAddress(addr3, NODE_NONE), LookupNumeric("252.5.1.1", 8333));
 
     // Test that the de-serialization does not throw an exception.
     CDataStream ssPeers1 = AddrmanToStream(addrmanUncorrupted);
@@ -154,14 +162,26 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     bool fInboundIn = false;
 
     // Test that fFeeler is false by default.
-    CNode* pnode1 = new CNode(hSocket, addr, pszDest, fInboundIn);
+    CNode* pnode1 = new CNode(0, NODE_NETWORK, 0, hSocket, addr, 0, 0, pszDest, fInboundIn);
     BOOST_CHECK(pnode1->fInbound == false);
     BOOST_CHECK(pnode1->fFeeler == false);
 
     fInboundIn = true;
-    CNode* pnode2 = new CNode(hSocket, addr, pszDest, fInboundIn);
+    CNode* pnode2 = new CNode(0, NODE_NETWORK, 0, hSocket, addr, 0, 0, pszDest, fInboundIn);
     BOOST_CHECK(pnode2->fInbound == true);
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(message_priority)
+{
+    BOOST_CHECK_EQUAL(GetMessagePriority(NetMsgType::BLOCK), MSG_PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(GetMessagePriority(NetMsgType::HEADERS), MSG_PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(GetMessagePriority(NetMsgType::TX), MSG_PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(GetMessagePriority(NetMsgType::VERSION), MSG_PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(GetMessagePriority("unknown"), MSG_PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(GetMessagePriority(NetMsgType::MNPING), MSG_PRIORITY_LOW);
+    BOOST_CHECK_EQUAL(GetMessagePriority(NetMsgType::TXLOCKVOTE), MSG_PRIORITY_LOW);
+    BOOST_CHECK_EQUAL(GetMessagePriority(NetMsgType::SMARTNODEPAYMENTVOTE), MSG_PRIORITY_LOW);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,8 +2,11 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "fixed.h"
+#include "libzerocoin/bitcoin_bignum/bignum.h"
 #include "pow.h"
 #include "random.h"
 #include "util.h"
@@ -95,4 +98,150 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/** The retarget as it was computed with CBigNum, the reference for the arith_uint256 implementation */
+static unsigned int LegacyDifficultyFunction(const CBlockIndex* pindexLast, uint32_t TargetBlocksSpacingSeconds, uint32_t PastBlocksMin, uint32_t PastBlocksMax)
+{
+    const CBigNum bnProofOfWorkLimit(ArithToUint256(~arith_uint256(0) >> 20));
+    const CBlockIndex *BlockLastSolved = pindexLast;
+    const CBlockIndex *BlockReading = pindexLast;
+    typedef numeric::Fixed<32, 32> fixed;
+
+    uint32_t nPastBlocks = 0;
+    int32_t nActualSeconds = 0;
+    int32_t nTargetSeconds = 0;
+    fixed nBlockTimeRatio = 1;
+    CBigNum bnPastTargetAverage;
+    CBigNum bnPastTargetAveragePrev;
+
+    if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 || (uint64_t)BlockLastSolved->nHeight < PastBlocksMin)
+        return pindexLast->nBits;
+
+    for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
+        if (PastBlocksMax > 0 && i > PastBlocksMax)
+            break;
+        nPastBlocks++;
+
+        if (i == 1)
+            bnPastTargetAverage.SetCompact(BlockReading->nBits);
+        else
+            bnPastTargetAverage = ((CBigNum().SetCompact(BlockReading->nBits) - bnPastTargetAveragePrev) / i) + bnPastTargetAveragePrev;
+        bnPastTargetAveragePrev = bnPastTargetAverage;
+        nActualSeconds = BlockLastSolved->GetBlockTime() - BlockReading->GetBlockTime();
+        nTargetSeconds = TargetBlocksSpacingSeconds * nPastBlocks;
+        nBlockTimeRatio = 1;
+        if (nActualSeconds < 1)
+            nActualSeconds = 1;
+        if (nActualSeconds != 0 && nTargetSeconds != 0)
+            nBlockTimeRatio = double(nTargetSeconds) / nActualSeconds;
+
+        if (nPastBlocks >= PastBlocksMin) {
+            if ((nBlockTimeRatio <= SlowBlocksLimit[nPastBlocks-1]) || (nBlockTimeRatio >= FastBlocksLimit[nPastBlocks-1]))
+                break;
+        }
+
+        if (BlockReading->pprev == NULL)
+            break;
+        BlockReading = BlockReading->pprev;
+    }
+
+    if (bnPastTargetAverage < (CBigNum().SetCompact(BlockLastSolved->nBits) / 2))
+        bnPastTargetAverage = CBigNum().SetCompact(BlockLastSolved->nBits) / 2;
+    if (bnPastTargetAverage > (CBigNum().SetCompact(BlockLastSolved->nBits) * 2))
+        bnPastTargetAverage = CBigNum().SetCompact(BlockLastSolved->nBits) * 2;
+
+    CBigNum bnNew(bnPastTargetAverage);
+    if (nActualSeconds != 0 && nTargetSeconds != 0) {
+        if (nActualSeconds > 3 * nTargetSeconds)
+            nActualSeconds = 3 * nTargetSeconds;
+        if (nActualSeconds < nTargetSeconds / 3)
+            nActualSeconds = nTargetSeconds / 3;
+        bnNew *= nActualSeconds;
+        bnNew /= nTargetSeconds;
+    }
+
+    if (bnNew > bnProofOfWorkLimit)
+        bnNew = bnProofOfWorkLimit;
+
+    return bnNew.GetCompact();
+}
+
+/**
+ * Build a chain whose difficulty follows the retarget rules. The block times switch
+ * between steady mining, hashrate spikes, stalls and timestamps going backwards.
+ */
+static void BuildRetargetChain(FastRandomContext& rand, int nStartHeight, unsigned int nStartBits, std::vector<CBlockIndex>& blocks, std::vector<uint256>& hashes)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    static unsigned int nChains = 0;
+    int nMode = 0;
+
+    nChains++;
+
+    for (size_t i = 0; i < blocks.size(); i++) {
+        CBlockIndex& block = blocks[i];
+        hashes[i] = ArithToUint256(arith_uint256(nChains) << 128 | (i + 1));
+        block.phashBlock = &hashes[i];
+        block.pprev = i ? &blocks[i - 1] : NULL;
+        block.nHeight = nStartHeight + i;
+
+        if (rand.rand32(200) == 0)
+            nMode = rand.rand32(4);
+
+        int64_t nSpacing;
+        switch (nMode) {
+            case 1:  nSpacing = rand.rand32(10); break;                   // hashrate spike
+            case 2:  nSpacing = 600 + rand.rand32(3000); break;           // stall
+            case 3:  nSpacing = (int64_t)rand.rand32(200) - 100; break;   // inaccurate clocks
+            default: nSpacing = 1 + rand.rand32(110); break;              // ~55s blocks
+        }
+        block.nTime = i ? blocks[i - 1].nTime + nSpacing : 1499000000;
+        block.nBits = i ? GetNextWorkRequired(block.pprev, NULL, params) : nStartBits;
+    }
+}
+
+/* The arith_uint256 retarget has to match the CBigNum one on every block */
+BOOST_AUTO_TEST_CASE(retarget_equivalence)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    FastRandomContext rand(true);
+
+    // Early chain, around the switch to 10 block retargets at height 90000, and a later chain
+    const int nStartHeights[] = { 0, 88000, 500000 };
+    const unsigned int nStartBits[] = { 0x1e0ffff0, 0x1b0404cb, 0x1c00a3f5, 0x1d00ffff, 0x1f0fffff };
+
+    for (int nStartHeight : nStartHeights) {
+        for (unsigned int nBits : nStartBits) {
+            std::vector<CBlockIndex> blocks(4000);
+            std::vector<uint256> hashes(blocks.size());
+            BuildRetargetChain(rand, nStartHeight, nBits, blocks, hashes);
+
+            for (const CBlockIndex& block : blocks) {
+                // Both parameter sets used by GetNextWorkRequired
+                BOOST_CHECK_EQUAL(BorisRidiculouslyNamedDifficultyFunction(&block, 55, 0, 10), LegacyDifficultyFunction(&block, 55, 0, 10));
+                BOOST_CHECK_EQUAL(BorisRidiculouslyNamedDifficultyFunction(&block, 55, 2, 785), LegacyDifficultyFunction(&block, 55, 2, 785));
+                // Cached result
+                BOOST_CHECK_EQUAL(BorisRidiculouslyNamedDifficultyFunction(&block, 55, 2, 785), LegacyDifficultyFunction(&block, 55, 2, 785));
+            }
+        }
+    }
+}
+
+/* Targets close to 2^256 don't overflow */
+BOOST_AUTO_TEST_CASE(retarget_large_targets)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    FastRandomContext rand(true);
+
+    std::vector<CBlockIndex> blocks(1000);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = 1499000000 + i * 55 + rand.rand32(1000);
+        blocks[i].nBits = rand.rand32(2) ? 0x207fffff : 0x2100ffff;
+    }
+
+    for (const CBlockIndex& block : blocks)
+        BOOST_CHECK_EQUAL(BorisRidiculouslyNamedDifficultyFunction(&block, 55, 2, 785), LegacyDifficultyFunction(&block, 55, 2, 785));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,12 +6,16 @@
 #include "rpc/client.h"
 
 #include "base58.h"
+#include "jsonwriter.h"
 #include "netbase.h"
+#include "txmempool.h"
+#include "validation.h"
 
 #include "test/test_bitcoin.h"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <univalue.h>
@@ -48,6 +52,27 @@ UniValue CallRPC(string args)
     }
 }
 
+static void AppendChunk(string* pstr, const string& strChunk)
+{
+    pstr->append(strChunk);
+}
+
+/** Result of the stream actor of args, written in small chunks. False if it was left to the actor. */
+static bool CallRPCStreamed(string args, string& strResult)
+{
+    vector<string> vArgs;
+    boost::split(vArgs, args, boost::is_any_of(" \t"));
+    string strMethod = vArgs[0];
+    vArgs.erase(vArgs.begin());
+    UniValue params = RPCConvertValues(strMethod, vArgs);
+    BOOST_REQUIRE(tableRPC[strMethod] && tableRPC[strMethod]->streamActor);
+    strResult.clear();
+    CJSONStreamWriter writer(boost::bind(AppendChunk, &strResult, _1), 0, 64);
+    if (!(*tableRPC[strMethod]->streamActor)(params, writer))
+        return false;
+    writer.Flush();
+    return true;
+}
 
 BOOST_FIXTURE_TEST_SUITE(rpc_tests, TestingSetup)
 
@@ -332,4 +357,36 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_streamed_results)
+{
+    string strResult;
+    string strGenesis = chainActive.Genesis()->GetBlockHash().GetHex();
+
+    // Streamed results are the same JSON the actors return
+    BOOST_CHECK(CallRPCStreamed("getblock " + strGenesis, strResult));
+    BOOST_CHECK_EQUAL(strResult, CallRPC("getblock " + strGenesis).write());
+    BOOST_CHECK(CallRPCStreamed("getblock " + strGenesis + " true", strResult));
+    BOOST_CHECK_EQUAL(strResult, CallRPC("getblock " + strGenesis).write());
+    BOOST_CHECK_THROW(CallRPCStreamed("getblock 0000000000000000000000000000000000000000000000000000000000000001", strResult), UniValue);
+
+    TestMemPoolEntryHelper entry;
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 10 * COIN;
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        mempool.addUnchecked(tx.GetHash(), entry.Fee(1000 * (i + 1)).FromTx(tx));
+    }
+    BOOST_CHECK(CallRPCStreamed("getrawmempool true", strResult));
+    BOOST_CHECK_EQUAL(strResult, CallRPC("getrawmempool true").write());
+    mempool.clear();
+
+    // The hex block and the txid list are left to the actors
+    BOOST_CHECK(!CallRPCStreamed("getblock " + strGenesis + " false", strResult));
+    BOOST_CHECK(!CallRPCStreamed("getrawmempool", strResult));
+    BOOST_CHECK(!CallRPCStreamed("getrawmempool false", strResult));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
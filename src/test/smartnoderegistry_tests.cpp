@@ -0,0 +1,185 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "smartnode/smartnoderegistry.h"
+#include "clientversion.h"
+#include "netbase.h"
+#include "streams.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(smartnoderegistry_tests, BasicTestingSetup)
+
+static CSmartnode MakeSmartnode(int n, const std::string& strAddr)
+{
+    CKey keyCollateral, keySmartnode;
+    keyCollateral.MakeNewKey(true);
+    keySmartnode.MakeNewKey(true);
+    COutPoint outpoint(ArithToUint256(arith_uint256(n + 1)), n % 2);
+    CSmartnode mn(LookupNumeric(strAddr.c_str(), 9678), outpoint, keyCollateral.GetPubKey(), keySmartnode.GetPubKey(), PROTOCOL_VERSION);
+    mn.nBlockLastPaid = 1000 - n;
+    return mn;
+}
+
+// Every smartnode can be found through every index
+static void CheckIndexes(CSmartnodeRegistry& registry)
+{
+    std::vector<CSmartnode> vecSmartnodes(registry.begin(), registry.end());
+    int nEnabled = 0;
+    for (const CSmartnode& mn : vecSmartnodes) {
+        CSmartnode* pmn = registry.Find(mn.vin.prevout);
+        BOOST_REQUIRE(pmn);
+        BOOST_CHECK(pmn->vin == mn.vin);
+        BOOST_CHECK(registry.FindByPubKey(mn.pubKeySmartnode) == pmn);
+        BOOST_CHECK(registry.FindByCollateral(mn.pubKeyCollateralAddress.GetID()) == pmn);
+        std::vector<CSmartnode*> vecSameAddr = registry.FindByAddr(mn.addr);
+        BOOST_CHECK(std::find(vecSameAddr.begin(), vecSameAddr.end(), pmn) != vecSameAddr.end());
+        bool fEnabled = mn.nActiveState == CSmartnode::SMARTNODE_ENABLED;
+        BOOST_CHECK_EQUAL(registry.GetPaymentQueue().count(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout)), fEnabled ? 1U : 0U);
+        nEnabled += fEnabled;
+    }
+    BOOST_CHECK_EQUAL(registry.GetPaymentQueue().size(), (size_t)nEnabled);
+    BOOST_CHECK_EQUAL(registry.Count(0), (int)vecSmartnodes.size());
+    BOOST_CHECK_EQUAL(registry.Count(0, CSmartnode::SMARTNODE_ENABLED), nEnabled);
+    BOOST_CHECK_EQUAL(registry.GetList()->size(), vecSmartnodes.size());
+}
+
+BOOST_AUTO_TEST_CASE(smartnoderegistry_add_erase)
+{
+    CSmartnodeRegistry registry;
+    std::vector<CSmartnode> vecSmartnodes;
+    for (int i = 0; i < 20; i++) {
+        vecSmartnodes.push_back(MakeSmartnode(i, strprintf("10.0.0.%d", i % 5 + 1)));
+        BOOST_CHECK(registry.Add(vecSmartnodes.back()));
+    }
+    BOOST_CHECK(!registry.Add(vecSmartnodes[3]));
+    BOOST_CHECK_EQUAL(registry.size(), 20U);
+    BOOST_CHECK_EQUAL(registry.FindByAddr(LookupNumeric("10.0.0.2", 9678)).size(), 4U);
+    CheckIndexes(registry);
+
+    // Erase moves the last smartnode into the slot, iterating goes on from there
+    CSmartnodeRegistry::iterator it = registry.begin();
+    while (it != registry.end()) {
+        if (it->vin.prevout.n == 1)
+            it = registry.Erase(it);
+        else
+            ++it;
+    }
+    BOOST_CHECK_EQUAL(registry.size(), 10U);
+    for (const CSmartnode& mn : vecSmartnodes)
+        BOOST_CHECK_EQUAL(registry.Find(mn.vin.prevout) != NULL, mn.vin.prevout.n == 0);
+    BOOST_CHECK(!registry.FindByPubKey(vecSmartnodes[1].pubKeySmartnode));
+    BOOST_CHECK_EQUAL(registry.FindByAddr(LookupNumeric("10.0.0.2", 9678)).size(), 2U);
+    CheckIndexes(registry);
+
+    // The payment queue is ordered by last paid block
+    int nLastPaid = -1;
+    for (const auto& queued : registry.GetPaymentQueue()) {
+        BOOST_CHECK(queued.first > nLastPaid);
+        nLastPaid = queued.first;
+    }
+
+    registry.Clear();
+    BOOST_CHECK(registry.empty());
+    BOOST_CHECK(registry.GetPaymentQueue().empty());
+    BOOST_CHECK_EQUAL(registry.Count(0), 0);
+}
+
+BOOST_AUTO_TEST_CASE(smartnoderegistry_update)
+{
+    CSmartnodeRegistry registry;
+    for (int i = 0; i < 10; i++)
+        registry.Add(MakeSmartnode(i, strprintf("10.0.1.%d", i + 1)));
+
+    CSmartnodeListRef list = registry.GetList();
+    // Nothing changed, the list is shared
+    for (auto& mn : registry)
+        registry.Update(&mn);
+    BOOST_CHECK(registry.GetList() == list);
+
+    CSmartnode* pmn = &*(registry.begin() + 4);
+    pmn->nActiveState = CSmartnode::SMARTNODE_EXPIRED;
+    pmn->addr = LookupNumeric("10.0.1.1", 9678);
+    pmn->nProtocolVersion = PROTOCOL_VERSION - 1;
+    registry.Update(pmn);
+    CheckIndexes(registry);
+    BOOST_CHECK_EQUAL(registry.FindByAddr(LookupNumeric("10.0.1.1", 9678)).size(), 2U);
+    BOOST_CHECK_EQUAL(registry.Count(PROTOCOL_VERSION), 9);
+    BOOST_CHECK_EQUAL(registry.CountByState()[CSmartnode::SMARTNODE_EXPIRED], 1);
+    BOOST_CHECK(registry.GetList() != list);
+    BOOST_CHECK_EQUAL(list->at(4).GetStatus(), "ENABLED");
+    BOOST_CHECK_EQUAL(registry.GetList()->at(4).GetStatus(), "EXPIRED");
+
+    // Getting paid moves a smartnode to the end of the queue
+    CSmartnode* pmnFirst = registry.Find(registry.GetPaymentQueue().begin()->second);
+    pmnFirst->nBlockLastPaid = 2000;
+    registry.Update(pmnFirst);
+    BOOST_CHECK(registry.GetPaymentQueue().rbegin()->second == pmnFirst->vin.prevout);
+    CheckIndexes(registry);
+
+    std::vector<CSmartnode*> vecSorted = registry.GetSortedByAddr();
+    BOOST_CHECK_EQUAL(vecSorted.size(), 10U);
+    for (size_t i = 1; i < vecSorted.size(); i++)
+        BOOST_CHECK(!(vecSorted[i]->addr < vecSorted[i - 1]->addr));
+}
+
+BOOST_AUTO_TEST_CASE(smartnoderegistry_changed)
+{
+    CSmartnodeRegistry registry;
+    for (int i = 0; i < 10; i++)
+        registry.Add(MakeSmartnode(i, strprintf("10.0.3.%d", i + 1)));
+
+    std::set<COutPoint> setChanged;
+    registry.TakeChanged(setChanged);
+    BOOST_CHECK_EQUAL(setChanged.size(), 10U);
+    registry.TakeChanged(setChanged);
+    BOOST_CHECK(setChanged.empty());
+
+    // An Update without changes to the indexed fields doesn't need a journal record
+    for (auto& mn : registry)
+        registry.Update(&mn);
+    registry.TakeChanged(setChanged);
+    BOOST_CHECK(setChanged.empty());
+
+    CSmartnode* pmnPaid = &*(registry.begin() + 2);
+    pmnPaid->nBlockLastPaid = 2000;
+    registry.Update(pmnPaid);
+    CSmartnode* pmnBanned = &*(registry.begin() + 5);
+    pmnBanned->nPoSeBanScore++;
+    registry.SetChanged(pmnBanned);
+    COutPoint outpointErased = registry.begin()->vin.prevout;
+    registry.Erase(registry.begin());
+
+    registry.TakeChanged(setChanged);
+    BOOST_CHECK_EQUAL(setChanged.size(), 3U);
+    BOOST_CHECK(setChanged.count(pmnPaid->vin.prevout));
+    BOOST_CHECK(setChanged.count(pmnBanned->vin.prevout));
+    BOOST_CHECK(setChanged.count(outpointErased));
+}
+
+BOOST_AUTO_TEST_CASE(smartnoderegistry_serialize)
+{
+    CSmartnodeRegistry registry;
+    for (int i = 0; i < 5; i++)
+        registry.Add(MakeSmartnode(i, "10.0.2.1"));
+
+    // Same format as the map it replaced in mncache.dat
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << registry;
+    BOOST_CHECK_EQUAL(ss.size(), registry.GetSerializeSize(SER_DISK, CLIENT_VERSION));
+    std::map<COutPoint, CSmartnode> mapSmartnodes;
+    ss >> mapSmartnodes;
+    BOOST_CHECK_EQUAL(mapSmartnodes.size(), 5U);
+    for (const auto& mnpair : mapSmartnodes)
+        BOOST_CHECK(registry.Find(mnpair.first));
+
+    ss << mapSmartnodes;
+    CSmartnodeRegistry registryRead;
+    ss >> registryRead;
+    BOOST_CHECK_EQUAL(registryRead.size(), 5U);
+    CheckIndexes(registryRead);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -48,7 +48,7 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
 
         // Sign:
         std::vector<unsigned char> vchSig;
-        uint256 hash = SignatureHash(scriptPubKey, spends[i], 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        uint256 hash = SignatureHash(scriptPubKey, spends[i], 0, SIGHASH_ALL);
         BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
         vchSig.push_back((unsigned char)SIGHASH_ALL);
         spends[i].vin[0].scriptSig << vchSig;
@@ -83,4 +83,96 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+static CMutableTransaction
+SpendTx(const COutPoint& prevout, const CScript& scriptPubKey, const CKey& key, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return tx;
+}
+
+/** Accept txns one by one and as a batch, each starting with an empty mempool, and compare the outcome */
+static void
+CheckBatchMatchesSerial(const std::vector<CMutableTransaction>& txns, std::vector<CTxAcceptResult>& vResults)
+{
+    LOCK(cs_main);
+
+    std::vector<CTransaction> vtx(txns.begin(), txns.end());
+    std::vector<const CTransaction*> vptx;
+    BOOST_FOREACH(const CTransaction& tx, vtx)
+        vptx.push_back(&tx);
+
+    mempool.clear();
+    std::vector<CTxAcceptResult> vSerial(vtx.size());
+    for (size_t i = 0; i < vtx.size(); i++)
+        vSerial[i].fAccepted = AcceptToMemoryPool(mempool, vSerial[i].state, vtx[i], false, &vSerial[i].fMissingInputs);
+    size_t nSerialSize = mempool.size();
+
+    mempool.clear();
+    AcceptToMemoryPoolBatch(mempool, vptx, vResults, false);
+    BOOST_CHECK_EQUAL(mempool.size(), nSerialSize);
+    mempool.clear();
+
+    BOOST_REQUIRE_EQUAL(vResults.size(), vtx.size());
+    for (size_t i = 0; i < vtx.size(); i++) {
+        int nDoSSerial = 0, nDoSBatch = 0;
+        BOOST_CHECK_EQUAL(vResults[i].fAccepted, vSerial[i].fAccepted);
+        BOOST_CHECK_EQUAL(vResults[i].fMissingInputs, vSerial[i].fMissingInputs);
+        BOOST_CHECK_EQUAL(vResults[i].state.GetRejectReason(), vSerial[i].state.GetRejectReason());
+        BOOST_CHECK_EQUAL(vResults[i].state.GetRejectCode(), vSerial[i].state.GetRejectCode());
+        BOOST_CHECK_EQUAL(vResults[i].state.IsInvalid(nDoSBatch), vSerial[i].state.IsInvalid(nDoSSerial));
+        BOOST_CHECK_EQUAL(nDoSBatch, nDoSSerial);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(tx_mempool_batch, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    std::vector<CMutableTransaction> txns;
+    // Valid spends of mature coinbase txns, and a child of the first one
+    txns.push_back(SpendTx(COutPoint(coinbaseTxns[0].GetHash(), 0), scriptPubKey, coinbaseKey, 11*CENT));
+    txns.push_back(SpendTx(COutPoint(coinbaseTxns[1].GetHash(), 0), scriptPubKey, coinbaseKey, 11*CENT));
+    txns.push_back(SpendTx(COutPoint(txns[0].GetHash(), 0), scriptPubKey, coinbaseKey, 10*CENT));
+
+    // Signed by the wrong key
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    txns.push_back(SpendTx(COutPoint(coinbaseTxns[2].GetHash(), 0), scriptPubKey, keyOther, 11*CENT));
+
+    // Orphan
+    txns.push_back(SpendTx(COutPoint(GetRandHash(), 0), scriptPubKey, coinbaseKey, 11*CENT));
+
+    std::vector<CTxAcceptResult> vResults;
+
+    // Parallel path, the fixture runs script check threads
+    BOOST_REQUIRE(nScriptCheckThreads > 0);
+    CheckBatchMatchesSerial(txns, vResults);
+    BOOST_CHECK(!vResults[3].fAccepted);
+    BOOST_CHECK(vResults[3].state.IsInvalid());
+    BOOST_CHECK(!vResults[4].fAccepted);
+    BOOST_CHECK(vResults[4].fMissingInputs);
+    BOOST_CHECK(!vResults[4].state.IsInvalid());
+
+    // Without the invalid one no script check fails
+    std::vector<CMutableTransaction> txnsValid(txns.begin(), txns.begin() + 3);
+    CheckBatchMatchesSerial(txnsValid, vResults);
+
+    // Without script check threads the batch is accepted serially
+    int nScriptCheckThreadsOld = nScriptCheckThreads;
+    nScriptCheckThreads = 0;
+    CheckBatchMatchesSerial(txns, vResults);
+    nScriptCheckThreads = nScriptCheckThreadsOld;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+// Copyright (c) 2018-2020 The SmartCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "smartvoting/votedb.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(votedb_tests, BasicTestingSetup)
+
+static CVoteKey RandomVoteKey()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return CVoteKey(key.GetPubKey().GetID());
+}
+
+static CProposalVote MakeVote(const CVoteKey& voteKey, const uint256& nProposalHash, int64_t nTime)
+{
+    CProposalVote vote(voteKey, nProposalHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(votefile_memory_only)
+{
+    // Without a database nothing gets evicted
+    uint256 nProposalHash = GetRandHash();
+    CVoteKey voteKey = RandomVoteKey();
+    CProposalVoteFile file;
+
+    for (int i = 0; i < 1500; i++)
+        file.AddVote(MakeVote(voteKey, nProposalHash, i));
+
+    BOOST_CHECK_EQUAL(file.GetVoteCount(), 1500);
+    BOOST_CHECK_EQUAL(file.GetVotes().size(), 1500U);
+    BOOST_CHECK(file.HasVote(MakeVote(voteKey, nProposalHash, 0).GetHash()));
+
+    file.RemoveVotesFromVotingKey(voteKey);
+    BOOST_CHECK_EQUAL(file.GetVoteCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(votefile_spill_to_disk)
+{
+    pvotedb = new CProposalVoteDB(1 << 20, true);
+
+    uint256 nProposalHash = GetRandHash();
+    CVoteKey voteKey1 = RandomVoteKey();
+    CVoteKey voteKey2 = RandomVoteKey();
+    CProposalVoteFile file;
+    std::vector<uint256> vecHashes;
+
+    for (int i = 0; i < 3000; i++) {
+        CProposalVote vote = MakeVote(i % 2 ? voteKey2 : voteKey1, nProposalHash, i);
+        vecHashes.push_back(vote.GetHash());
+        file.AddVote(vote);
+        // Known votes are not added twice
+        file.AddVote(vote);
+    }
+
+    BOOST_CHECK_EQUAL(file.GetVoteCount(), 3000);
+    BOOST_CHECK_EQUAL(file.GetVotes().size(), 3000U);
+    BOOST_CHECK_EQUAL(file.GetVoteHashes().size(), 3000U);
+
+    // The oldest votes are only on disk but still known and served
+    for (int i : {0, 1, 1500, 2999}) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        BOOST_CHECK(file.HasVote(vecHashes[i]));
+        BOOST_CHECK(file.SerializeVoteToStream(vecHashes[i], ss));
+        CProposalVote vote;
+        ss >> vote;
+        BOOST_CHECK(vote.GetHash() == vecHashes[i]);
+    }
+    BOOST_CHECK(!file.HasVote(GetRandHash()));
+
+    // Only the recent votes end up in the cache file
+    CDataStream ssFile(SER_DISK, CLIENT_VERSION);
+    ssFile << file;
+    BOOST_CHECK(ssFile.size() < 3000 * 100);
+
+    CProposalVoteFile fileLoaded;
+    ssFile >> fileLoaded;
+    fileLoaded.Load(nProposalHash);
+    BOOST_CHECK_EQUAL(fileLoaded.GetVoteCount(), 3000);
+    BOOST_CHECK(fileLoaded.HasVote(vecHashes[0]));
+
+    // Removal covers memory and disk
+    fileLoaded.RemoveVotesFromVotingKey(voteKey2);
+    BOOST_CHECK_EQUAL(fileLoaded.GetVoteCount(), 1500);
+    BOOST_CHECK(fileLoaded.HasVote(vecHashes[0]));
+    BOOST_CHECK(!fileLoaded.HasVote(vecHashes[1]));
+    BOOST_CHECK(!fileLoaded.HasVote(vecHashes[2999]));
+    BOOST_CHECK_EQUAL(fileLoaded.GetVotes().size(), 1500U);
+
+    BOOST_CHECK(pvotedb->EraseProposal(nProposalHash));
+    std::vector<uint256> vecLeft;
+    BOOST_CHECK(pvotedb->ReadVoteHashes(nProposalHash, vecLeft));
+    BOOST_CHECK(vecLeft.empty());
+
+    delete pvotedb;
+    pvotedb = NULL;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
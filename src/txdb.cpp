@@ -6,12 +6,14 @@
 #include "txdb.h"
 
 #include "chainparams.h"
+#include "crypto/muhash.h"
 #include "hash.h"
 #include "pow.h"
 #include "uint256.h"
 #include "ui_interface.h"
 #include "init.h"
 
+#include <limits>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -22,11 +24,7 @@ static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
-static const char DB_ADDRESSINDEX = 'a';
-static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
-static const char DB_SPENTINDEX = 'p';
-static const char DB_DEPOSITINDEX = 'd';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_VOTE_KEY_REGISTRATION = 'r';
@@ -34,6 +32,18 @@ static const char DB_VOTE_MAP_ADDRESS_TO_KEY = 'v';
 static const char DB_VOTE_MAP_KEY_TO_ADDRESS = 'V';
 
 static const char DB_INSTANTPAY_INDEX = 'i';
+static const char DB_INSTANTPAY_BUCKET = 'I';
+static const char DB_INSTANTPAY_RANK = 'J';
+
+// Written by the address indexes before they got their own database
+static const char DB_LEGACY_ADDRESSINDEX = 'a';
+static const char DB_LEGACY_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_LEGACY_SPENTINDEX = 'p';
+static const char DB_LEGACY_DEPOSITINDEX = 'd';
+
+static const char DB_COINSTATS = 'S';
+static const char DB_COINSTATS_BEST = 'U';
+static const char DB_COINSTATS_MUHASH = 'M';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
@@ -84,10 +94,16 @@ uint256 CCoinsViewDB::GetBestBlock() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool ret = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -97,8 +113,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
@@ -113,6 +127,194 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsViewDB *pdbIn, bool fAsyncIn) :
+    pdb(pdbIn), fAsync(fAsyncIn), nFrozenUsage(0), fFailed(false), fStop(false)
+{
+    if (fAsync)
+        threadWriter = boost::thread(&CCoinsViewBackgroundFlush::ThreadWriter, this);
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    if (!fAsync)
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+    }
+    condFlush.notify_all();
+    threadWriter.join();
+}
+
+void CCoinsViewBackgroundFlush::ThreadWriter()
+{
+    RenameThread("smartcash-coinsflush");
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (true) {
+        while (!pFrozen && !fStop)
+            condFlush.wait(lock);
+        // Pending coins are always written, the destructor only runs after the last flush
+        if (!pFrozen)
+            break;
+
+        // The snapshot is not modified until it is released below
+        const CCoinsMap &mapFrozen = *pFrozen;
+        uint256 hashBlock = hashFrozenBlock;
+        int64_t nStart = GetTimeMicros();
+
+        lock.unlock();
+        bool fOk = false;
+        try {
+            fOk = pdb->WriteCoins(mapFrozen, hashBlock);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        lock.lock();
+
+        stats.nLastDuration = GetTimeMicros() - nStart;
+        stats.nLastCoins = mapFrozen.size();
+        stats.nPendingCoins = 0;
+        stats.nFlushes++;
+        if (!fOk) {
+            LogPrintf("%s: failed to write %u coins to the coin database\n", __func__, (unsigned int)mapFrozen.size());
+            fFailed = true;
+        }
+        LogPrint("coindb", "%s: wrote %u coins in %.2fms\n", __func__, (unsigned int)stats.nLastCoins, stats.nLastDuration * 0.001);
+
+        pFrozen.reset();
+        pFrozenResource.reset();
+        nFrozenUsage = 0;
+        condFlush.notify_all();
+    }
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    if (fAsync) {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pFrozen) {
+            CCoinsMap::const_iterator it = pFrozen->find(outpoint);
+            if (it != pFrozen->end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    return pdb->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const
+{
+    if (fAsync) {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pFrozen) {
+            CCoinsMap::const_iterator it = pFrozen->find(outpoint);
+            if (it != pFrozen->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return pdb->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    if (fAsync) {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pFrozen && !hashFrozenBlock.IsNull())
+            return hashFrozenBlock;
+    }
+    return pdb->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    if (!fAsync)
+        return pdb->BatchWrite(mapCoins, hashBlock);
+
+    // Backpressure: a single snapshot is in flight
+    int64_t nStart = GetTimeMicros();
+    bool fOk = WaitForFlush();
+    int64_t nWait = GetTimeMicros() - nStart;
+    if (!fOk) {
+        mapCoins.clear();
+        return false;
+    }
+
+    std::unique_ptr<CCoinsMapMemoryResource> pResource(new CCoinsMapMemoryResource());
+    std::unique_ptr<CCoinsMap> pMap(new CCoinsMap(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), pResource.get()));
+    pMap->reserve(mapCoins.size());
+    size_t nUsage = 0;
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CCoinsCacheEntry &entry = (*pMap)[it->first];
+            entry.coin = std::move(it->second.coin);
+            entry.flags = CCoinsCacheEntry::DIRTY;
+            nUsage += entry.coin.DynamicMemoryUsage();
+        }
+    }
+    mapCoins.clear();
+    nUsage += memusage::DynamicUsage(*pMap);
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        stats.nTotalWaitTime += nWait;
+        stats.nPendingCoins = pMap->size();
+        pFrozenResource = std::move(pResource);
+        pFrozen = std::move(pMap);
+        hashFrozenBlock = hashBlock;
+        nFrozenUsage = nUsage;
+    }
+    condFlush.notify_all();
+
+    return true;
+}
+
+CCoinsViewCursor *CCoinsViewBackgroundFlush::Cursor() const
+{
+    // The cursor iterates the database only
+    WaitForFlush();
+    return pdb->Cursor();
+}
+
+size_t CCoinsViewBackgroundFlush::EstimateSize() const
+{
+    return pdb->EstimateSize();
+}
+
+bool CCoinsViewBackgroundFlush::WaitForFlush() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (pFrozen)
+        condFlush.wait(lock);
+    return !fFailed;
+}
+
+bool CCoinsViewBackgroundFlush::HasFailed() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return fFailed;
+}
+
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return nFrozenUsage;
+}
+
+uint256 CCoinsViewBackgroundFlush::GetCommittedBestBlock() const
+{
+    return pdb->GetBestBlock();
+}
+
+CCoinsFlushStats CCoinsViewBackgroundFlush::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return stats;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -213,59 +415,25 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
-}
-
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
+    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex) {
+bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
-
-    lastIndex.SetNull();
-    nCount = 0;
-
-    std::pair<char,CAddressUnspentKey> key;
+    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            ++nCount;
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
+            hashes.push_back(key.second.blockHash);
             pcursor->Next();
-        } else if( nCount ) {
-
-            pcursor->Prev();
-
-            if(pcursor->Valid() && pcursor->GetKey(key))
-                lastIndex = key.second;
-
-            break;
-        }else{
+        } else {
             break;
         }
     }
@@ -273,328 +441,253 @@ bool CBlockTreeDB::ReadAddressUnspentIndexCount(uint160 addressHash, int type, i
     return true;
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
-                                           const CAddressUnspentKey &start, int offset, int limit, bool reverse) {
+bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &timestamp, uint256 &blockHash) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-    int nOffsetCount = 0, nFound = 0;
-
-    if( start.IsNull() )
-        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    else
-        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, start));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            if (limit > 0 && nFound == limit) {
-                break;
-            }
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
 
-                if( offset < 0 || ++nOffsetCount > offset ){
-                    unspentOutputs.push_back(make_pair(key.second, nValue));
-                    ++nFound;
-                }
+    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(timestamp)));
 
-                if( reverse ) pcursor->Prev();
-                else          pcursor->Next();
+    blockHash.SetNull();
 
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
-            break;
+    if (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX) {
+            blockHash = key.second.blockHash;
+            return true;
         }
     }
 
-    return true;
+    return false;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+/**
+ * The instantpay index keeps a record for every non-empty time bucket with the
+ * number of its entries and the number of entries before it (DB_INSTANTPAY_BUCKET)
+ * and maps the position of the first entry of each bucket back to the bucket
+ * (DB_INSTANTPAY_RANK). Counting and paging seek into the bucket records and only
+ * walk the entries of a single bucket.
+ */
+static unsigned int GetInstantPayBucket(unsigned int nTime)
+{
+    return nTime - nTime % INSTANTPAY_INDEX_BUCKET_SECONDS;
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+/** Position the cursor at the last key before keyAfter */
+template<typename K>
+static bool SeekBefore(CDBIterator *pcursor, const K& keyAfter)
+{
+    pcursor->Seek(keyAfter);
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else
+        pcursor->SeekToLast();
+    return pcursor->Valid();
 }
 
-
-bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    if (start > 0 && end > 0) {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    }
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
-            }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
-            break;
-        }
+/** Read the last bucket record at or before nBucketTime */
+static bool ReadInstantPayBucketBefore(CDBIterator *pcursor, unsigned int nBucketTime,
+                                       unsigned int &nBucketTimeRet, CInstantPayBucket &bucket)
+{
+    std::pair<char, CInstantPayIndexIteratorTimeKey> key;
+    if (!SeekBefore(pcursor, make_pair(DB_INSTANTPAY_BUCKET, CInstantPayIndexIteratorTimeKey(nBucketTime + 1))) ||
+        !pcursor->GetKey(key) || key.first != DB_INSTANTPAY_BUCKET || !pcursor->GetValue(bucket)) {
+        return false;
     }
-
+    nBucketTimeRet = key.second.timestamp;
     return true;
 }
 
+/** Number of index entries with a timestamp below nTime */
+static int GetInstantPayRank(CDBIterator *pcursor, unsigned int nTime)
+{
+    unsigned int nBucketTime = GetInstantPayBucket(nTime);
+    unsigned int nFoundTime;
+    CInstantPayBucket bucket;
 
-bool CBlockTreeDB::ReadAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(DB_ADDRESSINDEX);
+    if (!ReadInstantPayBucketBefore(pcursor, nBucketTime, nFoundTime, bucket))
+        return 0;
 
-    CAddressIndexKey currentKey = CAddressIndexKey();
-    CAmount currentReceived = 0, currentBalance = 0;
+    if (nFoundTime < nBucketTime)
+        return bucket.nCountBefore + bucket.nCount;
 
+    int nRank = bucket.nCountBefore;
+    pcursor->Seek(make_pair(DB_INSTANTPAY_INDEX, CInstantPayIndexIteratorTimeKey(nBucketTime)));
     while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key)){
-
-            if( currentKey.IsNull() ){
-                currentKey = key.second;
-            }
-
-            if( key.first != DB_ADDRESSINDEX)
-                break;
-
-            if( key.second.hashBytes != currentKey.hashBytes ) {
-
-                if( currentBalance > 0 && (!excludeZeroBalances || (excludeZeroBalances && currentBalance )))
-                    // Save the address info
-                    addressList.push_back(CAddressListEntry(currentKey.type,
-                                                            currentKey.hashBytes,
-                                                            currentReceived,
-                                                            currentBalance));
-
-                // And move on with the next one
-                currentReceived = 0;
-                currentBalance = 0;
-                currentKey = key.second;
-            }
+        std::pair<char, CInstantPayIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_INSTANTPAY_INDEX || key.second.timestamp >= nTime)
+            break;
+        ++nRank;
+        pcursor->Next();
+    }
+    return nRank;
+}
 
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
+/** Number of index entries */
+static int GetInstantPayTotal(CDBIterator *pcursor)
+{
+    return GetInstantPayRank(pcursor, std::numeric_limits<unsigned int>::max());
+}
 
-                if( nEndHeight == -1 || key.second.blockHeight < nEndHeight ){
-                    currentBalance += nValue;
-                    if( nValue > 0)
-                        currentReceived += nValue;
-                }
+/** Position the cursor at the index entry with the given rank */
+static bool SeekInstantPayRank(CDBIterator *pcursor, int nRank)
+{
+    std::pair<char, CInstantPayRankKey> key;
+    unsigned int nBucketTime;
 
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
-            break;
-        }
+    if (nRank < 0 || !SeekBefore(pcursor, make_pair(DB_INSTANTPAY_RANK, CInstantPayRankKey(nRank + 1))) ||
+        !pcursor->GetKey(key) || key.first != DB_INSTANTPAY_RANK || !pcursor->GetValue(nBucketTime)) {
+        return false;
     }
 
-    if( !excludeZeroBalances || (excludeZeroBalances && currentBalance ))
-        // Store the last one..
-        addressList.push_back(CAddressListEntry(currentKey.type,
-                                                currentKey.hashBytes,
-                                                currentReceived,
-                                                currentBalance));
-
-    return true;
-}
+    pcursor->Seek(make_pair(DB_INSTANTPAY_INDEX, CInstantPayIndexIteratorTimeKey(nBucketTime)));
+    for (int i = key.second.rank; i < nRank && pcursor->Valid(); i++) {
+        pcursor->Next();
+    }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
-    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+    std::pair<char, CInstantPayIndexKey> keyEntry;
+    return pcursor->Valid() && pcursor->GetKey(keyEntry) && keyEntry.first == DB_INSTANTPAY_INDEX;
 }
 
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
+/** Count the entries added to the buckets of mapAdded and shift all bucket records after them */
+static void WriteInstantPayBuckets(CDBWrapper &db, CDBBatch &batch, const std::map<unsigned int, int> &mapAdded)
+{
+    if (mapAdded.empty())
+        return;
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    unsigned int nFirstTime = mapAdded.begin()->first;
 
-    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+    int nCountBefore = 0;
+    unsigned int nFoundTime;
+    CInstantPayBucket bucketBefore;
+    if (nFirstTime > 0 && ReadInstantPayBucketBefore(pcursor.get(), nFirstTime - 1, nFoundTime, bucketBefore))
+        nCountBefore = bucketBefore.nCountBefore + bucketBefore.nCount;
 
+    // Entries are added close to the current time, so usually only the last bucket changes
+    std::map<unsigned int, CInstantPayBucket> mapBuckets;
+    pcursor->Seek(make_pair(DB_INSTANTPAY_BUCKET, CInstantPayIndexIteratorTimeKey(nFirstTime)));
     while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
-            hashes.push_back(key.second.blockHash);
-            pcursor->Next();
-        } else {
+        std::pair<char, CInstantPayIndexIteratorTimeKey> key;
+        CInstantPayBucket bucket;
+        if (!pcursor->GetKey(key) || key.first != DB_INSTANTPAY_BUCKET || !pcursor->GetValue(bucket))
             break;
-        }
+        mapBuckets.insert(make_pair(key.second.timestamp, bucket));
+        pcursor->Next();
     }
 
-    return true;
-}
-
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &timestamp, uint256 &blockHash) {
+    for (const auto& added : mapAdded)
+        mapBuckets[added.first];
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    // All moved rank records are erased before any is written, they may take each others keys
+    for (auto& it : mapBuckets) {
+        CInstantPayBucket &bucket = it.second;
+        auto itAdded = mapAdded.find(it.first);
 
-    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(timestamp)));
+        if (bucket.nCount && bucket.nCountBefore != nCountBefore)
+            batch.Erase(make_pair(DB_INSTANTPAY_RANK, CInstantPayRankKey(bucket.nCountBefore)));
 
-    blockHash.SetNull();
+        bucket.nCountBefore = nCountBefore;
+        if (itAdded != mapAdded.end())
+            bucket.nCount += itAdded->second;
 
-    if (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX) {
-            blockHash = key.second.blockHash;
-            return true;
-        }
+        nCountBefore += bucket.nCount;
     }
 
-    return false;
+    for (const auto& it : mapBuckets) {
+        batch.Write(make_pair(DB_INSTANTPAY_BUCKET, CInstantPayIndexIteratorTimeKey(it.first)), it.second);
+        batch.Write(make_pair(DB_INSTANTPAY_RANK, CInstantPayRankKey(it.second.nCountBefore)), it.first);
+    }
 }
 
-bool CBlockTreeDB::WriteDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue > >&vect) {
+bool CBlockTreeDB::WriteInstantPayIndex(const std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &vecEntries)
+{
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_DEPOSITINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
+    std::map<unsigned int, int> mapAdded;
 
-bool CBlockTreeDB::EraseDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(make_pair(DB_DEPOSITINDEX, it->first));
-    return WriteBatch(batch);
-}
+    for (const auto& entry : vecEntries) {
+        // Updated entries are already counted
+        if (!entry.second.fWritten && !Exists(make_pair(DB_INSTANTPAY_INDEX, entry.first)))
+            ++mapAdded[GetInstantPayBucket(entry.first.timestamp)];
+        batch.Write(make_pair(DB_INSTANTPAY_INDEX, entry.first), entry.second);
+    }
 
-bool CBlockTreeDB::ReadDepositIndex(uint160 addressHash, int type,
-                                    std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex,
-                                    int start, int offset, int limit, bool reverse) {
+    WriteInstantPayBuckets(*this, batch, mapAdded);
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    return batch.SizeEstimate() ? WriteBatch(batch) : true;
+}
+
+bool CBlockTreeDB::UpgradeInstantPayIndex()
+{
+    bool fBuckets = false;
+    if (ReadFlag("instantpaybuckets", fBuckets) && fBuckets)
+        return true;
 
-    int nCount = 0;
+    LogPrintf("Counting the entries of the instantpay index...\n");
 
-    if (start > 0) {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorKey(type, addressHash)));
-    }
+    CDBBatch batch(*this);
+    std::map<unsigned int, int> mapAdded;
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
+    pcursor->Seek(DB_INSTANTPAY_BUCKET);
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CDepositIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_DEPOSITINDEX && key.second.hashBytes == addressHash) {
-            if (limit > 0 && depositIndex.size() == (size_t)limit) {
-                break;
-            }
-            CDepositValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                if( ++nCount > offset )
-                    depositIndex.push_back(make_pair(key.second, nValue));
-
-                if( reverse ) pcursor->Prev();
-                else          pcursor->Next();
-
-            } else {
-                return error("failed to get deposit index value");
-            }
-        } else {
+        std::pair<char, CInstantPayIndexIteratorTimeKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_INSTANTPAY_BUCKET)
             break;
-        }
+        batch.Erase(key);
+        pcursor->Next();
     }
 
-    return true;
-}
-
-bool CBlockTreeDB::ReadDepositIndexCount(uint160 addressHash, int type,
-                                    int &count,
-                                    int &firstTime, int &lastTime,
-                                    int start, int end) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    count = 0;
-    firstTime = 0;
-    lastTime = 0;
-
-    if (start > 0) {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorKey(type, addressHash)));
+    pcursor->Seek(DB_INSTANTPAY_RANK);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CInstantPayRankKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_INSTANTPAY_RANK)
+            break;
+        batch.Erase(key);
+        pcursor->Next();
     }
 
+    pcursor->Seek(DB_INSTANTPAY_INDEX);
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CDepositIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_DEPOSITINDEX && key.second.hashBytes == addressHash) {
-
-            if( !firstTime ) firstTime = key.second.timestamp;
-
-            if (end > 0 && key.second.timestamp > (unsigned int)end) {
-                if( !lastTime ) lastTime = firstTime;
-                break;
-            }
-
-            lastTime = key.second.timestamp;
-            count++;
-            pcursor->Next();
-
-        } else {
+        std::pair<char, CInstantPayIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_INSTANTPAY_INDEX)
             break;
-        }
+        ++mapAdded[GetInstantPayBucket(key.second.timestamp)];
+        pcursor->Next();
     }
 
-    return true;
-}
-
-bool CBlockTreeDB::WriteInstantPayLocks(std::map<CInstantPayIndexKey, CInstantPayValue> &mapLocks)
-{
-    CDBBatch batch(*this);
-    for (auto& lock : mapLocks ){
-
-        if( lock.second.fProcessed && !lock.second.fWritten ){
-            lock.second.fWritten = true;
-            batch.Write(make_pair(DB_INSTANTPAY_INDEX, lock.first), lock.second);
-        }
+    // Written in one batch, so the stale records above are never read
+    int nCountBefore = 0;
+    for (const auto& it : mapAdded) {
+        batch.Write(make_pair(DB_INSTANTPAY_BUCKET, CInstantPayIndexIteratorTimeKey(it.first)), CInstantPayBucket(nCountBefore, it.second));
+        batch.Write(make_pair(DB_INSTANTPAY_RANK, CInstantPayRankKey(nCountBefore)), it.first);
+        nCountBefore += it.second;
     }
-    return batch.SizeEstimate() ? WriteBatch(batch) : true;
+    batch.Write(make_pair(DB_FLAG, std::string("instantpaybuckets")), '1');
+
+    return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadInstantPayIndex( std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &instantPayIndex,
                                         int start, int offset, int limit, bool reverse) {
 
+    // A single cursor reads a consistent view while new entries are flushed
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    int nCount = 0;
+    int nRank;
 
-    if (start > 0) {
-        pcursor->Seek(make_pair(DB_INSTANTPAY_INDEX, CInstantPayIndexIteratorTimeKey(start)));
+    if (reverse) {
+        nRank = (start > 0 ? GetInstantPayRank(pcursor.get(), (unsigned int)start + 1) : GetInstantPayTotal(pcursor.get())) - 1 - offset;
     } else {
-        pcursor->Seek(DB_INSTANTPAY_INDEX);
+        nRank = (start > 0 ? GetInstantPayRank(pcursor.get(), start) : 0) + offset;
     }
 
+    if (!SeekInstantPayRank(pcursor.get(), nRank))
+        return true;
+
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CInstantPayIndexKey> key;
@@ -604,8 +697,7 @@ bool CBlockTreeDB::ReadInstantPayIndex( std::vector<std::pair<CInstantPayIndexKe
             }
             CInstantPayValue nValue;
             if (pcursor->GetValue(nValue)) {
-                if( ++nCount > offset )
-                    instantPayIndex.push_back(make_pair(key.second, nValue));
+                instantPayIndex.push_back(make_pair(key.second, nValue));
 
                 if( reverse ) pcursor->Prev();
                 else          pcursor->Next();
@@ -630,32 +722,23 @@ bool CBlockTreeDB::ReadInstantPayIndexCount(int &count, int &firstTime, int &las
     firstTime = 0;
     lastTime = 0;
 
-    if (start > 0) {
-        pcursor->Seek(make_pair(DB_INSTANTPAY_INDEX, CInstantPayIndexIteratorTimeKey(start)));
-    } else {
-        pcursor->Seek(DB_INSTANTPAY_INDEX);
-    }
+    int nFirst = start > 0 ? GetInstantPayRank(pcursor.get(), start) : 0;
+    int nLast = (end > 0 ? GetInstantPayRank(pcursor.get(), (unsigned int)end + 1) : GetInstantPayTotal(pcursor.get())) - 1;
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CInstantPayIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_INSTANTPAY_INDEX) {
+    if (nLast < nFirst)
+        return true;
 
-            if( !firstTime ) firstTime = key.second.timestamp;
+    std::pair<char,CInstantPayIndexKey> key;
 
-            if (end > 0 && key.second.timestamp > (unsigned int)end) {
-                if( !lastTime ) lastTime = firstTime;
-                break;
-            }
+    if (!SeekInstantPayRank(pcursor.get(), nFirst) || !pcursor->GetKey(key))
+        return error("failed to find first instantpay index entry");
+    firstTime = key.second.timestamp;
 
-            lastTime = key.second.timestamp;
-            count++;
-            pcursor->Next();
+    if (!SeekInstantPayRank(pcursor.get(), nLast) || !pcursor->GetKey(key))
+        return error("failed to find last instantpay index entry");
+    lastTime = key.second.timestamp;
 
-        } else {
-            break;
-        }
-    }
+    count = nLast - nFirst + 1;
 
     return true;
 }
@@ -767,7 +850,6 @@ bool CBlockTreeDB::ReadVoteKeyForAddress(const CSmartAddress &voteAddress, CVote
     return false;
 }
 
-
 bool CBlockTreeDB::ReadVoteKeys(std::vector<std::pair<CVoteKey,CVoteKeyValue>> &vecVoteKeys)
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
@@ -822,6 +904,29 @@ bool CBlockTreeDB::ReadVoteKeyValue(const CVoteKey &voteKey, CVoteKeyValue &vote
     return false;
 }
 
+bool CBlockTreeDB::WriteCoinStats(int nHeight, const CCoinStatsValue &stats, const MuHash3072 &muhash) {
+    CDBBatch batch(*this);
+    batch.Write(make_pair(DB_COINSTATS, nHeight), stats);
+    batch.Write(DB_COINSTATS_BEST, stats.hashBlock);
+    batch.Write(DB_COINSTATS_MUHASH, muhash);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadCoinStats(int nHeight, CCoinStatsValue &stats) {
+    return Read(make_pair(DB_COINSTATS, nHeight), stats);
+}
+
+bool CBlockTreeDB::EraseCoinStats(int nHeight, const uint256 &hashBest, const MuHash3072 &muhash) {
+    CDBBatch batch(*this);
+    batch.Erase(make_pair(DB_COINSTATS, nHeight));
+    batch.Write(DB_COINSTATS_BEST, hashBest);
+    batch.Write(DB_COINSTATS_MUHASH, muhash);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadCoinStatsBestBlock(uint256 &hashBest, MuHash3072 &muhash) {
+    return Read(DB_COINSTATS_BEST, hashBest) && Read(DB_COINSTATS_MUHASH, muhash);
+}
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
@@ -835,6 +940,53 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+template<typename K>
+static bool EraseLegacyRecords(CBlockTreeDB &db, char chPrefix, int64_t &nErased)
+{
+    static const size_t nBatchSize = 16 << 20;
+
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    CDBBatch batch(db);
+
+    pcursor->Seek(chPrefix);
+    while (pcursor->Valid()) {
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chPrefix)
+            break;
+        batch.Erase(key);
+        nErased++;
+        pcursor->Next();
+
+        if (batch.SizeEstimate() > nBatchSize) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            boost::this_thread::interruption_point();
+        }
+    }
+
+    return db.WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseLegacyAddressIndex() {
+    bool fErased;
+    if (ReadFlag("legacyaddressindexerased", fErased) && fErased)
+        return true;
+
+    int64_t nStart = GetTimeMillis();
+    int64_t nErased = 0;
+
+    if (!EraseLegacyRecords<CAddressIndexKey>(*this, DB_LEGACY_ADDRESSINDEX, nErased) ||
+        !EraseLegacyRecords<CAddressUnspentKey>(*this, DB_LEGACY_ADDRESSUNSPENTINDEX, nErased) ||
+        !EraseLegacyRecords<CSpentIndexKey>(*this, DB_LEGACY_SPENTINDEX, nErased) ||
+        !EraseLegacyRecords<CDepositIndexKey>(*this, DB_LEGACY_DEPOSITINDEX, nErased))
+        return error("%s: failed to erase the legacy address index", __func__);
+
+    LogPrintf("%s: erased %d records of the legacy address index, %dms\n", __func__, nErased, GetTimeMillis() - nStart);
+
+    return WriteFlag("legacyaddressindexerased", true);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
@@ -10,16 +10,20 @@
 #include "dbwrapper.h"
 #include "chain.h"
 #include "spentindex.h"
+#include "sync.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class MuHash3072;
 class uint256;
 struct CSmartAddress;
 
@@ -41,6 +45,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Seconds covered by one counted bucket of the instantpay index
+static const unsigned int INSTANTPAY_INDEX_BUCKET_SECONDS = 10 * 60;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -79,6 +85,8 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    //! Write the dirty coins of mapCoins without modifying it
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
@@ -108,6 +116,82 @@ private:
     friend class CCoinsViewDB;
 };
 
+/** State of the background writer of the coin database */
+struct CCoinsFlushStats
+{
+    //! Coins handed to the writer and not yet committed
+    size_t nPendingCoins;
+    //! Number of batches written in the background
+    uint64_t nFlushes;
+    //! Coins and duration of the last written batch
+    size_t nLastCoins;
+    int64_t nLastDuration;
+    //! Time validation spent waiting for a previous batch to commit
+    int64_t nTotalWaitTime;
+
+    CCoinsFlushStats() : nPendingCoins(0), nFlushes(0), nLastCoins(0), nLastDuration(0), nTotalWaitTime(0) {}
+};
+
+/**
+ * Layer between the coins cache and the coin database, which writes flushed
+ * coins in a background thread.
+ *
+ * A flush moves the dirty coins into a frozen snapshot and returns, so
+ * validation continues on the emptied cache right away. Until the writer has
+ * committed the snapshot, reads are served from it. The best block marker is
+ * part of the same batch, so the database never points to a tip whose coins
+ * are missing. Only one snapshot is written at a time, the next flush waits for
+ * the previous one.
+ *
+ * Without fAsync all calls go straight to the database.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsView
+{
+private:
+    CCoinsViewDB *pdb;
+    const bool fAsync;
+
+    mutable CWaitableCriticalSection cs;
+    mutable CConditionVariable condFlush;
+    //! Snapshot being written, read only until it is released (protected by cs)
+    std::unique_ptr<CCoinsMapMemoryResource> pFrozenResource;
+    std::unique_ptr<CCoinsMap> pFrozen;
+    uint256 hashFrozenBlock;
+    size_t nFrozenUsage;
+    bool fFailed;
+    bool fStop;
+    CCoinsFlushStats stats;
+
+    boost::thread threadWriter;
+
+    void ThreadWriter();
+
+public:
+    CCoinsViewBackgroundFlush(CCoinsViewDB *pdbIn, bool fAsyncIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    CCoinsViewCursor *Cursor() const override;
+    size_t EstimateSize() const override;
+
+    //! Wait until the last snapshot is committed. Returns false if a write failed.
+    bool WaitForFlush() const;
+    bool HasFailed() const;
+    bool IsAsync() const { return fAsync; }
+    //! Memory held by the snapshot being written
+    size_t DynamicMemoryUsage() const;
+    //! Best block of the coins committed to the database, without the snapshot
+    uint256 GetCommittedBestBlock() const;
+    CCoinsFlushStats GetStats() const;
+
+private:
+    CCoinsViewBackgroundFlush(const CCoinsViewBackgroundFlush&);
+    void operator=(const CCoinsViewBackgroundFlush&);
+};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
@@ -124,39 +208,26 @@ public:
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
-    bool ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex);
-    bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
-                                 const CAddressUnspentKey &start = CAddressUnspentKey(),
-                                 int offset = -1, int limit = -1, bool reverse = false);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool ReadAddressIndex(uint160 addressHash, int type,
-                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
-    bool ReadAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool ReadTimestampIndex(const unsigned int &timestamp, uint256 &blockHash);
-    bool WriteDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue> > &vect);
-    bool EraseDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue> > &vect);
-    bool ReadDepositIndex(uint160 addressHash, int type,
-                          std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex,
-                          int start = 0, int offset = 0, int limit = 0, bool reverse = false);
-    bool ReadDepositIndexCount(uint160 addressHash, int type,
-                                        int &count,
-                                        int &firstTime, int &lastTime,
-                                        int start, int end);
-
-    bool WriteInstantPayLocks(std::map<CInstantPayIndexKey, CInstantPayValue> &mapLocks);
+
+    bool WriteInstantPayIndex(const std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &vecEntries);
+    //! Count the buckets of an index written without them
+    bool UpgradeInstantPayIndex();
     bool ReadInstantPayIndex(std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &instantPayIndex,
                                             int start, int offset, int limit, bool reverse);
     bool ReadInstantPayIndexCount(int &count, int &firstTime, int &lastTime,
                                   int start, int end);
 
+    //! Write the coin stats of a block and make it the best block of the index, muhash is its coin set
+    bool WriteCoinStats(int nHeight, const CCoinStatsValue &stats, const MuHash3072 &muhash);
+    bool ReadCoinStats(int nHeight, CCoinStatsValue &stats);
+    //! Remove the coin stats of a disconnected block and move the best block back to its parent
+    bool EraseCoinStats(int nHeight, const uint256 &hashBest, const MuHash3072 &muhash);
+    //! Best block of the index and the coin set at that block
+    bool ReadCoinStatsBestBlock(uint256 &hashBest, MuHash3072 &muhash);
+
     /** SmartVoting start **/
     bool WriteInvalidVoteKeyRegistrations(std::vector<std::pair<CVoteKeyRegistrationKey, VoteKeyParseResult>> vecInvalidRegistrations);
     bool EraseInvalidVoteKeyRegistrations(std::vector<CVoteKeyRegistrationKey> vecInvalidRegistrations);
@@ -168,6 +239,9 @@ public:
     bool ReadVoteKeyValue(const CVoteKey &voteKey, CVoteKeyValue &voteKeyValue);
     /** SmartVoting end **/
 
+    //! Erase the address, spent and deposit index records kept in here before the address indexes got their own database
+    bool EraseLegacyAddressIndex();
+
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
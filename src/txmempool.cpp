@@ -70,8 +70,18 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints& lp)
 // Update the given tx for any in-mempool descendants.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
-bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
+bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit, cacheMap &cachedDescendants, const std::set<uint256> &setExclude, const TxCluster &excludedInCluster)
 {
+    // A cluster with a single root consists of the root and its descendants.
+    // No other transaction can reach the root as a descendant, so it doesn't
+    // need to be cached either.
+    const TxLinks &links = mapLinks[updateIt];
+    const TxCluster &cluster = mapClusters[links.cluster];
+    if (links.parents.empty() && cluster.nRoots == 1) {
+        mapTx.modify(updateIt, update_descendant_state(cluster.nSize - excludedInCluster.nSize, cluster.nModFees - excludedInCluster.nModFees, cluster.nCount - excludedInCluster.nCount));
+        return true;
+    }
+
     // Track the number of entries (outside setExclude) that we'd need to visit
     // (will bail out if it exceeds maxDescendantsToVisit)
     int nChildrenToVisit = 0;
@@ -146,34 +156,50 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
     // accounted for in the state of their ancestors)
     std::set<uint256> setAlreadyIncluded(vHashesToUpdate.begin(), vHashesToUpdate.end());
 
-    // Iterate in reverse, so that whenever we are looking at at a transaction
-    // we are sure that all in-mempool descendants have already been processed.
-    // This maximizes the benefit of the descendant cache and guarantees that
-    // setMemPoolChildren will be updated, an assumption made in
-    // UpdateForDescendants.
-    BOOST_REVERSE_FOREACH(const uint256 &hash, vHashesToUpdate) {
-        // we cache the in-mempool children to avoid duplicate updates
-        setEntries setChildren;
-        // calculate children from mapNextTx
+    // First calculate the children from mapNextTx, and update setMemPoolChildren
+    // to include them, and update their setMemPoolParents to include this tx.
+    // This merges the clusters of the block transactions with the ones of
+    // their children, so they are final before any descendant state is
+    // updated.
+    BOOST_FOREACH(const uint256 &hash, vHashesToUpdate) {
         txiter it = mapTx.find(hash);
         if (it == mapTx.end()) {
             continue;
         }
         std::map<COutPoint, CInPoint>::iterator iter = mapNextTx.lower_bound(COutPoint(hash, 0));
-        // First calculate the children, and update setMemPoolChildren to
-        // include them, and update their setMemPoolParents to include this tx.
         for (; iter != mapNextTx.end() && iter->first.hash == hash; ++iter) {
             const uint256 &childHash = iter->second.ptx->GetHash();
             txiter childIter = mapTx.find(childHash);
             assert(childIter != mapTx.end());
             // We can skip updating entries we've encountered before or that
             // are in the block (which are already accounted for).
-            if (setChildren.insert(childIter).second && !setAlreadyIncluded.count(childHash)) {
+            if (!setAlreadyIncluded.count(childHash) && !GetMemPoolChildren(it).count(childIter)) {
+                if (GetMemPoolParents(childIter).empty())
+                    mapClusters[mapLinks[childIter].cluster].nRoots--;
                 UpdateChild(it, childIter, true);
                 UpdateParent(childIter, it, true);
+                MergeClusters(it, childIter);
             }
         }
-        if (!UpdateForDescendants(it, 100, mapMemPoolDescendantsToUpdate, setAlreadyIncluded)) {
+    }
+
+    // Totals of the block transactions by cluster
+    clusterMap mapIncluded;
+    BOOST_FOREACH(const uint256 &hash, setAlreadyIncluded) {
+        txiter it = mapTx.find(hash);
+        if (it != mapTx.end())
+            mapIncluded[mapLinks[it].cluster].Add(*it);
+    }
+
+    // Iterate in reverse, so that whenever we are looking at at a transaction
+    // we are sure that all in-mempool descendants have already been processed.
+    // This maximizes the benefit of the descendant cache.
+    BOOST_REVERSE_FOREACH(const uint256 &hash, vHashesToUpdate) {
+        txiter it = mapTx.find(hash);
+        if (it == mapTx.end()) {
+            continue;
+        }
+        if (!UpdateForDescendants(it, 100, mapMemPoolDescendantsToUpdate, setAlreadyIncluded, mapIncluded[mapLinks[it].cluster])) {
             // Mark as dirty if we can't do the calculation.
             mapTx.modify(it, set_dirty());
         }
@@ -206,6 +232,22 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         parentHashes = GetMemPoolParents(it);
     }
 
+    // The ancestors and their descendants are all in the clusters of the
+    // parents. If these are within the limits, none of the checks below can
+    // fail and the walk only collects the ancestors.
+    std::set<uint64_t> setClusters;
+    uint64_t nClusterCount = 0, nClusterSize = 0;
+    BOOST_FOREACH(txiter parentIt, parentHashes) {
+        uint64_t nCluster = mapLinks[parentIt].cluster;
+        if (setClusters.insert(nCluster).second) {
+            const TxCluster &cluster = mapClusters[nCluster];
+            nClusterCount += cluster.nCount;
+            nClusterSize += cluster.nSize;
+        }
+    }
+    const bool fWithinLimits = nClusterCount + 1 <= std::min(limitAncestorCount, limitDescendantCount) &&
+                               nClusterSize + entry.GetTxSize() <= std::min(limitAncestorSize, limitDescendantSize);
+
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
     while (!parentHashes.empty()) {
@@ -215,6 +257,14 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         parentHashes.erase(stageit);
         totalSizeWithAncestors += stageit->GetTxSize();
 
+        if (fWithinLimits) {
+            BOOST_FOREACH(const txiter &phash, GetMemPoolParents(stageit)) {
+                if (setAncestors.count(phash) == 0)
+                    parentHashes.insert(phash);
+            }
+            continue;
+        }
+
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
             errString = strprintf("exceeds descendant size limit for tx %s [limit: %u]", stageit->GetTx().GetHash().ToString(), limitDescendantSize);
             return false;
@@ -267,41 +317,96 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 
 void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove)
 {
-    // For each entry, walk back all ancestors and decrement size associated with this
-    // transaction
-    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    // The ancestors of a removed transaction that stay in the mempool are the
+    // parents outside of entriesToRemove it reaches through removed parents,
+    // and their ancestors. Transactions reaching the same of these parents
+    // share the remaining ancestors, so those are walked once per group and
+    // updated by the group's total. Removing a chain from the middle is a
+    // single walk, removing a whole cluster doesn't walk anything.
+    //
+    // We use the mapLinks[] notion of parents here, which is what matters if
+    // we happen to be in the middle of processing a reorg, ie before
+    // UpdateTransactionsFromBlock() has been called: the set of ancestors
+    // reachable via mapLinks will be the same as the set of ancestors whose
+    // packages include the transaction, because when we add a new transaction
+    // to the mempool in addUnchecked(), we assume it has no children.
+    std::map<txiter, setEntries, CompareIteratorByHash> mapOutsideParents;
+    std::map<txiter, size_t, CompareIteratorByHash> mapPendingParents;
+    std::vector<txiter> vReady;
     BOOST_FOREACH(txiter removeIt, entriesToRemove) {
+        size_t nParents = 0;
+        BOOST_FOREACH(txiter parentIt, GetMemPoolParents(removeIt)) {
+            nParents += entriesToRemove.count(parentIt);
+        }
+        if (nParents == 0)
+            vReady.push_back(removeIt);
+        else
+            mapPendingParents[removeIt] = nParents;
+    }
+
+    // Parents first, so the outside parents of a removed parent are known
+    std::map<std::vector<uint256>, std::pair<setEntries, TxCluster> > mapGroups;
+    while (!vReady.empty()) {
+        txiter removeIt = vReady.back();
+        vReady.pop_back();
+
+        setEntries &setOutside = mapOutsideParents[removeIt];
+        BOOST_FOREACH(txiter parentIt, GetMemPoolParents(removeIt)) {
+            if (entriesToRemove.count(parentIt)) {
+                const setEntries &setParentOutside = mapOutsideParents[parentIt];
+                setOutside.insert(setParentOutside.begin(), setParentOutside.end());
+            } else {
+                setOutside.insert(parentIt);
+            }
+        }
+        if (!setOutside.empty()) {
+            std::vector<uint256> vKey;
+            BOOST_FOREACH(txiter outsideIt, setOutside)
+                vKey.push_back(outsideIt->GetTx().GetHash());
+            std::pair<setEntries, TxCluster> &group = mapGroups[vKey];
+            group.first = setOutside;
+            group.second.Add(*removeIt);
+        }
+
+        BOOST_FOREACH(txiter childIt, GetMemPoolChildren(removeIt)) {
+            std::map<txiter, size_t, CompareIteratorByHash>::iterator pendingIt = mapPendingParents.find(childIt);
+            if (pendingIt != mapPendingParents.end() && --pendingIt->second == 0) {
+                vReady.push_back(childIt);
+                mapPendingParents.erase(pendingIt);
+            }
+        }
+    }
+    // Links are always added in both directions, so this can't happen
+    assert(mapPendingParents.empty());
+
+    std::map<std::vector<uint256>, std::pair<setEntries, TxCluster> >::const_iterator groupIt;
+    for (groupIt = mapGroups.begin(); groupIt != mapGroups.end(); ++groupIt) {
+        const TxCluster &removed = groupIt->second.second;
         setEntries setAncestors;
-        const CTxMemPoolEntry &entry = *removeIt;
-        std::string dummy;
-        // Since this is a tx that is already in the mempool, we can call CMPA
-        // with fSearchForParents = false.  If the mempool is in a consistent
-        // state, then using true or false should both be correct, though false
-        // should be a bit faster.
-        // However, if we happen to be in the middle of processing a reorg, then
-        // the mempool can be in an inconsistent state.  In this case, the set
-        // of ancestors reachable via mapLinks will be the same as the set of 
-        // ancestors whose packages include this transaction, because when we
-        // add a new transaction to the mempool in addUnchecked(), we assume it
-        // has no children, and in the case of a reorg where that assumption is
-        // false, the in-mempool children aren't linked to the in-block tx's
-        // until UpdateTransactionsFromBlock() is called.
-        // So if we're being called during a reorg, ie before
-        // UpdateTransactionsFromBlock() has been called, then mapLinks[] will
-        // differ from the set of mempool parents we'd calculate by searching,
-        // and it's important that we use the mapLinks[] notion of ancestor
-        // transactions as the set of things to update for removal.
-        CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.  This is
-        // fine since we don't need to use the mempool children of any entries
-        // to walk back over our ancestors (but we do need the mempool
-        // parents!)
-        UpdateAncestorsOf(false, removeIt, setAncestors);
+        setEntries stage = groupIt->second.first;
+        while (!stage.empty()) {
+            txiter ancestorIt = *stage.begin();
+            stage.erase(stage.begin());
+            setAncestors.insert(ancestorIt);
+            BOOST_FOREACH(txiter parentIt, GetMemPoolParents(ancestorIt)) {
+                if (!setAncestors.count(parentIt))
+                    stage.insert(parentIt);
+            }
+        }
+        BOOST_FOREACH(txiter ancestorIt, setAncestors) {
+            if (!entriesToRemove.count(ancestorIt))
+                mapTx.modify(ancestorIt, update_descendant_state(-(int64_t)removed.nSize, -removed.nModFees, -(int64_t)removed.nCount));
+        }
+    }
+
+    // Sever the links in both directions between the transactions being
+    // removed and their parents and children.
+    BOOST_FOREACH(txiter removeIt, entriesToRemove) {
+        setEntries parentIters = GetMemPoolParents(removeIt);
+        BOOST_FOREACH(txiter parentIt, parentIters) {
+            UpdateChild(parentIt, removeIt, false);
+        }
     }
-    // After updating all the ancestor sizes, we can now sever the link between each
-    // transaction being removed and any mempool children (ie, update setMemPoolParents
-    // for each direct child of a transaction being removed).
     BOOST_FOREACH(txiter removeIt, entriesToRemove) {
         UpdateChildrenForRemoval(removeIt);
     }
@@ -387,6 +492,11 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     // further updated.)
     cachedInnerUsage += entry.DynamicMemoryUsage();
 
+    // Start a cluster of its own, linking the parents below merges their clusters
+    uint64_t nCluster = ++nLastCluster;
+    mapLinks[newit].cluster = nCluster;
+    mapClusters[nCluster].Add(*newit);
+
     const CTransaction& tx = newit->GetTx();
     std::set<uint256> setParentTransactions;
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
@@ -408,6 +518,11 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         }
     }
     UpdateAncestorsOf(true, newit, setAncestors);
+    if (GetMemPoolParents(newit).empty())
+        mapClusters[nCluster].nRoots++;
+    BOOST_FOREACH(txiter pit, GetMemPoolParents(newit)) {
+        MergeClusters(newit, pit);
+    }
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
@@ -808,6 +923,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
 void CTxMemPool::_clear()
 {
     mapLinks.clear();
+    mapClusters.clear();
+    nLastCluster = 0;
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
@@ -841,6 +958,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     LOCK(cs);
     list<const CTxMemPoolEntry*> waitingOnDependants;
+    clusterMap mapClustersCheck;
     for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->GetTxSize();
@@ -885,6 +1003,14 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             }
         }
         assert(setChildrenCheck == GetMemPoolChildren(it));
+        // Linked entries share their cluster
+        mapClustersCheck[links.cluster].Add(*it);
+        if (setParentCheck.empty())
+            mapClustersCheck[links.cluster].nRoots++;
+        BOOST_FOREACH(txiter linkedIt, setParentCheck)
+            assert(mapLinks.find(linkedIt)->second.cluster == links.cluster);
+        BOOST_FOREACH(txiter linkedIt, setChildrenCheck)
+            assert(mapLinks.find(linkedIt)->second.cluster == links.cluster);
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         if (!it->IsDirty()) {
@@ -927,6 +1053,26 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(it->first == it->second.ptx->vin[it->second.n].prevout);
     }
 
+    // The cached cluster state matches the entries, and a cluster doesn't
+    // consist of parts that aren't linked to each other
+    assert(mapClustersCheck.size() == mapClusters.size());
+    std::map<uint64_t, txiter> mapClusterEntry;
+    for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++)
+        mapClusterEntry[mapLinks.find(it)->second.cluster] = it;
+    BOOST_FOREACH(const clusterMap::value_type& item, mapClustersCheck) {
+        clusterMap::const_iterator clusterIt = mapClusters.find(item.first);
+        assert(clusterIt != mapClusters.end());
+        assert(clusterIt->second.nCount == item.second.nCount);
+        assert(clusterIt->second.nSize == item.second.nSize);
+        assert(clusterIt->second.nModFees == item.second.nModFees);
+        assert(clusterIt->second.nUsage == item.second.nUsage);
+        assert(clusterIt->second.nRoots == item.second.nRoots);
+
+        setEntries setReached;
+        CalculateCluster(mapClusterEntry[item.first], setReached);
+        assert(setReached.size() == item.second.nCount);
+    }
+
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
 }
@@ -1015,7 +1161,10 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
         deltas.second += nFeeDelta;
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
+            TxCluster &cluster = mapClusters[mapLinks[it].cluster];
+            cluster.nModFees -= it->GetModifiedFee();
             mapTx.modify(it, update_fee_delta(deltas.second));
+            cluster.nModFees += it->GetModifiedFee();
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -1075,15 +1224,44 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(mapClusters) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage) {
     AssertLockHeld(cs);
+    // Take the entries out of their clusters and collect the remaining
+    // entries they were linked to, the clusters can only split there.
+    std::map<uint64_t, setEntries> mapNeighbours;
+    setEntries setRemainingChildren;
+    BOOST_FOREACH(const txiter& it, stage) {
+        const TxLinks &links = mapLinks[it];
+        TxCluster &cluster = mapClusters[links.cluster];
+        cluster.Add(*it, -1);
+        if (links.parents.empty())
+            cluster.nRoots--;
+        setEntries &setNeighbours = mapNeighbours[links.cluster];
+        BOOST_FOREACH(txiter linkedIt, links.parents) {
+            if (!stage.count(linkedIt))
+                setNeighbours.insert(linkedIt);
+        }
+        BOOST_FOREACH(txiter linkedIt, links.children) {
+            if (!stage.count(linkedIt)) {
+                setNeighbours.insert(linkedIt);
+                setRemainingChildren.insert(linkedIt);
+            }
+        }
+    }
     UpdateForRemoveFromMempool(stage);
+    // Children left without parents become roots
+    BOOST_FOREACH(const txiter& it, setRemainingChildren) {
+        const TxLinks &links = mapLinks[it];
+        if (links.parents.empty())
+            mapClusters[links.cluster].nRoots++;
+    }
     BOOST_FOREACH(const txiter& it, stage) {
         removeUnchecked(it);
     }
+    SplitClusters(mapNeighbours);
 }
 
 int CTxMemPool::Expire(int64_t time) {
@@ -1132,6 +1310,121 @@ void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
     }
 }
 
+void CTxMemPool::MergeClusters(txiter a, txiter b)
+{
+    uint64_t nClusterA = mapLinks[a].cluster;
+    uint64_t nClusterB = mapLinks[b].cluster;
+    if (nClusterA == nClusterB)
+        return;
+
+    // Relabel the smaller one, so an entry is relabeled at most log2(n) times
+    clusterMap::iterator itA = mapClusters.find(nClusterA);
+    clusterMap::iterator itB = mapClusters.find(nClusterB);
+    assert(itA != mapClusters.end() && itB != mapClusters.end());
+    if (itA->second.nCount < itB->second.nCount) {
+        std::swap(a, b);
+        std::swap(itA, itB);
+    }
+
+    RelabelCluster(b, itB->first, itA->first);
+    itA->second.Add(itB->second);
+    mapClusters.erase(itB);
+}
+
+CTxMemPool::TxCluster CTxMemPool::RelabelCluster(txiter entry, uint64_t nFrom, uint64_t nTo)
+{
+    TxCluster cluster;
+    std::vector<txiter> vStack;
+
+    txlinksMap::iterator linksIt = mapLinks.find(entry);
+    assert(linksIt != mapLinks.end() && linksIt->second.cluster == nFrom);
+    linksIt->second.cluster = nTo;
+    vStack.push_back(entry);
+
+    while (!vStack.empty()) {
+        txiter it = vStack.back();
+        vStack.pop_back();
+
+        const TxLinks &links = mapLinks.find(it)->second;
+        cluster.Add(*it);
+        if (links.parents.empty())
+            cluster.nRoots++;
+        const setEntries *linked[] = {&links.parents, &links.children};
+        for (size_t i = 0; i < 2; i++) {
+            BOOST_FOREACH(txiter linkedIt, *linked[i]) {
+                TxLinks &linkedLinks = mapLinks.find(linkedIt)->second;
+                if (linkedLinks.cluster == nFrom) {
+                    linkedLinks.cluster = nTo;
+                    vStack.push_back(linkedIt);
+                }
+            }
+        }
+    }
+
+    return cluster;
+}
+
+void CTxMemPool::CalculateCluster(txiter entry, setEntries &setCluster) const
+{
+    std::vector<txiter> vStack(1, entry);
+    setCluster.insert(entry);
+    while (!vStack.empty()) {
+        txiter it = vStack.back();
+        vStack.pop_back();
+
+        const TxLinks &links = mapLinks.find(it)->second;
+        const setEntries *linked[] = {&links.parents, &links.children};
+        for (size_t i = 0; i < 2; i++) {
+            BOOST_FOREACH(txiter linkedIt, *linked[i]) {
+                if (setCluster.insert(linkedIt).second)
+                    vStack.push_back(linkedIt);
+            }
+        }
+    }
+}
+
+void CTxMemPool::SplitClusters(const std::map<uint64_t, setEntries> &mapNeighbours)
+{
+    std::map<uint64_t, setEntries>::const_iterator it;
+    for (it = mapNeighbours.begin(); it != mapNeighbours.end(); ++it) {
+        uint64_t nCluster = it->first;
+        const setEntries &setNeighbours = it->second;
+
+        clusterMap::iterator clusterIt = mapClusters.find(nCluster);
+        assert(clusterIt != mapClusters.end());
+        if (clusterIt->second.nCount == 0) {
+            assert(setNeighbours.empty());
+            mapClusters.erase(clusterIt);
+            continue;
+        }
+
+        // With the removed entries linked to a single remaining one, the
+        // rest of the cluster is still connected through it
+        if (setNeighbours.size() < 2)
+            continue;
+
+        // Every part the cluster fell apart into is linked to one of the
+        // neighbours and gets a new label
+        BOOST_FOREACH(txiter neighbourIt, setNeighbours) {
+            if (mapLinks[neighbourIt].cluster != nCluster)
+                continue;
+            uint64_t nNewCluster = ++nLastCluster;
+            mapClusters[nNewCluster] = RelabelCluster(neighbourIt, nCluster, nNewCluster);
+        }
+        mapClusters.erase(clusterIt);
+    }
+}
+
+const CTxMemPool::TxCluster & CTxMemPool::GetCluster(txiter entry) const
+{
+    assert (entry != mapTx.end());
+    txlinksMap::const_iterator it = mapLinks.find(entry);
+    assert(it != mapLinks.end());
+    clusterMap::const_iterator clusterIt = mapClusters.find(it->second.cluster);
+    assert(clusterIt != mapClusters.end());
+    return clusterIt->second;
+}
+
 const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
@@ -1193,7 +1486,8 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
-    while (DynamicMemoryUsage() > sizelimit) {
+    size_t nUsage;
+    while ((nUsage = DynamicMemoryUsage()) > sizelimit) {
         indexed_transaction_set::nth_index<1>::type::iterator it = mapTx.get<1>().begin();
 
         // We set the new mempool min fee to the feerate of the removed set, plus the
@@ -1201,14 +1495,22 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
         // equal to txn which were removed with no block in between.
         CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
-        removed += minReasonableRelayFee;
-        trackPackageRemoved(removed);
-        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
+        // If the cluster of the package pays no better than the package itself
+        // and is needed to get below the limit anyway, evict all of it at once
+        // instead of one package after the other.
         setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        const TxCluster &cluster = GetCluster(mapTx.project<0>(it));
+        if (cluster.nUsage <= nUsage - sizelimit && CFeeRate(cluster.nModFees, cluster.nSize) <= removed)
+            CalculateCluster(mapTx.project<0>(it), stage);
+        else
+            CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
+        removed += minReasonableRelayFee;
+        trackPackageRemoved(removed);
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
         std::vector<CTransaction> txn;
         if (pvNoSpendsRemaining) {
             txn.reserve(stage.size());
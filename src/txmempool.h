@@ -366,6 +366,31 @@ public:
  * the entry as "dirty", and set the feerate for sorting purposes to be equal
  * the feerate of the transaction without any descendants.
  *
+ * Clusters:
+ *
+ * Transactions connected through mapLinks, in either direction, form a
+ * cluster. Every entry is labeled with its cluster in mapLinks and the count,
+ * size, modified fees, memory usage and number of roots (entries without
+ * in-mempool parents) of each cluster are kept in mapClusters. Linking an
+ * entry to a parent merges their clusters by relabeling the smaller one.
+ * Removing entries can split a cluster, which is only possible if at least two
+ * remaining entries were linked to the removed ones; only then the rest of the
+ * cluster is walked and relabeled.
+ *
+ * The cluster state bounds the package queries: the ancestors of a new
+ * transaction and all of their descendants are in the clusters of its parents,
+ * so CalculateMemPoolAncestors() skips the limit checks if those clusters are
+ * small enough, and a cluster with a single root is made of that root and its
+ * descendants, so UpdateForDescendants() takes the descendant state of a root
+ * from its cluster instead of walking it. TrimToSize() evicts the whole
+ * cluster of the worst package at once if the cluster pays no better than the
+ * package and its memory usage isn't above what has to be freed.
+ *
+ * RemoveStaged() uses the link structure to update the descendant state of the
+ * remaining ancestors of a removed set without walking the ancestors of every
+ * removed entry, so evicting or conflicting out a long chain is linear in its
+ * length.
+ *
  */
 class CTxMemPool
 {
@@ -424,17 +449,63 @@ public:
 
     const setEntries & GetMemPoolParents(txiter entry) const;
     const setEntries & GetMemPoolChildren(txiter entry) const;
+
+    /** Aggregate state of a set of transactions, like a cluster */
+    struct TxCluster {
+        uint64_t nCount;
+        uint64_t nSize;
+        CAmount nModFees;
+        uint64_t nUsage; //! estimated memory usage of the entries in mapTx
+        uint64_t nRoots; //! number of entries without in-mempool parents
+
+        TxCluster() : nCount(0), nSize(0), nModFees(0), nUsage(0), nRoots(0) {}
+
+        void Add(const CTxMemPoolEntry &entry, int64_t nSign = 1)
+        {
+            nCount += nSign;
+            nSize += nSign * (int64_t)entry.GetTxSize();
+            nModFees += nSign * entry.GetModifiedFee();
+            nUsage += nSign * (int64_t)GetEntryUsage(entry);
+        }
+
+        void Add(const TxCluster &other)
+        {
+            nCount += other.nCount;
+            nSize += other.nSize;
+            nModFees += other.nModFees;
+            nUsage += other.nUsage;
+            nRoots += other.nRoots;
+        }
+    };
+
+    /** Memory an entry takes in mapTx, without its links */
+    static size_t GetEntryUsage(const CTxMemPoolEntry &entry)
+    {
+        // Estimate the overhead of mapTx to be 12 pointers + an allocation, see DynamicMemoryUsage()
+        return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) + entry.DynamicMemoryUsage();
+    }
+
+    /** The cluster entry belongs to */
+    const TxCluster & GetCluster(txiter entry) const;
+    size_t GetClusterCount() const { return mapClusters.size(); }
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
     struct TxLinks {
         setEntries parents;
         setEntries children;
+        uint64_t cluster; //! key in mapClusters
+
+        TxLinks() : cluster(0) {}
     };
 
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
+    typedef std::map<uint64_t, TxCluster> clusterMap;
+    clusterMap mapClusters;
+    uint64_t nLastCluster;
+
     typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
     addressDeltaMap mapAddress;
 
@@ -450,6 +521,18 @@ private:
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
+    /** Merge the clusters of two linked entries */
+    void MergeClusters(txiter a, txiter b);
+    /** Move the entries connected to entry that are labeled nFrom to cluster
+     *  nTo, returns their aggregate state */
+    TxCluster RelabelCluster(txiter entry, uint64_t nFrom, uint64_t nTo);
+    /** The entries of the cluster entry belongs to */
+    void CalculateCluster(txiter entry, setEntries &setCluster) const;
+    /** Relabel the clusters that may have fallen apart after a removal.
+     *  mapNeighbours holds the remaining entries that were linked to the
+     *  removed ones, by cluster. */
+    void SplitClusters(const std::map<uint64_t, setEntries> &mapNeighbours);
+
 public:
     std::map<COutPoint, CInPoint> mapNextTx;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
@@ -628,14 +711,22 @@ private:
      *  cachedDescendants will be updated with the descendants of the transaction
      *  being updated, so that future invocations don't need to walk the
      *  same transaction again, if encountered in another transaction chain.
+     *
+     *  excludedInCluster holds the totals of the transactions in setExclude that
+     *  are in the cluster of the transaction being updated. If that transaction
+     *  is the only root of its cluster, the whole cluster descends from it and
+     *  its state is updated from the cluster totals without any walk.
      */
     bool UpdateForDescendants(txiter updateIt,
             int maxDescendantsToVisit,
             cacheMap &cachedDescendants,
-            const std::set<uint256> &setExclude);
+            const std::set<uint256> &setExclude,
+            const TxCluster &excludedInCluster);
     /** Update ancestors of hash to add/remove it as a descendant transaction. */
     void UpdateAncestorsOf(bool add, txiter hash, setEntries &setAncestors);
-    /** For each transaction being removed, update ancestors and any direct children. */
+    /** For each transaction being removed, update ancestors and any direct children.
+     *  The ancestors are walked once per distinct set of ancestors outside of
+     *  entriesToRemove, not once per transaction. */
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry);
@@ -9,6 +9,7 @@
 
 #include "util.h"
 
+#include "asynclog.h"
 #include "chainparamsbase.h"
 #include "random.h"
 #include "serialize.h"
@@ -39,6 +40,7 @@
 #include <algorithm>
 #include <fcntl.h>
 #include <sys/resource.h>
+#include <signal.h>
 #include <sys/stat.h>
 
 #else
@@ -109,7 +111,7 @@ int nWalletBackups = 10;
 const char * const BITCOIN_CONF_FILENAME = "smartcash.conf";
 const char * const BITCOIN_PID_FILENAME = "smartcashd.pid";
 
-const std::vector<std::string> args = {"version", "alertnotify", "blocknotify", "blocksonly", "checkblocks", "checklevel", "conf", "daemon", "datadir", "dbcache", "feefilter", "loadblock", "maxorphantx", "maxmempool", "mempoolexpiry", "par", "pid", "prune", "reindex-chainstate", "reindex", "sysperms", "depositindex", "addnode", "banscore", "bantime", "bind", "connect", "discover", "dns", "dnsseed", "externalip", "forcednsseed", "listen", "listenonion", "maxconnections", "maxreceivebuffer", "maxsendbuffer", "maxtimeadjustment", "minpeerprotocol", "onion", "onlynet", "permitbaremultisig", "peerbloomfilters", "port", "proxy", "proxyrandomize", "rpcserialversion", "seednode", "timeout", "torcontrol", "torpassword", "upnp", "whitebind", "whitelist", "whitelistrelay", "whitelistforcerelay", "maxuploadtarget", "zmqpubhashblock", "zmqpubhashtx", "zmqpubrawblock", "zmqpubrawtx", "uacomment", "checkblockindex", "checkmempool", "checkpoints", "disablesafemode", "testsafemode", "dropmessagestest", "fuzzmessagestest", "stopafterblockimport", "limitancestorcount", "limitancestorsize", "limitdescendantcount", "limitdescendantsize", "bip9params", "debug", "nodebug", "help-debug", "logips", "logtimestamps", "logtimemicros", "mocktime", "limitfreerelay", "relaypriority", "maxsigcachesize", "maxtipage", "minrelaytxfee", "maxtxfee", "printtoconsole", "printpriority", "shrinkdebugfile", "acceptnonstdtxn", "bytespersigop", "datacarrier", "datacarriersize", "mempoolreplacement", "blockmaxweight", "blockmaxsize", "txmaxcount", "blockprioritysize", "blockversion", "server", "rest", "rpcbind", "rpccookiefile", "rpcuser", "rpcpassword", "rpcauth", "rpcport", "rpcallowip", "rpcthreads", "rpcworkqueue", "rpcservertimeout", "help", "?", "disablewallet", "keypool", "fallbackfee", "mintxfee", "paytxfee", "rescan", "salvagewallet", "sendfreetransactions", "spendzeroconfchange", "txconfirmtarget", "usehd", "upgradewallet", "wallet", "walletbroadcast", "walletnotify", "zapwallettxes", "dblogsize", "flushwallet", "privdb", "walletrejectlongchains", "testnet", "usenewaddressformat", "sapi", "sapiport", "sapithreads", "sapiworkqueue", "sapiservertimeout", "sapiwhitelist"};
+const std::vector<std::string> args = {"version", "alertnotify", "blocknotify", "blocksonly", "checkblocks", "checklevel", "conf", "daemon", "datadir", "dbcache", "feefilter", "loadblock", "maxorphantx", "maxmempool", "mempoolexpiry", "par", "pid", "prune", "reindex-chainstate", "reindex", "sysperms", "depositindex", "addnode", "banscore", "bantime", "bind", "connect", "discover", "dns", "dnsseed", "externalip", "forcednsseed", "listen", "listenonion", "maxconnections", "maxreceivebuffer", "maxsendbuffer", "maxtimeadjustment", "minpeerprotocol", "onion", "onlynet", "permitbaremultisig", "peerbloomfilters", "port", "proxy", "proxyrandomize", "rpcserialversion", "seednode", "timeout", "torcontrol", "torpassword", "upnp", "whitebind", "whitelist", "whitelistrelay", "whitelistforcerelay", "maxuploadtarget", "zmqpubhashblock", "zmqpubhashtx", "zmqpubrawblock", "zmqpubrawtx", "zmqpubaddressdelta", "zmqpubrewardsround", "zmqpubsmartnodelist", "uacomment", "checkblockindex", "checkmempool", "checkpoints", "disablesafemode", "testsafemode", "dropmessagestest", "fuzzmessagestest", "stopafterblockimport", "limitancestorcount", "limitancestorsize", "limitdescendantcount", "limitdescendantsize", "bip9params", "debug", "nodebug", "help-debug", "logips", "logtimestamps", "logtimemicros", "mocktime", "limitfreerelay", "relaypriority", "maxsigcachesize", "maxtipage", "minrelaytxfee", "maxtxfee", "printtoconsole", "asynclog", "logdropoverflow", "printpriority", "shrinkdebugfile", "acceptnonstdtxn", "bytespersigop", "datacarrier", "datacarriersize", "mempoolreplacement", "blockmaxweight", "blockmaxsize", "txmaxcount", "blockprioritysize", "blockversion", "server", "rest", "rpcbind", "rpccookiefile", "rpcuser", "rpcpassword", "rpcauth", "rpcport", "rpcallowip", "rpcthreads", "rpcworkqueue", "rpcservertimeout", "help", "?", "disablewallet", "keypool", "fallbackfee", "mintxfee", "paytxfee", "rescan", "salvagewallet", "sendfreetransactions", "spendzeroconfchange", "txconfirmtarget", "usehd", "upgradewallet", "wallet", "walletbroadcast", "walletnotify", "zapwallettxes", "dblogsize", "flushwallet", "privdb", "walletrejectlongchains", "testnet", "usenewaddressformat", "sapi", "sapiport", "sapithreads", "sapiworkqueue", "sapiservertimeout", "sapiwhitelist"};
 
 map<string, string> mapArgs;
 map<string, vector<string> > mapMultiArgs;
@@ -202,6 +204,17 @@ static boost::once_flag debugPrintInitFlag = BOOST_ONCE_INIT;
 static FILE* fileout = NULL;
 static boost::mutex* mutexDebugLog = NULL;
 static list<string> *vMsgsBeforeOpenLog;
+//! Writes debug.log on its own thread after OpenDebugLog (with -asynclog)
+static std::atomic<CAsyncLogWriter*> pDebugLogWriter(NULL);
+#ifndef WIN32
+//! debug.log for HandleCrashSignal, which can't go through fileout
+static std::atomic<int> nDebugLogFd(-1);
+//! HandleCrashSignal writes the queued messages straight to nDebugLogFd, so the
+//! lines the writer thread popped can't wait in the stdio buffer behind them
+static const int DEBUGLOG_ASYNC_BUFMODE = _IOLBF;
+#else
+static const int DEBUGLOG_ASYNC_BUFMODE = _IOFBF;
+#endif
 
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
@@ -224,7 +237,16 @@ void OpenDebugLog()
     assert(vMsgsBeforeOpenLog);
     boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
     fileout = fopen(pathDebug.string().c_str(), "a");
-    if (fileout) setbuf(fileout, NULL); // unbuffered
+
+    bool fAsync = fileout && GetBoolArg("-asynclog", DEFAULT_ASYNCLOG);
+
+    // The writer thread flushes whenever it runs out of messages
+    if (fileout) {
+        if (fAsync)
+            setvbuf(fileout, NULL, DEBUGLOG_ASYNC_BUFMODE, 1 << 16);
+        else
+            setbuf(fileout, NULL); // unbuffered
+    }
 
     // dump buffered messages from before we opened the log
     while (!vMsgsBeforeOpenLog->empty()) {
@@ -234,6 +256,99 @@ void OpenDebugLog()
 
     delete vMsgsBeforeOpenLog;
     vMsgsBeforeOpenLog = NULL;
+
+    if (fAsync)
+        StartDebugLogWriter();
+}
+
+static std::string LogTimestampPrefix(int64_t nTimeMicros)
+{
+    string strStamp = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nTimeMicros/1000000);
+    if (fLogTimeMicros)
+        strStamp += strprintf(".%06d", nTimeMicros%1000000);
+    return strStamp + ' ';
+}
+
+/** Called on the writer thread only */
+static void DebugLogWrite(int64_t nTimeMicros, const std::string &str)
+{
+    // reopen the log file, if requested
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        fflush(fileout);
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL) {
+            setvbuf(fileout, NULL, DEBUGLOG_ASYNC_BUFMODE, 1 << 16);
+#ifndef WIN32
+            nDebugLogFd = fileno(fileout);
+#endif
+        }
+    }
+
+    if (nTimeMicros >= 0)
+        FileWriteStr(LogTimestampPrefix(nTimeMicros), fileout);
+    FileWriteStr(str, fileout);
+}
+
+static void DebugLogFlush()
+{
+    fflush(fileout);
+}
+
+#ifndef WIN32
+//! Lets HandleCrashSignal run on the main thread after a stack overflow
+static char vchCrashSignalStack[64 * 1024];
+
+static void HandleCrashSignal(int nSignal)
+{
+    // Only async-signal-safe calls here: a crash inside malloc or stdio leaves
+    // their locks held. At most the line the writer thread is in the middle of
+    // is lost, the queued messages are written without timestamps.
+    CAsyncLogWriter* pwriter = pDebugLogWriter.exchange(NULL);
+    int fd = nDebugLogFd.load();
+    if (pwriter && fd >= 0)
+        pwriter->DrainOnCrash(fd);
+
+    // SA_RESETHAND restored the default action
+    raise(nSignal);
+}
+#endif
+
+void StartDebugLogWriter()
+{
+    CAsyncLogWriter* pwriter = new CAsyncLogWriter(DebugLogWrite, DebugLogFlush, GetBoolArg("-logdropoverflow", DEFAULT_LOGDROPOVERFLOW));
+    pwriter->Start();
+    pDebugLogWriter = pwriter;
+
+#ifndef WIN32
+    nDebugLogFd = fileno(fileout);
+
+    stack_t ss;
+    ss.ss_sp = vchCrashSignalStack;
+    ss.ss_size = sizeof(vchCrashSignalStack);
+    ss.ss_flags = 0;
+    sigaltstack(&ss, NULL);
+
+    // Get the queued messages to the file before a crash dump is written
+    struct sigaction sa;
+    sa.sa_handler = HandleCrashSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_ONSTACK | SA_RESETHAND;
+    for (int nSignal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT})
+        sigaction(nSignal, &sa, NULL);
+#endif
+}
+
+void StopDebugLogWriter()
+{
+    CAsyncLogWriter* pwriter = pDebugLogWriter.exchange(NULL);
+    if (!pwriter)
+        return;
+
+    pwriter->Stop();
+    // Messages pushed while the writer stopped
+    pwriter->Drain();
+    // Leaked like fileout, a logging thread might still hold the pointer
 }
 
 bool LogAcceptCategory(const char* category)
@@ -288,11 +403,7 @@ static std::string LogTimestampStr(const std::string &str, bool *fStartedNewLine
         return str;
 
     if (*fStartedNewLine) {
-        int64_t nTimeMicros = GetLogTimeMicros();
-        strStamped = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nTimeMicros/1000000);
-        if (fLogTimeMicros)
-            strStamped += strprintf(".%06d", nTimeMicros%1000000);
-        strStamped += ' ' + str;
+        strStamped = LogTimestampPrefix(GetLogTimeMicros()) + str;
     } else
         strStamped = str;
 
@@ -309,6 +420,20 @@ int LogPrintStr(const std::string &str)
     int ret = 0; // Returns total number of characters written
     static bool fStartedNewLine = true;
 
+    if (!fPrintToConsole && fPrintToDebugLog) {
+        CAsyncLogWriter* pwriter = pDebugLogWriter.load();
+        if (pwriter) {
+            // Only take the time here, the writer thread formats it
+            int64_t nTimeMicros = fLogTimestamps && fStartedNewLine ? GetLogTimeMicros() : -1;
+            if (fLogTimestamps)
+                fStartedNewLine = !str.empty() && str[str.size()-1] == '\n';
+
+            ret = str.size();
+            pwriter->Push(nTimeMicros, std::string(str));
+            return ret;
+        }
+    }
+
     string strTimestamped = LogTimestampStr(str, &fStartedNewLine);
 
     if (fPrintToConsole)
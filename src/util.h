@@ -162,6 +162,9 @@ void ReadConfigFile(std::map<std::string, std::string>& mapSettingsRet, std::map
 boost::filesystem::path GetSpecialFolderPath(int nFolder, bool fCreate = true);
 #endif
 void OpenDebugLog();
+void StartDebugLogWriter();
+//! Write everything logged so far and go back to writing on the logging threads
+void StopDebugLogWriter();
 void ShrinkDebugFile();
 void runCommand(const std::string& strCommand);
 
@@ -13,7 +13,10 @@
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
 #include "hash.h"
+#include "index/addressindexer.h"
+#include "index/coinstatsindex.h"
 #include "init.h"
 #include "messagesigner.h"
 #include "net_processing.h"
@@ -38,6 +41,7 @@
 #include "wallet/wallet.h"
 #include "warnings.h"
 
+#include <memory>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -274,6 +278,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewDB *pcoinsdbview = NULL;
+CCoinsViewBackgroundFlush *pcoinsflusher = NULL;
 CCoinsViewCache *pcoinsTip = NULL;
 CBlockTreeDB *pblocktree = NULL;
 
@@ -636,14 +641,19 @@ std::string FormatStateMessage(const CValidationState &state)
         state.GetRejectCode());
 }
 
-bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-                              bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
-                              std::vector<COutPoint>& coins_to_uncache, bool fDryRun){
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
-    AssertLockHeld(cs_main);
-    if (pfMissingInputs)
-        *pfMissingInputs = false;
+void ThreadScriptCheck() {
+    RenameThread("smartcash-scriptch");
+    scriptcheckqueue.Thread();
+}
 
+/**
+ * The checks of a loose transaction which need neither its inputs nor the
+ * rest of the mempool, apart from whether it is in there already.
+ */
+static bool CheckTxForMemPool(const CTransaction& tx, CValidationState& state, const CTxMemPool& pool)
+{
     uint256 hash = tx.GetHash();
     if (!CheckTransaction(tx, state, hash, false)) {
         return false; // state filled in by CheckTransaction
@@ -676,6 +686,35 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
     if (pool.exists(hash))
         return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-in-mempool");
 
+    return true;
+}
+
+/** Check the inputs of tx are standard and count its sigops, all inputs must be in view */
+static bool CheckInputsForMemPool(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int& nSigOps)
+{
+    // Check for non-standard pay-to-script-hash in inputs
+    if (MainNet() && fRequireStandard && !AreInputsStandard(tx, view)) {
+        LogPrintf("cause by -> AreInputsStandard\n");
+        return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
+    }
+
+    nSigOps = GetLegacySigOpCount(tx);
+    nSigOps += GetP2SHSigOpCount(tx, view);
+    return true;
+}
+
+bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                              bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
+                              std::vector<COutPoint>& coins_to_uncache, bool fDryRun, int64_t nAcceptTime){
+
+    AssertLockHeld(cs_main);
+    if (pfMissingInputs)
+        *pfMissingInputs = false;
+
+    uint256 hash = tx.GetHash();
+    if (!CheckTxForMemPool(tx, state, pool))
+        return false; // state filled in by CheckTxForMemPool
+
     // If this is a Transaction Lock Request check to see if it's valid
     if(instantsend.HasTxLockRequest(hash) && !CTxLockRequest(tx).IsValid())
         return state.DoS(10, error("AcceptToMemoryPool : CTxLockRequest %s is invalid", hash.ToString()),
@@ -802,14 +841,9 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         } //LOCK
 
     if (!tx.IsZerocoinSpend()) {
-        // Check for non-standard pay-to-script-hash in inputs
-        if (MainNet() && fRequireStandard && !AreInputsStandard(tx, view)) {
-            LogPrintf("cause by -> AreInputsStandard\n");
-            return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
-        }
-
-        unsigned int nSigOps = GetLegacySigOpCount(tx);
-        nSigOps += GetP2SHSigOpCount(tx, view);
+        unsigned int nSigOps;
+        if (!CheckInputsForMemPool(tx, state, view, nSigOps))
+            return false;
 
         CAmount nValueOut = tx.GetValueOut();
         CAmount nFees = nValueIn - nValueOut;
@@ -832,7 +866,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             }
         }
 
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbase, nSigOps, lp);
+        CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbase, nSigOps, lp);
 
         // Don't accept it if it can't get into a block
         int64_t txMinFee = tx.GetMinFee(1000, true, GMF_RELAY);
@@ -1068,6 +1102,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
+        // For batched transactions the signatures were verified by the script check
+        // threads already and are found in the signature cache.
         if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true))
             return false;
 
@@ -1145,7 +1181,7 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadSpentIndex(key, value))
         return false;
 
     return true;
@@ -1157,7 +1193,7 @@ bool GetAddressIndex(uint160 addressHash, int type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
     return true;
@@ -1168,18 +1204,40 @@ bool GetAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, b
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddresses(addressList, nEndHeight, excludeZeroBalances))
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadAddresses(addressList, nEndHeight, excludeZeroBalances))
         return error("unable to get all addresses");
 
     return true;
 }
 
+bool GetRichList(std::vector<CAddressListEntry> &vecEntries, CAmount nMinBalance, int offset, int limit)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadRichList(vecEntries, nMinBalance, offset, limit))
+        return error("unable to get rich list");
+
+    return true;
+}
+
+bool GetRichListCount(int &count, CAmount nMinBalance)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadRichListCount(count, nMinBalance))
+        return error("unable to get rich list count");
+
+    return true;
+}
+
 bool GetAddressUnspentCount(uint160 addressHash, int type, int &count, CAddressUnspentKey &lastIndex)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndexCount(addressHash, type, count, lastIndex))
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadAddressUnspentIndexCount(addressHash, type, count, lastIndex))
         return error("unable to get unspent count for address");
 
     return true;
@@ -1193,7 +1251,7 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, start, offset, limit, reverse))
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, start, offset, limit, reverse))
         return error("unable to get txids for address");
 
     return true;
@@ -1204,7 +1262,7 @@ bool GetDepositIndexCount(uint160 addressHash, int type, int &count, int &firstT
     if (!fDepositIndex)
         return error("deposit index not enabled");
 
-    if (!pblocktree->ReadDepositIndexCount(addressHash, type, count, firstTime, lastTime, start, end))
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadDepositIndexCount(addressHash, type, count, firstTime, lastTime, start, end))
         return error("unable to get deposits count for address");
 
     return true;
@@ -1217,7 +1275,7 @@ bool GetDepositIndex(uint160 addressHash, int type,
     if (!fDepositIndex)
         return error("deposit index not enabled");
 
-    if (!pblocktree->ReadDepositIndex(addressHash, type, depositIndex, start, offset, limit, reverse))
+    if (!paddressindexer || !paddressindexer->GetDB()->ReadDepositIndex(addressHash, type, depositIndex, start, offset, limit, reverse))
         return error("unable to get deposits for address");
 
     return true;
@@ -1250,7 +1308,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool fDryRun)
 {
     std::vector<COutPoint> coins_to_uncache;
-    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, fOverrideMempoolLimit, fRejectAbsurdFee, coins_to_uncache, fDryRun);
+    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, fOverrideMempoolLimit, fRejectAbsurdFee, coins_to_uncache, fDryRun, GetTime());
     if (!res || fDryRun) {
         if(!res) LogPrint("mempool", "%s: %s %s\n", __func__, tx.GetHash().ToString(), state.GetRejectReason());
         BOOST_FOREACH(const COutPoint& hashTx, coins_to_uncache)
@@ -1262,6 +1320,120 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return res;
 }
 
+/**
+ * Collect the script checks of tx if AcceptToMemoryPoolWorker would get that
+ * far, as far as it doesn't depend on the rest of the batch. Other transactions
+ * are left to the serial checks, so a batch can't be used to make us verify
+ * scripts we'd never have looked at.
+ */
+static bool PrepareScriptChecks(const CTransaction& tx, const CCoinsViewCache& view, const CTxMemPool& pool,
+                                bool fLimitFree, std::vector<CScriptCheck>& vChecks)
+{
+    CValidationState state;
+
+    if (tx.IsZerocoinSpend() || !CheckTxForMemPool(tx, state, pool))
+        return false;
+
+    // Spends outputs of another transaction of the batch, or is just invalid
+    if (!view.HaveInputs(tx))
+        return false;
+    unsigned int nSigOps;
+    if (!CheckInputsForMemPool(tx, state, view, nSigOps) || nSigOps > MAX_STANDARD_TX_SIGOPS_COST)
+        return false;
+
+    CAmount nFees = view.GetValueIn(tx) - tx.GetValueOut();
+    if (fLimitFree && nFees < tx.GetMinFee(1000, true, GMF_RELAY))
+        return false;
+
+    // Collects the script checks instead of running them
+    return CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, &vChecks);
+}
+
+void AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<const CTransaction*>& vtx, std::vector<CTxAcceptResult>& vResults,
+                             bool fLimitFree, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
+                             const std::vector<int64_t>* pvAcceptTime)
+{
+    AssertLockHeld(cs_main);
+
+    vResults.assign(vtx.size(), CTxAcceptResult());
+    std::vector<std::vector<COutPoint> > vCoinsToUncache(vtx.size());
+
+    if (nScriptCheckThreads && vtx.size() > 1) {
+        int64_t nStart = GetTimeMicros();
+
+        CCoinsView dummy;
+        CCoinsViewCache view(&dummy);
+
+        // Fetch the inputs of all transactions in one pass, in key order
+        std::vector<COutPoint> vPrevouts;
+        BOOST_FOREACH(const CTransaction* ptx, vtx) {
+            BOOST_FOREACH(const CTxIn& txin, ptx->vin)
+                vPrevouts.push_back(txin.prevout);
+        }
+        std::sort(vPrevouts.begin(), vPrevouts.end());
+        vPrevouts.erase(std::unique(vPrevouts.begin(), vPrevouts.end()), vPrevouts.end());
+
+        std::set<COutPoint> setFetched;
+        {
+            LOCK(pool.cs);
+            CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
+            view.SetBackend(viewMemPool);
+
+            BOOST_FOREACH(const COutPoint& prevout, vPrevouts) {
+                bool fHadCoinInCache = pcoinsTip->HaveCoinInCache(prevout);
+                if (view.HaveCoin(prevout) && !fHadCoinInCache)
+                    setFetched.insert(prevout);
+            }
+
+            // Bring the best block into scope
+            view.GetBestBlock();
+            view.SetBackend(dummy);
+        }
+
+        std::vector<std::vector<CScriptCheck> > vChecks(vtx.size());
+        size_t nChecks = 0;
+        for (size_t i = 0; i < vtx.size(); i++) {
+            BOOST_FOREACH(const CTxIn& txin, vtx[i]->vin) {
+                if (setFetched.count(txin.prevout))
+                    vCoinsToUncache[i].push_back(txin.prevout);
+            }
+            if (!PrepareScriptChecks(*vtx[i], view, pool, fLimitFree, vChecks[i])) {
+                vChecks[i].clear();
+                continue;
+            }
+            nChecks += vChecks[i].size();
+        }
+
+        // The valid signatures end up in the signature cache, the serial
+        // checks below still run every script but mostly find them there.
+        // A failing check only stops the queue early, the serial checks
+        // tell which transaction it was and set its reject reason.
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        for (size_t i = 0; i < vtx.size(); i++)
+            control.Add(vChecks[i]);
+        control.Wait();
+
+        LogPrint("bench", "    - Prepare %u txins of %u mempool txs: %.2fms\n", nChecks, vtx.size(), (GetTimeMicros() - nStart) * 0.001);
+    }
+
+    for (size_t i = 0; i < vtx.size(); i++) {
+        const CTransaction& tx = *vtx[i];
+        CTxAcceptResult& result = vResults[i];
+
+        result.fAccepted = AcceptToMemoryPoolWorker(pool, result.state, tx, fLimitFree, &result.fMissingInputs, fOverrideMempoolLimit,
+                                                    fRejectAbsurdFee, vCoinsToUncache[i], false, pvAcceptTime ? (*pvAcceptTime)[i] : GetTime());
+        if (!result.fAccepted) {
+            LogPrint("mempool", "%s: %s %s\n", __func__, tx.GetHash().ToString(), result.state.GetRejectReason());
+            BOOST_FOREACH(const COutPoint& outpoint, vCoinsToUncache[i])
+                pcoinsTip->Uncache(outpoint);
+        }
+    }
+
+    // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
+    CValidationState stateDummy;
+    FlushStateToDisk(stateDummy, FLUSH_STATE_PERIODIC);
+}
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -1393,6 +1565,55 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    vchBlock.clear();
+
+    // The block is preceded by the message start and its size, see WriteBlockToDisk
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s: Invalid position %s", __func__, pos.ToString());
+
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+
+    // Open history file to read
+    CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blockStart;
+        unsigned int nSize;
+
+        filein >> FLATDATA(blockStart) >> nSize;
+
+        if (memcmp(blockStart, messageStart, MESSAGE_START_SIZE))
+            return error("%s: Block magic mismatch at %s", __func__, pos.ToString());
+
+        if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("%s: Invalid block size %u at %s", __func__, nSize, pos.ToString());
+
+        vchBlock.resize(nSize);
+        filein.read((char*)begin_ptr(vchBlock), nSize);
+    }
+    catch (const std::exception& e) {
+        vchBlock.clear();
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = pindex->GetBlockPos();
+    }
+
+    return ReadRawBlockFromDisk(vchBlock, pos, messageStart);
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     if (nHeight == 0)
@@ -1739,6 +1960,26 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
+/** Abort with a message */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+    return false;
+}
+
+bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+{
+    AbortNode(strMessage, userMessage);
+    return state.Error(strMessage);
+}
+
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
     // Open history file to read
@@ -1766,26 +2007,6 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
     return true;
 }
 
-/** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
-{
-    SetMiscWarning(strMessage);
-    LogPrintf("*** %s\n", strMessage);
-    uiInterface.ThreadSafeMessageBox(
-        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
-        "", CClientUIInterface::MSG_ERROR);
-    StartShutdown();
-    return false;
-}
-
-bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
-{
-    AbortNode(strMessage, userMessage);
-    return state.Error(strMessage);
-}
-
-} // anon namespace
-
 enum DisconnectResult
 {
     DISCONNECT_OK,      // All good.
@@ -1848,10 +2069,11 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
         return DISCONNECT_FAILED;
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-    std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
+    // Collected before the spent coins get moved out of the undo data below
+    CVotingPowerDeltas mapVotingPowerDeltas;
+    if (!fIsVerifyDB)
+        GetVotingPowerDeltas(block, blockUndo, mapVotingPowerDeltas);
+
     /* WIP-VOTING uncomment
     std::map<CVoteKey, CSmartAddress> mapVoteKeys;
     std::vector<CVoteKeyRegistrationKey> vecInvalidVoteKeyRegistrations;
@@ -1865,73 +2087,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
         const CTransaction &tx = block.vtx[i];
         uint256 hash = tx.GetHash();
         bool is_coinbase = tx.IsCoinBase();
-        std::map<std::pair<uint160, int>, CAmount> vecInputs;
-        std::map<std::pair<uint160, int>, CAmount> vecOutputs;
-
-        if (fAddressIndex || fDepositIndex) {
-
-            uint160 hashBytes;
-            int addressType;
-
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23));
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-
-                    vector<unsigned char> pubKeyBytes(out.scriptPubKey.begin()+1, out.scriptPubKey.begin()+34);
-                    CPubKey pubKey(pubKeyBytes);
-                    hashBytes = pubKey.GetID();
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToScriptHashLocked()) {
-
-                    int nOffset = out.scriptPubKey[0] + 5;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-
-                    int nOffset = out.scriptPubKey[0] + 6;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 1;
-                } else {
-                    continue;
-                }
-
-                if( fAddressIndex ){
-
-                    // undo receiving activity
-                    addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, hash, k, pindex->nHeight), CAddressUnspentValue()));
-                }
-
-                if ( fDepositIndex ) {
-
-                    auto it = vecOutputs.find(std::make_pair(hashBytes,addressType));
-
-                    if( it == vecOutputs.end() ){
-                        // For the first occurrence of the address it
-                        vecOutputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), out.nValue));
-                    }else{
-                        // For further ones add up the amount
-                        it->second += out.nValue;
-                    }
-
-                }
-
-            }
-
-        }
 
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
@@ -1955,85 +2110,9 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             }
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                int undoHeight = txundo.vprevout[j].nHeight;
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-                const CTxIn input = tx.vin[j];
-
-                if (fSpentIndex) {
-                    // undo and delete the spent index
-                    spentIndex.push_back(make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
-                }
-
-                if (fAddressIndex || fDepositIndex) {
-
-                    const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-
-                    uint160 hashBytes;
-                    int addressType = 0;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-
-                        vector<unsigned char> pubKeyBytes(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.begin()+34);
-                        CPubKey pubKey(pubKeyBytes);
-                        hashBytes = pubKey.GetID();
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToScriptHashLocked()) {
-
-                        int nOffset = prevout.scriptPubKey[0] + 5;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 2;
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-
-                        int nOffset = prevout.scriptPubKey[0] + 6;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 1;
-
-                    } else {
-                        continue;
-                    }
-
-                    if ( fDepositIndex ) {
-
-                        auto it = vecInputs.find(std::make_pair(hashBytes,addressType));
-
-                        if( it == vecInputs.end() ){
-                            // For the first occurrence of the address it
-                            vecInputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), prevout.nValue));
-                        }else{
-                            // For further ones add up the amount
-                            it->second += prevout.nValue;
-                        }
-
-                    }
-
-                    if( fAddressIndex ){
-
-                        // undo spending activity
-                        addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, undoHeight), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
-                    }
-
-                }
-
             }
 
             /* WIP-VOTING uncomment
@@ -2063,28 +2142,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             }
             */
 
-            if( fDepositIndex ){
-
-                for( auto const &output : vecOutputs ){
-
-                    auto input = vecInputs.find(std::make_pair( output.first.first, output.first.second ));
-
-                    if( input == vecInputs.end() ){
-                        // If there is no input related to the address of this output just add it as deposit
-                        depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(output.second,pindex->nHeight)));
-                    }else{
-
-                        // If there is an input related to the address of this output evaluate if the outputs exceed the inputs
-                        CAmount nDeposit = output.second - input->second;
-
-                        if( nDeposit > 0 ){
-                            // If the outputs exceed the inputs add the deposit.
-                            depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(nDeposit,pindex->nHeight)));
-                        }
-                    }
-                }
-            }
-
             // At this point, all of txundo.vprevout should have been moved out.
         }
 
@@ -2097,27 +2154,16 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    if (!fIsVerifyDB && fDepositIndex) {
-
-        if( !pblocktree->EraseDepositIndex(depositIndex) ){
-            AbortNode(state, "Failed to write deposit index");
-            return DISCONNECT_FAILED;
-        }
+    if( !fIsVerifyDB && !prewards->CommitUndoBlock( (CBlockIndex*) pindex, smartRewardsResult) ){
+        AbortNode(state, "Failed to commit smartrewards block undo");
+        return DISCONNECT_FAILED;
     }
 
-    if (!fIsVerifyDB && fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode(state, "Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode(state, "Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
+    if (!fIsVerifyDB)
+        ApplyVotingPowerDeltas(mapVotingPowerDeltas, pindex, false);
 
-    if( !fIsVerifyDB && !prewards->CommitUndoBlock( (CBlockIndex*) pindex, smartRewardsResult) ){
-        AbortNode(state, "Failed to commit smartrewards block undo");
+    if (!fIsVerifyDB && pcoinstatsindex && !pcoinstatsindex->BlockDisconnected(block, blockUndo, pindex)) {
+        AbortNode(state, "Failed to update coin stats index");
         return DISCONNECT_FAILED;
     }
 
@@ -2161,13 +2207,6 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
-void ThreadScriptCheck() {
-    RenameThread("smartcash-scriptch");
-    scriptcheckqueue.Thread();
-}
-
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2373,10 +2412,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-    std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
     /* WIP-VOTING uncomment
     std::vector<std::pair<CVoteKeyRegistrationKey, VoteKeyParseResult>> vecInvalidVoteKeyRegistrations;
     std::map<CVoteKey, CVoteKeyValue> mapVoteKeys;
@@ -2391,8 +2426,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     {
         const CTransaction &tx = block.vtx[i];
         const uint256 txhash = tx.GetHash();
-        std::map<std::pair<uint160, int>, CAmount> vecInputs;
-        std::map<std::pair<uint160, int>, CAmount> vecOutputs;
 
         int nCurrentRewardsRound = prewards->GetCurrentRound()->number;
         bool fProcessRewards = !fIsVerifyDB && prewards->ProcessTransaction(pindex, tx, nCurrentRewardsRound);
@@ -2434,67 +2467,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                 if( fProcessRewards && !input.scriptSig.IsZerocoinSpend() ){
                     prewards->ProcessInput(tx, prevout, coin.nHeight, nCurrentRewardsRound, smartRewardsResult);
                 }
-
-                if (fAddressIndex || fSpentIndex || fDepositIndex)
-                {
-                    uint160 hashBytes;
-                    int addressType;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        hashBytes = uint160(vector <unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        hashBytes = uint160(vector <unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        vector<unsigned char> pubKeyBytes(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.begin()+34);
-                        CPubKey pubKey(pubKeyBytes);
-                        hashBytes = pubKey.GetID();
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToScriptHashLocked()) {
-                        int nOffset = prevout.scriptPubKey[0] + 5;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-                        int nOffset = prevout.scriptPubKey[0] + 6;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 1;
-                    } else {
-                        hashBytes.SetNull();
-                        addressType = 0;
-                    }
-
-                    if (fDepositIndex && addressType) {
-
-                        auto it = vecInputs.find(std::make_pair(hashBytes,addressType));
-
-                        if( it == vecInputs.end() ){
-                            // For the first occurrence of the address it
-                            vecInputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), prevout.nValue));
-                        }else{
-                            // For further ones add up the amount
-                            it->second += prevout.nValue;
-                        }
-
-                    }
-
-                    if (fAddressIndex && addressType > 0) {
-                        // record spending activity
-                        addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, coin.nHeight), CAddressUnspentValue()));
-                    }
-
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
-                    }
-                }
-
             }
 
             if (fStrictPayToScriptHash)
@@ -2525,82 +2497,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             if( fProcessRewards && !out.scriptPubKey.IsZerocoinMint() ){
                 prewards->ProcessOutput(tx, out, nCurrentRewardsRound, pindex->nHeight, pindex->nTime, smartRewardsResult);
             }
-
-            if (fAddressIndex || fDepositIndex) {
-
-                uint160 hashBytes;
-                int addressType;
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    hashBytes = uint160(vector <unsigned char>(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    hashBytes = uint160(vector <unsigned char>(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23));
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    vector<unsigned char> pubKeyBytes(out.scriptPubKey.begin()+1, out.scriptPubKey.begin()+34);
-                    CPubKey pubKey(pubKeyBytes);
-                    hashBytes = pubKey.GetID();
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToScriptHashLocked()) {
-                    int nOffset = out.scriptPubKey[0] + 5;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-                    int nOffset = out.scriptPubKey[0] + 6;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 1;
-                } else {
-                    continue;
-                }
-
-                if ( fDepositIndex ) {
-
-                    auto it = vecOutputs.find(std::make_pair(hashBytes,addressType));
-
-                    if( it == vecOutputs.end() ){
-                        // For the first occurrence of the address it
-                        vecOutputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), out.nValue));
-                    }else{
-                        // For further ones add up the amount
-                        it->second += out.nValue;
-                    }
-
-                }
-
-                if( fAddressIndex ){
-
-                    // record receiving activity
-                    addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
-                    // record unspent output
-                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k, pindex->nHeight), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-                }
-
-            }
-
-            if( fDepositIndex ){
-
-                for( auto const &output : vecOutputs ){
-
-                    auto input = vecInputs.find(std::make_pair( output.first.first, output.first.second ));
-
-                    if( input == vecInputs.end() ){
-                        // If there is no input related to the address of this output just add it as deposit
-                        depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(output.second,pindex->nHeight)));
-                    }else{
-
-                        // If there is an input related to the address of this output evaluate if the outputs exceed the inputs
-                        CAmount nDeposit = output.second - input->second;
-
-                        if( nDeposit > 0 ){
-                            // If the outputs exceed the inputs add the deposit.
-                            depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(nDeposit,pindex->nHeight)));
-                        }
-                    }
-                }
-            }
         }
 
         /* WIP-VOTING uncomment
@@ -2693,6 +2589,12 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         prewards->CommitBlock(pindex, smartRewardsResult);
     }
 
+    if (!fIsVerifyDB) {
+        CVotingPowerDeltas mapVotingPowerDeltas;
+        GetVotingPowerDeltas(block, blockundo, mapVotingPowerDeltas);
+        ApplyVotingPowerDeltas(mapVotingPowerDeltas, pindex, true);
+    }
+
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS))
     {
@@ -2716,30 +2618,13 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (!fIsVerifyDB && fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-    }
-
-    if (!fIsVerifyDB && fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write spent index");
-
     if (!fIsVerifyDB && fTimestampIndex)
         if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
             return AbortNode(state, "Failed to write timestamp index");
 
-    if (!fIsVerifyDB && fDepositIndex) {
-
-        if( !pblocktree->WriteDepositIndex(depositIndex) ){
-            return AbortNode(state, "Failed to write deposit index");
-        }
-    }
+    if (!fIsVerifyDB && pcoinstatsindex)
+        if (!pcoinstatsindex->BlockConnected(block, blockundo, pindex))
+            return AbortNode(state, "Failed to write coin stats index");
 
     /* WIP-VOTING uncomment
     if ( vecInvalidVoteKeyRegistrations.size() && !pblocktree->WriteInvalidVoteKeyRegistrations(vecInvalidVoteKeyRegistrations) )
@@ -2781,6 +2666,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
     std::set<int> setFilesToPrune;
     bool fFlushForPrune = false;
     try {
+    // A batch written in the background failed, the state on disk is behind pcoinsTip
+    if (pcoinsflusher && pcoinsflusher->HasFailed())
+        return AbortNode(state, "Failed to write to coin database");
     if (fPruneMode && fCheckForPruning && !fReindex) {
         FindFilesToPrune(setFilesToPrune, chainparams.PruneAfterHeight());
         fCheckForPruning = false;
@@ -2804,6 +2692,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         nLastSetChain = nNow;
     }
     size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+    // A snapshot still being written in the background counts against -dbcache as well
+    if (pcoinsflusher)
+        cacheSize += pcoinsflusher->DynamicMemoryUsage();
     // The cache is large and close to the limit, but we have time now (not in the middle of a block processing).
     bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0/9) > nCoinCacheUsage;
     // The cache is over the limit, we have to write now.
@@ -2844,9 +2735,6 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
                 return AbortNode(state, "Files to write to block index database");
             }
         }
-        // Finally remove any pruned files
-        if (fFlushForPrune)
-            UnlinkPrunedFiles(setFilesToPrune);
         nLastWrite = nNow;
     }
     // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2859,14 +2747,30 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
         // Flush the chainstate (which may refer to block index entries).
+        // With -backgroundflush this only hands the coins over to the writer.
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
+        // Callers of a full flush expect the coins on disk when it returns, and
+        // the pruned block files may still be needed until they are
+        if ((mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && pcoinsflusher && !pcoinsflusher->WaitForFlush())
+            return AbortNode(state, "Failed to write to coin database");
+        // Finally remove any pruned files
+        if (fFlushForPrune)
+            UnlinkPrunedFiles(setFilesToPrune);
         nLastFlush = nNow;
     }
     if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
         // Update best block in wallet (so we can detect restored wallets).
-        GetMainSignals().SetBestChain(chainActive.GetLocator());
-        nLastSetChain = nNow;
+        // The wallet can't get ahead of the coins that are on disk.
+        const CBlockIndex* pindexFlushed = chainActive.Tip();
+        if (pcoinsflusher && pcoinsflusher->IsAsync()) {
+            BlockMap::iterator mi = mapBlockIndex.find(pcoinsflusher->GetCommittedBestBlock());
+            pindexFlushed = mi != mapBlockIndex.end() ? mi->second : NULL;
+        }
+        if (pindexFlushed) {
+            GetMainSignals().SetBestChain(chainActive.GetLocator(pindexFlushed));
+            nLastSetChain = nNow;
+        }
     }
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error while flushing: ") + e.what());
@@ -2974,12 +2878,19 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
         return false;
     // Resurrect mempool transactions from the disconnected block.
+    std::vector<const CTransaction*> vResurrect;
+    BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+        if (!tx.IsCoinBase())
+            vResurrect.push_back(&tx);
+    }
+    // ignore validation errors in resurrected transactions
+    std::vector<CTxAcceptResult> vResults;
+    AcceptToMemoryPoolBatch(mempool, vResurrect, vResults, false, true);
     std::vector<uint256> vHashUpdate;
-    BOOST_FOREACH(const CTransaction &tx, block.vtx) {
-        // ignore validation errors in resurrected transactions
+    for (size_t i = 0, j = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = block.vtx[i];
         list<CTransaction> removed;
-        CValidationState stateDummy;
-        if (tx.IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL, true)) {
+        if (tx.IsCoinBase() || !vResults[j++].fAccepted) {
             mempool.remove(tx, removed, true);
         } else if (mempool.exists(tx.GetHash())) {
             vHashUpdate.push_back(tx.GetHash());
@@ -2993,6 +2904,7 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
     mempool.UpdateTransactionsFromBlock(vHashUpdate);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
+    GetMainSignals().BlockDisconnected(block, pindexDelete);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     BOOST_FOREACH(const CTransaction &tx, block.vtx) {
@@ -3051,6 +2963,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, !IsInitialBlockDownload());
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    GetMainSignals().BlockConnected(*pblock, pindexNew);
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH(const CTransaction &tx, txConflicted) {
@@ -3675,9 +3588,13 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
                 uint256 hashLocked;
                 if(instantsend.GetLockedOutPointTxHash(txin.prevout, hashLocked) && hashLocked != tx.GetHash()) {
                     // The node which relayed this will have to switch later,
-                    // relaying instantsend data won't help it.
-                    LOCK(cs_main);
-                    mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+                    // relaying instantsend data won't help it. Blocks of the
+                    // active chain checked by VerifyDB are not rejected, this
+                    // runs on its worker threads while cs_main is held.
+                    if (!isVerifyDB) {
+                        LOCK(cs_main);
+                        mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+                    }
                     return state.DoS(0, error("CheckBlock(SMART): transaction %s conflicts with transaction lock %s",
                                                 tx.GetHash().ToString(), hashLocked.ToString()),
                                      REJECT_INVALID, "conflict-tx-lock");
@@ -4392,6 +4309,166 @@ bool static LoadBlockIndexDB()
     return true;
 }
 
+namespace {
+
+/** A block of the active chain checked by CVerifyDBPrefetcher */
+struct CVerifyDBEntry
+{
+    CBlockIndex* pindex;
+    //! Kept for the disconnect of check level 3
+    CBlock block;
+    unsigned int nSize;
+    //! The check level the block failed, -1 if it passed them
+    int nFailedLevel;
+    //! Microseconds spent on the check levels 0-2
+    int64_t nTimeLevel[3];
+    bool fReady;
+
+    CVerifyDBEntry(CBlockIndex* pindexIn) : pindex(pindexIn), nSize(0), nFailedLevel(-1), fReady(false)
+    {
+        nTimeLevel[0] = nTimeLevel[1] = nTimeLevel[2] = 0;
+    }
+};
+
+typedef std::shared_ptr<CVerifyDBEntry> CVerifyDBEntryRef;
+
+/**
+ * Runs the check levels 0-2 of VerifyDB (read the block, CheckBlock, read the
+ * undo data and verify its checksum) on worker threads. They don't depend on
+ * each other, unlike the disconnect of level 3, which gets the blocks from the
+ * tip down as before. The workers stay at most MAX_VERIFYDB_PREFETCH_SIZE bytes
+ * of blocks ahead of it.
+ *
+ * The workers run while the caller holds cs_main, so they must not take it.
+ */
+class CVerifyDBPrefetcher
+{
+private:
+    const Consensus::Params& consensusParams;
+    int nCheckLevel;
+
+    CWaitableCriticalSection cs;
+    CConditionVariable condWorker;
+    CConditionVariable condVerifier;
+
+    //! The blocks to check, tip first
+    std::vector<CVerifyDBEntryRef> vEntries;
+    size_t nNextWork;
+    size_t nNextOut;
+    //! Size of the checked blocks not handed out yet
+    uint64_t nQueuedSize;
+    int64_t nTimeWaited;
+    bool fStop;
+
+    boost::thread_group threadGroup;
+
+    void Check(CVerifyDBEntry& entry)
+    {
+        int64_t nTimeStart = GetTimeMicros();
+        // check level 0: read from disk
+        if (!ReadBlockFromDisk(entry.block, entry.pindex, consensusParams)) {
+            entry.nFailedLevel = 0;
+            return;
+        }
+        int64_t nTimeRead = GetTimeMicros();
+        entry.nTimeLevel[0] = nTimeRead - nTimeStart;
+
+        // check level 1: verify block validity
+        CValidationState state;
+        if (nCheckLevel >= 1 && !CheckBlock(entry.block, state, true, true, true)) {
+            entry.nFailedLevel = 1;
+            return;
+        }
+        int64_t nTimeCheck = GetTimeMicros();
+        entry.nTimeLevel[1] = nTimeCheck - nTimeRead;
+
+        // check level 2: verify undo validity
+        if (nCheckLevel >= 2) {
+            CBlockUndo undo;
+            CDiskBlockPos pos = entry.pindex->GetUndoPos();
+            if (!pos.IsNull() && !UndoReadFromDisk(undo, pos, entry.pindex->pprev->GetBlockHash())) {
+                entry.nFailedLevel = 2;
+                return;
+            }
+        }
+        entry.nTimeLevel[2] = GetTimeMicros() - nTimeCheck;
+
+        if (nCheckLevel >= 3)
+            entry.nSize = ::GetSerializeSize(entry.block, SER_DISK, CLIENT_VERSION);
+        else
+            entry.block.SetNull();
+    }
+
+    void ThreadCheck()
+    {
+        while (true) {
+            CVerifyDBEntryRef entry;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && (nNextWork == vEntries.size() || nQueuedSize > MAX_VERIFYDB_PREFETCH_SIZE))
+                    condWorker.wait(lock);
+                if (fStop)
+                    return;
+                entry = vEntries[nNextWork++];
+            }
+
+            Check(*entry);
+
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                entry->fReady = true;
+                nQueuedSize += entry->nSize;
+            }
+            condVerifier.notify_all();
+        }
+    }
+
+public:
+    CVerifyDBPrefetcher(const std::vector<CBlockIndex*>& vIndex, const Consensus::Params& consensusParamsIn, int nCheckLevelIn, int nThreads) :
+        consensusParams(consensusParamsIn), nCheckLevel(nCheckLevelIn),
+        nNextWork(0), nNextOut(0), nQueuedSize(0), nTimeWaited(0), fStop(false)
+    {
+        vEntries.reserve(vIndex.size());
+        BOOST_FOREACH(CBlockIndex* pindex, vIndex)
+            vEntries.push_back(std::make_shared<CVerifyDBEntry>(pindex));
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&CVerifyDBPrefetcher::ThreadCheck, this));
+    }
+
+    ~CVerifyDBPrefetcher()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        condWorker.notify_all();
+        threadGroup.join_all();
+    }
+
+    //! Wait for the next checked block, from the tip down. Returns false after the last one.
+    bool Next(CVerifyDBEntryRef& entry)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (nNextOut == vEntries.size())
+            return false;
+
+        int64_t nTimeStart = GetTimeMicros();
+        while (!vEntries[nNextOut]->fReady)
+            condVerifier.wait(lock);
+        nTimeWaited += GetTimeMicros() - nTimeStart;
+
+        entry.swap(vEntries[nNextOut++]);
+        nQueuedSize -= entry->nSize;
+        condWorker.notify_all();
+        return true;
+    }
+
+    //! Microseconds Next() waited for the workers
+    int64_t GetTimeWaited() const { return nTimeWaited; }
+};
+
+} // anon namespace
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -4420,51 +4497,68 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     CBlockIndex* pindexFailure = NULL;
     int nGoodTransactions = 0;
     CValidationState state;
+
+    std::vector<CBlockIndex*> vIndex;
     for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
     {
-        boost::this_thread::interruption_point();
-        uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
-
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, true, true, true))
-            return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            DisconnectResult res = DisconnectBlock(block, state, pindex, coins, true);
-            if (res == DISCONNECT_FAILED) {
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
+        vIndex.push_back(pindex);
+    }
 
-            pindexState = pindex->pprev;
-            if (res == DISCONNECT_UNCLEAN) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else {
-                nGoodTransactions += block.vtx.size();
+    // The script check threads are idle meanwhile, with -par=1 the single
+    // worker still reads ahead of the disconnects
+    int nThreads = std::max(1, nScriptCheckThreads);
+    int64_t nTimeStart = GetTimeMicros();
+    int64_t nTimeLevel[5] = {0, 0, 0, 0, 0};
+    int64_t nTimeWaited = 0;
+    {
+        CVerifyDBPrefetcher prefetcher(vIndex, chainparams.GetConsensus(), nCheckLevel, nThreads);
+        CVerifyDBEntryRef entry;
+        while (prefetcher.Next(entry))
+        {
+            CBlockIndex* pindex = entry->pindex;
+            boost::this_thread::interruption_point();
+            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
+
+            if (entry->nFailedLevel == 0)
+                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            if (entry->nFailedLevel == 1)
+                return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+            if (entry->nFailedLevel == 2)
+                return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+            for (int i = 0; i < 3; i++)
+                nTimeLevel[i] += entry->nTimeLevel[i];
+
+            // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+            int64_t nTimeDisconnect = GetTimeMicros();
+            if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+                DisconnectResult res = DisconnectBlock(entry->block, state, pindex, coins, true);
+                if (res == DISCONNECT_FAILED) {
+                    return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+                }
+
+                pindexState = pindex->pprev;
+                if (res == DISCONNECT_UNCLEAN) {
+                    nGoodTransactions = 0;
+                    pindexFailure = pindex;
+                } else {
+                    nGoodTransactions += entry->block.vtx.size();
+                }
             }
+            nTimeLevel[3] += GetTimeMicros() - nTimeDisconnect;
+            entry.reset();
+
+            if (ShutdownRequested())
+                return true;
         }
-        if (ShutdownRequested())
-            return true;
+        nTimeWaited = prefetcher.GetTimeWaited();
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
 
     // check level 4: try reconnecting blocks
+    int64_t nTimeConnect = GetTimeMicros();
     if (nCheckLevel >= 4) {
         CBlockIndex *pindex = pindexState;
         while (pindex != chainActive.Tip()) {
@@ -4478,7 +4572,12 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         }
     }
+    nTimeLevel[4] = GetTimeMicros() - nTimeConnect;
 
+    // Levels 0-2 are summed over the worker threads
+    LogPrintf("VerifyDB: %u blocks in %.2fs, level 0 %.2fs, level 1 %.2fs, level 2 %.2fs (%d threads, %.2fs waited for), level 3 %.2fs, level 4 %.2fs\n",
+              vIndex.size(), (GetTimeMicros() - nTimeStart) * 0.000001, nTimeLevel[0] * 0.000001, nTimeLevel[1] * 0.000001,
+              nTimeLevel[2] * 0.000001, nThreads, nTimeWaited * 0.000001, nTimeLevel[3] * 0.000001, nTimeLevel[4] * 0.000001);
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", chainActive.Height() - pindexState->nHeight, nGoodTransactions);
 
     return true;
@@ -4578,58 +4677,301 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+namespace {
+
+/** A block found in a block file by CBlockFilePrefetcher */
+struct CBlockFileEntry
+{
+    //! Position of the message start preceding the block
+    uint64_t nStartPos;
+    //! Position of the serialized block
+    uint64_t nBlockPos;
+    unsigned int nSize;
+    //! Serialized block, released once deserialized
+    std::unique_ptr<CDataStream> pssBlock;
+
+    CBlock block;
+    uint256 hash;
+    bool fReady;
+    bool fFailed;
+    std::string strError;
+
+    CBlockFileEntry() : nStartPos(0), nBlockPos(0), nSize(0), fReady(false), fFailed(false) {}
+};
+
+typedef std::shared_ptr<CBlockFileEntry> CBlockFileEntryRef;
+
+/**
+ * Reads a block file ahead of the importer. One thread scans the file for blocks and
+ * a few worker threads deserialize them and compute the block hashes (transaction hashes
+ * are computed while deserializing). The blocks are handed out in file order, so the
+ * importer only has to validate and store them.
+ */
+class CBlockFilePrefetcher
+{
+private:
+    CAutoFile file;
+    const CMessageHeader::MessageStartChars& messageStart;
+
+    CWaitableCriticalSection cs;
+    CConditionVariable condReader;
+    CConditionVariable condWorker;
+    CConditionVariable condImporter;
+
+    //! Blocks read ahead in file order
+    std::deque<CBlockFileEntryRef> queue;
+    //! Blocks which still need to be deserialized
+    std::deque<CBlockFileEntryRef> queueWork;
+    uint64_t nQueuedSize;
+    //! Incremented by Restart(), blocks read for an older generation are dropped
+    int nGeneration;
+    uint64_t nRestartPos;
+    bool fEof;
+    bool fStop;
+
+    boost::thread_group threadGroup;
+
+    bool FindMessageStart(uint64_t& nPos)
+    {
+        // Skip to the next occurrence of the first message start byte behind nPos
+        unsigned char buf[4096];
+        nPos++;
+        if (fseek(file.Get(), nPos, SEEK_SET))
+            return false;
+        while (true) {
+            size_t nRead = fread(buf, 1, sizeof(buf), file.Get());
+            const unsigned char* pfound = (const unsigned char*)memchr(buf, messageStart[0], nRead);
+            if (pfound) {
+                nPos += pfound - buf;
+                return true;
+            }
+            nPos += nRead;
+            if (nRead < sizeof(buf))
+                return false;
+        }
+    }
+
+    bool ReadBlock(uint64_t& nPos, CBlockFileEntryRef& entry)
+    {
+        unsigned char header[MESSAGE_START_SIZE + sizeof(uint32_t)];
+
+        while (true) {
+            if (fseek(file.Get(), nPos, SEEK_SET) || fread(header, 1, sizeof(header), file.Get()) != sizeof(header))
+                return false;
+
+            unsigned int nSize = ReadLE32(header + MESSAGE_START_SIZE);
+
+            // Anything smaller than a block header can't be a block either
+            if (!memcmp(header, messageStart, MESSAGE_START_SIZE) && nSize >= 80 && nSize <= MAX_BLOCK_SERIALIZED_SIZE) {
+                entry = std::make_shared<CBlockFileEntry>();
+                entry->nStartPos = nPos;
+                entry->nBlockPos = nPos + sizeof(header);
+                entry->nSize = nSize;
+                entry->pssBlock.reset(new CDataStream(SER_DISK, CLIENT_VERSION));
+                entry->pssBlock->resize(nSize);
+                if (fread(&(*entry->pssBlock)[0], 1, nSize, file.Get()) == nSize) {
+                    nPos = entry->nBlockPos + nSize;
+                    return true;
+                }
+                // Truncated block, continue to look for blocks behind its message start
+            }
+
+            if (!FindMessageStart(nPos))
+                return false;
+        }
+    }
+
+    void ThreadRead()
+    {
+        uint64_t nPos = ftell(file.Get());
+        int nReadGeneration = 0;
+
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && nReadGeneration == nGeneration && nQueuedSize > MAX_BLOCKFILE_PREFETCH_SIZE)
+                    condReader.wait(lock);
+                if (fStop)
+                    return;
+                if (nReadGeneration != nGeneration) {
+                    nReadGeneration = nGeneration;
+                    nPos = nRestartPos;
+                }
+            }
+
+            CBlockFileEntryRef entry;
+            bool fFound = ReadBlock(nPos, entry);
+
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                if (nReadGeneration != nGeneration)
+                    continue;
+                if (!fFound) {
+                    fEof = true;
+                    condImporter.notify_all();
+                    while (!fStop && nReadGeneration == nGeneration)
+                        condReader.wait(lock);
+                    continue;
+                }
+                queue.push_back(entry);
+                queueWork.push_back(entry);
+                nQueuedSize += entry->nSize;
+            }
+            condWorker.notify_one();
+        }
+    }
+
+    void ThreadDeserialize()
+    {
+        while (true) {
+            CBlockFileEntryRef entry;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && queueWork.empty())
+                    condWorker.wait(lock);
+                if (fStop)
+                    return;
+                entry = queueWork.front();
+                queueWork.pop_front();
+            }
+
+            try {
+                *entry->pssBlock >> entry->block;
+                entry->hash = entry->block.GetHash();
+            } catch (const std::exception& e) {
+                entry->fFailed = true;
+                entry->strError = e.what();
+            }
+            entry->pssBlock.reset();
+
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                entry->fReady = true;
+            }
+            condImporter.notify_all();
+        }
+    }
+
+public:
+    CBlockFilePrefetcher(FILE* fileIn, const CMessageHeader::MessageStartChars& messageStartIn, int nThreads) :
+        file(fileIn, SER_DISK, CLIENT_VERSION), messageStart(messageStartIn),
+        nQueuedSize(0), nGeneration(0), nRestartPos(0), fEof(false), fStop(false)
+    {
+        threadGroup.create_thread(boost::bind(&CBlockFilePrefetcher::ThreadRead, this));
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&CBlockFilePrefetcher::ThreadDeserialize, this));
+    }
+
+    ~CBlockFilePrefetcher()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        condReader.notify_all();
+        condWorker.notify_all();
+        threadGroup.join_all();
+    }
+
+    //! Wait for the next block in file order. Returns false at the end of the file.
+    bool Next(CBlockFileEntryRef& entry)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (true) {
+            if (!queue.empty() && queue.front()->fReady) {
+                entry = queue.front();
+                queue.pop_front();
+                nQueuedSize -= entry->nSize;
+                condReader.notify_one();
+                return true;
+            }
+            if (queue.empty() && fEof)
+                return false;
+            condImporter.wait(lock);
+        }
+    }
+
+    //! Drop the blocks read ahead and continue scanning the file at nPos
+    void Restart(uint64_t nPos)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            queue.clear();
+            queueWork.clear();
+            nQueuedSize = 0;
+            nRestartPos = nPos;
+            nGeneration++;
+            fEof = false;
+        }
+        condReader.notify_all();
+    }
+};
+
+/** A block whose parent wasn't known yet when it was read */
+struct CUnknownParentBlock
+{
+    //! Position in the block files (only if reindexing)
+    CDiskBlockPos pos;
+    //! The block itself, if it fit into the buffer
+    std::shared_ptr<const CBlock> pblock;
+    unsigned int nSize;
+
+    CUnknownParentBlock() : nSize(0) {}
+};
+
+} // anon namespace
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    // Map of blocks with unknown parent, kept in memory up to MAX_BLOCKFILE_ORPHAN_BUFFER_SIZE
+    // and re-read from disk beyond that (only possible when reindexing)
+    static std::multimap<uint256, CUnknownParentBlock> mapBlocksUnknownParent;
+    static uint64_t nUnknownParentBufferSize = 0;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
+    int nRead = 0;
+    uint64_t nReadSize = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        // This takes over fileIn and calls fclose() on it in the CBlockFilePrefetcher destructor
+        int nThreads = std::max(1, std::min(GetNumCores() - 1, MAX_BLOCKFILE_PREFETCH_THREADS));
+        CBlockFilePrefetcher prefetcher(fileIn, chainparams.MessageStart(), nThreads);
+        CBlockFileEntryRef entry;
+        while (prefetcher.Next(entry)) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+            if (entry->fFailed) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, entry->strError);
+                // start one byte further, the size of the block might have been wrong
+                prefetcher.Restart(entry->nStartPos + 1);
+                continue;
             }
+
+            nRead++;
+            nReadSize += entry->nSize;
+
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+                    dbp->nPos = entry->nBlockPos;
+                const CBlock& block = entry->block;
+                const uint256& hash = entry->hash;
 
                 // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
                 if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
                     LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
                             block.hashPrevBlock.ToString());
+                    CUnknownParentBlock unknown;
                     if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                        unknown.pos = *dbp;
+                    if (nUnknownParentBufferSize + entry->nSize <= MAX_BLOCKFILE_ORPHAN_BUFFER_SIZE) {
+                        unknown.pblock = std::make_shared<const CBlock>(block);
+                        unknown.nSize = entry->nSize;
+                        nUnknownParentBufferSize += unknown.nSize;
+                    } else if (!dbp) {
+                        // Can't be read back from disk later
+                        continue;
+                    }
+                    mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, unknown));
                     continue;
                 }
 
@@ -4661,22 +5003,29 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 while (!queue.empty()) {
                     uint256 head = queue.front();
                     queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                    std::pair<std::multimap<uint256, CUnknownParentBlock>::iterator, std::multimap<uint256, CUnknownParentBlock>::iterator> range = mapBlocksUnknownParent.equal_range(head);
                     while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second, chainparams.GetConsensus()))
+                        std::multimap<uint256, CUnknownParentBlock>::iterator it = range.first;
+                        std::shared_ptr<const CBlock> pblockChild = it->second.pblock;
+                        if (!pblockChild) {
+                            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+                            if (ReadBlockFromDisk(*pblockRead, it->second.pos, chainparams.GetConsensus()))
+                                pblockChild = pblockRead;
+                        }
+                        if (pblockChild)
                         {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockChild->GetHash().ToString(),
                                     head.ToString());
                             LOCK(cs_main);
                             CValidationState dummy;
-                            if (AcceptBlock(block, dummy, chainparams, NULL, true, &it->second, NULL))
+                            if (AcceptBlock(*pblockChild, dummy, chainparams, NULL, true, it->second.pos.IsNull() ? NULL : &it->second.pos, NULL))
                             {
                                 nLoaded++;
-                                queue.push_back(block.GetHash());
+                                queue.push_back(pblockChild->GetHash());
                             }
                         }
                         range.first++;
+                        nUnknownParentBufferSize -= it->second.nSize;
                         mapBlocksUnknownParent.erase(it);
                         NotifyHeaderTip();
                     }
@@ -4688,8 +5037,10 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
+    int64_t nTime = std::max(GetTimeMillis() - nStart, (int64_t)1);
     if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+        LogPrintf("Loaded %i blocks from external file in %dms (read %i blocks, %.1f blocks/s, %.2f MB/s)\n", nLoaded, nTime,
+                  nRead, nRead * 1000.0 / nTime, nReadSize * 1000.0 / nTime / (1024 * 1024));
     return nLoaded > 0;
 }
 
@@ -4887,6 +5238,186 @@ ThresholdState VersionBitsTipState(const Consensus::Params& params, Consensus::D
     return VersionBitsState(chainActive.Tip(), params, pos, versionbitscache);
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+
+static void AcceptMempoolBatch(const std::vector<CTransaction>& vtx, const std::vector<int64_t>& vAcceptTime, int& nAccepted, int& nFailed)
+{
+    std::vector<const CTransaction*> vptx;
+    BOOST_FOREACH(const CTransaction& tx, vtx)
+        vptx.push_back(&tx);
+
+    std::vector<CTxAcceptResult> vResults;
+    {
+        LOCK(cs_main);
+        AcceptToMemoryPoolBatch(mempool, vptx, vResults, true, false, false, &vAcceptTime);
+    }
+    BOOST_FOREACH(const CTxAcceptResult& result, vResults) {
+        if (result.fAccepted)
+            nAccepted++;
+        else
+            nFailed++;
+    }
+}
+
+bool LoadMempool()
+{
+    int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    FILE* filestr = fopen((GetDataDir() / "mempool.dat").string().c_str(), "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    int64_t nStart = GetTimeMicros();
+    int64_t nNow = GetTime();
+    int nAccepted = 0, nFailed = 0, nExpired = 0, nLocks = 0;
+
+    try {
+        uint64_t nVersion;
+        file >> nVersion;
+        if (nVersion != MEMPOOL_DUMP_VERSION) {
+            LogPrintf("Unknown mempool file version %u. Continuing anyway.\n", nVersion);
+            return false;
+        }
+
+        // The deltas come first, so the transactions are accepted with them
+        std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+        file >> mapDeltas;
+        for (std::map<uint256, std::pair<double, CAmount> >::const_iterator it = mapDeltas.begin(); it != mapDeltas.end(); ++it)
+            mempool.PrioritiseTransaction(it->first, it->first.ToString(), it->second.first, it->second.second);
+
+        // Parents are written before their children, so batches can be
+        // accepted in the order they were written
+        uint64_t nCount;
+        file >> nCount;
+        std::vector<CTransaction> vtx;
+        std::vector<int64_t> vAcceptTime;
+        for (uint64_t i = 0; i < nCount; i++) {
+            CTransaction tx;
+            int64_t nTime;
+            file >> tx;
+            file >> nTime;
+
+            if (nTime + nExpiryTimeout <= nNow) {
+                nExpired++;
+                continue;
+            }
+            vtx.push_back(tx);
+            vAcceptTime.push_back(nTime);
+
+            if (vtx.size() == MEMPOOL_LOAD_BATCH) {
+                AcceptMempoolBatch(vtx, vAcceptTime, nAccepted, nFailed);
+                vtx.clear();
+                vAcceptTime.clear();
+            }
+            if (ShutdownRequested())
+                return false;
+        }
+        if (!vtx.empty())
+            AcceptMempoolBatch(vtx, vAcceptTime, nAccepted, nFailed);
+
+        // Locks of transactions that made it back into the mempool
+        std::map<uint256, std::vector<CTxLockVote> > mapLockVotes;
+        file >> mapLockVotes;
+        for (std::map<uint256, std::vector<CTxLockVote> >::const_iterator it = mapLockVotes.begin(); it != mapLockVotes.end(); ++it) {
+            CTransaction tx;
+            if (mempool.lookup(it->first, tx) && instantsend.RestoreTxLock(CTxLockRequest(tx), it->second))
+                nLocks++;
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired, %i InstantSend locks restored (%.2fs)\n",
+              nAccepted, nFailed, nExpired, nLocks, (GetTimeMicros() - nStart) * 0.000001);
+    return true;
+}
+
+bool DumpMempool()
+{
+    // Shutdown and the scheduler thread may dump at the same time
+    static CCriticalSection cs_dumpmempool;
+    LOCK(cs_dumpmempool);
+
+    int64_t nStart = GetTimeMicros();
+
+    // Taken before mempool.cs, like everywhere else
+    std::map<uint256, std::vector<CTxLockVote> > mapLockVotes;
+    instantsend.GetLockedTxVotes(mapLockVotes);
+
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    std::vector<std::pair<CTransaction, int64_t> > vtx;
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+
+        // Write every entry after its in-mempool parents. The parent links
+        // are always up to date, unlike the descendant state of entries
+        // that were re-added in a reorg. An entry is pushed again with
+        // true once its parents are on the stack, to be written after them.
+        CTxMemPool::setEntries setVisited;
+        std::vector<std::pair<CTxMemPool::txiter, bool> > vStack;
+        vtx.reserve(mempool.mapTx.size());
+        for (CTxMemPool::txiter it = mempool.mapTx.begin(); it != mempool.mapTx.end(); ++it) {
+            vStack.push_back(std::make_pair(it, false));
+            while (!vStack.empty()) {
+                std::pair<CTxMemPool::txiter, bool> item = vStack.back();
+                vStack.pop_back();
+                if (item.second) {
+                    vtx.push_back(std::make_pair(item.first->GetTx(), item.first->GetTime()));
+                    continue;
+                }
+                if (!setVisited.insert(item.first).second)
+                    continue;
+                vStack.push_back(std::make_pair(item.first, true));
+                BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(item.first)) {
+                    if (!setVisited.count(parent))
+                        vStack.push_back(std::make_pair(parent, false));
+                }
+            }
+        }
+
+        std::map<uint256, std::vector<CTxLockVote> >::iterator itLock = mapLockVotes.begin();
+        while (itLock != mapLockVotes.end()) {
+            if (mempool.mapTx.count(itLock->first))
+                ++itLock;
+            else
+                mapLockVotes.erase(itLock++);
+        }
+    }
+
+    int64_t nMid = GetTimeMicros();
+
+    try {
+        FILE* filestr = fopen((GetDataDir() / "mempool.dat.new").string().c_str(), "wb");
+        if (!filestr)
+            return false;
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        file << MEMPOOL_DUMP_VERSION;
+        file << mapDeltas;
+        file << (uint64_t)vtx.size();
+        for (size_t i = 0; i < vtx.size(); i++) {
+            file << vtx[i].first;
+            file << vtx[i].second;
+        }
+        file << mapLockVotes;
+
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Dumped mempool: %u transactions, %u InstantSend locks, %.3fs to copy, %.3fs to dump\n",
+              vtx.size(), mapLockVotes.size(), (nMid - nStart) * 0.000001, (GetTimeMicros() - nMid) * 0.000001);
+    return true;
+}
+
 class CMainCleanup
 {
 public:
@@ -13,6 +13,7 @@
 #include "amount.h"
 #include "chain.h"
 #include "coins.h"
+#include "consensus/validation.h"
 #include "net.h"
 #include "script/script_error.h"
 #include "sync.h"
@@ -35,15 +36,16 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewBackgroundFlush;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
 class CScriptCheck;
 class CTxMemPool;
 class CValidationInterface;
-class CValidationState;
 
 struct PrecomputedTransactionData;
 struct CNodeStateStats;
@@ -80,6 +82,10 @@ static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Transactions of mempool.dat accepted at once when it is loaded */
+static const unsigned int MEMPOOL_LOAD_BATCH = 500;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -92,6 +98,14 @@ static const int64_t DUST_HARD_LIMIT = 1000;   // 0.00001 SMART mininput
 static const int MAX_SCRIPTCHECK_THREADS = 15;  // was 16
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads deserializing blocks ahead during -reindex and -loadblock */
+static const int MAX_BLOCKFILE_PREFETCH_THREADS = 4;
+/** Maximum size of the blocks read ahead of the one being processed during -reindex and -loadblock */
+static const unsigned int MAX_BLOCKFILE_PREFETCH_SIZE = 64 * 1024 * 1024;
+/** Maximum size of the blocks checked ahead of the one being disconnected by VerifyDB */
+static const unsigned int MAX_VERIFYDB_PREFETCH_SIZE = 64 * 1024 * 1024;
+/** Maximum size of the out of order blocks kept in memory until their parent is known */
+static const unsigned int MAX_BLOCKFILE_ORPHAN_BUFFER_SIZE = 32 * 1024 * 1024;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 64;  //was 16
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -150,6 +164,9 @@ static const bool DEFAULT_ADDRESSINDEX = false; // WIP-VOTING, Voting set to tru
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
 static const bool DEFAULT_DEPOSITINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = true;
+/** Default for -backgroundflush */
+static const bool DEFAULT_BACKGROUND_FLUSH = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 static const bool DEFAULT_TESTSAFEMODE = false;
@@ -192,6 +209,9 @@ extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fInstantPayIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fDepositIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
@@ -349,6 +369,34 @@ int64_t GetBlockValue(int nHeight, int64_t nFees, unsigned int nTime);
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fOverrideMempoolLimit=false, bool fRejectAbsurdFee=false, bool fDryRun=false);
 
+/** Outcome of one transaction of AcceptToMemoryPoolBatch */
+struct CTxAcceptResult
+{
+    CValidationState state;
+    bool fAccepted;
+    bool fMissingInputs;
+
+    CTxAcceptResult() : fAccepted(false), fMissingInputs(false) {}
+};
+
+/**
+ * (try to) add a batch of transactions to memory pool, in the given order.
+ * The outcome is the same as calling AcceptToMemoryPool for each of them but
+ * the inputs of all transactions are fetched in one pass and their signatures
+ * are verified in parallel by the script check threads ahead of the serial
+ * checks, which then find them in the signature cache. Requires cs_main, which
+ * is held for the whole batch. pvAcceptTime optionally gives the entry time
+ * of each transaction, it is the current time otherwise.
+ */
+void AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<const CTransaction*>& vtx, std::vector<CTxAcceptResult>& vResults,
+                             bool fLimitFree, bool fOverrideMempoolLimit=false, bool fRejectAbsurdFee=false,
+                             const std::vector<int64_t>* pvAcceptTime=NULL);
+
+/** Write the mempool, its fee deltas and the completed InstantSend locks of it to mempool.dat */
+bool DumpMempool();
+/** Accept the transactions of mempool.dat again and restore their InstantSend locks */
+bool LoadMempool();
+
 bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin);
 int GetUTXOHeight(const COutPoint& outpoint);
 int GetUTXOConfirmations(const COutPoint& outpoint);
@@ -513,6 +561,8 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
 bool GetAddresses(std::vector<CAddressListEntry> &addressList,int nEndHeight = -1, bool excludeZeroBalances = false);
+bool GetRichList(std::vector<CAddressListEntry> &vecEntries, CAmount nMinBalance = 1, int offset = 0, int limit = -1);
+bool GetRichListCount(int &count, CAmount nMinBalance = 1);
 bool GetAddressUnspentCount(uint160 addressHash, int type, int &count, CAddressUnspentKey &lastIndex);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
@@ -536,6 +586,11 @@ bool GetInvalidVoteKeyRegistration(const uint256 &txHash);
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the serialized block as stored in the block files, without deserializing it. The
+ *  on-disk format equals the network format, so the data can be relayed or returned as is. */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -603,6 +658,9 @@ extern CChain chainActive;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern CCoinsViewDB *pcoinsdbview;
 
+/** Global variable that points to the writer between pcoinsTip and the coins database (protected by cs_main) */
+extern CCoinsViewBackgroundFlush *pcoinsflusher;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
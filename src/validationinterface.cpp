@@ -17,6 +17,8 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
     g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
+    g_signals.BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
+    g_signals.BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
     g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
     g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
     g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
@@ -25,9 +27,17 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    g_signals.AddressIndexUpdated.connect(boost::bind(&CValidationInterface::AddressIndexUpdated, pwalletIn, _1, _2, _3));
+    g_signals.SmartRewardsRoundStarted.connect(boost::bind(&CValidationInterface::SmartRewardsRoundStarted, pwalletIn, _1, _2));
+    g_signals.SmartRewardsRoundReopened.connect(boost::bind(&CValidationInterface::SmartRewardsRoundReopened, pwalletIn, _1));
+    g_signals.SmartnodeListChanged.connect(boost::bind(&CValidationInterface::SmartnodeListChanged, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_signals.SmartnodeListChanged.disconnect(boost::bind(&CValidationInterface::SmartnodeListChanged, pwalletIn, _1));
+    g_signals.SmartRewardsRoundReopened.disconnect(boost::bind(&CValidationInterface::SmartRewardsRoundReopened, pwalletIn, _1));
+    g_signals.SmartRewardsRoundStarted.disconnect(boost::bind(&CValidationInterface::SmartRewardsRoundStarted, pwalletIn, _1, _2));
+    g_signals.AddressIndexUpdated.disconnect(boost::bind(&CValidationInterface::AddressIndexUpdated, pwalletIn, _1, _2, _3));
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -36,6 +46,8 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
     g_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
+    g_signals.BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
     g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
     g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.NotifyHeaderTip.disconnect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
@@ -43,6 +55,10 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_signals.SmartnodeListChanged.disconnect_all_slots();
+    g_signals.SmartRewardsRoundReopened.disconnect_all_slots();
+    g_signals.SmartRewardsRoundStarted.disconnect_all_slots();
+    g_signals.AddressIndexUpdated.disconnect_all_slots();
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
@@ -51,6 +67,8 @@ void UnregisterAllValidationInterfaces() {
     g_signals.SetBestChain.disconnect_all_slots();
     g_signals.UpdatedTransaction.disconnect_all_slots();
     g_signals.NotifyTransactionLock.disconnect_all_slots();
+    g_signals.BlockDisconnected.disconnect_all_slots();
+    g_signals.BlockConnected.disconnect_all_slots();
     g_signals.SyncTransaction.disconnect_all_slots();
     g_signals.UpdatedBlockTip.disconnect_all_slots();
     g_signals.NotifyHeaderTip.disconnect_all_slots();
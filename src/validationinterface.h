@@ -14,6 +14,10 @@ struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
 class CReserveScript;
+class CSmartRewardRound;
+struct CAddressIndexBlockData;
+struct CSmartRewardsRoundResult;
+struct CSmartnodeListDiff;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -29,11 +33,15 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterAllValidationInterfaces();
 
 class CValidationInterface {
+public:
+    virtual ~CValidationInterface() {}
 protected:
     virtual void AcceptedBlockHeader(const CBlockIndex *pindexNew) {}
     virtual void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) {}
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
+    virtual void BlockConnected(const CBlock &block, const CBlockIndex *pindex) {}
+    virtual void BlockDisconnected(const CBlock &block, const CBlockIndex *pindex) {}
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
@@ -42,6 +50,10 @@ protected:
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {}
     virtual void ResetRequestCount(const uint256 &hash) {}
+    virtual void AddressIndexUpdated(const CBlockIndex *pindex, bool fConnect, const CAddressIndexBlockData &data) {}
+    virtual void SmartRewardsRoundStarted(const CSmartRewardRound &round, const CSmartRewardsRoundResult *pFinished) {}
+    virtual void SmartRewardsRoundReopened(const CSmartRewardRound &round) {}
+    virtual void SmartnodeListChanged(const CSmartnodeListDiff &diff) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -56,6 +68,10 @@ struct CMainSignals {
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
     boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
+    /** Notifies listeners of a block being connected to the active chain. */
+    boost::signals2::signal<void (const CBlock &, const CBlockIndex *)> BlockConnected;
+    /** Notifies listeners of a block being disconnected from the active chain. */
+    boost::signals2::signal<void (const CBlock &, const CBlockIndex *)> BlockDisconnected;
     /** Notifies listeners of an updated transaction lock without new data. */
     boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
@@ -72,6 +88,14 @@ struct CMainSignals {
     boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
     /** Notifies listeners that a block has been successfully mined */
     boost::signals2::signal<void (const uint256 &)> BlockFound;
+    /** Notifies listeners of the address index entries of a block written (fConnect) or removed by the address indexer */
+    boost::signals2::signal<void (const CBlockIndex *, bool fConnect, const CAddressIndexBlockData &)> AddressIndexUpdated;
+    /** Notifies listeners of a new SmartRewards round and the results of the round it replaced (NULL if there was none) */
+    boost::signals2::signal<void (const CSmartRewardRound &, const CSmartRewardsRoundResult *)> SmartRewardsRoundStarted;
+    /** Notifies listeners of a finished SmartRewards round that became current again because its last block was disconnected */
+    boost::signals2::signal<void (const CSmartRewardRound &)> SmartRewardsRoundReopened;
+    /** Notifies listeners of smartnodes added to or removed from the list */
+    boost::signals2::signal<void (const CSmartnodeListDiff &)> SmartnodeListChanged;
 };
 
 CMainSignals& GetMainSignals();
@@ -2929,55 +2929,55 @@ extern UniValue importprunedfunds(const UniValue& params, bool fHelp);
 extern UniValue removeprunedfunds(const UniValue& params, bool fHelp);
 
 static const CRPCCommand commands[] =
-{ //  category              name                        actor (function)           okSafeMode
-    //  --------------------- ------------------------    -----------------------    ----------
-    { "rawtransactions",    "fundrawtransaction",       &fundrawtransaction,       false },
-    { "hidden",             "resendwallettransactions", &resendwallettransactions, true  },
-    { "wallet",             "abandontransaction",       &abandontransaction,       false },
-    { "wallet",             "addmultisigaddress",       &addmultisigaddress,       true  },
-    { "wallet",             "addwitnessaddress",        &addwitnessaddress,        true  },
-    { "wallet",             "backupwallet",             &backupwallet,             true  },
-    { "wallet",             "dumpprivkey",              &dumpprivkey,              true  },
-    { "wallet",             "dumpwallet",               &dumpwallet,               true  },
-    { "wallet",             "encryptwallet",            &encryptwallet,            true  },
-    { "wallet",             "getaccountaddress",        &getaccountaddress,        true  },
-    { "wallet",             "getaccount",               &getaccount,               true  },
-    { "wallet",             "getaddress",               &getaddress,               true  },
-    { "wallet",             "getaddressesbyaccount",    &getaddressesbyaccount,    true  },
-    { "wallet",             "getbalance",               &getbalance,               false },
-    { "wallet",             "getnewaddress",            &getnewaddress,            true  },
-    { "wallet",             "getrawchangeaddress",      &getrawchangeaddress,      true  },
-    { "wallet",             "getreceivedbyaccount",     &getreceivedbyaccount,     false },
-    { "wallet",             "getreceivedbyaddress",     &getreceivedbyaddress,     false },
-    { "wallet",             "gettransaction",           &gettransaction,           false },
-    { "wallet",             "getunconfirmedbalance",    &getunconfirmedbalance,    false },
-    { "wallet",             "getwalletinfo",            &getwalletinfo,            false },
-    { "wallet",             "importprivkey",            &importprivkey,            true  },
-    { "wallet",             "importwallet",             &importwallet,             true  },
-    { "wallet",             "importaddress",            &importaddress,            true  },
+{ //  category              name                        actor (function)           okSafeMode  streamActor
+    //  --------------------- ------------------------    -----------------------    ----------  -----------
+    { "rawtransactions",    "fundrawtransaction",       &fundrawtransaction,       false, NULL },
+    { "hidden",             "resendwallettransactions", &resendwallettransactions, true,  NULL },
+    { "wallet",             "abandontransaction",       &abandontransaction,       false, NULL },
+    { "wallet",             "addmultisigaddress",       &addmultisigaddress,       true,  NULL },
+    { "wallet",             "addwitnessaddress",        &addwitnessaddress,        true,  NULL },
+    { "wallet",             "backupwallet",             &backupwallet,             true,  NULL },
+    { "wallet",             "dumpprivkey",              &dumpprivkey,              true,  NULL },
+    { "wallet",             "dumpwallet",               &dumpwallet,               true,  NULL },
+    { "wallet",             "encryptwallet",            &encryptwallet,            true,  NULL },
+    { "wallet",             "getaccountaddress",        &getaccountaddress,        true,  NULL },
+    { "wallet",             "getaccount",               &getaccount,               true,  NULL },
+    { "wallet",             "getaddress",               &getaddress,               true,  NULL },
+    { "wallet",             "getaddressesbyaccount",    &getaddressesbyaccount,    true,  NULL },
+    { "wallet",             "getbalance",               &getbalance,               false, NULL },
+    { "wallet",             "getnewaddress",            &getnewaddress,            true,  NULL },
+    { "wallet",             "getrawchangeaddress",      &getrawchangeaddress,      true,  NULL },
+    { "wallet",             "getreceivedbyaccount",     &getreceivedbyaccount,     false, NULL },
+    { "wallet",             "getreceivedbyaddress",     &getreceivedbyaddress,     false, NULL },
+    { "wallet",             "gettransaction",           &gettransaction,           false, NULL },
+    { "wallet",             "getunconfirmedbalance",    &getunconfirmedbalance,    false, NULL },
+    { "wallet",             "getwalletinfo",            &getwalletinfo,            false, NULL },
+    { "wallet",             "importprivkey",            &importprivkey,            true,  NULL },
+    { "wallet",             "importwallet",             &importwallet,             true,  NULL },
+    { "wallet",             "importaddress",            &importaddress,            true,  NULL },
     //{ "wallet",             "importprunedfunds",        &importprunedfunds,        true  },
-    { "wallet",             "importpubkey",             &importpubkey,             true  },
-    { "wallet",             "instantsendtoaddress",     &instantsendtoaddress,     false },
-    { "wallet",             "keypoolrefill",            &keypoolrefill,            true  },
-    { "wallet",             "listaccounts",             &listaccounts,             false },
-    { "wallet",             "listaddressgroupings",     &listaddressgroupings,     false },
-    { "wallet",             "listlockunspent",          &listlockunspent,          false },
-    { "wallet",             "listreceivedbyaccount",    &listreceivedbyaccount,    false },
-    { "wallet",             "listreceivedbyaddress",    &listreceivedbyaddress,    false },
-    { "wallet",             "listsinceblock",           &listsinceblock,           false },
-    { "wallet",             "listtransactions",         &listtransactions,         false },
-    { "wallet",             "listunspent",              &listunspent,              false },
-    { "wallet",             "lockunspent",              &lockunspent,              true  },
-    { "wallet",             "move",                     &movecmd,                  false },
-    { "wallet",             "sendfrom",                 &sendfrom,                 false },
-    { "wallet",             "sendmany",                 &sendmany,                 false },
-    { "wallet",             "sendtoaddress",            &sendtoaddress,            false },
-    { "wallet",             "setaccount",               &setaccount,               true  },
-    { "wallet",             "settxfee",                 &settxfee,                 true  },
-    { "wallet",             "signmessage",              &signmessage,              true  },
-    { "wallet",             "walletlock",               &walletlock,               true  },
-    { "wallet",             "walletpassphrasechange",   &walletpassphrasechange,   true  },
-    { "wallet",             "walletpassphrase",         &walletpassphrase,         true  },
+    { "wallet",             "importpubkey",             &importpubkey,             true,  NULL },
+    { "wallet",             "instantsendtoaddress",     &instantsendtoaddress,     false, NULL },
+    { "wallet",             "keypoolrefill",            &keypoolrefill,            true,  NULL },
+    { "wallet",             "listaccounts",             &listaccounts,             false, NULL },
+    { "wallet",             "listaddressgroupings",     &listaddressgroupings,     false, NULL },
+    { "wallet",             "listlockunspent",          &listlockunspent,          false, NULL },
+    { "wallet",             "listreceivedbyaccount",    &listreceivedbyaccount,    false, NULL },
+    { "wallet",             "listreceivedbyaddress",    &listreceivedbyaddress,    false, NULL },
+    { "wallet",             "listsinceblock",           &listsinceblock,           false, NULL },
+    { "wallet",             "listtransactions",         &listtransactions,         false, NULL },
+    { "wallet",             "listunspent",              &listunspent,              false, NULL },
+    { "wallet",             "lockunspent",              &lockunspent,              true,  NULL },
+    { "wallet",             "move",                     &movecmd,                  false, NULL },
+    { "wallet",             "sendfrom",                 &sendfrom,                 false, NULL },
+    { "wallet",             "sendmany",                 &sendmany,                 false, NULL },
+    { "wallet",             "sendtoaddress",            &sendtoaddress,            false, NULL },
+    { "wallet",             "setaccount",               &setaccount,               true,  NULL },
+    { "wallet",             "settxfee",                 &settxfee,                 true,  NULL },
+    { "wallet",             "signmessage",              &signmessage,              true,  NULL },
+    { "wallet",             "walletlock",               &walletlock,               true,  NULL },
+    { "wallet",             "walletpassphrasechange",   &walletpassphrasechange,   true,  NULL },
+    { "wallet",             "walletpassphrase",         &walletpassphrase,         true,  NULL },
     //{ "wallet",             "removeprunedfunds",        &removeprunedfunds,        true  },
 };
 
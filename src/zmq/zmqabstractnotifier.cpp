@@ -16,6 +16,11 @@ bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/)
     return true;
 }
 
+bool CZMQAbstractNotifier::NotifyRawBlock(const CBlockIndex * /*pindex*/, const CDataStream &/*ssBlock*/)
+{
+    return true;
+}
+
 bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/)
 {
     return true;
@@ -25,3 +30,18 @@ bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transacti
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyAddressIndex(const CBlockIndex * /*pindex*/, bool /*fConnect*/, const CAddressIndexBlockData &/*data*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifySmartRewardsRound(const CSmartRewardRound &/*round*/, const CSmartRewardsRoundResult * /*pFinished*/, bool /*fReopened*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifySmartnodeList(const CSmartnodeListDiff &/*diff*/)
+{
+    return true;
+}
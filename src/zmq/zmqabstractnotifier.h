@@ -8,7 +8,12 @@
 #include "zmqconfig.h"
 
 class CBlockIndex;
+class CDataStream;
+class CSmartRewardRound;
 class CZMQAbstractNotifier;
+struct CAddressIndexBlockData;
+struct CSmartRewardsRoundResult;
+struct CSmartnodeListDiff;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -33,8 +38,15 @@ public:
     virtual void Shutdown() = 0;
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
+    //! Whether NotifyRawBlock should be called with the serialized block
+    virtual bool NeedsRawBlock() const { return false; }
+    virtual bool NotifyRawBlock(const CBlockIndex *pindex, const CDataStream &ssBlock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyAddressIndex(const CBlockIndex *pindex, bool fConnect, const CAddressIndexBlockData &data);
+    //! pFinished is the result of the round replaced by round, fReopened is set if a disconnected block made it current again
+    virtual bool NotifySmartRewardsRound(const CSmartRewardRound &round, const CSmartRewardsRoundResult *pFinished, bool fReopened);
+    virtual bool NotifySmartnodeList(const CSmartnodeListDiff &diff);
 
 protected:
     void *psocket;
@@ -5,6 +5,7 @@
 #include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
 
+#include "chainparams.h"
 #include "version.h"
 #include "validation.h"
 #include "streams.h"
@@ -15,7 +16,7 @@ void zmqError(const char *str)
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL), fRawBlock(false)
 {
 }
 
@@ -41,6 +42,9 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubaddressdelta"] = CZMQAbstractNotifier::Create<CZMQPublishAddressDeltaNotifier>;
+    factories["pubrewardsround"] = CZMQAbstractNotifier::Create<CZMQPublishRewardsRoundNotifier>;
+    factories["pubsmartnodelist"] = CZMQAbstractNotifier::Create<CZMQPublishSmartnodeListNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -61,6 +65,9 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
 
+        for (CZMQAbstractNotifier *notifier : notifiers)
+            notificationInterface->fRawBlock |= notifier->NeedsRawBlock();
+
         if (!notificationInterface->Initialize())
         {
             delete notificationInterface;
@@ -126,15 +133,15 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+template <typename Function>
+void CZMQNotificationInterface::ForEachNotifier(const Function &func)
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
+    LOCK(cs);
 
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (func(notifier))
         {
             i++;
         }
@@ -146,36 +153,79 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
     }
 }
 
-void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+void CZMQNotificationInterface::BlockConnected(const CBlock &block, const CBlockIndex *pindex)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+    // Called with cs_main held, UpdatedBlockTip would skip the block during the initial download anyway
+    if (!fRawBlock || IsInitialBlockDownload())
+        return;
+
+    std::shared_ptr<CDataStream> pssBlock = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION);
+    *pssBlock << block;
+
+    LOCK(cs);
+    hashLastBlock = pindex->GetBlockHash();
+    pssLastBlock = pssBlock;
+}
+
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    std::shared_ptr<const CDataStream> pssBlock;
+
+    if (fRawBlock) {
         {
-            i++;
+            LOCK(cs);
+            if (hashLastBlock == pindexNew->GetBlockHash())
+                pssBlock = pssLastBlock;
         }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+
+        // Another thread connected a block in the meantime, read the tip back from disk
+        if (!pssBlock) {
+            LOCK(cs_main);
+            CBlock block;
+            if (ReadBlockFromDisk(block, pindexNew, Params().GetConsensus())) {
+                std::shared_ptr<CDataStream> pssRead = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION);
+                *pssRead << block;
+                pssBlock = pssRead;
+            } else {
+                zmqError("Can't read block from disk");
+            }
         }
     }
+
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) {
+        return notifier->NotifyBlock(pindexNew) && (!pssBlock || notifier->NotifyRawBlock(pindexNew, *pssBlock));
+    });
+}
+
+void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+{
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifyTransaction(tx); });
 }
 
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransactionLock(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifyTransactionLock(tx); });
+}
+
+void CZMQNotificationInterface::AddressIndexUpdated(const CBlockIndex *pindex, bool fConnect, const CAddressIndexBlockData &data)
+{
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifyAddressIndex(pindex, fConnect, data); });
+}
+
+void CZMQNotificationInterface::SmartRewardsRoundStarted(const CSmartRewardRound &round, const CSmartRewardsRoundResult *pFinished)
+{
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifySmartRewardsRound(round, pFinished, false); });
+}
+
+void CZMQNotificationInterface::SmartRewardsRoundReopened(const CSmartRewardRound &round)
+{
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifySmartRewardsRound(round, NULL, true); });
+}
+
+void CZMQNotificationInterface::SmartnodeListChanged(const CSmartnodeListDiff &diff)
+{
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifySmartnodeList(diff); });
 }
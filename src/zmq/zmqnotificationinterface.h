@@ -5,7 +5,12 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include "streams.h"
+#include "sync.h"
+#include "uint256.h"
 #include "validationinterface.h"
+#include <list>
+#include <memory>
 #include <string>
 #include <map>
 
@@ -27,12 +32,30 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     void NotifyTransactionLock(const CTransaction &tx);
+    void BlockConnected(const CBlock &block, const CBlockIndex *pindex);
+    void AddressIndexUpdated(const CBlockIndex *pindex, bool fConnect, const CAddressIndexBlockData &data);
+    void SmartRewardsRoundStarted(const CSmartRewardRound &round, const CSmartRewardsRoundResult *pFinished);
+    void SmartRewardsRoundReopened(const CSmartRewardRound &round);
+    void SmartnodeListChanged(const CSmartnodeListDiff &diff);
 
 private:
     CZMQNotificationInterface();
 
+    //! Call func for every notifier, shutting down and removing the ones it fails for
+    template <typename Function>
+    void ForEachNotifier(const Function &func);
+
     void *pcontext;
+
+    /** Notifications come from the validation, indexer and network threads.
+     *  Nothing else is locked while holding cs, so it can be taken with cs_main held. */
+    CCriticalSection cs;
     std::list<CZMQAbstractNotifier*> notifiers;
+    //! Set if any notifier needs serialized blocks
+    bool fRawBlock;
+    //! Last connected block, serialized while it is in memory (protected by cs)
+    uint256 hashLastBlock;
+    std::shared_ptr<const CDataStream> pssLastBlock;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -2,11 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
-#include "chainparams.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
 #include "util.h"
+#include "index/addressindexdb.h"
+#include "smartnode/smartnodeman.h"
+#include "smartrewards/rewards.h"
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +18,14 @@ static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_ADDRESSDELTA  = "addressdelta";
+static const char *MSG_REWARDSROUND  = "rewardsround";
+static const char *MSG_SMARTNODELIST = "smartnodelist";
+
+// Events of the rewardsround message
+static const unsigned char REWARDSROUND_STARTED  = 0;
+static const unsigned char REWARDSROUND_FINISHED = 1;
+static const unsigned char REWARDSROUND_REOPENED = 2;
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -173,25 +183,10 @@ bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransa
     return SendMessage(MSG_HASHTXLOCK, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyRawBlock(const CBlockIndex *pindex, const CDataStream &ssBlock)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
-
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
-    }
-
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, &(*ssBlock.begin()), ssBlock.size());
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -211,3 +206,62 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     ss << transaction;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishAddressDeltaNotifier::NotifyAddressIndex(const CBlockIndex *pindex, bool fConnect, const CAddressIndexBlockData &data)
+{
+    CAddressBalanceDeltaMap mapDeltas;
+    GetAddressBalanceDeltas(data, fConnect, mapDeltas);
+
+    LogPrint("zmq", "zmq: Publish addressdelta %s (%s), %u addresses\n", pindex->GetBlockHash().GetHex(), fConnect ? "connected" : "disconnected", mapDeltas.size());
+
+    /* block hash, height, connected flag, then per address:
+       type, hash160, balance change and received amount change */
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << pindex->GetBlockHash() << pindex->nHeight << (unsigned char)fConnect;
+    WriteCompactSize(ss, mapDeltas.size());
+    for (const auto &delta : mapDeltas)
+        ss << (unsigned char)delta.first.first << delta.first.second << delta.second.balance << delta.second.received;
+
+    return SendMessage(MSG_ADDRESSDELTA, &(*ss.begin()), ss.size());
+}
+
+static bool SendRewardsRound(CZMQAbstractPublishNotifier *notifier, unsigned char nEvent, const CSmartRewardRound &round, int64_t nPayees, CAmount nPaid)
+{
+    LogPrint("zmq", "zmq: Publish rewardsround %d, event %d\n", round.number, nEvent);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << nEvent << round.number << round.startBlockHeight << round.startBlockTime << round.endBlockHeight << round.endBlockTime;
+    ss << round.eligibleEntries << round.eligibleSmart << round.disqualifiedEntries << round.disqualifiedSmart << round.rewards;
+    ss << nPayees << nPaid;
+
+    return notifier->SendMessage(MSG_REWARDSROUND, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishRewardsRoundNotifier::NotifySmartRewardsRound(const CSmartRewardRound &round, const CSmartRewardsRoundResult *pFinished, bool fReopened)
+{
+    if (pFinished) {
+        CAmount nPaid = 0;
+        for (const CSmartRewardResultEntry *payout : pFinished->payouts)
+            nPaid += payout->reward;
+
+        if (!SendRewardsRound(this, REWARDSROUND_FINISHED, pFinished->round, pFinished->payouts.size(), nPaid))
+            return false;
+    }
+
+    return SendRewardsRound(this, fReopened ? REWARDSROUND_REOPENED : REWARDSROUND_STARTED, round, 0, 0);
+}
+
+bool CZMQPublishSmartnodeListNotifier::NotifySmartnodeList(const CSmartnodeListDiff &diff)
+{
+    LogPrint("zmq", "zmq: Publish smartnodelist, %u added, %u removed\n", diff.vecAdded.size(), diff.vecRemoved.size());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, diff.vecAdded.size());
+    for (const smartnode_info_t &info : diff.vecAdded)
+        ss << info.vin.prevout << info.addr << info.pubKeyCollateralAddress << info.pubKeySmartnode << info.nProtocolVersion << info.sigTime;
+    WriteCompactSize(ss, diff.vecRemoved.size());
+    for (const COutPoint &outpoint : diff.vecRemoved)
+        ss << outpoint;
+
+    return SendMessage(MSG_SMARTNODELIST, &(*ss.begin()), ss.size());
+}
@@ -49,7 +49,8 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NeedsRawBlock() const { return true; }
+    bool NotifyRawBlock(const CBlockIndex *pindex, const CDataStream &ssBlock);
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -64,4 +65,22 @@ public:
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishAddressDeltaNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyAddressIndex(const CBlockIndex *pindex, bool fConnect, const CAddressIndexBlockData &data);
+};
+
+class CZMQPublishRewardsRoundNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifySmartRewardsRound(const CSmartRewardRound &round, const CSmartRewardsRoundResult *pFinished, bool fReopened);
+};
+
+class CZMQPublishSmartnodeListNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifySmartnodeList(const CSmartnodeListDiff &diff);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H